@@ -0,0 +1,680 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "adc.h"
+#include "ratelimit.h"
+
+#define ADC_IDLE                    0xff
+#define ADC_BURST                   0xfe    // Converting for burst capture
+
+// Measurement data coding. Normalized integer, unit Volt, sensor index
+// is the channel. The value is sent in mV.
+#define ADC_DATACODING              0x80
+#define ADC_DECIMAL_POINT           0x83    // Three steps to the left
+
+adc_channel_t adc_channel[ ADC_CHANNELS ];
+uint8_t adc_enabled;                // Channels in use, one bit per channel
+uint8_t adc_oversample;             // 4^n samples per value
+uint16_t adc_fullscale;             // mV at full scale
+
+// Scan state - Used by interrupt
+uint8_t adc_ch;                     // Channel converting or ADC_IDLE
+uint8_t adc_rounds;                 // Scans summed so far
+uint16_t adc_acc[ ADC_CHANNELS ];   // Sum of samples
+
+// Values - Written by interrupt
+volatile uint16_t adc_value[ ADC_CHANNELS ];
+volatile uint8_t adc_ready;         // New value, one bit per channel
+
+// Event state
+uint16_t adc_last[ ADC_CHANNELS ];  // Value last sent
+uint8_t adc_valid;                  // Value seen, one bit per channel
+uint8_t adc_above;                  // Above threshold, one bit per channel
+uint8_t adc_period_cnt[ ADC_CHANNELS ];
+uint8_t adc_period_due;             // Period elapsed, one bit per channel
+
+// Burst capture
+uint16_t adc_burst_buf[ ADC_BURST_MAX ];
+volatile uint8_t adc_burst_state;
+uint8_t adc_burst_ch;
+uint16_t adc_burst_count;           // Samples to capture
+uint16_t adc_burst_period;          // Time stamp ticks between samples
+uint8_t adc_burst_interval;         // ms between streamed frames
+uint16_t adc_burst_n;               // Samples captured or sent
+uint32_t adc_burst_first;           // Time stamp of first and last
+uint32_t adc_burst_last;            // conversion start
+uint16_t adc_burst_rate;            // Effective sample rate (Hz)
+volatile uint8_t adc_burst_overruns;
+volatile uint8_t adc_burst_timer;   // ms since last streamed frame
+
+// Select channel and start conversion. Acquisition time is inserted
+// by the ADC (ACQT) so GO can be set right away.
+#define ADC_START( ch )             { ADCON0 = ( (ch) << 2 ) | 0x01;  \
+                                        ADCON0bits.GO = 1; }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// loadChannel
+//
+
+static void loadChannel( uint8_t ch )
+{
+    uint8_t addr = EEPROM_ADC_CHANNEL + ch * REG_ADC_CHANNEL_SIZE;
+
+    adc_channel[ ch ].flags = eeprom_read( addr + ADC_REG_FLAGS );
+    adc_channel[ ch ].threshold =
+            ( (uint16_t)eeprom_read( addr + ADC_REG_THRESHOLD_MSB ) << 8 ) |
+            eeprom_read( addr + ADC_REG_THRESHOLD_LSB );
+    adc_channel[ ch ].hysteresis =
+            ( (uint16_t)eeprom_read( addr + ADC_REG_HYSTERESIS_MSB ) << 8 ) |
+            eeprom_read( addr + ADC_REG_HYSTERESIS_LSB );
+    adc_channel[ ch ].delta =
+            ( (uint16_t)eeprom_read( addr + ADC_REG_DELTA_MSB ) << 8 ) |
+            eeprom_read( addr + ADC_REG_DELTA_LSB );
+    adc_channel[ ch ].period = eeprom_read( addr + ADC_REG_PERIOD );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// loadBurst
+//
+
+static void loadBurst( void )
+{
+    adc_burst_count = eeprom_read( EEPROM_ADC_BURST_COUNT );
+    if ( 0 == adc_burst_count ) adc_burst_count = ADC_BURST_MAX;
+
+    adc_burst_period = ( (uint16_t)eeprom_read( EEPROM_ADC_BURST_PERIOD_MSB ) << 8 ) |
+                            eeprom_read( EEPROM_ADC_BURST_PERIOD_LSB );
+    if ( adc_burst_period < ADC_BURST_MIN_PERIOD ) {
+        adc_burst_period = ADC_BURST_MIN_PERIOD;
+    }
+
+    adc_burst_interval = eeprom_read( EEPROM_ADC_BURST_INTERVAL );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// adc_init
+//
+
+void adc_init( void )
+{
+    uint8_t ch;
+    uint8_t gie;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+
+    adc_oversample = eeprom_read( EEPROM_ADC_OVERSAMPLE );
+    if ( adc_oversample > ADC_OVERSAMPLE_MAX ) {
+        adc_oversample = ADC_OVERSAMPLE_MAX;
+    }
+
+    adc_fullscale = ( (uint16_t)eeprom_read( EEPROM_ADC_FULLSCALE_MSB ) << 8 ) |
+                        eeprom_read( EEPROM_ADC_FULLSCALE_LSB );
+
+    loadBurst();
+
+    adc_enabled = 0;
+    for ( ch = 0; ch < ADC_CHANNELS; ch++ ) {
+
+        loadChannel( ch );
+
+        if ( PIN_MODE_ANALOG == pins_getMode( ADC_FIRST_PIN + ch ) ) {
+            adc_enabled |= ( 1 << ch );
+        }
+
+        adc_acc[ ch ] = 0;
+        adc_period_cnt[ ch ] = 0;
+    }
+
+    adc_ch = ADC_IDLE;
+    adc_rounds = 0;
+    adc_ready = 0;
+    adc_valid = 0;
+    adc_above = 0;
+    adc_period_due = 0;
+
+    // A burst in progress is dropped
+    PIE4bits.CCP4IE = 0;
+    CCP4CON = 0;
+    adc_burst_state = ADC_BURST_IDLE;
+
+    // CCP4 compare on Timer1 is the burst sample clock
+    CCPTMRSbits.C4TSEL = 0;
+    IPR4bits.CCP4IP = 0;
+
+    // AN0-AN4 analog for enabled channels
+    ANCON0 = adc_enabled;
+    ANCON1 = 0;
+
+    // AVDD/AVSS reference, single ended
+    ADCON1 = 0;
+
+    // Right justified, 4 TAD acquisition, Fosc/64 (TAD = 1.6 us)
+    ADCON2 = 0b10010110;
+
+    ADCON0 = adc_enabled ? 0x01 : 0x00;
+
+    IPR1bits.ADIP = 0;
+    PIR1bits.ADIF = 0;
+    PIE1bits.ADIE = adc_enabled ? 1 : 0;
+
+    INTCONbits.GIEL = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// adc_init_eeprom
+//
+
+void adc_init_eeprom( void )
+{
+    uint8_t ch;
+    uint8_t addr;
+
+    // No events. Threshold at half scale.
+    for ( ch = 0; ch < ADC_CHANNELS; ch++ ) {
+        addr = EEPROM_ADC_CHANNEL + ch * REG_ADC_CHANNEL_SIZE;
+        eeprom_write( addr + ADC_REG_FLAGS, 0 );
+        eeprom_write( addr + ADC_REG_THRESHOLD_MSB, 0x80 );
+        eeprom_write( addr + ADC_REG_THRESHOLD_LSB, 0x00 );
+        eeprom_write( addr + ADC_REG_HYSTERESIS_MSB, 0x04 );
+        eeprom_write( addr + ADC_REG_HYSTERESIS_LSB, 0x00 );
+        eeprom_write( addr + ADC_REG_DELTA_MSB, 0x01 );
+        eeprom_write( addr + ADC_REG_DELTA_LSB, 0x00 );
+        eeprom_write( addr + ADC_REG_PERIOD, 0 );
+    }
+
+    eeprom_write( EEPROM_ADC_OVERSAMPLE, ADC_DEFAULT_OVERSAMPLE );
+    eeprom_write( EEPROM_ADC_FULLSCALE_MSB, ( ADC_DEFAULT_FULLSCALE >> 8 ) & 0xff );
+    eeprom_write( EEPROM_ADC_FULLSCALE_LSB, ADC_DEFAULT_FULLSCALE & 0xff );
+
+    eeprom_write( EEPROM_ADC_BURST_COUNT, 0 );
+    eeprom_write( EEPROM_ADC_BURST_PERIOD_MSB, ( ADC_DEFAULT_BURST_PERIOD >> 8 ) & 0xff );
+    eeprom_write( EEPROM_ADC_BURST_PERIOD_LSB, ADC_DEFAULT_BURST_PERIOD & 0xff );
+    eeprom_write( EEPROM_ADC_BURST_INTERVAL, ADC_DEFAULT_BURST_INTERVAL );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// adc_tick
+//
+// One scan of all enabled channels each ms. The scan is chained from
+// the conversion done interrupt so nothing waits for the ADC.
+//
+
+void adc_tick( void )
+{
+    uint8_t ch;
+    uint16_t now;
+
+    adc_burst_timer++;
+
+    if ( !adc_enabled || ( ADC_IDLE != adc_ch ) ) return;
+
+    // Start a burst capture between scans. The channel is selected
+    // here so it is acquiring until the first sample is due.
+    if ( ADC_BURST_PENDING == adc_burst_state ) {
+
+        adc_ch = ADC_BURST;
+        adc_burst_n = 0;
+        adc_burst_state = ADC_BURST_CAPTURE;
+        ADCON0 = ( adc_burst_ch << 2 ) | 0x01;
+
+        TIMESTAMP_READ( now );
+        now += adc_burst_period;
+        CCPR4H = now >> 8;
+        CCPR4L = now & 0xff;
+
+        CCP4CON = 0b00001010;   // Compare, interrupt only
+        PIR4bits.CCP4IF = 0;
+        PIE4bits.CCP4IE = 1;
+        return;
+    }
+
+    for ( ch = 0; ch < ADC_CHANNELS; ch++ ) {
+        if ( adc_enabled & ( 1 << ch ) ) {
+            adc_ch = ch;
+            ADC_START( ch );
+            return;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// adc_isr
+//
+// Sum the sample and start the next channel. When 4^n scans are summed
+// the sums are scaled to 16 bits and handed to the main loop.
+//
+
+void adc_isr( void )
+{
+    uint8_t ch;
+    uint16_t sample;
+
+    PIR1bits.ADIF = 0;
+
+    sample = ( (uint16_t)ADRESH << 8 ) | ADRESL;
+
+    // Burst capture
+    if ( ADC_BURST == adc_ch ) {
+
+        adc_burst_buf[ adc_burst_n++ ] = sample;
+
+        if ( adc_burst_n >= adc_burst_count ) {
+            PIE4bits.CCP4IE = 0;
+            CCP4CON = 0;
+            adc_ch = ADC_IDLE;
+            adc_burst_n = 0;
+            adc_burst_state = ADC_BURST_STREAM;
+        }
+
+        return;
+    }
+
+    adc_acc[ adc_ch ] += sample;
+
+    for ( ch = adc_ch + 1; ch < ADC_CHANNELS; ch++ ) {
+        if ( adc_enabled & ( 1 << ch ) ) {
+            adc_ch = ch;
+            ADC_START( ch );
+            return;
+        }
+    }
+
+    // Scan done
+    adc_ch = ADC_IDLE;
+
+    if ( ++adc_rounds < ( 1 << ( 2 * adc_oversample ) ) ) return;
+    adc_rounds = 0;
+
+    for ( ch = 0; ch < ADC_CHANNELS; ch++ ) {
+        adc_value[ ch ] = adc_acc[ ch ] << ( 4 - 2 * adc_oversample );
+        adc_acc[ ch ] = 0;
+    }
+
+    adc_ready |= adc_enabled;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// adc_burst_isr
+//
+// CCP4 compare on the free running Timer1 gives the sample clock. The
+// next compare is set a period after the last one so the rate does not
+// drift with interrupt latency. A sample is an overrun if the previous
+// conversion is not done or the next compare is already passed.
+//
+
+void adc_burst_isr( void )
+{
+    uint16_t next;
+    uint16_t now;
+
+    PIR4bits.CCP4IF = 0;
+
+    next = ( ( (uint16_t)CCPR4H << 8 ) | CCPR4L ) + adc_burst_period;
+    TIMESTAMP_READ( now );
+    if ( (uint16_t)( next - now ) > adc_burst_period ) {
+        next = now + adc_burst_period;
+        if ( adc_burst_overruns < 255 ) adc_burst_overruns++;
+    }
+    CCPR4H = next >> 8;
+    CCPR4L = next & 0xff;
+
+    if ( ADCON0bits.GO ) {
+        if ( adc_burst_overruns < 255 ) adc_burst_overruns++;
+        return;
+    }
+
+    ADCON0bits.GO = 1;
+
+    // 32-bit time stamps for the effective rate
+    INTCONbits.GIEH = 0;
+    TIMESTAMP_READ32( adc_burst_last );
+    INTCONbits.GIEH = 1;
+    if ( 0 == adc_burst_n ) adc_burst_first = adc_burst_last;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// adc_startBurst
+//
+
+uint8_t adc_startBurst( uint8_t ch )
+{
+    if ( ch >= ADC_CHANNELS ) return FALSE;
+    if ( !( adc_enabled & ( 1 << ch ) ) ) return FALSE;
+    if ( ADC_BURST_IDLE != adc_burst_state ) return FALSE;
+
+    adc_burst_ch = ch;
+    adc_burst_state = ADC_BURST_PENDING;
+
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// streamBurst
+//
+// Send the captured samples four to a frame. Byte 0 is the frame
+// sequence index and bytes 1-6 hold the samples packed two in three
+// bytes. Frames are sent at low priority, spaced by the interval and
+// only while the transmit ring is at most half full so other traffic
+// gets through.
+//
+
+static void streamBurst( void )
+{
+    uint8_t i;
+    uint8_t data[ 7 ];
+    uint16_t s[ ADC_BURST_PER_FRAME ];
+    uint32_t ticks;
+
+    if ( ADC_BURST_STREAM != adc_burst_state ) return;
+    if ( adc_burst_timer < adc_burst_interval ) return;
+    if ( getCANTxFree() < ( CAN_TX_FIFO_SIZE / 2 ) ) return;
+    if ( !ratelimit_ready( VSCP_CLASS1_DATA ) ) return;
+
+    adc_burst_timer = 0;
+
+    // Effective rate for this capture
+    if ( 0 == adc_burst_n ) {
+        ticks = adc_burst_last - adc_burst_first;
+        adc_burst_rate = ticks ?
+                ( (uint32_t)( adc_burst_count - 1 ) * TIMESTAMP_TICKS_PER_SECOND ) / ticks :
+                0;
+    }
+
+    for ( i = 0; i < ADC_BURST_PER_FRAME; i++ ) {
+        s[ i ] = ( ( adc_burst_n + i ) < adc_burst_count ) ?
+                    adc_burst_buf[ adc_burst_n + i ] : 0;
+    }
+
+    data[ 0 ] = adc_burst_n / ADC_BURST_PER_FRAME;
+    data[ 1 ] = s[ 0 ] >> 4;
+    data[ 2 ] = ( ( s[ 0 ] & 0x0f ) << 4 ) | ( s[ 1 ] >> 8 );
+    data[ 3 ] = s[ 1 ] & 0xff;
+    data[ 4 ] = s[ 2 ] >> 4;
+    data[ 5 ] = ( ( s[ 2 ] & 0x0f ) << 4 ) | ( s[ 3 ] >> 8 );
+    data[ 6 ] = s[ 3 ] & 0xff;
+    sendVSCPFrame( VSCP_CLASS1_DATA,
+                    VSCP_TYPE_DATA_AD,
+                    vscp_nickname,
+                    VSCP_PRIORITY_LOW,
+                    7,
+                    data );
+
+    adc_burst_n += ADC_BURST_PER_FRAME;
+    if ( adc_burst_n >= adc_burst_count ) {
+        adc_burst_state = ADC_BURST_IDLE;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendMeasurement
+//
+
+static void sendMeasurement( uint8_t ch, uint16_t value )
+{
+    uint8_t data[ 5 ];
+    uint32_t mv;
+
+    mv = ( (uint32_t)value * adc_fullscale ) >> 16;
+
+    data[ 0 ] = ADC_DATACODING | ch;
+    data[ 1 ] = ADC_DECIMAL_POINT;
+    data[ 2 ] = ( mv >> 16 ) & 0xff;
+    data[ 3 ] = ( mv >> 8 ) & 0xff;
+    data[ 4 ] = mv & 0xff;
+    sendVSCPFrame( VSCP_CLASS1_MEASUREMENT,
+                    VSCP_TYPE_MEASUREMENT_ELECTRICAL_POTENTIAL,
+                    vscp_nickname,
+                    VSCP_PRIORITY_MEDIUM,
+                    5,
+                    data );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doADC
+//
+// Events are only sent when a value crosses the threshold, has moved
+// delta since last sent or the period has elapsed. The first value
+// after start is always sent if the channel has any event configured.
+//
+
+void doADC( void )
+{
+    uint8_t ch;
+    uint8_t bit;
+    uint8_t ready;
+    uint8_t bSend;
+    uint16_t value;
+    uint16_t diff;
+    adc_channel_t *pch;
+
+    streamBurst();
+
+    INTCONbits.GIEL = 0;
+    ready = adc_ready;
+    adc_ready = 0;
+    INTCONbits.GIEL = 1;
+
+    if ( !ready ) return;
+
+    for ( ch = 0; ch < ADC_CHANNELS; ch++ ) {
+
+        bit = ( 1 << ch );
+        if ( !( ready & bit ) ) continue;
+
+        INTCONbits.GIEL = 0;
+        value = adc_value[ ch ];
+        INTCONbits.GIEL = 1;
+
+        pch = &adc_channel[ ch ];
+        bSend = FALSE;
+
+        if ( !( adc_valid & bit ) ) {
+
+            adc_valid |= bit;
+            if ( value >= pch->threshold ) adc_above |= bit;
+            if ( pch->flags || pch->period ) bSend = TRUE;
+
+        }
+        else {
+
+            // Threshold with hysteresis below it
+            if ( !( adc_above & bit ) && ( value >= pch->threshold ) ) {
+                adc_above |= bit;
+                if ( pch->flags & ADC_FLAG_THRESHOLD ) bSend = TRUE;
+            }
+            else if ( ( adc_above & bit ) &&
+                        ( (uint32_t)value + pch->hysteresis < pch->threshold ) ) {
+                adc_above &= ~bit;
+                if ( pch->flags & ADC_FLAG_THRESHOLD ) bSend = TRUE;
+            }
+
+            if ( pch->flags & ADC_FLAG_DELTA ) {
+                diff = ( value > adc_last[ ch ] ) ?
+                            ( value - adc_last[ ch ] ) : ( adc_last[ ch ] - value );
+                if ( diff >= pch->delta ) bSend = TRUE;
+            }
+        }
+
+        if ( adc_period_due & bit ) {
+            adc_period_due &= ~bit;
+            bSend = TRUE;
+        }
+
+        if ( bSend ) {
+            sendMeasurement( ch, value );
+            adc_last[ ch ] = value;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// adc_oneSecond
+//
+
+void adc_oneSecond( void )
+{
+    uint8_t ch;
+
+    for ( ch = 0; ch < ADC_CHANNELS; ch++ ) {
+
+        if ( !( adc_enabled & ( 1 << ch ) ) || !adc_channel[ ch ].period ) {
+            continue;
+        }
+
+        if ( ++adc_period_cnt[ ch ] >= adc_channel[ ch ].period ) {
+            adc_period_cnt[ ch ] = 0;
+            adc_period_due |= ( 1 << ch );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// adc_getMillivolts
+//
+
+uint8_t adc_getMillivolts( uint8_t ch, uint16_t *pmv )
+{
+    uint16_t value;
+
+    if ( ch >= ADC_CHANNELS ) return FALSE;
+    if ( !( adc_valid & ( 1 << ch ) ) ) return FALSE;
+
+    INTCONbits.GIEL = 0;
+    value = adc_value[ ch ];
+    INTCONbits.GIEL = 1;
+
+    *pmv = ( (uint32_t)value * adc_fullscale ) >> 16;
+
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// adc_readReg
+//
+
+uint8_t adc_readReg( uint8_t reg )
+{
+    uint16_t val;
+
+    if ( reg < REG_ADC_VALUE ) {
+        return eeprom_read( EEPROM_ADC_CHANNEL + reg );
+    }
+    else if ( reg < REG_ADC_OVERSAMPLE ) {
+
+        INTCONbits.GIEL = 0;
+        val = adc_value[ ( reg - REG_ADC_VALUE ) >> 1 ];
+        INTCONbits.GIEL = 1;
+
+        // MSB is on even registers
+        return ( reg & 1 ) ? ( val & 0xff ) : ( val >> 8 );
+    }
+    else if ( REG_ADC_OVERSAMPLE == reg ) {
+        return adc_oversample;
+    }
+    else if ( REG_ADC_FULLSCALE_MSB == reg ) {
+        return eeprom_read( EEPROM_ADC_FULLSCALE_MSB );
+    }
+    else if ( REG_ADC_FULLSCALE_LSB == reg ) {
+        return eeprom_read( EEPROM_ADC_FULLSCALE_LSB );
+    }
+    else if ( REG_ADC_BURST_CONTROL == reg ) {
+        return ( adc_burst_state << 4 ) | adc_burst_ch;
+    }
+    else if ( ( reg >= REG_ADC_BURST_COUNT ) && ( reg <= REG_ADC_BURST_INTERVAL ) ) {
+        return eeprom_read( EEPROM_ADC_BURST_COUNT + ( reg - REG_ADC_BURST_COUNT ) );
+    }
+    else if ( REG_ADC_BURST_RATE_MSB == reg ) {
+        return adc_burst_rate >> 8;
+    }
+    else if ( REG_ADC_BURST_RATE_LSB == reg ) {
+        return adc_burst_rate & 0xff;
+    }
+    else if ( REG_ADC_BURST_OVERRUNS == reg ) {
+        return adc_burst_overruns;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// adc_writeReg
+//
+
+uint8_t adc_writeReg( uint8_t reg, uint8_t val )
+{
+    if ( reg < REG_ADC_VALUE ) {
+        eeprom_write( EEPROM_ADC_CHANNEL + reg, val );
+        loadChannel( reg / REG_ADC_CHANNEL_SIZE );
+        return eeprom_read( EEPROM_ADC_CHANNEL + reg );
+    }
+    else if ( REG_ADC_OVERSAMPLE == reg ) {
+
+        if ( val > ADC_OVERSAMPLE_MAX ) return ~val;
+
+        // Sums in progress are for the old setting
+        eeprom_write( EEPROM_ADC_OVERSAMPLE, val );
+        adc_init();
+        return adc_oversample;
+    }
+    else if ( ( REG_ADC_FULLSCALE_MSB == reg ) || ( REG_ADC_FULLSCALE_LSB == reg ) ) {
+        eeprom_write( EEPROM_ADC_FULLSCALE_MSB + ( reg - REG_ADC_FULLSCALE_MSB ), val );
+        adc_fullscale = ( (uint16_t)eeprom_read( EEPROM_ADC_FULLSCALE_MSB ) << 8 ) |
+                            eeprom_read( EEPROM_ADC_FULLSCALE_LSB );
+        return eeprom_read( EEPROM_ADC_FULLSCALE_MSB + ( reg - REG_ADC_FULLSCALE_MSB ) );
+    }
+    else if ( REG_ADC_BURST_CONTROL == reg ) {
+
+        // Bit 7 starts a capture on the channel in bit 0-2
+        if ( !( val & 0x80 ) || !adc_startBurst( val & 0x07 ) ) return ~val;
+        return ( adc_burst_state << 4 ) | adc_burst_ch;
+    }
+    else if ( ( reg >= REG_ADC_BURST_COUNT ) && ( reg <= REG_ADC_BURST_INTERVAL ) ) {
+
+        // Not while a burst is captured
+        if ( ADC_BURST_CAPTURE == adc_burst_state ) return ~val;
+
+        eeprom_write( EEPROM_ADC_BURST_COUNT + ( reg - REG_ADC_BURST_COUNT ), val );
+        loadBurst();
+        return eeprom_read( EEPROM_ADC_BURST_COUNT + ( reg - REG_ADC_BURST_COUNT ) );
+    }
+    else if ( REG_ADC_BURST_OVERRUNS == reg ) {
+        adc_burst_overruns = 0;
+        return 0;
+    }
+
+    return ~val;
+}
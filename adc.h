@@ -0,0 +1,134 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_ADC_H
+#define ODESSA_ADC_H
+
+// Channels AN0-AN4 on pin 8-12
+#define ADC_CHANNELS                5
+#define ADC_FIRST_PIN               8
+
+// Oversampling. 4^n samples are summed for n extra bits. Values are
+// always scaled to 16 bits (0x0000-0xfff0) whatever the setting.
+#define ADC_OVERSAMPLE_MAX          2
+#define ADC_DEFAULT_OVERSAMPLE      2   // 16 samples, 14 bits
+
+#define ADC_DEFAULT_FULLSCALE       5000    // mV
+
+// Burst capture. Samples are kept as 16-bit words in RAM.
+#define ADC_BURST_MAX               256
+#define ADC_BURST_MIN_PERIOD        50      // 40 us, conversion is ~29 us
+#define ADC_DEFAULT_BURST_PERIOD    100     // 80 us, 12.5 kHz
+#define ADC_DEFAULT_BURST_INTERVAL  2       // ms between frames
+#define ADC_BURST_PER_FRAME         4       // Packed samples per frame
+
+// Burst capture state
+#define ADC_BURST_IDLE              0
+#define ADC_BURST_PENDING           1       // Waiting for scan to end
+#define ADC_BURST_CAPTURE           2
+#define ADC_BURST_STREAM            3
+
+// Event flags (channel configuration)
+#define ADC_FLAG_THRESHOLD          0x01    // Event when crossing threshold
+#define ADC_FLAG_DELTA              0x02    // Event on change >= delta
+
+// Channel configuration (RAM copy of EEPROM)
+typedef struct {
+    uint8_t flags;
+    uint16_t threshold;
+    uint16_t hysteresis;
+    uint16_t delta;
+    uint8_t period;                 // Seconds, 0 = off
+} adc_channel_t;
+
+/*!
+    Set up the ADC from pin modes. Call after pins_init().
+*/
+void adc_init( void );
+
+/*!
+    Write default ADC configuration to EEPROM
+*/
+void adc_init_eeprom( void );
+
+/*!
+    Start a scan of the enabled channels. Called from the 1 ms tick
+    interrupt only.
+*/
+void adc_tick( void );
+
+/*!
+    Handle a finished conversion and start the next. Called from the
+    low priority interrupt only.
+*/
+void adc_isr( void );
+
+/*!
+    Burst capture sample clock. Called from the low priority interrupt
+    only.
+*/
+void adc_burst_isr( void );
+
+/*!
+    Start a burst capture
+    @param ch Channel 0-4. Must be in analog mode.
+    @return TRUE if started, FALSE if busy or channel not analog.
+*/
+uint8_t adc_startBurst( uint8_t ch );
+
+/*!
+    Send measurement events for new values and stream captured bursts
+*/
+void doADC( void );
+
+/*!
+    Count down event periods. Call once a second.
+*/
+void adc_oneSecond( void );
+
+/*!
+    Get the last value of a channel
+    @param ch Channel 0-4.
+    @param pmv Pointer to value in mV.
+    @return TRUE if the channel is analog and has a value.
+*/
+uint8_t adc_getMillivolts( uint8_t ch, uint16_t *pmv );
+
+/*!
+    Read ADC register (page REG_PAGE_ADC)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t adc_readReg( uint8_t reg );
+
+/*!
+    Write ADC register (page REG_PAGE_ADC)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t adc_writeReg( uint8_t reg, uint8_t val );
+
+#endif
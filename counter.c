@@ -0,0 +1,523 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "counter.h"
+
+// Measurement data coding, sensor index 0
+#define COUNTER_CODING_INTEGER      0x60    // Count
+#define COUNTER_CODING_NORMALIZED   0x80    // Frequency, unit Hz
+#define COUNTER_DECIMAL_POINT       0x82    // Two steps to the left
+
+uint8_t counter_enabled;
+volatile uint16_t counter_high;     // Upper half of total, by interrupt
+
+// Gate - Snapshot of the total taken from the tick
+uint16_t counter_gate;              // Gate time (ms)
+uint16_t counter_gate_cnt;
+volatile uint32_t counter_snap;
+volatile uint8_t counter_gate_ready;
+uint32_t counter_prev;              // Snapshot of previous gate
+uint8_t counter_valid;              // TRUE when counter_prev is valid
+uint32_t counter_freq;              // Frequency (0.01 Hz)
+
+// Events
+uint8_t counter_period;             // Seconds, 0 = off
+uint8_t counter_period_cnt;
+uint8_t counter_report;             // TRUE when events are due
+
+// Saving
+uint8_t counter_slot;               // Newest slot
+uint8_t counter_seq;                // Sequence number of newest slot
+uint32_t counter_saved;             // Total in newest slot
+uint8_t counter_saves;              // Saves since start
+uint8_t counter_preset[ 4 ];        // Total written by registers
+
+// Read the 32-bit total. Low priority interrupts must be off. An
+// overflow not yet counted by the interrupt is added here.
+#define COUNTER_READ( t )           { uint16_t _lo; _lo = TMR3L;            \
+                                        _lo |= ( (uint16_t)TMR3H << 8 );    \
+                                        t = counter_high;                   \
+                                        if ( PIR2bits.TMR3IF &&             \
+                                                ( _lo < 0x8000 ) ) t++;     \
+                                        t = ( t << 16 ) | _lo; }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// writeByte
+//
+// Write one EEPROM byte without using the library so it can be used
+// from the power loss interrupt. Waits for the write to finish.
+//
+
+static void writeByte( uint16_t addr, uint8_t val )
+{
+    while ( EECON1bits.WR );
+
+    EEADRH = addr >> 8;
+    EEADR = addr & 0xff;
+    EEDATA = val;
+    EECON1bits.EEPGD = 0;
+    EECON1bits.CFGS = 0;
+    EECON1bits.WREN = 1;
+
+    INTCONbits.GIEH = 0;
+    EECON2 = 0x55;
+    EECON2 = 0xaa;
+    EECON1bits.WR = 1;
+    INTCONbits.GIEH = 1;
+
+    while ( EECON1bits.WR );
+    EECON1bits.WREN = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// saveTotal
+//
+// Write the total to the slot after the newest. The sequence number is
+// written last so a write cut short by power loss leaves the previous
+// slot as the newest.
+//
+
+static void saveTotal( uint32_t total )
+{
+    uint16_t addr;
+
+    counter_slot = ( counter_slot + 1 ) & ( COUNTER_SLOTS - 1 );
+    counter_seq++;
+
+    addr = EEPROM_COUNTER_SLOTS + (uint16_t)counter_slot * COUNTER_SLOT_SIZE;
+    writeByte( addr + 0, ( total >> 24 ) & 0xff );
+    writeByte( addr + 1, ( total >> 16 ) & 0xff );
+    writeByte( addr + 2, ( total >> 8 ) & 0xff );
+    writeByte( addr + 3, total & 0xff );
+    writeByte( addr + 4, counter_seq );
+
+    counter_saved = total;
+    if ( counter_saves < 255 ) counter_saves++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// saveNow
+//
+// Save from the main loop. Power loss saving is held off meanwhile.
+//
+
+static void saveNow( uint32_t total )
+{
+    uint8_t hlvd;
+
+    hlvd = PIE2bits.HLVDIE;
+    PIE2bits.HLVDIE = 0;
+    saveTotal( total );
+    PIE2bits.HLVDIE = hlvd;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// loadTotal
+//
+// Find the newest slot and return its total.
+//
+
+static uint32_t loadTotal( void )
+{
+    uint8_t i;
+    uint8_t seq;
+    uint16_t addr;
+    uint32_t total;
+
+    for ( i = 0; i < COUNTER_SLOTS; i++ ) {
+        seq = eeprom_read( EEPROM_COUNTER_SLOTS +
+                            (uint16_t)i * COUNTER_SLOT_SIZE + 4 );
+        if ( eeprom_read( EEPROM_COUNTER_SLOTS +
+                            (uint16_t)( ( i + 1 ) & ( COUNTER_SLOTS - 1 ) ) *
+                            COUNTER_SLOT_SIZE + 4 ) != (uint8_t)( seq + 1 ) ) {
+            break;
+        }
+    }
+
+    // All in sequence can only happen if EEPROM is damaged
+    if ( i >= COUNTER_SLOTS ) i = 0;
+
+    counter_slot = i;
+    counter_seq = eeprom_read( EEPROM_COUNTER_SLOTS +
+                                (uint16_t)i * COUNTER_SLOT_SIZE + 4 );
+
+    addr = EEPROM_COUNTER_SLOTS + (uint16_t)i * COUNTER_SLOT_SIZE;
+    total = eeprom_read( addr );
+    total = ( total << 8 ) | eeprom_read( addr + 1 );
+    total = ( total << 8 ) | eeprom_read( addr + 2 );
+    total = ( total << 8 ) | eeprom_read( addr + 3 );
+
+    return total;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// readTotal
+//
+
+static uint32_t readTotal( void )
+{
+    uint32_t total;
+
+    INTCONbits.GIEL = 0;
+    COUNTER_READ( total );
+    INTCONbits.GIEL = 1;
+
+    return total;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// startCounter
+//
+// Start counting from a total.
+//
+
+static void startCounter( uint32_t total )
+{
+    uint8_t gie;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+
+    // External clock on T3CKI, no prescaler, not synchronized, 16-bit
+    // read/write. TMR3H is written through a buffer on TMR3L write.
+    T3CON = 0;
+    T3GCON = 0;
+    TMR3H = ( total >> 8 ) & 0xff;
+    TMR3L = total & 0xff;
+    counter_high = total >> 16;
+    T3CON = 0b10000111;
+
+    IPR2bits.TMR3IP = 0;
+    PIR2bits.TMR3IF = 0;
+    PIE2bits.TMR3IE = 1;
+
+    counter_valid = FALSE;
+    counter_gate_cnt = 0;
+    counter_gate_ready = 0;
+
+    INTCONbits.GIEL = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// counter_init
+//
+
+void counter_init( void )
+{
+    uint32_t total;
+
+    // Keep what was counted under the old configuration
+    if ( counter_enabled ) {
+        total = readTotal();
+        if ( total != counter_saved ) saveNow( total );
+    }
+
+    counter_gate = ( (uint16_t)eeprom_read( EEPROM_COUNTER_GATE_MSB ) << 8 ) |
+                        eeprom_read( EEPROM_COUNTER_GATE_LSB );
+    if ( counter_gate < COUNTER_MIN_GATE ) counter_gate = COUNTER_MIN_GATE;
+
+    counter_period = eeprom_read( EEPROM_COUNTER_PERIOD );
+    counter_period_cnt = 0;
+    counter_report = FALSE;
+    counter_freq = 0;
+
+    counter_enabled = ( PIN_MODE_COUNTER == pins_getMode( COUNTER_PIN ) );
+
+    PIE2bits.HLVDIE = 0;
+    HLVDCON = 0;
+
+    if ( !counter_enabled ) {
+        PIE2bits.TMR3IE = 0;
+        T3CON = 0;
+        return;
+    }
+
+    counter_saved = loadTotal();
+    startCounter( counter_saved );
+
+    // Power loss detection, supply falling below the trip level. The
+    // interrupt is enabled from counter_oneSecond() once the reference
+    // is stable and there is something to save.
+    HLVDCON = 0x10 | ( eeprom_read( EEPROM_COUNTER_HLVD_LEVEL ) & 0x0f );
+    IPR2bits.HLVDIP = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// counter_init_eeprom
+//
+
+void counter_init_eeprom( void )
+{
+    uint8_t i;
+    uint8_t j;
+
+    eeprom_write( EEPROM_COUNTER_GATE_MSB, ( COUNTER_DEFAULT_GATE >> 8 ) & 0xff );
+    eeprom_write( EEPROM_COUNTER_GATE_LSB, COUNTER_DEFAULT_GATE & 0xff );
+    eeprom_write( EEPROM_COUNTER_PERIOD, COUNTER_DEFAULT_PERIOD );
+    eeprom_write( EEPROM_COUNTER_HLVD_LEVEL, COUNTER_DEFAULT_HLVD_LEVEL );
+
+    // Zero totals in sequence, last slot newest
+    for ( i = 0; i < COUNTER_SLOTS; i++ ) {
+        for ( j = 0; j < 4; j++ ) {
+            eeprom_write( EEPROM_COUNTER_SLOTS + (uint16_t)i * COUNTER_SLOT_SIZE + j, 0 );
+        }
+        eeprom_write( EEPROM_COUNTER_SLOTS + (uint16_t)i * COUNTER_SLOT_SIZE + 4, i );
+    }
+
+    counter_enabled = FALSE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// counter_tick
+//
+
+void counter_tick( void )
+{
+    if ( !counter_enabled ) return;
+
+    if ( ++counter_gate_cnt < counter_gate ) return;
+    counter_gate_cnt = 0;
+
+    COUNTER_READ( counter_snap );
+    counter_gate_ready = TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// counter_isr
+//
+// On power loss the total is saved at once. The EEPROM registers are
+// restored afterwards as the main loop may be in the middle of an
+// EEPROM access. Detection is re-armed from counter_oneSecond().
+//
+
+void counter_isr( void )
+{
+    uint32_t total;
+    uint8_t eeadr;
+    uint8_t eeadrh;
+    uint8_t eedata;
+    uint8_t eecon1;
+
+    if ( PIE2bits.HLVDIE && PIR2bits.HLVDIF ) {
+
+        PIR2bits.HLVDIF = 0;
+        PIE2bits.HLVDIE = 0;
+
+        eeadr = EEADR;
+        eeadrh = EEADRH;
+        eedata = EEDATA;
+        eecon1 = EECON1;
+
+        COUNTER_READ( total );
+        saveTotal( total );
+
+        EEADR = eeadr;
+        EEADRH = eeadrh;
+        EEDATA = eedata;
+        EECON1 = eecon1 & 0xc4;     // EEPGD, CFGS, WREN
+    }
+
+    if ( PIE2bits.TMR3IE && PIR2bits.TMR3IF ) {
+        PIR2bits.TMR3IF = 0;
+        counter_high++;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendMeasurement
+//
+
+static void sendMeasurement( uint8_t type, uint8_t coding, uint32_t value )
+{
+    uint8_t data[ 6 ];
+    uint8_t n = 0;
+
+    data[ n++ ] = coding;
+    if ( COUNTER_CODING_NORMALIZED == coding ) {
+        data[ n++ ] = COUNTER_DECIMAL_POINT;
+    }
+    data[ n++ ] = ( value >> 24 ) & 0xff;
+    data[ n++ ] = ( value >> 16 ) & 0xff;
+    data[ n++ ] = ( value >> 8 ) & 0xff;
+    data[ n++ ] = value & 0xff;
+
+    sendVSCPFrame( VSCP_CLASS1_MEASUREMENT,
+                    type,
+                    vscp_nickname,
+                    VSCP_PRIORITY_MEDIUM,
+                    n,
+                    data );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doCounter
+//
+
+void doCounter( void )
+{
+    uint32_t snap;
+    uint32_t delta;
+
+    if ( !counter_enabled ) return;
+
+    if ( counter_gate_ready ) {
+
+        INTCONbits.GIEL = 0;
+        snap = counter_snap;
+        counter_gate_ready = FALSE;
+        INTCONbits.GIEL = 1;
+
+        // Pulses over the gate time to 0.01 Hz
+        if ( counter_valid ) {
+            delta = snap - counter_prev;
+            if ( delta < 4000000L ) {
+                counter_freq = ( delta * 1000 / counter_gate ) * 100 +
+                                ( ( delta * 1000 % counter_gate ) * 100 ) / counter_gate;
+            }
+            else {
+                counter_freq = ( delta / counter_gate ) * 100000L;
+            }
+        }
+
+        counter_prev = snap;
+        counter_valid = TRUE;
+    }
+
+    if ( counter_report ) {
+        counter_report = FALSE;
+        sendMeasurement( VSCP_TYPE_MEASUREMENT_COUNT,
+                            COUNTER_CODING_INTEGER,
+                            readTotal() );
+        sendMeasurement( VSCP_TYPE_MEASUREMENT_FREQUENCY,
+                            COUNTER_CODING_NORMALIZED,
+                            counter_freq );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// counter_oneSecond
+//
+
+void counter_oneSecond( void )
+{
+    if ( !counter_enabled ) return;
+
+    if ( counter_period && ( ++counter_period_cnt >= counter_period ) ) {
+        counter_period_cnt = 0;
+        counter_report = TRUE;
+    }
+
+    // Arm power loss detection when there is something new to save.
+    // Also re-arms if the node is still running after a save.
+    if ( !PIE2bits.HLVDIE && HLVDCONbits.IRVST &&
+            ( readTotal() != counter_saved ) ) {
+        PIR2bits.HLVDIF = 0;
+        PIE2bits.HLVDIE = 1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// counter_readReg
+//
+
+uint8_t counter_readReg( uint8_t reg )
+{
+    if ( reg <= REG_COUNTER_TOTAL3 ) {
+        return ( readTotal() >> ( 8 * ( REG_COUNTER_TOTAL3 - reg ) ) ) & 0xff;
+    }
+    else if ( REG_COUNTER_GATE_MSB == reg ) {
+        return eeprom_read( EEPROM_COUNTER_GATE_MSB );
+    }
+    else if ( REG_COUNTER_GATE_LSB == reg ) {
+        return eeprom_read( EEPROM_COUNTER_GATE_LSB );
+    }
+    else if ( reg <= REG_COUNTER_FREQ3 ) {
+        return ( counter_freq >> ( 8 * ( REG_COUNTER_FREQ3 - reg ) ) ) & 0xff;
+    }
+    else if ( REG_COUNTER_PERIOD == reg ) {
+        return eeprom_read( EEPROM_COUNTER_PERIOD );
+    }
+    else if ( REG_COUNTER_HLVD_LEVEL == reg ) {
+        return eeprom_read( EEPROM_COUNTER_HLVD_LEVEL );
+    }
+    else if ( REG_COUNTER_SAVES == reg ) {
+        return counter_saves;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// counter_writeReg
+//
+
+uint8_t counter_writeReg( uint8_t reg, uint8_t val )
+{
+    uint32_t total;
+
+    if ( reg <= REG_COUNTER_TOTAL3 ) {
+
+        // Bytes are collected and the total is set on the LSB write
+        counter_preset[ reg - REG_COUNTER_TOTAL0 ] = val;
+        if ( ( REG_COUNTER_TOTAL3 == reg ) && counter_enabled ) {
+            total = ( (uint32_t)counter_preset[ 0 ] << 24 ) |
+                    ( (uint32_t)counter_preset[ 1 ] << 16 ) |
+                    ( (uint16_t)counter_preset[ 2 ] << 8 ) |
+                    counter_preset[ 3 ];
+            startCounter( total );
+            saveNow( total );
+        }
+        return val;
+    }
+    else if ( ( REG_COUNTER_GATE_MSB == reg ) || ( REG_COUNTER_GATE_LSB == reg ) ) {
+        eeprom_write( EEPROM_COUNTER_GATE_MSB + ( reg - REG_COUNTER_GATE_MSB ), val );
+        counter_init();
+        return eeprom_read( EEPROM_COUNTER_GATE_MSB + ( reg - REG_COUNTER_GATE_MSB ) );
+    }
+    else if ( REG_COUNTER_PERIOD == reg ) {
+        eeprom_write( EEPROM_COUNTER_PERIOD, val );
+        counter_period = eeprom_read( EEPROM_COUNTER_PERIOD );
+        return counter_period;
+    }
+    else if ( REG_COUNTER_HLVD_LEVEL == reg ) {
+        if ( val > 0x0f ) return ~val;
+        eeprom_write( EEPROM_COUNTER_HLVD_LEVEL, val );
+        counter_init();
+        return eeprom_read( EEPROM_COUNTER_HLVD_LEVEL );
+    }
+
+    return ~val;
+}
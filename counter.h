@@ -0,0 +1,93 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_COUNTER_H
+#define ODESSA_COUNTER_H
+
+// Pulse counter on pin 20 (RB5/T3CKI). Timer3 counts the pulses in
+// hardware and is extended to 32 bits by its overflow interrupt, so a
+// pulse costs no CPU time.
+#define COUNTER_PIN                 20
+
+#define COUNTER_DEFAULT_GATE        1000    // ms
+#define COUNTER_MIN_GATE            10      // ms
+#define COUNTER_DEFAULT_PERIOD      10      // s
+#define COUNTER_DEFAULT_HLVD_LEVEL  0x0d    // HLVDL code, see datasheet
+
+// Total save slots in EEPROM. Four bytes total, MSB first, and a
+// sequence number written last. The newest slot is the one whose
+// next slot does not follow it in sequence.
+#define COUNTER_SLOTS               16
+#define COUNTER_SLOT_SIZE           5
+
+/*!
+    Set up the counter from pin modes. Call after pins_init(). A
+    total counted so far is saved first.
+*/
+void counter_init( void );
+
+/*!
+    Write default counter configuration and clear the total in EEPROM
+*/
+void counter_init_eeprom( void );
+
+/*!
+    Gate time. Called from the 1 ms tick interrupt only.
+*/
+void counter_tick( void );
+
+/*!
+    Timer3 overflow and power loss. Called from the low priority
+    interrupt only.
+*/
+void counter_isr( void );
+
+/*!
+    Compute frequency for finished gates and send events
+*/
+void doCounter( void );
+
+/*!
+    Count down event period and re-arm power loss detection. Call
+    once a second.
+*/
+void counter_oneSecond( void );
+
+/*!
+    Read counter register (page REG_PAGE_COUNTER)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t counter_readReg( uint8_t reg );
+
+/*!
+    Write counter register (page REG_PAGE_COUNTER)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t counter_writeReg( uint8_t reg, uint8_t val );
+
+#endif
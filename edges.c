@@ -0,0 +1,347 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include "odessa.h"
+#include "pins.h"
+#include "inputs.h"
+#include "edges.h"
+
+// Connector pin and port B bit for each channel
+const uint8_t edge_pin[ EDGE_CHANNELS ] = { 15, 17, 18, 19, 20 };
+const uint8_t edge_bit[ EDGE_CHANNELS ] = { 0x10, 0x02, 0x01, 0x40, 0x20 };
+
+// Edge queue - Filled by high priority interrupt
+edge_t edge_queue[ EDGE_QUEUE_SIZE ];
+volatile uint8_t edge_head;         // Written by interrupt
+uint8_t edge_tail;
+
+uint8_t edge_enabled;               // Channels in use, one bit per channel
+uint8_t edge_invert;                // Channels that are active low
+uint8_t edge_kbi_mask;              // Port B bits used with interrupt-on-change
+uint8_t edge_kbi_last;              // Port B at last interrupt-on-change
+
+// Counters and statistics
+volatile uint16_t edge_count[ EDGE_CHANNELS ];  // Active edges
+volatile uint16_t edge_lost;                    // Edges lost, queue full
+volatile uint8_t edge_maxfill;                  // Max edges in queue
+uint16_t edge_width[ EDGE_CHANNELS ];           // Last pulse width (us)
+uint16_t edge_latency_max;                      // Edge to event (us)
+
+uint32_t edge_start[ EDGE_CHANNELS ];           // Time stamp of active edge
+uint8_t edge_started;                           // Active edge seen, per channel
+
+// 16-bit register value latched when its MSB is read, so the LSB read
+// next belongs to the same value
+uint16_t edge_latch;
+uint8_t edge_latch_reg;                         // LSB register, 0 = none
+
+// Time stamp ticks for 65535 us
+#define EDGE_US_MAX_TICKS           81918L
+
+// INT0/INT1. The edge is latched in hardware so a pulse shorter than the
+// interrupt latency is still seen. If the pin is already back the return
+// edge is queued as well. The other edge is then armed and if the pin
+// changed while arming the interrupt is raised again.
+#define EDGE_INT( ch, bit, flag, edge )                                     \
+    fired = ( edge ) ? ( bit ) : 0;                                         \
+    captureEdge( ch, fired, stamp );                                        \
+    now = PORTB & ( bit );                                                  \
+    if ( now != fired ) captureEdge( ch, now, stamp );                      \
+    edge = now ? 0 : 1;                                                     \
+    flag = 0;                                                               \
+    if ( ( PORTB & ( bit ) ) != now ) flag = 1;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// edges_init
+//
+
+void edges_init( void )
+{
+    uint8_t ch;
+    uint8_t gie;
+    uint8_t mode;
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+
+    edge_enabled = 0;
+    edge_invert = 0;
+    edge_kbi_mask = 0;
+
+    for ( ch = 0; ch < EDGE_CHANNELS; ch++ ) {
+
+        mode = pin_mode[ edge_pin[ ch ] - PIN_FIRST ];
+        if ( PIN_MODE_EDGE != ( mode & PIN_MODE_MASK ) ) continue;
+
+        edge_enabled |= ( 1 << ch );
+        if ( mode & PIN_FLAG_INVERT ) {
+            edge_invert |= ( 1 << ch );
+        }
+
+        if ( edge_bit[ ch ] & 0xf0 ) {
+            edge_kbi_mask |= edge_bit[ ch ];
+        }
+    }
+
+    edge_head = 0;
+    edge_tail = 0;
+    edge_started = 0;
+
+    // INT0 (always high priority). Arm for the edge away from the
+    // current level.
+    INTCON2bits.INTEDG0 = PORTBbits.RB0 ? 0 : 1;
+    INTCONbits.INT0IF = 0;
+    INTCONbits.INT0IE = ( edge_enabled & ( 1 << EDGE_CH_RB0 ) ) ? 1 : 0;
+
+    // INT1
+    INTCON2bits.INTEDG1 = PORTBbits.RB1 ? 0 : 1;
+    INTCON3bits.INT1IP = 1;
+    INTCON3bits.INT1IF = 0;
+    INTCON3bits.INT1IE = ( edge_enabled & ( 1 << EDGE_CH_RB1 ) ) ? 1 : 0;
+
+    // Interrupt-on-change. Reading port B ends the mismatch.
+    IOCB = edge_kbi_mask;
+    edge_kbi_last = PORTB;
+    INTCON2bits.RBIP = 1;
+    INTCONbits.RBIF = 0;
+    INTCONbits.RBIE = edge_kbi_mask ? 1 : 0;
+
+    INTCONbits.GIEH = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// captureEdge
+//
+// Count and queue one edge. Interrupt only.
+//
+
+static void captureEdge( uint8_t ch, uint8_t level, uint32_t stamp )
+{
+    uint8_t next;
+    uint8_t fill;
+    uint8_t flags;
+
+    flags = ch;
+    if ( ( level ? 1 : 0 ) ^ ( ( edge_invert >> ch ) & 1 ) ) {
+        flags |= EDGE_FLAG_ACTIVE;
+        edge_count[ ch ]++;
+    }
+
+    next = ( edge_head + 1 ) & ( EDGE_QUEUE_SIZE - 1 );
+    if ( next == edge_tail ) {
+        if ( edge_lost < 0xffff ) edge_lost++;
+        return;
+    }
+
+    edge_queue[ edge_head ].flags = flags;
+    edge_queue[ edge_head ].stamp = stamp;
+    edge_head = next;
+
+    fill = ( edge_head - edge_tail ) & ( EDGE_QUEUE_SIZE - 1 );
+    if ( fill > edge_maxfill ) {
+        edge_maxfill = fill;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// edges_isr
+//
+// Called from the high priority interrupt. All edges found in one pass
+// get the same time stamp.
+//
+
+void edges_isr( void )
+{
+    uint32_t stamp;
+    uint8_t fired;
+    uint8_t now;
+    uint8_t port;
+    uint8_t changed;
+
+    TIMESTAMP_READ32( stamp );
+
+    if ( INTCONbits.INT0IE && INTCONbits.INT0IF ) {
+        EDGE_INT( EDGE_CH_RB0, 0x01, INTCONbits.INT0IF, INTCON2bits.INTEDG0 );
+    }
+
+    if ( INTCON3bits.INT1IE && INTCON3bits.INT1IF ) {
+        EDGE_INT( EDGE_CH_RB1, 0x02, INTCON3bits.INT1IF, INTCON2bits.INTEDG1 );
+    }
+
+    // Interrupt-on-change. Compared with the level at the last interrupt
+    // so a port B read elsewhere that ends the mismatch is harmless.
+    if ( INTCONbits.RBIE && INTCONbits.RBIF ) {
+
+        port = PORTB;
+        INTCONbits.RBIF = 0;
+
+        changed = ( port ^ edge_kbi_last ) & edge_kbi_mask;
+        edge_kbi_last = port;
+
+        // A pin changed and went back before we got here, both edges
+        // of the pulse are lost
+        if ( !changed ) {
+            edge_lost = ( edge_lost < 0xfffe ) ? edge_lost + 2 : 0xffff;
+        }
+
+        if ( changed & 0x10 ) captureEdge( EDGE_CH_RB4, port & 0x10, stamp );
+        if ( changed & 0x20 ) captureEdge( EDGE_CH_RB5, port & 0x20, stamp );
+        if ( changed & 0x40 ) captureEdge( EDGE_CH_RB6, port & 0x40, stamp );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doEdges
+//
+// Convert queued edges to events. A limited number per pass so other
+// work is not held up by a burst of edges.
+//
+
+void doEdges( void )
+{
+    uint8_t i;
+    uint8_t ch;
+    edge_t edge;
+    uint32_t now;
+    uint32_t ticks;
+
+    for ( i = 0; ( i < EDGE_EVENTS_PER_PASS ) && ( edge_tail != edge_head ); i++ ) {
+
+        edge = edge_queue[ edge_tail ];
+        edge_tail = ( edge_tail + 1 ) & ( EDGE_QUEUE_SIZE - 1 );
+
+        ch = edge.flags & EDGE_FLAG_CHANNEL;
+
+        // Pulse width from active to inactive edge
+        if ( edge.flags & EDGE_FLAG_ACTIVE ) {
+            edge_start[ ch ] = edge.stamp;
+            edge_started |= ( 1 << ch );
+        }
+        else if ( edge_started & ( 1 << ch ) ) {
+            ticks = edge.stamp - edge_start[ ch ];
+            edge_width[ ch ] = ( ticks > EDGE_US_MAX_TICKS ) ?
+                                    0xffff : TIMESTAMP_TO_US( ticks );
+        }
+
+        inputs_sendEvent( edge_pin[ ch ], edge.flags & EDGE_FLAG_ACTIVE );
+
+        // Edge to event latency
+        INTCONbits.GIEH = 0;
+        TIMESTAMP_READ32( now );
+        INTCONbits.GIEH = 1;
+
+        ticks = now - edge.stamp;
+        if ( ticks > EDGE_US_MAX_TICKS ) {
+            edge_latency_max = 0xffff;
+        }
+        else if ( TIMESTAMP_TO_US( ticks ) > edge_latency_max ) {
+            edge_latency_max = TIMESTAMP_TO_US( ticks );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// edges_readReg
+//
+
+uint8_t edges_readReg( uint8_t reg )
+{
+    uint16_t val;
+
+    // LSB of the value latched by the MSB read
+    if ( ( reg & 1 ) && ( reg == edge_latch_reg ) ) {
+        edge_latch_reg = 0;
+        return edge_latch & 0xff;
+    }
+
+    if ( reg < REG_EDGE_WIDTH ) {
+        INTCONbits.GIEH = 0;
+        val = edge_count[ ( reg - REG_EDGE_COUNT ) >> 1 ];
+        INTCONbits.GIEH = 1;
+    }
+    else if ( reg < REG_EDGE_LOST_MSB ) {
+        val = edge_width[ ( reg - REG_EDGE_WIDTH ) >> 1 ];
+    }
+    else if ( reg <= REG_EDGE_LOST_LSB ) {
+        INTCONbits.GIEH = 0;
+        val = edge_lost;
+        INTCONbits.GIEH = 1;
+    }
+    else if ( REG_EDGE_MAX_FILL == reg ) {
+        return edge_maxfill;
+    }
+    else if ( ( reg >= REG_EDGE_LATENCY_MAX_MSB ) &&
+                ( reg <= REG_EDGE_LATENCY_MAX_LSB ) ) {
+        val = edge_latency_max;
+    }
+    else {
+        return 0;
+    }
+
+    // MSB is on even registers
+    if ( reg & 1 ) return val & 0xff;
+
+    edge_latch = val;
+    edge_latch_reg = reg + 1;
+    return val >> 8;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// edges_writeReg
+//
+
+uint8_t edges_writeReg( uint8_t reg, uint8_t val )
+{
+    // A cleared value is not read from the latch
+    edge_latch_reg = 0;
+
+    if ( reg < REG_EDGE_WIDTH ) {
+        INTCONbits.GIEH = 0;
+        edge_count[ ( reg - REG_EDGE_COUNT ) >> 1 ] = 0;
+        INTCONbits.GIEH = 1;
+    }
+    else if ( reg < REG_EDGE_LOST_MSB ) {
+        edge_width[ ( reg - REG_EDGE_WIDTH ) >> 1 ] = 0;
+    }
+    else if ( reg <= REG_EDGE_LATENCY_MAX_LSB ) {
+        INTCONbits.GIEH = 0;
+        edge_lost = 0;
+        edge_maxfill = 0;
+        INTCONbits.GIEH = 1;
+        edge_latency_max = 0;
+    }
+    else {
+        return ~val;
+    }
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_EDGES_H
+#define ODESSA_EDGES_H
+
+// Edge capture channels. INT0/INT1 latch an edge in hardware so any
+// pulse is seen. The KBI pins (interrupt-on-change) compare levels so a
+// pulse shorter than the interrupt latency on those pins is not seen.
+#define EDGE_CHANNELS               5   // Pin 15, 17, 18, 19, 20
+
+#define EDGE_CH_RB4                 0   // Pin 15 - KBI0
+#define EDGE_CH_RB1                 1   // Pin 17 - INT1
+#define EDGE_CH_RB0                 2   // Pin 18 - INT0
+#define EDGE_CH_RB6                 3   // Pin 19 - KBI2
+#define EDGE_CH_RB5                 4   // Pin 20 - KBI1
+
+// Edge queue between the high priority interrupt and the main loop.
+// Size must be a power of two.
+#define EDGE_QUEUE_SIZE             16
+
+// Max number of queued edges converted to events per main loop pass
+#define EDGE_EVENTS_PER_PASS        4
+
+// Queued edge
+typedef struct {
+    uint8_t flags;                  // Channel and active state
+    uint32_t stamp;                 // 32-bit time stamp
+} edge_t;
+
+#define EDGE_FLAG_CHANNEL           0x07
+#define EDGE_FLAG_ACTIVE            0x80    // Input active after the edge
+
+extern volatile uint8_t edge_head;  // Written by interrupt
+extern uint8_t edge_tail;
+
+/*!
+    Set up edge capture from pin modes. Call after pins_init().
+*/
+void edges_init( void );
+
+/*!
+    Capture edges. Called from the high priority interrupt only.
+*/
+void edges_isr( void );
+
+/*!
+    Send events for captured edges
+*/
+void doEdges( void );
+
+/*!
+    Read edge capture register (page REG_PAGE_EDGES)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t edges_readReg( uint8_t reg );
+
+/*!
+    Write edge capture register (page REG_PAGE_EDGES). Writing a
+    register clears the counter or statistic it belongs to.
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t edges_writeReg( uint8_t reg, uint8_t val );
+
+#endif
@@ -0,0 +1,638 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "i2c.h"
+#include "ratelimit.h"
+
+// Transaction steps, each ended by an MSSP interrupt
+#define I2C_STATE_IDLE              0
+#define I2C_STATE_START             1   // Start sent, send address
+#define I2C_STATE_ADDR              2   // Address sent, send register
+#define I2C_STATE_WRITE             3   // Byte sent, send next
+#define I2C_STATE_RESTART           4   // Restart sent, send address
+#define I2C_STATE_ADDR_READ         5   // Address sent, receive
+#define I2C_STATE_READ              6   // Byte received, acknowledge
+#define I2C_STATE_ACK               7   // Acknowledge sent
+#define I2C_STATE_STOP              8   // Stop sent, transaction done
+
+// Measurement data coding
+#define I2C_CODING_NORMALIZED       0x80
+
+// SSPADD for 100 kHz and 400 kHz, Fosc / ( 4 * rate ) - 1
+#define I2C_SSPADD_100K             99
+#define I2C_SSPADD_400K             24
+
+uint8_t i2c_enabled;
+
+// Transaction queue. New transactions are added at head by the main
+// loop, the interrupt works on cur and the main loop takes finished
+// transactions from tail.
+i2c_xfer_t i2c_xfer[ I2C_QUEUE_SIZE ];
+uint8_t i2c_head;
+volatile uint8_t i2c_cur;
+uint8_t i2c_tail;
+
+volatile uint8_t i2c_state;
+uint8_t i2c_idx;                    // Byte in transaction
+volatile uint8_t i2c_timer;         // ms in this step
+uint16_t i2c_start;                 // Time stamp at start condition
+
+// Sensors
+volatile uint8_t i2c_due;           // Sensors due for a poll, one bit each
+uint8_t i2c_pending;                // Sensors with a poll in the queue
+uint8_t i2c_period_cnt[ I2C_SENSORS ];
+uint8_t i2c_tenth;                  // ms to next 100 ms
+
+// Statistics
+volatile uint32_t i2c_busy;         // Bus busy this second (ticks)
+volatile uint8_t i2c_count;         // Transactions this second
+volatile uint8_t i2c_errors;        // NACK, collision or timeout
+volatile uint16_t i2c_isr_max;      // Longest interrupt (ticks)
+uint16_t i2c_utilization;           // Last second (0.1 %)
+uint8_t i2c_rate;                   // Transactions last second
+uint8_t i2c_queue_full;             // Polls delayed by a full queue
+
+
+///////////////////////////////////////////////////////////////////////////////
+// i2c_init
+//
+
+void i2c_init( void )
+{
+    uint8_t i;
+    uint8_t gie;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+
+    PIE1bits.SSPIE = 0;
+
+    i2c_enabled = ( PIN_MODE_I2C == pins_getMode( I2C_SCL_PIN ) ) &&
+                    ( PIN_MODE_I2C == pins_getMode( I2C_SDA_PIN ) );
+
+    i2c_head = i2c_cur = i2c_tail = 0;
+    i2c_state = I2C_STATE_IDLE;
+    i2c_due = 0;
+    i2c_pending = 0;
+    i2c_tenth = 100;
+
+    for ( i = 0; i < I2C_SENSORS; i++ ) {
+        i2c_period_cnt[ i ] = eeprom_read( EEPROM_I2C_SENSORS +
+                                            I2C_SENSOR_SIZE * i +
+                                            I2C_SENSOR_PERIOD );
+    }
+
+    if ( i2c_enabled ) {
+
+        // Master mode, slew rate control off for 100 kHz
+        SSPCON1 = 0;
+        SSPSTAT = ( I2C_SPEED_400K == eeprom_read( EEPROM_I2C_SPEED ) ) ? 0x00 : 0x80;
+        SSPADD = ( I2C_SPEED_400K == eeprom_read( EEPROM_I2C_SPEED ) ) ?
+                    I2C_SSPADD_400K : I2C_SSPADD_100K;
+        SSPCON2 = 0;
+        SSPCON1 = 0b00101000;       // SSPEN, I2C master
+
+        PIR1bits.SSPIF = 0;
+        IPR1bits.SSPIP = 0;
+        PIE1bits.SSPIE = 1;
+    }
+    else {
+        SSPCON1 = 0;
+    }
+
+    INTCONbits.GIEL = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// i2c_init_eeprom
+//
+
+void i2c_init_eeprom( void )
+{
+    uint8_t i;
+
+    eeprom_write( EEPROM_I2C_SPEED, I2C_SPEED_100K );
+
+    // No sensors
+    for ( i = 0; i < I2C_SENSORS * I2C_SENSOR_SIZE; i++ ) {
+        eeprom_write( EEPROM_I2C_SENSORS + i, 0 );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// i2c_tick
+//
+// A step that does not end in time leaves the bus in an unknown state,
+// the MSSP is reset and the transaction failed.
+//
+
+void i2c_tick( void )
+{
+    uint8_t i;
+
+    if ( !i2c_enabled ) return;
+
+    if ( I2C_STATE_IDLE != i2c_state ) {
+        if ( ++i2c_timer > I2C_TIMEOUT ) {
+
+            SSPCON1bits.SSPEN = 0;
+            SSPCON2 = 0;
+            PIR2bits.BCLIF = 0;
+            PIR1bits.SSPIF = 0;
+            SSPCON1bits.SSPEN = 1;
+
+            i2c_xfer[ i2c_cur ].status = I2C_STATUS_ERROR;
+            i2c_cur = ( i2c_cur + 1 ) & ( I2C_QUEUE_SIZE - 1 );
+            i2c_state = I2C_STATE_IDLE;
+            if ( i2c_errors < 255 ) i2c_errors++;
+        }
+    }
+
+    if ( --i2c_tenth ) return;
+    i2c_tenth = 100;
+
+    for ( i = 0; i < I2C_SENSORS; i++ ) {
+        if ( i2c_period_cnt[ i ] && !--i2c_period_cnt[ i ] ) {
+            i2c_due |= ( 1 << i );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fail
+//
+// No acknowledge, give up the transaction. Interrupt only.
+//
+
+static void fail( i2c_xfer_t *p )
+{
+    p->status = I2C_STATUS_ERROR;
+    if ( i2c_errors < 255 ) i2c_errors++;
+    SSPCON2bits.PEN = 1;
+    i2c_state = I2C_STATE_STOP;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// startBus
+//
+// Start the next transaction if the bus is idle, else the interrupt
+// gets to it. Main loop only.
+//
+
+static void startBus( void )
+{
+    INTCONbits.GIEL = 0;
+
+    if ( ( I2C_STATE_IDLE == i2c_state ) && ( i2c_cur != i2c_head ) ) {
+        TIMESTAMP_READ( i2c_start );
+        i2c_timer = 0;
+        SSPCON2bits.SEN = 1;
+        i2c_state = I2C_STATE_START;
+    }
+
+    INTCONbits.GIEL = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// i2c_isr
+//
+
+void i2c_isr( void )
+{
+    uint16_t start;
+    uint16_t stop;
+    i2c_xfer_t *p;
+
+    TIMESTAMP_READ( start );
+
+    PIR1bits.SSPIF = 0;
+    i2c_timer = 0;
+    p = &i2c_xfer[ i2c_cur ];
+
+    switch ( i2c_state ) {
+
+        case I2C_STATE_START:
+            SSPBUF = p->addr << 1;
+            i2c_state = I2C_STATE_ADDR;
+            break;
+
+        case I2C_STATE_ADDR:
+            if ( SSPCON2bits.ACKSTAT ) {
+                fail( p );
+                break;
+            }
+            i2c_idx = 0;
+            SSPBUF = p->reg;
+            i2c_state = I2C_STATE_WRITE;
+            break;
+
+        case I2C_STATE_WRITE:
+            if ( SSPCON2bits.ACKSTAT ) {
+                fail( p );
+                break;
+            }
+            if ( i2c_idx < p->wlen ) {
+                SSPBUF = p->data[ i2c_idx++ ];
+            }
+            else if ( p->rlen ) {
+                SSPCON2bits.RSEN = 1;
+                i2c_state = I2C_STATE_RESTART;
+            }
+            else {
+                p->status = I2C_STATUS_OK;
+                SSPCON2bits.PEN = 1;
+                i2c_state = I2C_STATE_STOP;
+            }
+            break;
+
+        case I2C_STATE_RESTART:
+            SSPBUF = ( p->addr << 1 ) | 1;
+            i2c_state = I2C_STATE_ADDR_READ;
+            break;
+
+        case I2C_STATE_ADDR_READ:
+            if ( SSPCON2bits.ACKSTAT ) {
+                fail( p );
+                break;
+            }
+            i2c_idx = 0;
+            SSPCON2bits.RCEN = 1;
+            i2c_state = I2C_STATE_READ;
+            break;
+
+        case I2C_STATE_READ:
+            p->data[ i2c_idx++ ] = SSPBUF;
+            // Not acknowledge on the last byte
+            SSPCON2bits.ACKDT = ( i2c_idx >= p->rlen ) ? 1 : 0;
+            SSPCON2bits.ACKEN = 1;
+            i2c_state = I2C_STATE_ACK;
+            break;
+
+        case I2C_STATE_ACK:
+            if ( i2c_idx < p->rlen ) {
+                SSPCON2bits.RCEN = 1;
+                i2c_state = I2C_STATE_READ;
+            }
+            else {
+                p->status = I2C_STATUS_OK;
+                SSPCON2bits.PEN = 1;
+                i2c_state = I2C_STATE_STOP;
+            }
+            break;
+
+        case I2C_STATE_STOP:
+            i2c_busy += (uint16_t)( start - i2c_start );
+            i2c_count++;
+            i2c_cur = ( i2c_cur + 1 ) & ( I2C_QUEUE_SIZE - 1 );
+
+            // Go on with the next transaction
+            if ( i2c_cur != i2c_head ) {
+                i2c_start = start;
+                SSPCON2bits.SEN = 1;
+                i2c_state = I2C_STATE_START;
+            }
+            else {
+                i2c_state = I2C_STATE_IDLE;
+            }
+            break;
+    }
+
+    TIMESTAMP_READ( stop );
+    stop -= start;
+    if ( stop > i2c_isr_max ) {
+        i2c_isr_max = stop;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// i2c_queue
+//
+
+uint8_t i2c_queue( uint8_t addr,
+                    uint8_t reg,
+                    uint8_t wlen,
+                    uint8_t rlen,
+                    uint8_t *pdata,
+                    uint8_t tag )
+{
+    uint8_t i;
+    uint8_t next;
+    i2c_xfer_t *p;
+
+    if ( !i2c_enabled ) return FALSE;
+    if ( ( wlen > I2C_DATA_MAX ) || ( rlen > I2C_DATA_MAX ) ) return FALSE;
+
+    next = ( i2c_head + 1 ) & ( I2C_QUEUE_SIZE - 1 );
+    if ( next == i2c_tail ) return FALSE;
+
+    p = &i2c_xfer[ i2c_head ];
+    p->addr = addr;
+    p->reg = reg;
+    p->wlen = wlen;
+    p->rlen = rlen;
+    for ( i = 0; i < wlen; i++ ) {
+        p->data[ i ] = pdata[ i ];
+    }
+    p->status = I2C_STATUS_PENDING;
+    p->tag = tag;
+
+    i2c_head = next;
+    startBus();
+
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendSensor
+//
+// Convert a sensor reading and send it as a measurement event
+//
+
+static uint8_t sendSensor( uint8_t idx, uint8_t *praw )
+{
+    uint8_t i;
+    uint8_t len;
+    uint8_t format;
+    uint8_t shift;
+    uint8_t mul;
+    uint8_t div;
+    int32_t value;
+    uint8_t data[ 6 ];
+    uint16_t row;
+
+    // Kept and sent later, not dropped
+    if ( !ratelimit_ready( VSCP_CLASS1_MEASUREMENT ) ) return FALSE;
+
+    row = EEPROM_I2C_SENSORS + I2C_SENSOR_SIZE * idx;
+    format = eeprom_read( row + I2C_SENSOR_FORMAT );
+    len = format & I2C_FORMAT_LENGTH;
+    if ( ( 0 == len ) || ( len > I2C_DATA_MAX ) ) len = 1;
+
+    // Raw value
+    value = 0;
+    for ( i = 0; i < len; i++ ) {
+        value <<= 8;
+        value |= ( format & I2C_FORMAT_LSB_FIRST ) ? praw[ len - 1 - i ] : praw[ i ];
+    }
+
+    // Sign extend from the top bit read
+    if ( ( format & I2C_FORMAT_SIGNED ) && ( len < 4 ) &&
+            ( value & ( (int32_t)0x80 << ( 8 * ( len - 1 ) ) ) ) ) {
+        value |= (int32_t)-1 << ( 8 * len );
+    }
+
+    shift = eeprom_read( row + I2C_SENSOR_SHIFT );
+    mul = eeprom_read( row + I2C_SENSOR_MUL );
+    div = eeprom_read( row + I2C_SENSOR_DIV );
+
+    value >>= ( shift & 0x0f );
+    if ( mul ) value *= mul;
+    if ( div ) value /= div;
+    value += (int8_t)eeprom_read( row + I2C_SENSOR_OFFSET );
+
+    data[ 0 ] = I2C_CODING_NORMALIZED |
+                    ( eeprom_read( row + I2C_SENSOR_CODING ) & 0x1f );
+    data[ 1 ] = 0x80 | ( shift >> 4 );  // Decimal point steps to the left
+    data[ 2 ] = ( value >> 24 ) & 0xff;
+    data[ 3 ] = ( value >> 16 ) & 0xff;
+    data[ 4 ] = ( value >> 8 ) & 0xff;
+    data[ 5 ] = value & 0xff;
+
+    return sendVSCPFrame( VSCP_CLASS1_MEASUREMENT,
+                            eeprom_read( row + I2C_SENSOR_TYPE ),
+                            vscp_nickname,
+                            VSCP_PRIORITY_LOW,
+                            6,
+                            data );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// i2c_hasWork
+//
+
+uint8_t i2c_hasWork( void )
+{
+    if ( !i2c_enabled ) return FALSE;
+
+    return ( ( i2c_tail != i2c_cur ) || ( i2c_due & ~i2c_pending ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doI2C
+//
+
+void doI2C( void )
+{
+    uint8_t i;
+    uint8_t due;
+    uint16_t row;
+    i2c_xfer_t *p;
+
+    if ( !i2c_enabled ) return;
+
+    // Finished transactions. A result that can't be sent now is kept
+    // and tried again.
+    while ( i2c_tail != i2c_cur ) {
+
+        p = &i2c_xfer[ i2c_tail ];
+
+        if ( p->tag < I2C_SENSORS ) {
+            if ( ( I2C_STATUS_OK == p->status ) &&
+                    !sendSensor( p->tag, p->data ) ) {
+                break;
+            }
+            i2c_pending &= ~( 1 << p->tag );
+        }
+
+        i2c_tail = ( i2c_tail + 1 ) & ( I2C_QUEUE_SIZE - 1 );
+    }
+
+    // Queue left waiting after a timeout
+    startBus();
+
+    // Sensors due for a poll
+    INTCONbits.GIEL = 0;
+    due = i2c_due & ~i2c_pending;
+    INTCONbits.GIEL = 1;
+    if ( !due ) return;
+
+    for ( i = 0; i < I2C_SENSORS; i++ ) {
+
+        if ( !( due & ( 1 << i ) ) ) continue;
+
+        row = EEPROM_I2C_SENSORS + I2C_SENSOR_SIZE * i;
+
+        // Row not in use
+        if ( 0 == eeprom_read( row + I2C_SENSOR_ADDR ) ) {
+            INTCONbits.GIEL = 0;
+            i2c_due &= ~( 1 << i );
+            i2c_period_cnt[ i ] = eeprom_read( row + I2C_SENSOR_PERIOD );
+            INTCONbits.GIEL = 1;
+            continue;
+        }
+
+        if ( !i2c_queue( eeprom_read( row + I2C_SENSOR_ADDR ),
+                            eeprom_read( row + I2C_SENSOR_REG ),
+                            0,
+                            eeprom_read( row + I2C_SENSOR_FORMAT ) & I2C_FORMAT_LENGTH,
+                            NULL,
+                            i ) ) {
+            if ( i2c_queue_full < 255 ) i2c_queue_full++;
+            return;
+        }
+
+        i2c_pending |= ( 1 << i );
+
+        INTCONbits.GIEL = 0;
+        i2c_due &= ~( 1 << i );
+        i2c_period_cnt[ i ] = eeprom_read( row + I2C_SENSOR_PERIOD );
+        INTCONbits.GIEL = 1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// i2c_oneSecond
+//
+
+void i2c_oneSecond( void )
+{
+    uint32_t busy;
+
+    INTCONbits.GIEL = 0;
+    busy = i2c_busy;
+    i2c_busy = 0;
+    i2c_rate = i2c_count;
+    i2c_count = 0;
+    INTCONbits.GIEL = 1;
+
+    // 0.8 us ticks in a second to 0.1 %
+    i2c_utilization = busy / 1250;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// i2c_readReg
+//
+
+uint8_t i2c_readReg( uint8_t reg )
+{
+    uint16_t max;
+
+    if ( ( reg >= REG_I2C_SENSOR ) &&
+            ( reg < ( REG_I2C_SENSOR + I2C_SENSORS * I2C_SENSOR_SIZE ) ) ) {
+        return eeprom_read( EEPROM_I2C_SENSORS + ( reg - REG_I2C_SENSOR ) );
+    }
+
+    switch ( reg ) {
+
+        case REG_I2C_SPEED:
+            return eeprom_read( EEPROM_I2C_SPEED );
+
+        case REG_I2C_UTILIZATION_MSB:
+            return ( i2c_utilization >> 8 ) & 0xff;
+
+        case REG_I2C_UTILIZATION_LSB:
+            return i2c_utilization & 0xff;
+
+        case REG_I2C_RATE:
+            return i2c_rate;
+
+        case REG_I2C_ERRORS:
+            return i2c_errors;
+
+        case REG_I2C_ISR_MAX:
+            INTCONbits.GIEL = 0;
+            max = i2c_isr_max;
+            INTCONbits.GIEL = 1;
+            max = TIMESTAMP_TO_US( max );
+            return ( max > 255 ) ? 255 : max;
+
+        case REG_I2C_QUEUE_FULL:
+            return i2c_queue_full;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// i2c_writeReg
+//
+
+uint8_t i2c_writeReg( uint8_t reg, uint8_t val )
+{
+    uint8_t idx;
+
+    if ( ( reg >= REG_I2C_SENSOR ) &&
+            ( reg < ( REG_I2C_SENSOR + I2C_SENSORS * I2C_SENSOR_SIZE ) ) ) {
+
+        eeprom_write( EEPROM_I2C_SENSORS + ( reg - REG_I2C_SENSOR ), val );
+
+        // A new period starts now
+        idx = ( reg - REG_I2C_SENSOR ) / I2C_SENSOR_SIZE;
+        if ( I2C_SENSOR_PERIOD == ( reg - REG_I2C_SENSOR ) % I2C_SENSOR_SIZE ) {
+            INTCONbits.GIEL = 0;
+            i2c_period_cnt[ idx ] = val;
+            INTCONbits.GIEL = 1;
+        }
+
+        return eeprom_read( EEPROM_I2C_SENSORS + ( reg - REG_I2C_SENSOR ) );
+    }
+
+    switch ( reg ) {
+
+        case REG_I2C_SPEED:
+            if ( val > I2C_SPEED_400K ) return ~val;
+            eeprom_write( EEPROM_I2C_SPEED, val );
+            i2c_init();
+            return eeprom_read( EEPROM_I2C_SPEED );
+
+        // Write to clear
+        case REG_I2C_ERRORS:
+            i2c_errors = 0;
+            return 0;
+
+        case REG_I2C_ISR_MAX:
+            INTCONbits.GIEL = 0;
+            i2c_isr_max = 0;
+            INTCONbits.GIEL = 1;
+            return 0;
+
+        case REG_I2C_QUEUE_FULL:
+            i2c_queue_full = 0;
+            return 0;
+    }
+
+    return ~val;
+}
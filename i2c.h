@@ -0,0 +1,156 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_I2C_H
+#define ODESSA_I2C_H
+
+// I2C master on the MSSP, pin 5 (RC3/SCL) and pin 6 (RC4/SDA). Both pins
+// must be in I2C mode. Transactions are queued by the main loop and run
+// by the MSSP interrupt one step at a time, so the main loop never waits
+// for the bus.
+#define I2C_SCL_PIN                 5
+#define I2C_SDA_PIN                 6
+
+// Transaction queue. Size must be a power of two.
+#define I2C_QUEUE_SIZE              8
+#define I2C_DATA_MAX                4
+
+// Transaction status
+#define I2C_STATUS_PENDING          0
+#define I2C_STATUS_OK               1
+#define I2C_STATUS_ERROR            2
+
+// A transaction with no reply wanted
+#define I2C_TAG_NONE                0xff
+
+// Bus speed
+#define I2C_SPEED_100K              0
+#define I2C_SPEED_400K              1
+
+// Transaction timeout (ms). The MSSP is reset if a step takes longer.
+#define I2C_TIMEOUT                 10
+
+// Sensor poll table
+#define I2C_SENSORS                 8
+#define I2C_SENSOR_SIZE             10
+
+// Sensor row layout
+#define I2C_SENSOR_ADDR             0   // 7-bit address, 0 = not used
+#define I2C_SENSOR_REG              1   // Register to read
+#define I2C_SENSOR_FORMAT           2   // Length and byte order
+#define I2C_SENSOR_PERIOD           3   // 100 ms units, 0 = off
+#define I2C_SENSOR_SHIFT            4   // Right shift, decimals
+#define I2C_SENSOR_MUL              5   // Multiplier
+#define I2C_SENSOR_DIV              6   // Divisor
+#define I2C_SENSOR_OFFSET           7   // Signed offset after scaling
+#define I2C_SENSOR_TYPE             8   // CLASS1.MEASUREMENT type
+#define I2C_SENSOR_CODING           9   // Sensor index and unit
+
+// Format bits
+#define I2C_FORMAT_LENGTH           0x07    // 1-4 bytes
+#define I2C_FORMAT_LSB_FIRST        0x10
+#define I2C_FORMAT_SIGNED           0x20
+
+typedef struct {
+    uint8_t addr;                   // 7-bit address
+    uint8_t reg;                    // Register, always written first
+    uint8_t wlen;                   // Data bytes to write after reg
+    uint8_t rlen;                   // Bytes to read after a restart
+    uint8_t data[ I2C_DATA_MAX ];   // Write data, then read data
+    uint8_t status;
+    uint8_t tag;                    // Owner of the result
+} i2c_xfer_t;
+
+/*!
+    Set up I2C from pin modes. Call after pins_init().
+*/
+void i2c_init( void );
+
+/*!
+    Write default I2C configuration to EEPROM
+*/
+void i2c_init_eeprom( void );
+
+/*!
+    Sensor periods and transaction timeout. Called from the 1 ms tick
+    interrupt only.
+*/
+void i2c_tick( void );
+
+/*!
+    Run the next step of the current transaction. Called from the low
+    priority interrupt only.
+*/
+void i2c_isr( void );
+
+/*!
+    Queue a transaction
+    @param addr 7-bit address.
+    @param reg Register written first.
+    @param wlen Bytes from pdata to write after the register.
+    @param rlen Bytes to read after a restart.
+    @param pdata Data to write, may be NULL if wlen is 0.
+    @param tag Owner of the result or I2C_TAG_NONE.
+    @return TRUE if queued, FALSE if the queue is full.
+*/
+uint8_t i2c_queue( uint8_t addr,
+                    uint8_t reg,
+                    uint8_t wlen,
+                    uint8_t rlen,
+                    uint8_t *pdata,
+                    uint8_t tag );
+
+/*!
+    Check for finished transactions or sensors due for a poll
+    @return TRUE if doI2C() has work to do.
+*/
+uint8_t i2c_hasWork( void );
+
+/*!
+    Poll sensors and send measurement events for finished transactions
+*/
+void doI2C( void );
+
+/*!
+    Compute bus utilization of the last second. Call once a second.
+*/
+void i2c_oneSecond( void );
+
+/*!
+    Read I2C register (page REG_PAGE_I2C)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t i2c_readReg( uint8_t reg );
+
+/*!
+    Write I2C register (page REG_PAGE_I2C)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t i2c_writeReg( uint8_t reg, uint8_t val );
+
+#endif
@@ -0,0 +1,273 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "inputs.h"
+
+// Debounced state and changes not yet reported, per port. Active = 1.
+volatile uint8_t input_state[ PIN_PORTS ];
+volatile uint8_t input_changed[ PIN_PORTS ];
+
+// Two bit vertical counters, one bit per port pin
+uint8_t input_ct0[ PIN_PORTS ];
+uint8_t input_ct1[ PIN_PORTS ];
+
+uint8_t input_mask[ PIN_PORTS ];    // Port bits used as inputs
+uint8_t input_invert[ PIN_PORTS ];  // Port bits that are active low
+
+uint8_t input_sample_time;          // Sample period in ms
+uint8_t input_sample_cnt;           // ms since last sample
+
+// Debounce one port. A bit toggles in the debounced state when the
+// sample has been different from it four samples in a row. The same
+// bitwise operations handle all pins on the port at once.
+#define INPUT_DEBOUNCE( idx, port )                                         \
+    delta = ( ( port ^ input_invert[ idx ] ) ^ input_state[ idx ] ) &       \
+                input_mask[ idx ];                                          \
+    input_ct0[ idx ] = ~( input_ct0[ idx ] & delta );                       \
+    input_ct1[ idx ] = input_ct0[ idx ] ^ ( input_ct1[ idx ] & delta );     \
+    delta &= input_ct0[ idx ] & input_ct1[ idx ];                           \
+    input_state[ idx ] ^= delta;                                            \
+    input_changed[ idx ] |= delta;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// inputs_init
+//
+
+void inputs_init( void )
+{
+    uint8_t i;
+
+    input_sample_time = eeprom_read( EEPROM_INPUT_SAMPLE_TIME );
+    if ( 0 == input_sample_time ) input_sample_time = 1;
+
+    INTCONbits.GIEL = 0;
+
+    input_mask[ PIN_PORT_A ] = 0;
+    input_mask[ PIN_PORT_B ] = 0;
+    input_mask[ PIN_PORT_C ] = 0;
+    input_invert[ PIN_PORT_A ] = 0;
+    input_invert[ PIN_PORT_B ] = 0;
+    input_invert[ PIN_PORT_C ] = 0;
+
+    for ( i = 0; i < PIN_COUNT; i++ ) {
+
+        if ( PIN_PORT_NONE == pin_port[ i ] ) continue;
+        if ( PIN_MODE_INPUT != ( pin_mode[ i ] & PIN_MODE_MASK ) ) continue;
+
+        input_mask[ pin_port[ i ] ] |= pin_mask[ i ];
+        if ( pin_mode[ i ] & PIN_FLAG_INVERT ) {
+            input_invert[ pin_port[ i ] ] |= pin_mask[ i ];
+        }
+    }
+
+    // Start from current levels so no events are sent at power up
+    input_state[ PIN_PORT_A ] = ( PORTA ^ input_invert[ PIN_PORT_A ] ) &
+                                    input_mask[ PIN_PORT_A ];
+    input_state[ PIN_PORT_B ] = ( PORTB ^ input_invert[ PIN_PORT_B ] ) &
+                                    input_mask[ PIN_PORT_B ];
+    input_state[ PIN_PORT_C ] = ( PORTC ^ input_invert[ PIN_PORT_C ] ) &
+                                    input_mask[ PIN_PORT_C ];
+
+    for ( i = 0; i < PIN_PORTS; i++ ) {
+        input_changed[ i ] = 0;
+        input_ct0[ i ] = 0xff;
+        input_ct1[ i ] = 0xff;
+    }
+
+    input_sample_cnt = 0;
+
+    INTCONbits.GIEL = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// inputs_init_eeprom
+//
+
+void inputs_init_eeprom( void )
+{
+    eeprom_write( EEPROM_INPUT_SAMPLE_TIME, INPUT_DEFAULT_SAMPLE_TIME );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// inputs_sample
+//
+// Called from the tick interrupt. Three port reads and a handful of
+// bitwise operations per port regardless of the number of inputs.
+//
+
+void inputs_sample( void )
+{
+    uint8_t delta;
+
+    if ( ++input_sample_cnt < input_sample_time ) return;
+    input_sample_cnt = 0;
+
+    INPUT_DEBOUNCE( PIN_PORT_A, PORTA );
+    INPUT_DEBOUNCE( PIN_PORT_B, PORTB );
+    INPUT_DEBOUNCE( PIN_PORT_C, PORTC );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendButtonEvent
+//
+
+static void sendButtonEvent( uint8_t pin, uint8_t bPressed )
+{
+    uint8_t data[ 5 ];
+
+    data[ 0 ] = bPressed ? 1 : 0;   // Pressed/released
+    data[ 1 ] = eeprom_read( VSCP_EEPROM_END + REG_ZONE );
+    data[ 2 ] = eeprom_read( VSCP_EEPROM_END + REG_PIN3_SUBZONE +
+                                ( pin - PIN_FIRST ) );
+    data[ 3 ] = 0;                  // Button code MSB
+    data[ 4 ] = pin;                // Button code LSB
+    sendVSCPFrame( VSCP_CLASS1_INFORMATION,
+                    VSCP_TYPE_INFORMATION_BUTTON,
+                    vscp_nickname,
+                    VSCP_PRIORITY_MEDIUM,
+                    5,
+                    data );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doInputs
+//
+
+void doInputs( void )
+{
+    uint8_t i;
+    uint8_t pin;
+    uint8_t changed[ PIN_PORTS ];
+    uint8_t state[ PIN_PORTS ];
+    uint32_t changedPins;
+    uint32_t activePins;
+
+    INTCONbits.GIEL = 0;
+    for ( i = 0; i < PIN_PORTS; i++ ) {
+        changed[ i ] = input_changed[ i ];
+        input_changed[ i ] = 0;
+        state[ i ] = input_state[ i ];
+    }
+    INTCONbits.GIEL = 1;
+
+    if ( !( changed[ PIN_PORT_A ] | changed[ PIN_PORT_B ] | changed[ PIN_PORT_C ] ) ) {
+        return;
+    }
+
+    changedPins = pins_fromPorts( changed );
+    activePins = pins_fromPorts( state );
+
+    for ( pin = PIN_FIRST; pin <= PIN_LAST; pin++ ) {
+
+        if ( changedPins & 1 ) {
+            inputs_sendEvent( pin, activePins & 1 );
+        }
+
+        changedPins >>= 1;
+        activePins >>= 1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// inputs_sendEvent
+//
+
+void inputs_sendEvent( uint8_t pin, uint8_t bActive )
+{
+    if ( pin_mode[ pin - PIN_FIRST ] & PIN_FLAG_BUTTON ) {
+        sendButtonEvent( pin, bActive );
+    }
+    else {
+        SendInformationEvent( pin,
+                                VSCP_CLASS1_INFORMATION,
+                                bActive ?
+                                    VSCP_TYPE_INFORMATION_ON :
+                                    VSCP_TYPE_INFORMATION_OFF );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// inputs_getState
+//
+
+uint8_t inputs_getState( uint8_t pin )
+{
+    if ( ( pin < PIN_FIRST ) || ( pin > PIN_LAST ) ) return FALSE;
+    if ( PIN_PORT_NONE == pin_port[ pin - PIN_FIRST ] ) return FALSE;
+
+    return ( input_state[ pin_port[ pin - PIN_FIRST ] ] &
+                pin_mask[ pin - PIN_FIRST ] ) ? TRUE : FALSE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// inputs_readReg
+//
+
+uint8_t inputs_readReg( uint8_t reg )
+{
+    uint8_t state[ PIN_PORTS ];
+    uint32_t pins;
+
+    if ( REG_INPUT_SAMPLE_TIME == reg ) {
+        return input_sample_time;
+    }
+    else if ( ( reg >= REG_INPUT_STATE0 ) && ( reg <= REG_INPUT_STATE2 ) ) {
+
+        state[ PIN_PORT_A ] = input_state[ PIN_PORT_A ];
+        state[ PIN_PORT_B ] = input_state[ PIN_PORT_B ];
+        state[ PIN_PORT_C ] = input_state[ PIN_PORT_C ];
+        pins = pins_fromPorts( state );
+
+        return ( pins >> ( 8 * ( reg - REG_INPUT_STATE0 ) ) ) & 0xff;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// inputs_writeReg
+//
+
+uint8_t inputs_writeReg( uint8_t reg, uint8_t val )
+{
+    if ( REG_INPUT_SAMPLE_TIME == reg ) {
+        eeprom_write( EEPROM_INPUT_SAMPLE_TIME, val );
+        input_sample_time = eeprom_read( EEPROM_INPUT_SAMPLE_TIME );
+        if ( 0 == input_sample_time ) input_sample_time = 1;
+        return input_sample_time;
+    }
+
+    return ~val;
+}
@@ -0,0 +1,86 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+#ifndef ODESSA_INPUTS_H
+#define ODESSA_INPUTS_H
+
+// Default sample period in ms. A change must be stable for four
+// samples to be accepted.
+#define INPUT_DEFAULT_SAMPLE_TIME   5
+
+// Debounced input state per port (active = 1)
+extern volatile uint8_t input_state[ PIN_PORTS ];
+
+/*!
+    Set up input sampling from pin modes. Call after pins_init().
+*/
+void inputs_init( void );
+
+/*!
+    Write default input configuration to EEPROM
+*/
+void inputs_init_eeprom( void );
+
+/*!
+    Sample and debounce all inputs. Called from the 1 ms tick
+    interrupt only.
+*/
+void inputs_sample( void );
+
+/*!
+    Send events for inputs that changed state since last call
+*/
+void doInputs( void );
+
+/*!
+    Send the change of state event configured for an input pin,
+    ON/OFF or BUTTON.
+    @param pin Connector pin 3-20
+    @param bActive TRUE if input is active.
+*/
+void inputs_sendEvent( uint8_t pin, uint8_t bActive );
+
+/*!
+    Get the debounced state of an input pin
+    @param pin Connector pin 3-20
+    @return TRUE if input is active.
+*/
+uint8_t inputs_getState( uint8_t pin );
+
+/*!
+    Read input register (page REG_PAGE_PINS)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t inputs_readReg( uint8_t reg );
+
+/*!
+    Write input register (page REG_PAGE_PINS)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t inputs_writeReg( uint8_t reg, uint8_t val );
+
+#endif
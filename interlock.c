@@ -0,0 +1,424 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "interlock.h"
+
+uint32_t interlock_pins;
+
+// RAM copy of EEPROM, output pins only
+uint32_t interlock_mask[ INTERLOCK_GROUPS ];
+uint8_t interlock_port_mask[ INTERLOCK_GROUPS ][ PIN_PORTS ];
+uint16_t interlock_dead[ INTERLOCK_GROUPS ];                    // ms
+
+volatile uint16_t interlock_wait[ INTERLOCK_GROUPS ];           // ms left
+volatile uint8_t interlock_last[ INTERLOCK_GROUPS ][ PIN_PORTS ];   // Members on at last tick
+uint8_t interlock_pending[ INTERLOCK_GROUPS ];                  // Pin held back, 0 = none
+
+// Statistics
+uint8_t interlock_delayed;          // Held back for the dead time
+uint8_t interlock_blocked;          // Not done
+
+
+///////////////////////////////////////////////////////////////////////////////
+// readOutputs
+//
+// Output pins in interlock groups that are on.
+//
+
+static uint32_t readOutputs( void )
+{
+    uint8_t ports[ PIN_PORTS ];
+
+    ports[ PIN_PORT_A ] = LATA;
+    ports[ PIN_PORT_B ] = LATB;
+    ports[ PIN_PORT_C ] = LATC;
+
+    return pins_fromPorts( ports ) & interlock_pins;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// load
+//
+
+static void load( uint8_t idx )
+{
+    uint8_t i;
+    uint16_t addr;
+    uint32_t mask;
+    uint8_t gie;
+
+    addr = EEPROM_INTERLOCK_GROUPS + idx * INTERLOCK_SIZE;
+
+    mask = 0;
+    for ( i = 0; i < PIN_COUNT; i++ ) {
+        if ( ( PIN_PORT_NONE != pin_port[ i ] ) &&
+                ( PIN_MODE_OUTPUT == ( pin_mode[ i ] & PIN_MODE_MASK ) ) ) {
+            mask |= PIN_BIT( i + PIN_FIRST );
+        }
+    }
+
+    mask &= (uint32_t)eeprom_read( addr + INTERLOCK_POS_MASK ) |
+            ( (uint32_t)eeprom_read( addr + INTERLOCK_POS_MASK + 1 ) << 8 ) |
+            ( (uint32_t)eeprom_read( addr + INTERLOCK_POS_MASK + 2 ) << 16 );
+
+    // A group of one pin has nothing to lock against
+    if ( !( mask & ( mask - 1 ) ) ) mask = 0;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+
+    interlock_dead[ idx ] = (uint16_t)eeprom_read( addr + INTERLOCK_POS_DEAD_TIME ) * 10;
+
+    // A group with the same members keeps its running dead time, a
+    // member just turned off must still wait it out
+    if ( mask == interlock_mask[ idx ] ) {
+        if ( interlock_wait[ idx ] > interlock_dead[ idx ] ) {
+            interlock_wait[ idx ] = interlock_dead[ idx ];
+        }
+    }
+    else {
+        interlock_mask[ idx ] = mask;
+        pins_toPorts( mask, interlock_port_mask[ idx ] );
+        interlock_wait[ idx ] = 0;
+        for ( i = 0; i < PIN_PORTS; i++ ) {
+            interlock_last[ idx ][ i ] = 0;
+        }
+        interlock_pending[ idx ] = 0;
+    }
+
+    INTCONbits.GIEL = gie;
+
+    interlock_pins = 0;
+    for ( i = 0; i < INTERLOCK_GROUPS; i++ ) {
+        interlock_pins |= interlock_mask[ i ];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isClear
+//
+// TRUE if no member other than those in pins has been on within the
+// dead time. A member turned off since the last tick is still seen as
+// on.
+//
+
+static uint8_t isClear( uint8_t idx, uint32_t pins )
+{
+    uint8_t i;
+    uint8_t gie;
+    uint8_t rv;
+    uint8_t ports[ PIN_PORTS ];
+
+    pins_toPorts( pins, ports );
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+
+    rv = interlock_wait[ idx ] ? FALSE : TRUE;
+    for ( i = 0; i < PIN_PORTS; i++ ) {
+        if ( interlock_last[ idx ][ i ] & ~ports[ i ] ) rv = FALSE;
+    }
+
+    INTCONbits.GIEL = gie;
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// forceOff
+//
+
+static void forceOff( uint8_t idx, uint32_t pins )
+{
+    uint8_t i;
+    uint8_t gie;
+    uint8_t ports[ PIN_PORTS ];
+
+    pins_toPorts( pins, ports );
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+
+    LATA &= ~ports[ PIN_PORT_A ];
+    LATB &= ~ports[ PIN_PORT_B ];
+    LATC &= ~ports[ PIN_PORT_C ];
+
+    INTCONbits.GIEH = gie;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    interlock_wait[ idx ] = interlock_dead[ idx ];
+    INTCONbits.GIEL = gie;
+
+    for ( i = 0; i < PIN_COUNT; i++ ) {
+        if ( pins & PIN_BIT( i + PIN_FIRST ) ) {
+            SendInformationEvent( i + PIN_FIRST,
+                                    VSCP_CLASS1_INFORMATION,
+                                    VSCP_TYPE_INFORMATION_OFF );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// hold
+//
+// Hold back a pin until the dead time has passed. Another pin already
+// held back in the group is dropped.
+//
+
+static void hold( uint8_t idx, uint32_t pins )
+{
+    uint8_t pin;
+
+    for ( pin = PIN_FIRST; pin <= PIN_LAST; pin++ ) {
+        if ( pins & PIN_BIT( pin ) ) break;
+    }
+
+    if ( interlock_pending[ idx ] == pin ) return;
+
+    if ( interlock_pending[ idx ] ) {
+        if ( interlock_blocked < 255 ) interlock_blocked++;
+    }
+    interlock_pending[ idx ] = pin;
+
+    if ( interlock_delayed < 255 ) interlock_delayed++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// interlock_init
+//
+
+void interlock_init( void )
+{
+    uint8_t i;
+
+    for ( i = 0; i < INTERLOCK_GROUPS; i++ ) {
+        load( i );
+    }
+
+    interlock_delayed = 0;
+    interlock_blocked = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// interlock_init_eeprom
+//
+
+void interlock_init_eeprom( void )
+{
+    uint8_t i;
+
+    for ( i = 0; i < INTERLOCK_GROUPS * INTERLOCK_SIZE; i++ ) {
+        eeprom_write( EEPROM_INTERLOCK_GROUPS + i,
+                        ( INTERLOCK_POS_DEAD_TIME == ( i % INTERLOCK_SIZE ) ) ?
+                            INTERLOCK_DEFAULT_DEAD_TIME : 0 );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// interlock_tick
+//
+// The dead time starts when a member is seen going off, whatever
+// turned it off.
+//
+
+void interlock_tick( void )
+{
+    uint8_t i;
+    uint8_t on[ PIN_PORTS ];
+
+    for ( i = 0; i < INTERLOCK_GROUPS; i++ ) {
+
+        if ( !interlock_mask[ i ] ) continue;
+
+        on[ PIN_PORT_A ] = LATA & interlock_port_mask[ i ][ PIN_PORT_A ];
+        on[ PIN_PORT_B ] = LATB & interlock_port_mask[ i ][ PIN_PORT_B ];
+        on[ PIN_PORT_C ] = LATC & interlock_port_mask[ i ][ PIN_PORT_C ];
+
+        if ( ( interlock_last[ i ][ PIN_PORT_A ] & ~on[ PIN_PORT_A ] ) ||
+                ( interlock_last[ i ][ PIN_PORT_B ] & ~on[ PIN_PORT_B ] ) ||
+                ( interlock_last[ i ][ PIN_PORT_C ] & ~on[ PIN_PORT_C ] ) ) {
+            interlock_wait[ i ] = interlock_dead[ i ];
+        }
+        else if ( interlock_wait[ i ] ) {
+            interlock_wait[ i ]--;
+        }
+
+        interlock_last[ i ][ PIN_PORT_A ] = on[ PIN_PORT_A ];
+        interlock_last[ i ][ PIN_PORT_B ] = on[ PIN_PORT_B ];
+        interlock_last[ i ][ PIN_PORT_C ] = on[ PIN_PORT_C ];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doInterlock
+//
+
+void doInterlock( void )
+{
+    uint8_t i;
+    uint8_t pin;
+
+    for ( i = 0; i < INTERLOCK_GROUPS; i++ ) {
+
+        if ( !interlock_pending[ i ] ) continue;
+        if ( !isClear( i, 0 ) ) continue;
+
+        pin = interlock_pending[ i ];
+        interlock_pending[ i ] = 0;
+        actionSet( 0, pin );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// interlock_set
+//
+
+uint8_t interlock_set( uint8_t pin )
+{
+    if ( ( pin < PIN_FIRST ) || ( pin > PIN_LAST ) ) return TRUE;
+    if ( !( interlock_pins & PIN_BIT( pin ) ) ) return TRUE;
+
+    return ( interlock_filter( PIN_BIT( pin ), PIN_BIT( pin ) ) &
+                PIN_BIT( pin ) ) ? TRUE : FALSE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// interlock_filter
+//
+// Pins not written keep their state. Writing a held back pin off
+// cancels it.
+//
+
+uint32_t interlock_filter( uint32_t pins, uint32_t written )
+{
+    uint8_t i;
+    uint32_t cur;
+    uint32_t req;
+    uint32_t on;
+    uint32_t others;
+
+    if ( !( interlock_pins & written ) ) return pins;
+
+    cur = readOutputs();
+
+    for ( i = 0; i < INTERLOCK_GROUPS; i++ ) {
+
+        if ( !( interlock_mask[ i ] & written ) ) continue;
+
+        req = ( ( pins & written ) | ( cur & ~written ) ) & interlock_mask[ i ];
+
+        if ( interlock_pending[ i ] &&
+                ( written & PIN_BIT( interlock_pending[ i ] ) ) &&
+                !( req & PIN_BIT( interlock_pending[ i ] ) ) ) {
+            interlock_pending[ i ] = 0;
+        }
+
+        on = req & ~cur;
+        if ( !on ) continue;
+
+        // More than one member turned on at once
+        if ( on & ( on - 1 ) ) {
+            pins &= ~on;
+            if ( interlock_blocked < 255 ) interlock_blocked++;
+            continue;
+        }
+
+        others = cur & interlock_mask[ i ] & ~on;
+        if ( !others && isClear( i, on ) ) continue;
+
+        if ( others ) forceOff( i, others );
+        pins &= ~( on | others );
+        hold( i, on );
+    }
+
+    return pins;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// interlock_readReg
+//
+
+uint8_t interlock_readReg( uint8_t reg )
+{
+    if ( reg < ( REG_INTERLOCK_GROUPS + INTERLOCK_GROUPS * INTERLOCK_SIZE ) ) {
+        return eeprom_read( EEPROM_INTERLOCK_GROUPS + reg - REG_INTERLOCK_GROUPS );
+    }
+
+    if ( ( reg >= REG_INTERLOCK_PENDING ) &&
+            ( reg < ( REG_INTERLOCK_PENDING + INTERLOCK_GROUPS ) ) ) {
+        return interlock_pending[ reg - REG_INTERLOCK_PENDING ];
+    }
+
+    switch ( reg ) {
+
+        case REG_INTERLOCK_DELAYED:
+            return interlock_delayed;
+
+        case REG_INTERLOCK_BLOCKED:
+            return interlock_blocked;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// interlock_writeReg
+//
+
+uint8_t interlock_writeReg( uint8_t reg, uint8_t val )
+{
+    if ( reg < ( REG_INTERLOCK_GROUPS + INTERLOCK_GROUPS * INTERLOCK_SIZE ) ) {
+        eeprom_write( EEPROM_INTERLOCK_GROUPS + reg - REG_INTERLOCK_GROUPS, val );
+        load( ( reg - REG_INTERLOCK_GROUPS ) / INTERLOCK_SIZE );
+        return interlock_readReg( reg );
+    }
+
+    switch ( reg ) {
+
+        case REG_INTERLOCK_DELAYED:
+            interlock_delayed = 0;
+            break;
+
+        case REG_INTERLOCK_BLOCKED:
+            interlock_blocked = 0;
+            break;
+
+        default:
+            return ~val;
+    }
+
+    return interlock_readReg( reg );
+}
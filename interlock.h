@@ -0,0 +1,97 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_INTERLOCK_H
+#define ODESSA_INTERLOCK_H
+
+// Interlock groups. At most one output in a group is on. Turning a
+// member on turns the others off and holds the new output until the
+// dead time of the group has passed since a member went off.
+#define INTERLOCK_GROUPS            4
+#define INTERLOCK_SIZE              4   // EEPROM bytes per group
+
+#define INTERLOCK_POS_MASK          0   // Pin bitmap, 3 bytes
+#define INTERLOCK_POS_DEAD_TIME     3   // 10 ms
+
+#define INTERLOCK_DEFAULT_DEAD_TIME 50  // 500 ms
+
+// Output pins that are in an interlock group
+extern uint32_t interlock_pins;
+
+/*!
+    Load interlock groups from EEPROM. Call after pins_init().
+*/
+void interlock_init( void );
+
+/*!
+    Write default interlock configuration to EEPROM, no groups
+*/
+void interlock_init_eeprom( void );
+
+/*!
+    Count down dead times. Called from the 1 ms tick interrupt only.
+*/
+void interlock_tick( void );
+
+/*!
+    Switch outputs held back by a dead time when it has passed
+*/
+void doInterlock( void );
+
+/*!
+    Check if an output pin may be turned on now. If not the other
+    members of its group are turned off and the pin is turned on with
+    actionSet() when the dead time has passed.
+    @param pin Connector pin 3-20
+    @return TRUE if the pin may be turned on now.
+*/
+uint8_t interlock_set( uint8_t pin );
+
+/*!
+    Filter a write of several output pins. A group where more than one
+    member would be turned on is blocked, a member that must wait for
+    the dead time is held back and turned on later.
+    @param pins Requested state of the written pins.
+    @param written Pins written.
+    @return Requested state with pins not allowed on cleared.
+*/
+uint32_t interlock_filter( uint32_t pins, uint32_t written );
+
+/*!
+    Read interlock register (page REG_PAGE_INTERLOCK)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t interlock_readReg( uint8_t reg );
+
+/*!
+    Write interlock register (page REG_PAGE_INTERLOCK)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t interlock_writeReg( uint8_t reg, uint8_t val );
+
+#endif
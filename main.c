@@ -34,6 +34,24 @@
 #include <vscp-class.h>
 #include <vscp-type.h>
 #include "odessa.h"
+#include "pins.h"
+#include "inputs.h"
+#include "edges.h"
+#include "adc.h"
+#include "counter.h"
+#include "pwm.h"
+#include "softpwm.h"
+#include "uart.h"
+#include "i2c.h"
+#include "spi.h"
+#include "onewire.h"
+#include "scene.h"
+#include "translate.h"
+#include "rules.h"
+#include "interlock.h"
+#include "shutter.h"
+#include "regulator.h"
+#include "ratelimit.h"
 #include "version.h"
 
 
@@ -71,12 +89,13 @@
 
 
 // Prototypes
-void actionSet( uint8_t dmflags, uint8_t param );
-void actionClr( uint8_t dmflags, uint8_t param );
 void actionSetAll( uint8_t dmflags, uint8_t param );
 void actionClrAll( uint8_t dmflags, uint8_t param );
+void actionPWM( uint8_t action, uint8_t dmflags, uint8_t param );
+void loadDMRow( uint8_t row );
 uint8_t writeControlReg( uint8_t ctrlreg, uint8_t val );
 uint8_t readControlReg( uint8_t ctrlreg );
+uint8_t isOvertaking( canframe_t *purgent );
 
 // Calculate and st required filter and mask
 // for the current decision matrix
@@ -87,20 +106,277 @@ const uint8_t vscp_deviceURL[] = "www.eurosource.se/odessa001.xml";
 
 volatile unsigned long measurement_clock; // Clock for measurments
 
-uint8_t sendTimer;  // Timer for CAN send
+volatile uint16_t sendTimer;    // Timer for CAN send
 uint8_t seconds;    // counter for seconds
 uint8_t minutes;    // counter for minutes
 uint8_t hours;      // Counter for hours
 
+// Idle
+uint8_t idle_control;               // Idle configuration
+uint8_t idle_latency_bound;         // Max wake to process latency (us)
+uint32_t idle_ticks;                // Time stamp ticks spent idle this second
+uint8_t idle_percent;               // Idle time last second (%)
+uint8_t idle_rxwake;                // TRUE if last wake was from CAN receive
+uint16_t idle_wakestamp;            // Time stamp for last CAN receive wake
+uint16_t idle_latency_max;          // Max wake to process latency (us)
+uint8_t idle_latency_overruns;      // Number of times bound was exceeded
+
+// CAN receive ring - Filled by high priority interrupt
+canframe_t can_rx_fifo[ CAN_RX_FIFO_SIZE ];
+volatile uint8_t can_rx_head;       // Written by interrupt
+volatile uint8_t can_rx_tail;       // Written by main loop
+volatile uint8_t can_rx_overruns;   // Frames lost as ring was full
+volatile uint8_t can_rx_maxfill;    // Max number of frames in ring
+uint32_t can_rx_stamp;              // Time stamp of frame in vscp_imsg
+
+// CAN receive urgent lane - Filled by high priority interrupt
+canframe_t can_rx_urgent_fifo[ CAN_RX_URGENT_SIZE ];
+volatile uint8_t can_rx_urgent_head;        // Written by interrupt
+volatile uint8_t can_rx_urgent_tail;        // Written by main loop
+volatile uint8_t can_rx_urgent_overruns;    // Urgent frames put in normal lane
+volatile uint8_t can_rx_urgent_maxfill;     // Max number of frames in lane
+uint16_t can_rx_urgent_latency_max;         // Max receive to process (us)
+volatile uint16_t can_rx_shed;              // Low priority frames shed
+uint8_t can_rx_shed_threshold;              // Shed at this normal lane fill
+uint8_t can_rx_urgent_priority;             // Priority below this is urgent
+uint8_t can_rx_seq;                         // Receive order, interrupt only
+
+// CAN transmit ring - Emptied by high priority interrupt
+canframe_t can_tx_fifo[ CAN_TX_FIFO_SIZE ];
+volatile uint8_t can_tx_head;       // Written by main loop
+volatile uint8_t can_tx_tail;       // Written by interrupt
+uint8_t can_tx_overruns;            // Frames lost as ring was full
+
+// High priority interrupt statistics (time stamp ticks)
+volatile uint16_t irq_latency_max;  // Timer1 overflow to ISR entry
+volatile uint16_t irq_duration_max; // ISR entry to exit
+
+// Decision matrix, RAM copy
+dmrow_t dm_row[ DESCION_MATRIX_ROWS ];
+uint16_t dm_time_last;              // Matching time last event (ticks)
+uint16_t dm_time_max;               // Longest matching time (ticks)
+
+// Upper half of 32-bit time stamp
+volatile uint16_t timestamp_high;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// High priority interrupt
+//      - Services CAN receive (ECAN FIFO -> receive ring)
+//      - Services CAN transmit (transmit ring -> ECAN buffers)
+//      - Services Timer1 overflow (latency probe, time stamp)
+//      - Services edge capture (INT0/INT1/interrupt-on-change)
+//      - Services CCP3 compare (1-Wire slot timing)
+//
+// Keep this short. Work done here delays everything else.
+//////////////////////////////////////////////////////////////////////////////
+
+void interrupt high_priority interrupt_at_high_vector( void )
+{
+    uint16_t start;
+    uint16_t stop;
+    uint8_t cnt;
+    uint8_t next;
+    uint8_t fill;
+    uint8_t vtype;
+    uint16_t vclass;
+    uint32_t stamp;
+    canframe_t *pframe;
+    ECAN_RX_MSG_FLAGS flags;
+
+    TIMESTAMP_READ( start );
+
+    // Timer1 overflow. As Timer1 just wrapped, the time stamp at entry
+    // is the time from the interrupt to the handler. If the overflow
+    // happened after we entered the sample is not valid.
+    if ( PIR1bits.TMR1IF ) {
+
+        PIR1bits.TMR1IF = 0;
+        timestamp_high++;
+
+        if ( ( start < 0x8000 ) && ( start > irq_latency_max ) ) {
+            irq_latency_max = start;
+        }
+
+    }
+
+    // 1-Wire slot step. First as the read sample must be taken within
+    // 15 us of the start of the slot.
+    if ( PIE4bits.CCP3IE && PIR4bits.CCP3IF ) {
+        onewire_isr();
+    }
+
+    // Synchronized fire on the CCP2 compare
+    if ( PIE3bits.CCP2IE && PIR3bits.CCP2IF ) {
+        scene_fireIsr();
+    }
+
+    // Edge capture. Before CAN so the time stamp is close to the edge.
+    if ( ( INTCONbits.INT0IE && INTCONbits.INT0IF ) ||
+            ( INTCON3bits.INT1IE && INTCON3bits.INT1IF ) ||
+            ( INTCONbits.RBIE && INTCONbits.RBIF ) ) {
+        edges_isr();
+    }
+
+    // CAN receive. Move frames from the ECAN FIFO to the receive
+    // ring. Bounded by the depth of the hardware FIFO.
+    if ( PIR3_RXBnIF ) {
+
+        PIR3_RXBnIF = 0;
+
+        // All frames moved now were received since the last interrupt
+        TIMESTAMP_READ32( stamp );
+
+        for ( cnt = 0; ( cnt < 8 ) && COMSTAT_FIFOEMPTY; cnt++ ) {
+
+            // The slot at head is not visible to the main loop until
+            // head is moved so it is safe to read into it even if full.
+            pframe = &can_rx_fifo[ can_rx_head ];
+            if ( !ECANReceiveMessage( &pframe->id,
+                                        pframe->data,
+                                        &pframe->dlc,
+                                        &flags ) ) {
+                break;
+            }
+
+            // RTR not interesting and must be extended frame
+            if ( ( flags & ECAN_RX_RTR_FRAME ) ||
+                    !( flags & ECAN_RX_XTD_FRAME ) ) {
+                continue;
+            }
+
+            pframe->stamp = stamp;
+            pframe->seq = can_rx_seq++;
+
+            // Sort into lanes on class and priority (see odessa.h)
+            vclass = (uint16_t)( pframe->id >> 16 ) & 0x1ff;
+            vtype = (uint8_t)( pframe->id >> 8 );
+            fill = ( can_rx_head - can_rx_tail ) & ( CAN_RX_FIFO_SIZE - 1 );
+
+            if ( ( VSCP_CLASS1_MEASUREMENT == vclass ) ||
+                    ( VSCP_CLASS1_MEASUREMENT64 == vclass ) ||
+                    ( VSCP_CLASS1_MEASUREZONE == vclass ) ||
+                    ( VSCP_CLASS1_MEASUREMENT32 == vclass ) ||
+                    ( ( VSCP_CLASS1_PROTOCOL == vclass ) &&
+                        ( VSCP_TYPE_PROTOCOL_SEGCTRL_HEARTBEAT == vtype ) ) ||
+                    ( ( VSCP_CLASS1_INFORMATION == vclass ) &&
+                        ( VSCP_TYPE_INFORMATION_NODE_HEARTBEAT == vtype ) ) ) {
+
+                if ( can_rx_shed_threshold &&
+                        ( fill >= can_rx_shed_threshold ) ) {
+                    if ( can_rx_shed < 0xffff ) can_rx_shed++;
+                    continue;
+                }
+            }
+            else if ( ( VSCP_CLASS1_PROTOCOL == vclass ) ||
+                        ( VSCP_CLASS1_CONTROL == vclass ) ||
+                        ( (uint8_t)( ( pframe->id >> 26 ) & 7 ) <
+                            can_rx_urgent_priority ) ) {
+
+                next = ( can_rx_urgent_head + 1 ) & ( CAN_RX_URGENT_SIZE - 1 );
+                if ( next != can_rx_urgent_tail ) {
+
+                    can_rx_urgent_fifo[ can_rx_urgent_head ] = *pframe;
+                    can_rx_urgent_head = next;
+
+                    fill = ( can_rx_urgent_head - can_rx_urgent_tail ) &
+                                ( CAN_RX_URGENT_SIZE - 1 );
+                    if ( fill > can_rx_urgent_maxfill ) {
+                        can_rx_urgent_maxfill = fill;
+                    }
+                    continue;
+                }
+
+                // Urgent lane full, fall back to the normal lane
+                if ( can_rx_urgent_overruns < 255 ) can_rx_urgent_overruns++;
+            }
+
+            next = ( can_rx_head + 1 ) & ( CAN_RX_FIFO_SIZE - 1 );
+            if ( next == can_rx_tail ) {
+                if ( can_rx_overruns < 255 ) can_rx_overruns++;
+                continue;
+            }
+
+            can_rx_head = next;
+
+            fill = ( can_rx_head - can_rx_tail ) & ( CAN_RX_FIFO_SIZE - 1 );
+            if ( fill > can_rx_maxfill ) {
+                can_rx_maxfill = fill;
+            }
+        }
+    }
+
+    // CAN transmit. Fill free ECAN transmit buffers from the transmit
+    // ring. Bounded by the number of transmit buffers.
+    if ( PIE5bits.TXBnIE && PIR5bits.TXBnIF ) {
+
+        PIR5bits.TXBnIF = 0;
+
+        while ( can_tx_tail != can_tx_head ) {
+
+            pframe = &can_tx_fifo[ can_tx_tail ];
+            if ( !ECANSendMessage( pframe->id,
+                                    pframe->data,
+                                    pframe->dlc,
+                                    ECAN_TX_XTD_FRAME ) ) {
+                break;  // No free buffer, wait for next transmit done
+            }
+
+            can_tx_tail = ( can_tx_tail + 1 ) & ( CAN_TX_FIFO_SIZE - 1 );
+        }
+
+        // Nothing more to send
+        if ( can_tx_tail == can_tx_head ) {
+            PIE5bits.TXBnIE = 0;
+        }
+    }
+
+    TIMESTAMP_READ( stop );
+    stop -= start;
+    if ( stop > irq_duration_max ) {
+        irq_duration_max = stop;
+    }
+}
 
 ///////////////////////////////////////////////////////////////////////////////
-// Isr() 	- Interrupt Service Routine
-//      	- Services Timer0 Overflow
-//      	- Services GP3 Pin Change
+// Low priority interrupt
+//      - Services Timer0 Overflow (1 ms tick)
+//      - Services ADC conversion done
+//      - Services CCP4 compare (burst capture sample clock)
+//      - Services Timer3 overflow (pulse counter) and power loss (HLVD)
+//      - Services Timer4 (software PWM)
+//      - Services UART receive/transmit
+//      - Services MSSP (I2C transaction steps or SPI bytes)
 //////////////////////////////////////////////////////////////////////////////
 
 void interrupt low_priority  interrupt_at_low_vector( void )
 {
+    // Power loss first, then counter overflow
+    if ( ( PIE2bits.HLVDIE && PIR2bits.HLVDIF ) ||
+            ( PIE2bits.TMR3IE && PIR2bits.TMR3IF ) ) {
+        counter_isr();
+    }
+
+    // Software PWM slot, before the tick as the shortest slot is 25 us
+    if ( PIE4bits.TMR4IE && PIR4bits.TMR4IF ) {
+        softpwm_isr();
+    }
+
+    // UART
+    if ( PIE1bits.RC1IE && ( PIR1bits.RC1IF || PIE1bits.TX1IE ) ) {
+        uart_isr();
+    }
+
+    // MSSP, SPI or I2C
+    if ( PIE1bits.SSPIE && PIR1bits.SSPIF ) {
+        if ( spi_enabled ) {
+            spi_isr();
+        }
+        else {
+            i2c_isr();
+        }
+    }
+
     // Clock
     if ( INTCONbits.TMR0IF ) { // If a Timer0 Interrupt, Then...
 
@@ -112,6 +388,48 @@ void interrupt low_priority  interrupt_at_low_vector( void )
         measurement_clock++;
         sendTimer++;
 
+        // Sample inputs
+        inputs_sample();
+
+        // Start ADC scan
+        adc_tick();
+
+        // Counter gate
+        counter_tick();
+
+        // PWM fades
+        pwm_tick();
+
+        // UART idle time
+        uart_tick();
+
+        // I2C sensor periods and timeout
+        i2c_tick();
+
+        // 1-Wire conversion time
+        onewire_tick();
+
+        // Event translation cooldown
+        translate_tick();
+
+        // Periodic rules
+        rules_tick();
+
+        // Interlock dead times
+        interlock_tick();
+
+        // Staggered switch on
+        scene_tick();
+
+        // Shutter motors
+        shutter_tick();
+
+        // Regulator control periods
+        regulator_tick();
+
+        // Rate limit refill
+        ratelimit_tick();
+
         // Check for init button
         if ( INIT_BUTTON ) {
             vscp_initbtncnt = 0;
@@ -149,6 +467,16 @@ void interrupt low_priority  interrupt_at_low_vector( void )
 
     }
 
+    // Burst capture sample clock
+    if ( PIE4bits.CCP4IE && PIR4bits.CCP4IF ) {
+        adc_burst_isr();
+    }
+
+    // ADC conversion done
+    if ( PIE1bits.ADIE && PIR1bits.ADIF ) {
+        adc_isr();
+    }
+
     return;
 }
 
@@ -169,6 +497,16 @@ void main()
         init_app_eeprom();
         init_app_ram();     // Needed because some ram positions
                             // are initialized from EEPROM
+        configureIO();
+
+    }
+    else if ( EEPROM_LAYOUT != eeprom_read( EEPROM_LAYOUT_VERSION ) ) {
+
+        // Upgraded from firmware with another application EEPROM
+        // layout - defaults for the application area
+        init_app_layout_eeprom();
+        init_app_ram();
+        configureIO();
 
     }
 
@@ -233,6 +571,15 @@ void main()
                     }
 
                     doDM();
+
+                    // Rules run on event
+                    rules_event();
+
+                    // Measurements for regulators
+                    regulator_event();
+
+                    // Stream data to UART
+                    uart_receiveEvent();
 					
                 }
                 break;
@@ -251,6 +598,10 @@ void main()
         if ( measurement_clock > 1000 ) {
 
             measurement_clock = 0;
+
+            // Idle time as percentage of last second
+            idle_percent = idle_ticks / ( TIMESTAMP_TICKS_PER_SECOND / 100 );
+            idle_ticks = 0;
  
             // Do VSCP one second jobs
             vscp_doOneSecondWork();
@@ -283,6 +634,9 @@ void main()
 
         doWork();
 
+        // Idle until next tick or CAN frame if there is nothing to do
+        doIdle();
+
     } // while
 }
 
@@ -337,6 +691,9 @@ void init()
     TRISC = 0b00000001;
     PORTC = 0x00;
 
+    // Pins configured as inputs
+    configureIO();
+
 /*
     // Sensor 0 timer
     OpenTimer0( TIMER_INT_OFF &
@@ -364,6 +721,10 @@ void init()
     OpenTimer0( TIMER_INT_ON & T0_16BIT & T0_SOURCE_INT & T0_PS_1_8 );
     WriteTimer0( TIMER0_RELOAD_VALUE );
 
+    // Timer 1 - Free running time stamp counter
+    // Fosc/4, 1:8 prescaler, 16-bit read/write, on
+    T1CON = 0b00110011;
+
     // Initialize CAN
     ECANInitialize();
 
@@ -385,11 +746,29 @@ void init()
 
      */
 
-    // Enable peripheral interrupt
-    INTCONbits.PEIE = 1;
+    // Enable interrupt priority levels
+    RCONbits.IPEN = 1;
 
-    // Enable global interrupt
-    INTCONbits.GIE = 1;
+    // Timer0 (tick) - Low priority
+    INTCON2bits.TMR0IP = 0;
+
+    // Timer1 overflow - High priority latency probe
+    IPR1bits.TMR1IP = 1;
+    PIE1bits.TMR1IE = 1;
+
+    // CAN receive/transmit - High priority. In mode 2 each buffer
+    // must also be enabled to generate an interrupt.
+    BIE0 = 0xff;
+    TXBIE = 0x1c;
+    IPR5bits.RXB1IP = 1;
+    IPR5bits.TXBnIP = 1;
+    PIE5bits.RXB1IE = 1;
+
+    // Enable low priority interrupts
+    INTCONbits.GIEL = 1;
+
+    // Enable high priority interrupts
+    INTCONbits.GIEH = 1;
 
     return;
 }
@@ -407,6 +786,40 @@ void init_app_ram( void )
     seconds = 0;
     minutes = 0;
     hours = 0;
+
+    idle_control = eeprom_read( EEPROM_IDLE_CONTROL );
+    idle_latency_bound = eeprom_read( EEPROM_IDLE_LATENCY_BOUND );
+    idle_ticks = 0;
+    idle_percent = 0;
+    idle_rxwake = FALSE;
+    idle_latency_max = 0;
+    idle_latency_overruns = 0;
+
+    can_rx_head = 0;
+    can_rx_tail = 0;
+    can_rx_overruns = 0;
+    can_rx_maxfill = 0;
+    can_rx_urgent_head = 0;
+    can_rx_urgent_tail = 0;
+    can_rx_urgent_overruns = 0;
+    can_rx_urgent_maxfill = 0;
+    can_rx_urgent_latency_max = 0;
+    can_rx_shed = 0;
+    can_rx_seq = 0;
+    can_rx_shed_threshold = eeprom_read( EEPROM_CAN_RX_SHED_THRESHOLD );
+    can_rx_urgent_priority = eeprom_read( EEPROM_CAN_RX_URGENT_PRIORITY );
+    can_tx_head = 0;
+    can_tx_tail = 0;
+    can_tx_overruns = 0;
+
+    irq_latency_max = 0;
+    irq_duration_max = 0;
+
+    for ( i = 0; i < DESCION_MATRIX_ROWS; i++ ) {
+        loadDMRow( i );
+    }
+    dm_time_last = 0;
+    dm_time_max = 0;
     
 }
 
@@ -429,7 +842,7 @@ void init_app_eeprom(void)
     eeprom_write( VSCP_EEPROM_END + REG_CONTROL0, 0 );
     eeprom_write( VSCP_EEPROM_END + REG_CONTROL1, 0 );
     eeprom_write( VSCP_EEPROM_END + REG_CONTROL2, 0 );
-    
+
     // * * * Decision Matrix * * *
     // All elements disabled.
     for ( i = 0; i < DESCION_MATRIX_ROWS; i++ ) {
@@ -438,6 +851,55 @@ void init_app_eeprom(void)
         }
     }
 
+    init_app_layout_eeprom();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// init_app_layout_eeprom
+//
+// Defaults for the application area after the decision matrix. Also
+// used when the layout version does not match after an upgrade, the
+// registers on page 0 and the decision matrix are kept then.
+//
+
+void init_app_layout_eeprom( void )
+{
+    uint8_t i;
+    uint8_t j;
+
+    eeprom_write( EEPROM_IDLE_CONTROL, 0 );
+    eeprom_write( EEPROM_IDLE_LATENCY_BOUND, IDLE_DEFAULT_LATENCY_BOUND );
+
+    eeprom_write( EEPROM_CAN_RX_SHED_THRESHOLD,
+                    CAN_RX_DEFAULT_SHED_THRESHOLD );
+    eeprom_write( EEPROM_CAN_RX_URGENT_PRIORITY,
+                    CAN_RX_DEFAULT_URGENT_PRIORITY );
+
+    pins_init_eeprom();
+    inputs_init_eeprom();
+    adc_init_eeprom();
+    counter_init_eeprom();
+    pwm_init_eeprom();
+    uart_init_eeprom();
+    i2c_init_eeprom();
+    spi_init_eeprom();
+    onewire_init_eeprom();
+    scene_init_eeprom();
+    translate_init_eeprom();
+    rules_init_eeprom();
+    interlock_init_eeprom();
+    shutter_init_eeprom();
+    regulator_init_eeprom();
+    ratelimit_init_eeprom();
+
+    // Decision matrix data match
+    for ( i = 0; i < DESCION_MATRIX_ROWS; i++ ) {
+        for ( j = 0; j < 4; j++ ) {
+            eeprom_write( EEPROM_DM_DATA_MATCH + i * 4 + j, 0 );
+        }
+    }
+
+    eeprom_write( EEPROM_LAYOUT_VERSION, EEPROM_LAYOUT );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -447,6 +909,15 @@ void init_app_eeprom(void)
 void doApplicationOneSecondWork(void)
 {
     // Do work that should be done once a second here
+    adc_oneSecond();
+    counter_oneSecond();
+    softpwm_oneSecond();
+    uart_oneSecond();
+    i2c_oneSecond();
+    spi_oneSecond();
+    onewire_oneSecond();
+    rules_oneSecond();
+    regulator_oneSecond();
 }
 
 
@@ -564,10 +1035,173 @@ uint8_t vscp_getSubzone(void)
 
 void doWork(void)
 {
+    // Software PWM levels
+    doSoftPWM();
+
     if ( VSCP_STATE_ACTIVE == vscp_node_state ) {
-        // Do work when active here
-		;
+        // Report input changes
+        doInputs();
+
+        // Report captured edges
+        doEdges();
+
+        // Report analog values
+        doADC();
+
+        // Pulse counter frequency and reports
+        doCounter();
+
+        // UART to stream data events
+        doUART();
+
+        // I2C sensor polling
+        doI2C();
+
+        // SPI transfers and output extender
+        doSPI();
+
+        // 1-Wire temperature sensors
+        doOneWire();
+
+        // Periodic rules
+        doRules();
+
+        // Outputs held back by interlock dead time
+        doInterlock();
+
+        // Next wave of a staggered switch on
+        doScene();
+
+        // Shutters arrived and moves waiting for the reverse pause
+        doShutter();
+
+        // Regulator control loops
+        doRegulator();
+
+        // Rate limit refill and held pin events
+        doRateLimit();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// configureIO
+//
+// Set up pin directions and the subsystems that use pins from the
+// pin modes.
+//
+
+void configureIO( void )
+{
+    pins_init();
+    inputs_init();
+    edges_init();
+    adc_init();
+    counter_init();
+    pwm_init();
+    softpwm_init();
+    uart_init();
+    i2c_init();
+    spi_init();
+    onewire_init();
+    scene_init();
+    translate_init();
+    rules_init();
+    interlock_init();
+    shutter_init();
+    regulator_init();
+    ratelimit_init();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// configurePin
+//
+// Set up a pin and the subsystems that used it in the old mode or use
+// it in the new one after its mode has been written. Other pins and
+// subsystems keep running.
+//
+
+void configurePin( uint8_t pin, uint8_t old )
+{
+    uint16_t modes;
+
+    modes = PIN_CAP( old & PIN_MODE_MASK ) | PIN_CAP( pins_getMode( pin ) );
+
+    pins_configure( pin );
+
+    if ( modes & PIN_CAP( PIN_MODE_INPUT ) ) inputs_init();
+    if ( modes & PIN_CAP( PIN_MODE_EDGE ) ) edges_init();
+    if ( modes & PIN_CAP( PIN_MODE_ANALOG ) ) adc_init();
+    if ( modes & PIN_CAP( PIN_MODE_COUNTER ) ) counter_init();
+    if ( modes & PIN_CAP( PIN_MODE_PWM ) ) pwm_init();
+    if ( modes & PIN_CAP( PIN_MODE_SOFTPWM ) ) softpwm_init();
+    if ( modes & PIN_CAP( PIN_MODE_UART ) ) uart_init();
+    if ( modes & PIN_CAP( PIN_MODE_I2C ) ) i2c_init();
+    if ( ( modes & PIN_CAP( PIN_MODE_SPI ) ) ||
+            ( pin == eeprom_read( EEPROM_SPI_EXT_CS ) ) ) {
+        spi_init();
+    }
+    if ( modes & PIN_CAP( PIN_MODE_ONEWIRE ) ) onewire_init();
+
+    // Users of output pins
+    if ( modes & PIN_DRIVEN_MODES ) {
+        scene_configure();
+        interlock_init();
+        shutter_pinChanged( pin );
+        regulator_pinChanged( pin );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doIdle
+//
+// Put the core in IDLE mode until the next interrupt if there is
+// nothing to do. Peripherals keep running in IDLE so the 1 ms tick and
+// the ECAN receive interrupt both wake the core. Sleep is not used as
+// ECAN wake-up from Sleep loses the frame that woke the node.
+//
+
+void doIdle( void )
+{
+    uint16_t start;
+    uint16_t stop;
+
+    if ( !( idle_control & IDLE_CONTROL_ENABLE ) ) return;
+
+    // Event waiting to be handled
+    if ( vscp_imsg.flags & VSCP_VALID_MSG ) return;
+
+    // One second work is due
+    if ( measurement_clock > 1000 ) return;
+
+    // Interrupts are disabled while checking so that a frame received
+    // after the check still wakes us up directly. A pending enabled
+    // interrupt makes SLEEP return at once.
+    INTCONbits.GIEH = 0;
+
+    if ( ( can_rx_head != can_rx_tail ) ||
+            ( can_rx_urgent_head != can_rx_urgent_tail ) ||
+            ( edge_head != edge_tail ) ||
+            uart_hasWork() || i2c_hasWork() || spi_hasWork() ||
+            COMSTAT_FIFOEMPTY || PIR3_RXBnIF || INTCONbits.TMR0IF ) {
+        INTCONbits.GIEH = 1;
+        return;
+    }
+
+    TIMESTAMP_READ( start );
+
+    OSCCONbits.IDLEN = 1;
+    SLEEP();
+    NOP();
+
+    TIMESTAMP_READ( stop );
+    idle_ticks += (uint16_t)( stop - start );
+
+    if ( PIR3_RXBnIF ) {
+        idle_rxwake = TRUE;
+        idle_wakestamp = stop;
     }
+
+    INTCONbits.GIEH = 1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -608,18 +1242,165 @@ uint8_t vscp_readAppReg(uint8_t reg)
             rv = readControlReg( 2 );
             rv &= 0x03; // Take away unused bits
         }
+        // Idle
+        else if ( reg == REG_IDLE_CONTROL ) {
+            rv = idle_control;
+        }
+        else if ( reg == REG_IDLE_LATENCY_BOUND ) {
+            rv = idle_latency_bound;
+        }
+        else if ( reg == REG_IDLE_PERCENT ) {
+            rv = idle_percent;
+        }
+        else if ( reg == REG_IDLE_LATENCY_MAX_MSB ) {
+            rv = ( idle_latency_max >> 8 ) & 0xff;
+        }
+        else if ( reg == REG_IDLE_LATENCY_MAX_LSB ) {
+            rv = idle_latency_max & 0xff;
+        }
+        else if ( reg == REG_IDLE_LATENCY_OVERRUNS ) {
+            rv = idle_latency_overruns;
+        }
+        // Interrupt statistics
+        else if ( reg == REG_IRQ_LATENCY_MAX_MSB ) {
+            rv = ( TIMESTAMP_TO_US( irq_latency_max ) >> 8 ) & 0xff;
+        }
+        else if ( reg == REG_IRQ_LATENCY_MAX_LSB ) {
+            rv = TIMESTAMP_TO_US( irq_latency_max ) & 0xff;
+        }
+        else if ( reg == REG_IRQ_DURATION_MAX_MSB ) {
+            rv = ( TIMESTAMP_TO_US( irq_duration_max ) >> 8 ) & 0xff;
+        }
+        else if ( reg == REG_IRQ_DURATION_MAX_LSB ) {
+            rv = TIMESTAMP_TO_US( irq_duration_max ) & 0xff;
+        }
+        else if ( reg == REG_CAN_RX_OVERRUNS ) {
+            rv = can_rx_overruns;
+        }
+        else if ( reg == REG_CAN_RX_MAX_FILL ) {
+            rv = can_rx_maxfill;
+        }
+        else if ( reg == REG_CAN_TX_OVERRUNS ) {
+            rv = can_tx_overruns;
+        }
+        // Receive lanes
+        else if ( reg == REG_CAN_RX_SHED_MSB ) {
+            INTCONbits.GIEH = 0;
+            rv = ( can_rx_shed >> 8 ) & 0xff;
+            INTCONbits.GIEH = 1;
+        }
+        else if ( reg == REG_CAN_RX_SHED_LSB ) {
+            rv = can_rx_shed & 0xff;
+        }
+        else if ( reg == REG_CAN_RX_URGENT_OVERRUNS ) {
+            rv = can_rx_urgent_overruns;
+        }
+        else if ( reg == REG_CAN_RX_URGENT_MAX_FILL ) {
+            rv = can_rx_urgent_maxfill;
+        }
+        else if ( reg == REG_CAN_RX_URGENT_LATENCY_MSB ) {
+            rv = ( can_rx_urgent_latency_max >> 8 ) & 0xff;
+        }
+        else if ( reg == REG_CAN_RX_URGENT_LATENCY_LSB ) {
+            rv = can_rx_urgent_latency_max & 0xff;
+        }
+        else if ( reg == REG_CAN_RX_SHED_THRESHOLD ) {
+            rv = can_rx_shed_threshold;
+        }
+        else if ( reg == REG_CAN_RX_URGENT_PRIORITY ) {
+            rv = can_rx_urgent_priority;
+        }
     }
     // * * *  Page = 1
     else if ( 1 == vscp_page_select ) {
         
         // DM REG_FIRST_PAGE_END + REG_DESCION_MATRIX + i * 8 + j
-        if ( ( reg >= REG_DESCION_MATRIX ) && ( reg <= ( REG_DESCION_MATRIX + 
+        if ( ( reg >= REG_DESCION_MATRIX ) && ( reg < ( REG_DESCION_MATRIX + 
                 ( 8 * DESCION_MATRIX_ROWS ) ) ) ) {
             rv = eeprom_read(VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
                     ( reg - REG_DESCION_MATRIX ) );
         }
+        // Data match
+        else if ( ( reg >= REG_DM_DATA_MATCH ) && ( reg < ( REG_DM_DATA_MATCH +
+                ( 4 * DESCION_MATRIX_ROWS ) ) ) ) {
+            rv = eeprom_read( EEPROM_DM_DATA_MATCH + ( reg - REG_DM_DATA_MATCH ) );
+        }
+        else if ( reg == REG_DM_TIME_LAST_MSB ) {
+            rv = ( TIMESTAMP_TO_US( dm_time_last ) >> 8 ) & 0xff;
+        }
+        else if ( reg == REG_DM_TIME_LAST_LSB ) {
+            rv = TIMESTAMP_TO_US( dm_time_last ) & 0xff;
+        }
+        else if ( reg == REG_DM_TIME_MAX_MSB ) {
+            rv = ( TIMESTAMP_TO_US( dm_time_max ) >> 8 ) & 0xff;
+        }
+        else if ( reg == REG_DM_TIME_MAX_LSB ) {
+            rv = TIMESTAMP_TO_US( dm_time_max ) & 0xff;
+        }
         
     }
+    // * * *  Page = 2
+    else if ( REG_PAGE_PINS == vscp_page_select ) {
+
+        if ( reg <= REG_PIN20_MODE ) {
+            rv = pins_readReg( reg );
+        }
+        else {
+            rv = inputs_readReg( reg );
+        }
+
+    }
+    else if ( REG_PAGE_EDGES == vscp_page_select ) {
+        rv = edges_readReg( reg );
+    }
+    else if ( REG_PAGE_ADC == vscp_page_select ) {
+        rv = adc_readReg( reg );
+    }
+    else if ( REG_PAGE_COUNTER == vscp_page_select ) {
+        rv = counter_readReg( reg );
+    }
+    else if ( REG_PAGE_PWM == vscp_page_select ) {
+        rv = pwm_readReg( reg );
+    }
+    else if ( REG_PAGE_SOFTPWM == vscp_page_select ) {
+        rv = softpwm_readReg( reg );
+    }
+    else if ( REG_PAGE_UART == vscp_page_select ) {
+        rv = uart_readReg( reg );
+    }
+    else if ( REG_PAGE_I2C == vscp_page_select ) {
+        rv = i2c_readReg( reg );
+    }
+    else if ( REG_PAGE_SPI == vscp_page_select ) {
+        rv = spi_readReg( reg );
+    }
+    else if ( REG_PAGE_ONEWIRE == vscp_page_select ) {
+        rv = onewire_readReg( reg );
+    }
+    else if ( REG_PAGE_SCENE == vscp_page_select ) {
+        rv = scene_readReg( reg );
+    }
+    else if ( REG_PAGE_TRANSLATE == vscp_page_select ) {
+        rv = translate_readReg( reg );
+    }
+    else if ( REG_PAGE_RULE_CODE == vscp_page_select ) {
+        rv = rules_readCode( reg );
+    }
+    else if ( REG_PAGE_RULES == vscp_page_select ) {
+        rv = rules_readReg( reg );
+    }
+    else if ( REG_PAGE_INTERLOCK == vscp_page_select ) {
+        rv = interlock_readReg( reg );
+    }
+    else if ( REG_PAGE_SHUTTER == vscp_page_select ) {
+        rv = shutter_readReg( reg );
+    }
+    else if ( REG_PAGE_REGULATOR == vscp_page_select ) {
+        rv = regulator_readReg( reg );
+    }
+    else if ( REG_PAGE_RATELIMIT == vscp_page_select ) {
+        rv = ratelimit_readReg( reg );
+    }
 
     return rv;
 
@@ -632,6 +1413,7 @@ uint8_t vscp_readAppReg(uint8_t reg)
 uint8_t vscp_writeAppReg( uint8_t reg, uint8_t val )
 {
     uint8_t rv;
+    uint8_t mode;
 
     rv = ~val; // error return
 
@@ -671,21 +1453,148 @@ uint8_t vscp_writeAppReg( uint8_t reg, uint8_t val )
             rv = writeControlReg( CONTROL2, val );
             rv &= 0x03; // Take away unused bits
         }
+        // Idle
+        else if ( reg == REG_IDLE_CONTROL ) {
+            eeprom_write( EEPROM_IDLE_CONTROL, val );
+            idle_control = val;
+            rv = idle_control;
+        }
+        else if ( reg == REG_IDLE_LATENCY_BOUND ) {
+            eeprom_write( EEPROM_IDLE_LATENCY_BOUND, val );
+            idle_latency_bound = val;
+            rv = idle_latency_bound;
+        }
+        // Writing any of the latency registers clear the statistics
+        else if ( ( reg == REG_IDLE_LATENCY_MAX_MSB ) ||
+                    ( reg == REG_IDLE_LATENCY_MAX_LSB ) ||
+                    ( reg == REG_IDLE_LATENCY_OVERRUNS ) ) {
+            idle_latency_max = 0;
+            idle_latency_overruns = 0;
+            rv = val;
+        }
+        // Receive lanes. The interrupt reads these, a byte write is
+        // atomic.
+        else if ( reg == REG_CAN_RX_SHED_THRESHOLD ) {
+            eeprom_write( EEPROM_CAN_RX_SHED_THRESHOLD, val );
+            can_rx_shed_threshold = val;
+            rv = can_rx_shed_threshold;
+        }
+        else if ( reg == REG_CAN_RX_URGENT_PRIORITY ) {
+            eeprom_write( EEPROM_CAN_RX_URGENT_PRIORITY, val );
+            can_rx_urgent_priority = val;
+            rv = can_rx_urgent_priority;
+        }
+        // Writing any of the interrupt/CAN statistics registers
+        // clear them all
+        else if ( ( reg >= REG_IRQ_LATENCY_MAX_MSB ) &&
+                    ( reg <= REG_CAN_RX_URGENT_LATENCY_LSB ) ) {
+            INTCONbits.GIEH = 0;
+            irq_latency_max = 0;
+            irq_duration_max = 0;
+            can_rx_overruns = 0;
+            can_rx_maxfill = 0;
+            can_rx_urgent_overruns = 0;
+            can_rx_urgent_maxfill = 0;
+            can_rx_shed = 0;
+            INTCONbits.GIEH = 1;
+            can_tx_overruns = 0;
+            can_rx_urgent_latency_max = 0;
+            rv = val;
+        }
     
     }
 	// * * *  Page = 1
     else if ( 1 == vscp_page_select ) {
         
         // DM
-        if ( ( reg >= REG_DESCION_MATRIX ) && ( reg <= ( REG_DESCION_MATRIX + 
+        if ( ( reg >= REG_DESCION_MATRIX ) && ( reg < ( REG_DESCION_MATRIX + 
                 ( 8 * DESCION_MATRIX_ROWS ) ) ) ) {
             eeprom_write(VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
                         ( reg - REG_DESCION_MATRIX ), val);
             rv = eeprom_read(VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
                         ( reg - REG_DESCION_MATRIX ) );
+            loadDMRow( ( reg - REG_DESCION_MATRIX ) / 8 );
+        }
+        // Data match
+        else if ( ( reg >= REG_DM_DATA_MATCH ) && ( reg < ( REG_DM_DATA_MATCH +
+                ( 4 * DESCION_MATRIX_ROWS ) ) ) ) {
+            eeprom_write( EEPROM_DM_DATA_MATCH + ( reg - REG_DM_DATA_MATCH ), val );
+            rv = eeprom_read( EEPROM_DM_DATA_MATCH + ( reg - REG_DM_DATA_MATCH ) );
+            loadDMRow( ( reg - REG_DM_DATA_MATCH ) / 4 );
+        }
+        // Write to clear
+        else if ( ( reg == REG_DM_TIME_MAX_MSB ) || ( reg == REG_DM_TIME_MAX_LSB ) ) {
+            dm_time_max = 0;
+            rv = 0;
         }
         
     }
+    // * * *  Page = 2
+    else if ( REG_PAGE_PINS == vscp_page_select ) {
+
+        if ( reg <= REG_PIN20_MODE ) {
+            mode = pins_readReg( reg );
+            rv = pins_writeReg( reg, val );
+            if ( rv != mode ) {
+                configurePin( reg - REG_PIN3_MODE + PIN_FIRST, mode );
+            }
+        }
+        else {
+            rv = inputs_writeReg( reg, val );
+        }
+
+    }
+    else if ( REG_PAGE_EDGES == vscp_page_select ) {
+        rv = edges_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_ADC == vscp_page_select ) {
+        rv = adc_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_COUNTER == vscp_page_select ) {
+        rv = counter_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_PWM == vscp_page_select ) {
+        rv = pwm_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_SOFTPWM == vscp_page_select ) {
+        rv = softpwm_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_UART == vscp_page_select ) {
+        rv = uart_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_I2C == vscp_page_select ) {
+        rv = i2c_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_SPI == vscp_page_select ) {
+        rv = spi_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_ONEWIRE == vscp_page_select ) {
+        rv = onewire_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_SCENE == vscp_page_select ) {
+        rv = scene_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_TRANSLATE == vscp_page_select ) {
+        rv = translate_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_RULE_CODE == vscp_page_select ) {
+        rv = rules_writeCode( reg, val );
+    }
+    else if ( REG_PAGE_RULES == vscp_page_select ) {
+        rv = rules_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_INTERLOCK == vscp_page_select ) {
+        rv = interlock_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_SHUTTER == vscp_page_select ) {
+        rv = shutter_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_REGULATOR == vscp_page_select ) {
+        rv = regulator_writeReg( reg, val );
+    }
+    else if ( REG_PAGE_RATELIMIT == vscp_page_select ) {
+        rv = ratelimit_writeReg( reg, val );
+    }
 
     return rv;
 }
@@ -697,6 +1606,13 @@ uint8_t vscp_writeAppReg( uint8_t reg, uint8_t val )
 uint8_t writeControlReg( uint8_t ctrlreg, uint8_t val )
 {
     uint8_t rv = 0;
+
+    // Control register n holds pin bitmap bits 8n-8n+7
+    if ( ctrlreg <= CONTROL2 ) {
+        val = ( interlock_filter( (uint32_t)val << ( 8 * ctrlreg ),
+                                    (uint32_t)0xff << ( 8 * ctrlreg ) ) >>
+                ( 8 * ctrlreg ) ) & 0xff;
+    }
     
     switch ( ctrlreg ) {
     
@@ -804,11 +1720,20 @@ void SendInformationEvent( unsigned char idx,
                             unsigned char eventTypeId )
 {
     uint8_t data[3];
+
+    // Over the rate limit, the last state of the pin is sent later
+    if ( ( VSCP_CLASS1_INFORMATION == eventClass ) &&
+            ratelimit_hold( idx, eventTypeId ) ) {
+        return;
+    }
+
     idx -= 3;
     
     data[ 0 ] = idx; // Register
     data[ 1 ] = eeprom_read( VSCP_EEPROM_END + REG_ZONE );
-    data[ 2 ] = eeprom_read( VSCP_EEPROM_END + REG_PIN3_SUBZONE + idx );
+    // Extender pins have no sub zone
+    data[ 2 ] = ( idx < PIN_COUNT ) ?
+                    eeprom_read( VSCP_EEPROM_END + REG_PIN3_SUBZONE + idx ) : 0;
     sendVSCPFrame( eventClass,
                     eventTypeId,
                     vscp_nickname,
@@ -817,121 +1742,286 @@ void SendInformationEvent( unsigned char idx,
                     data );
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// loadDMRow
+//
+// Load a decision matrix row and its data match from EEPROM into the
+// RAM copy. The data match operator is turned into a range test,
+// lo <= ( data & mask ) <= lo + span, optionally inverted, so all
+// operators cost the same when an event is matched.
+//
+
+void loadDMRow( uint8_t row )
+{
+    uint16_t addr;
+    uint8_t op;
+    uint8_t value;
+    uint8_t high;
+    dmrow_t *prow;
+
+    if ( row >= DESCION_MATRIX_ROWS ) return;
+
+    prow = &dm_row[ row ];
+    addr = VSCP_EEPROM_END + REG_FIRST_PAGE_END + REG_DESCION_MATRIX + 8 * row;
+
+    prow->oaddr = eeprom_read( addr + VSCP_DM_POS_OADDR );
+    prow->flags = eeprom_read( addr + VSCP_DM_POS_FLAGS );
+    prow->class_filter = ( ( prow->flags & VSCP_DM_FLAG_CLASS_FILTER ) ? 0x100 : 0 ) +
+                            eeprom_read( addr + VSCP_DM_POS_CLASSFILTER );
+    prow->class_mask = ( ( prow->flags & VSCP_DM_FLAG_CLASS_MASK ) ? 0x100 : 0 ) +
+                            eeprom_read( addr + VSCP_DM_POS_CLASSMASK );
+    prow->type_filter = eeprom_read( addr + VSCP_DM_POS_TYPEFILTER );
+    prow->type_mask = eeprom_read( addr + VSCP_DM_POS_TYPEMASK );
+    prow->action = eeprom_read( addr + VSCP_DM_POS_ACTION );
+    prow->param = eeprom_read( addr + VSCP_DM_POS_ACTIONPARAM );
+
+    addr = EEPROM_DM_DATA_MATCH + 4 * row;
+    op = ( eeprom_read( addr ) >> 4 ) & 0x07;
+    value = eeprom_read( addr + 2 );
+    high = eeprom_read( addr + 3 );
+
+    prow->data_idx = eeprom_read( addr ) & 0x07;
+    prow->data_len = prow->data_idx + 1;
+    prow->data_mask = eeprom_read( addr + 1 );
+    prow->data_lo = 0;
+    prow->data_span = 255;
+    prow->data_invert = FALSE;
+
+    switch ( op ) {
+
+        case DM_OP_EQ:
+            prow->data_lo = value;
+            prow->data_span = 0;
+            break;
+
+        case DM_OP_NE:
+            prow->data_lo = value;
+            prow->data_span = 0;
+            prow->data_invert = TRUE;
+            break;
+
+        case DM_OP_LT:
+            if ( value ) {
+                prow->data_span = value - 1;
+            }
+            else {
+                prow->data_invert = TRUE;   // Never
+            }
+            break;
+
+        case DM_OP_GT:
+            if ( value < 255 ) {
+                prow->data_lo = value + 1;
+                prow->data_span = 255 - prow->data_lo;
+            }
+            else {
+                prow->data_invert = TRUE;   // Never
+            }
+            break;
+
+        case DM_OP_RANGE:
+            if ( high >= value ) {
+                prow->data_lo = value;
+                prow->data_span = high - value;
+            }
+            else {
+                prow->data_invert = TRUE;   // Never
+            }
+            break;
+
+        default:
+            // No data match, the range test always passes
+            prow->data_idx = 0;
+            prow->data_len = 0;
+            prow->data_mask = 0;
+            break;
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Do decision Matrix handling
 // 
 // The routine expects vscp_imsg to contain a valid incoming event
 //
+// Rows are matched from the RAM copy. The time spent matching, not
+// counting the actions, is kept for the registers.
+//
 
 void doDM(void)
 {
-    unsigned char i;
-    unsigned char dmflags;
-    unsigned short class_filter;
-    unsigned short class_mask;
-    unsigned char type_filter;
-    unsigned char type_mask;
+    uint8_t i;
+    uint8_t size;
+    uint8_t x;
+    uint16_t start;
+    uint16_t stop;
+    uint16_t act_start;
+    uint16_t act_ticks;
+    dmrow_t *prow;
 
     // Don't deal with the protocol functionality
     if ( VSCP_CLASS1_PROTOCOL == vscp_imsg.vscp_class ) return;
 
-    for (i = 0; i < DESCION_MATRIX_ROWS; i++) {
+    TIMESTAMP_READ( start );
+    act_ticks = 0;
+
+    size = vscp_imsg.flags & 0x0f;
+
+    for ( i = 0; i < DESCION_MATRIX_ROWS; i++ ) {
 
-        // Get DM flags for this row
-        dmflags = eeprom_read( VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
-                                    REG_DESCION_MATRIX + 1 + (8 * i) );
+        prow = &dm_row[ i ];
 
         // Is the DM row enabled?
-        if ( dmflags & VSCP_DM_FLAG_ENABLED ) {
+        if ( !( prow->flags & VSCP_DM_FLAG_ENABLED ) ) continue;
 
-            // Should the originating id be checked and if so is it the same?
-            if ( ( dmflags & VSCP_DM_FLAG_CHECK_OADDR ) &&
-                    ( vscp_imsg.oaddr != eeprom_read( VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
-                                                        REG_DESCION_MATRIX + (8 * i) ) ) ) {
-                continue;
-            }
+        // Class and type
+        if ( ( ( prow->class_filter ^ vscp_imsg.vscp_class ) & prow->class_mask ) ||
+                ( ( prow->type_filter ^ vscp_imsg.vscp_type ) & prow->type_mask ) ) {
+            continue;
+        }
 
-            // Check if zone should match and if so if it match
-            if ( dmflags & VSCP_DM_FLAG_CHECK_ZONE ) {
-                if ( 255 != vscp_imsg.data[ 1 ] ) {
-                    if ( vscp_imsg.data[ 1 ] != eeprom_read( VSCP_EEPROM_END + REG_ZONE ) ) {
-                        continue;
-                    }
+        // Should the originating id be checked and if so is it the same?
+        if ( ( prow->flags & VSCP_DM_FLAG_CHECK_OADDR ) &&
+                ( vscp_imsg.oaddr != prow->oaddr ) ) {
+            continue;
+        }
+
+        // Check if zone should match and if so if it match
+        if ( prow->flags & VSCP_DM_FLAG_CHECK_ZONE ) {
+            if ( 255 != vscp_imsg.data[ 1 ] ) {
+                if ( vscp_imsg.data[ 1 ] != eeprom_read( VSCP_EEPROM_END + REG_ZONE ) ) {
+                    continue;
                 }
             }
+        }
 
-            // Check if sub zone should match and if so if it match
-            if ( dmflags & VSCP_DM_FLAG_CHECK_SUBZONE ) {
-                if ( 255 != vscp_imsg.data[ 2 ] ) {
-                    if ( vscp_imsg.data[ 2 ] != eeprom_read( VSCP_EEPROM_END + REG_ZONE ) ) {
-                        continue;
-                    }
+        // Check if sub zone should match and if so if it match
+        if ( prow->flags & VSCP_DM_FLAG_CHECK_SUBZONE ) {
+            if ( 255 != vscp_imsg.data[ 2 ] ) {
+                if ( vscp_imsg.data[ 2 ] != eeprom_read( VSCP_EEPROM_END + REG_ZONE ) ) {
+                    continue;
                 }
             }
-            
-            class_filter = ( dmflags & VSCP_DM_FLAG_CLASS_FILTER)*256 +
-                    eeprom_read( VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
-                                REG_DESCION_MATRIX +
-                                (8 * i) +
-                                VSCP_DM_POS_CLASSFILTER);
-            class_mask = ( dmflags & VSCP_DM_FLAG_CLASS_MASK)*256 +
-                    eeprom_read( VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
-                                    REG_DESCION_MATRIX +
-                                    (8 * i) +
-                                    VSCP_DM_POS_CLASSMASK);
-            type_filter = eeprom_read( VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
-                                        REG_DESCION_MATRIX + 
-                                        (8 * i) +
-                                        VSCP_DM_POS_TYPEFILTER);
-            type_mask = eeprom_read( VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
-                                        REG_DESCION_MATRIX +
-                                        (8 * i) +
-                                        VSCP_DM_POS_TYPEMASK);
-
-            if ( !( ( class_filter ^ vscp_imsg.vscp_class ) & class_mask ) &&
-                    !( ( type_filter ^ vscp_imsg.vscp_type ) & type_mask ) ) {
-
-                // OK Trigger this action
-                switch ( eeprom_read( VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
-                                        REG_DESCION_MATRIX + (8 * i) + 
-                                        VSCP_DM_POS_ACTION ) ) {
-
-                    case ACTION_NOOP: // Do nothing
-                        break;
-                        
-                    case ACTION_SET: // Set pin to active state
-                        actionSet( dmflags, 
-                                eeprom_read( VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
-                                                REG_DESCION_MATRIX + (8 * i) + 
-                                                VSCP_DM_POS_ACTIONPARAM ) );
-                        break;
-
-                    case ACTION_CLR: // Set pin to inactive state
-                        actionClr( dmflags, 
-                                eeprom_read( VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
-                                                REG_DESCION_MATRIX + (8 * i) + 
-                                                VSCP_DM_POS_ACTIONPARAM ) );
-                        break;
-
-                    case ACTION_SETALL: // Activate all pins
-                        actionSetAll( dmflags, 
-                                eeprom_read( VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
-                                                REG_DESCION_MATRIX + (8 * i) + 
-                                                VSCP_DM_POS_ACTIONPARAM ) );
-                        break;
-
-                    case ACTION_CLRALL: // Inactivate all pins
-                        actionClrAll( dmflags, 
-                                eeprom_read( VSCP_EEPROM_END + REG_FIRST_PAGE_END + 
-                                                REG_DESCION_MATRIX + (8 * i) + 
-                                                VSCP_DM_POS_ACTIONPARAM ) );
-                        break;
-
-                } // case
- 
-            } // Filter/mask
-        } // Row enabled
+        }
+
+        // Data byte
+        if ( size < prow->data_len ) continue;
+        x = ( vscp_imsg.data[ prow->data_idx ] & prow->data_mask ) - prow->data_lo;
+        if ( ( x <= prow->data_span ) ? prow->data_invert : !prow->data_invert ) {
+            continue;
+        }
+
+        TIMESTAMP_READ( act_start );
+
+        // OK Trigger this action
+        switch ( prow->action ) {
+
+            case ACTION_NOOP: // Do nothing
+                break;
+
+            case ACTION_SET: // Set pin to active state
+                actionSet( prow->flags, prow->param );
+                break;
+
+            case ACTION_CLR: // Set pin to inactive state
+                actionClr( prow->flags, prow->param );
+                break;
+
+            case ACTION_SETALL: // Activate all pins
+                actionSetAll( prow->flags, prow->param );
+                break;
+
+            case ACTION_CLRALL: // Inactivate all pins
+                actionClrAll( prow->flags, prow->param );
+                break;
+
+            case ACTION_CAPTURE: // Burst capture on analog channel
+                adc_startBurst( prow->param );
+                break;
+
+            case ACTION_PWM_LEVEL:      // Set PWM level
+            case ACTION_PWM_DIM_UP:     // Dim up one step
+            case ACTION_PWM_DIM_DOWN:   // Dim down one step
+            case ACTION_PWM_FADE:       // Fade to level
+                actionPWM( prow->action, prow->flags, prow->param );
+                break;
+
+            case ACTION_SCENE_RECALL:   // Recall scene
+                scene_recall( prow->param );
+                break;
+
+            case ACTION_SCENE_STORE:    // Store outputs in scene
+                scene_store( prow->param );
+                break;
+
+            case ACTION_SCENE_TOGGLE:   // Toggle scene
+                scene_toggle( prow->param );
+                break;
+
+            case ACTION_SET_MASK:       // Set pins in group
+                scene_setGroup( prow->param, SCENE_GROUP_SET );
+                break;
+
+            case ACTION_CLR_MASK:       // Clear pins in group
+                scene_setGroup( prow->param, SCENE_GROUP_CLR );
+                break;
+
+            case ACTION_TOGGLE_MASK:    // Toggle pins in group
+                scene_setGroup( prow->param, SCENE_GROUP_TOGGLE );
+                break;
+
+            case ACTION_SEND_EVENT:     // Send event from template
+                translate_send( prow->param );
+                break;
+
+            case ACTION_SHUTTER_UP:     // Open shutter
+                shutter_goto( prow->param, 0 );
+                break;
+
+            case ACTION_SHUTTER_DOWN:   // Close shutter
+                shutter_goto( prow->param, 100 );
+                break;
+
+            case ACTION_SHUTTER_STOP:   // Stop shutter
+                shutter_stop( prow->param );
+                break;
+
+            case ACTION_SHUTTER_GOTO:   // Position from first data byte
+                if ( size < 1 ) break;
+                shutter_goto( prow->param, vscp_imsg.data[ 0 ] );
+                break;
+
+            case ACTION_REGULATOR_SETPOINT: // Setpoint from event data
+                regulator_setpointEvent( prow->param );
+                break;
+
+            case ACTION_SYNC_ARM:       // Stage scene for fire
+                scene_arm( prow->param );
+                break;
+
+            case ACTION_SYNC_ARM_SET:   // Stage pin on for fire
+                scene_armPin( prow->param, TRUE );
+                break;
+
+            case ACTION_SYNC_ARM_CLR:   // Stage pin off for fire
+                scene_armPin( prow->param, FALSE );
+                break;
+
+            case ACTION_SYNC_FIRE:      // Apply staged outputs after param ms
+                scene_fire( prow->param );
+                break;
+
+        } // case
+
+        TIMESTAMP_READ( stop );
+        act_ticks += stop - act_start;
+
     } // for each row
+
+    TIMESTAMP_READ( stop );
+    dm_time_last = stop - start - act_ticks;
+    if ( dm_time_last > dm_time_max ) {
+        dm_time_max = dm_time_last;
+    }
 }
 
 
@@ -943,6 +2033,16 @@ void doDM(void)
 
 void actionSet( uint8_t dmflags, uint8_t param )
 {    
+    // Output extender pin
+    if ( ( param >= SPI_EXT_FIRST ) && !( param & 0x80 ) ) {
+        if ( spi_setOutput( param, TRUE ) ) {
+            SendInformationEvent( param, 
+                                    VSCP_CLASS1_INFORMATION, 
+                                    VSCP_TYPE_INFORMATION_ON );
+        }
+        return;
+    }
+
     // We should check sub zone
     if ( param & 0x80 ) {
         
@@ -956,6 +2056,31 @@ void actionSet( uint8_t dmflags, uint8_t param )
     
     if ( param < 3) return;
     if ( param > 20 ) return;
+
+    // A wave of a staggered switch must not undo this
+    scene_cancelWave( param );
+
+    // A PWM pin goes to full level
+    if ( PIN_MODE_PWM == pins_getMode( param ) ) {
+        pwm_setLevel( pwm_channel( param ), 255 );
+        SendInformationEvent( param, 
+                                VSCP_CLASS1_INFORMATION, 
+                                VSCP_TYPE_INFORMATION_ON );
+        return;
+    }
+    else if ( PIN_MODE_SOFTPWM == pins_getMode( param ) ) {
+        softpwm_setLevel( param, 255 );
+        SendInformationEvent( param, 
+                                VSCP_CLASS1_INFORMATION, 
+                                VSCP_TYPE_INFORMATION_ON );
+        return;
+    }
+
+    // Pin must be an output
+    if ( PIN_MODE_OUTPUT != pins_getMode( param ) ) return;
+
+    // Other outputs in an interlock group go off first
+    if ( !interlock_set( param ) ) return;
     
     SendInformationEvent( param, 
                             VSCP_CLASS1_INFORMATION, 
@@ -1046,6 +2171,16 @@ void actionSet( uint8_t dmflags, uint8_t param )
 
 void actionClr( uint8_t dmflags, uint8_t param )
 {
+    // Output extender pin
+    if ( ( param >= SPI_EXT_FIRST ) && !( param & 0x80 ) ) {
+        if ( spi_setOutput( param, FALSE ) ) {
+            SendInformationEvent( param, 
+                                    VSCP_CLASS1_INFORMATION, 
+                                    VSCP_TYPE_INFORMATION_OFF );
+        }
+        return;
+    }
+
     // We should check sub zone
     if ( param & 0x80 ) {
         
@@ -1059,6 +2194,31 @@ void actionClr( uint8_t dmflags, uint8_t param )
     
     if ( param < 3) return;
     if ( param > 20 ) return;
+
+    // A wave of a staggered switch must not undo this
+    scene_cancelWave( param );
+
+    // A PWM pin is turned off
+    if ( PIN_MODE_PWM == pins_getMode( param ) ) {
+        pwm_setLevel( pwm_channel( param ), 0 );
+        SendInformationEvent( param, 
+                                VSCP_CLASS1_INFORMATION, 
+                                VSCP_TYPE_INFORMATION_OFF );
+        return;
+    }
+    else if ( PIN_MODE_SOFTPWM == pins_getMode( param ) ) {
+        softpwm_setLevel( param, 0 );
+        SendInformationEvent( param, 
+                                VSCP_CLASS1_INFORMATION, 
+                                VSCP_TYPE_INFORMATION_OFF );
+        return;
+    }
+
+    // Pin must be an output
+    if ( PIN_MODE_OUTPUT != pins_getMode( param ) ) return;
+
+    // Cancels a SET held back by interlock
+    interlock_filter( 0, PIN_BIT( param ) );
     
     SendInformationEvent( param, 
                             VSCP_CLASS1_INFORMATION, 
@@ -1150,15 +2310,9 @@ void actionClr( uint8_t dmflags, uint8_t param )
 
 void actionSetAll( uint8_t dmflags, uint8_t param )
 {
-    PORTA = 0xff;
-    PORTB = 0xff;
-    PORTC = 0xff;
-    
-    for ( int i=3; i<21; i++ ) {   
-        SendInformationEvent( i, 
-                                VSCP_CLASS1_INFORMATION, 
-                                VSCP_TYPE_INFORMATION_ON );
-    }
+    // Pins in output mode only, in waves if staggered
+    scene_setAll( TRUE );
+    spi_setAll( TRUE );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1169,14 +2323,80 @@ void actionSetAll( uint8_t dmflags, uint8_t param )
 
 void actionClrAll( uint8_t dmflags, uint8_t param )
 {
-    PORTA = 0x00;
-    PORTB = 0x00;
-    PORTC = 0x00;
-    
-    for ( int i=3; i<21; i++ ) {   
-        SendInformationEvent( i, 
-                                VSCP_CLASS1_INFORMATION, 
-                                VSCP_TYPE_INFORMATION_OFF );
+    // Pins in output mode only
+    scene_setAll( FALSE );
+    spi_setAll( FALSE );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// actionPWM
+// 
+// Do PWM actions. Level is taken from the first data byte of the event
+// as 0-100 percent. Param is the pin with bit 7 set to check sub zone.
+// Software PWM pins have no fading, fade to sets the level at once.
+//
+
+void actionPWM( uint8_t action, uint8_t dmflags, uint8_t param )
+{
+    uint8_t ch;
+    uint8_t level;
+
+    // We should check sub zone
+    if ( param & 0x80 ) {
+        
+        param &= 0x7f;
+        
+        if ( eeprom_read( VSCP_EEPROM_END + REG_PIN3_SUBZONE + (param - 3) ) 
+                != vscp_imsg.data[ 2 ] )  {
+                return;
+        }
+    }
+
+    level = ( vscp_imsg.data[ 0 ] > 100 ) ? 100 : vscp_imsg.data[ 0 ];
+    level = ( (uint16_t)level * 255 + 50 ) / 100;
+
+    if ( PIN_MODE_SOFTPWM == pins_getMode( param ) ) {
+
+        switch ( action ) {
+
+            case ACTION_PWM_LEVEL:
+            case ACTION_PWM_FADE:
+                softpwm_setLevel( param, level );
+                break;
+
+            case ACTION_PWM_DIM_UP:
+                softpwm_dim( param, TRUE, pwm_dim_step );
+                break;
+
+            case ACTION_PWM_DIM_DOWN:
+                softpwm_dim( param, FALSE, pwm_dim_step );
+                break;
+        }
+
+        return;
+    }
+
+    // Else pin must be in PWM mode
+    ch = pwm_channel( param );
+    if ( PWM_NONE == ch ) return;
+
+    switch ( action ) {
+
+        case ACTION_PWM_LEVEL:
+            pwm_setLevel( ch, level );
+            break;
+
+        case ACTION_PWM_DIM_UP:
+            pwm_dim( ch, TRUE );
+            break;
+
+        case ACTION_PWM_DIM_DOWN:
+            pwm_dim( ch, FALSE );
+            break;
+
+        case ACTION_PWM_FADE:
+            pwm_fadeTo( ch, level );
+            break;
     }
 }
 
@@ -1431,6 +2651,7 @@ uint32_t vscp_getFamilyType() {
 void vscp_restoreDefaults() {
     init_app_eeprom();
     init_app_ram();
+    configureIO();
 }
 
 
@@ -1440,7 +2661,7 @@ void vscp_restoreDefaults() {
 
 uint8_t vscp_getRegisterPagesUsed( void )
 {
-    return 1; // One pae used
+    return REG_PAGES_USED;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1459,6 +2680,12 @@ int8_t sendVSCPFrame( uint16_t vscpclass,
                     ( (uint32_t)vscptype << 8 ) |
                     nodeid; // node address (our address)
 
+    // Protocol events and heartbeats are never limited
+    if ( !ratelimit_take( vscpclass, vscptype ) ) {
+        vscp_omsg.flags = 0;
+        return FALSE;
+    }
+
     if ( !sendCANFrame( id, size, pData ) ) {
         return FALSE;
     }
@@ -1499,19 +2726,90 @@ int8_t getVSCPFrame(uint16_t *pvscpclass,
 
 int8_t sendCANFrame(uint32_t id, uint8_t dlc, uint8_t *pdata)
 {
-    uint8_t rv = FALSE;
-    sendTimer = 0;
+    uint8_t i;
+    uint8_t next;
+    uint8_t gie;
+    uint16_t elapsed;
+    canframe_t *pframe;
 
-    while ( sendTimer < 1000 ) {
-        if ( ECANSendMessage( id, pdata, dlc, ECAN_TX_XTD_FRAME ) ) {
-            rv = TRUE;
-            break;
+    vscp_omsg.flags = 0;
+
+    // Wait for room in the transmit ring. The timer is counted in the
+    // low priority interrupt so both bytes are accessed with it off.
+    next = ( can_tx_head + 1 ) & ( CAN_TX_FIFO_SIZE - 1 );
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    sendTimer = 0;
+    INTCONbits.GIEL = gie;
+    while ( next == can_tx_tail ) {
+        INTCONbits.GIEL = 0;
+        elapsed = sendTimer;
+        INTCONbits.GIEL = gie;
+        if ( elapsed >= 1000 ) {
+            if ( can_tx_overruns < 255 ) can_tx_overruns++;
+            return FALSE;
         }
     }
 
-    vscp_omsg.flags = 0;
+    pframe = &can_tx_fifo[ can_tx_head ];
+    pframe->id = id;
+    pframe->dlc = dlc;
+    for ( i = 0; i < dlc; i++ ) {
+        pframe->data[ i ] = pdata[ i ];
+    }
 
-    return rv;
+    can_tx_head = next;
+
+    // Let the high priority interrupt move it to a transmit buffer
+    PIE5bits.TXBnIE = 1;
+    PIR5bits.TXBnIF = 1;
+
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getCANTxFree
+//
+
+uint8_t getCANTxFree( void )
+{
+    return ( CAN_TX_FIFO_SIZE - 1 ) -
+                ( ( can_tx_head - can_tx_tail ) & ( CAN_TX_FIFO_SIZE - 1 ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isOvertaking
+//
+// An urgent frame must not overtake an older frame in the normal lane
+// of the same class or from the same node. Events from one sender are
+// then run in the order they were sent, SYNC-ARM before SYNC-FIRE even
+// when the fire event has a higher priority than the arm event.
+//
+
+uint8_t isOvertaking( canframe_t *purgent )
+{
+    uint8_t i;
+    uint8_t head;
+    uint16_t vclass;
+    canframe_t *pframe;
+
+    vclass = (uint16_t)( purgent->id >> 16 ) & 0x1ff;
+    head = can_rx_head;
+
+    for ( i = can_rx_tail; i != head; i = ( i + 1 ) & ( CAN_RX_FIFO_SIZE - 1 ) ) {
+
+        pframe = &can_rx_fifo[ i ];
+
+        // The normal lane is in receive order, the rest are newer
+        if ( (int8_t)( pframe->seq - purgent->seq ) > 0 ) break;
+
+        if ( ( ( (uint16_t)( pframe->id >> 16 ) & 0x1ff ) == vclass ) ||
+                ( (uint8_t)pframe->id == (uint8_t)purgent->id ) ) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1520,25 +2818,86 @@ int8_t sendCANFrame(uint32_t id, uint8_t dlc, uint8_t *pdata)
 
 int8_t getCANFrame(uint32_t *pid, uint8_t *pdlc, uint8_t *pdata)
 {
-    ECAN_RX_MSG_FLAGS flags;
+    uint8_t i;
+    uint8_t urgent;
+    uint32_t now;
+    canframe_t *pframe;
 
     // Dont read in new event if there already is a event
     // in the input buffer
     if (vscp_imsg.flags & VSCP_VALID_MSG) return FALSE;
 
-    if ( ECANReceiveMessage( pid, pdata, pdlc, &flags) ) {
+    // Urgent lane goes first unless that would overtake an older frame
+    // in the normal lane it must come after
+    urgent = FALSE;
+    if ( can_rx_urgent_head != can_rx_urgent_tail ) {
+        pframe = &can_rx_urgent_fifo[ can_rx_urgent_tail ];
+        urgent = !isOvertaking( pframe );
+    }
+
+    if ( !urgent ) {
+        if ( can_rx_head == can_rx_tail ) {
+            // The frame that woke us up was not kept (RTR, shed or
+            // overrun), nothing to measure
+            idle_rxwake = FALSE;
+            return FALSE;
+        }
+        pframe = &can_rx_fifo[ can_rx_tail ];
+    }
+
+    *pid = pframe->id;
+    *pdlc = pframe->dlc;
+    for ( i = 0; i < pframe->dlc; i++ ) {
+        pdata[ i ] = pframe->data[ i ];
+    }
+    can_rx_stamp = pframe->stamp;
+
+    if ( urgent ) {
+
+        can_rx_urgent_tail =
+                ( can_rx_urgent_tail + 1 ) & ( CAN_RX_URGENT_SIZE - 1 );
 
-        // RTR not interesting
-        if (flags & ECAN_RX_RTR_FRAME) return FALSE;
+        // Time from receive to processing, saturated at 65535 us
+        INTCONbits.GIEH = 0;
+        TIMESTAMP_READ32( now );
+        INTCONbits.GIEH = 1;
+        now -= can_rx_stamp;
+        if ( now > ( 0xffffL * 5 ) / 4 ) {
+            now = 0xffff;
+        }
+        else {
+            now = TIMESTAMP_TO_US( now );
+        }
 
-        // Must be extended frame
-        if (!(flags & ECAN_RX_XTD_FRAME)) return FALSE;
+        if ( now > can_rx_urgent_latency_max ) {
+            can_rx_urgent_latency_max = (uint16_t)now;
+        }
+    }
+    else {
+        can_rx_tail = ( can_rx_tail + 1 ) & ( CAN_RX_FIFO_SIZE - 1 );
+    }
 
-        return TRUE;
+    // Woken up by this frame - measure wake to process latency
+    if ( idle_rxwake ) {
 
+        uint16_t wake_now;
+        uint16_t latency;
+
+        idle_rxwake = FALSE;
+        TIMESTAMP_READ( wake_now );
+        latency = TIMESTAMP_TO_US( (uint16_t)( wake_now - idle_wakestamp ) );
+
+        if ( latency > idle_latency_max ) {
+            idle_latency_max = latency;
+        }
+
+        if ( ( latency > idle_latency_bound ) &&
+                ( idle_latency_overruns < 255 ) ) {
+            idle_latency_overruns++;
+        }
     }
 
-    return FALSE;
+    return TRUE;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -88,7 +88,78 @@
 //
 #define TIMER2_RELOAD_VALUE         156
 
-
+//
+// Timer 1 is a free running time stamp counter
+// 10 MHz with PLL => 40 MHz
+// 1:4 => 10 MHz, 1:8 prescaler => 1.25 MHz ( 0.800 uS cycle )
+// Wraps every 52.4 ms
+//
+#define TIMESTAMP_TICKS_PER_SECOND  1250000L
+
+// Read the 16-bit time stamp (TMR1L must be read first in RD16 mode)
+#define TIMESTAMP_READ( t )         { t = TMR1L; t |= ( (uint16_t)TMR1H << 8 ); }
+
+// Convert time stamp ticks to microseconds
+#define TIMESTAMP_TO_US( t )        ( ( (uint32_t)(t) * 4 ) / 5 )
+
+// Upper 16 bits of the 32-bit time stamp, counted by the high priority
+// interrupt on Timer1 overflow. The 32-bit time stamp wraps after 57
+// minutes.
+extern volatile uint16_t timestamp_high;
+
+// Read the 32-bit time stamp. High priority interrupts must be off.
+// An overflow not yet counted by the interrupt is added here.
+#define TIMESTAMP_READ32( t )       { uint16_t _lo; TIMESTAMP_READ( _lo );  \
+                                        t = timestamp_high;                 \
+                                        if ( PIR1bits.TMR1IF &&             \
+                                                ( _lo < 0x8000 ) ) t++;     \
+                                        t = ( t << 16 ) | _lo; }
+
+
+// CAN receive/transmit rings between the high priority interrupt
+// and the main loop. Size must be a power of two.
+#define CAN_RX_FIFO_SIZE            16
+#define CAN_RX_URGENT_SIZE          8
+#define CAN_TX_FIFO_SIZE            8
+
+// Receive lanes. Protocol and control events, and events with a
+// priority better than the urgent priority register, go to the urgent
+// lane which is always emptied first. Heartbeats and measurements are
+// dropped (shed) when the normal lane holds more than the shed
+// threshold so that a flood of them can't delay commands.
+#define CAN_RX_DEFAULT_SHED_THRESHOLD   8   // Frames, 0 = never shed
+#define CAN_RX_DEFAULT_URGENT_PRIORITY  2   // Priority 0-1 is urgent
+
+typedef struct {
+    uint32_t id;        // Extended CAN id
+    uint8_t dlc;        // Number of data bytes
+    uint8_t data[ 8 ];  // Data
+    uint32_t stamp;     // 32-bit time stamp when received
+    uint8_t seq;        // Receive order over both receive lanes
+} canframe_t;
+
+// Receive time stamp of the event in vscp_imsg
+extern uint32_t can_rx_stamp;
+
+// Decision matrix row, RAM copy of the EEPROM row and its data match.
+// The data byte matches if lo <= ( data & mask ) <= lo + span, or
+// outside of that if invert is set.
+typedef struct {
+    uint8_t oaddr;
+    uint8_t flags;
+    uint16_t class_filter;
+    uint16_t class_mask;
+    uint8_t type_filter;
+    uint8_t type_mask;
+    uint8_t action;
+    uint8_t param;
+    uint8_t data_len;   // Event data bytes needed, 0 = no data match
+    uint8_t data_idx;
+    uint8_t data_mask;
+    uint8_t data_lo;
+    uint8_t data_span;
+    uint8_t data_invert;
+} dmrow_t;
 
 #define STATUS_LED  PORTCbits.RC1
 #define INIT_BUTTON PORTCbits.RC0
@@ -123,6 +194,30 @@
 #define REG_PIN20_SUBZONE           22
 
 #define REG_FIRST_PAGE_END          23
+
+// Registers after REG_FIRST_PAGE_END on page 0 are not stored
+// at VSCP_EEPROM_END + reg. See EEPROM layout below.
+#define REG_IDLE_CONTROL            23  // bit 0 - Enable idle
+#define REG_IDLE_LATENCY_BOUND      24  // Max wake to process latency (us)
+#define REG_IDLE_PERCENT            25  // Idle time last second (%)
+#define REG_IDLE_LATENCY_MAX_MSB    26  // Max wake to process latency (us)
+#define REG_IDLE_LATENCY_MAX_LSB    27
+#define REG_IDLE_LATENCY_OVERRUNS   28  // Latency > bound counter
+#define REG_IRQ_LATENCY_MAX_MSB     29  // Max high priority latency (us)
+#define REG_IRQ_LATENCY_MAX_LSB     30
+#define REG_IRQ_DURATION_MAX_MSB    31  // Max high priority ISR time (us)
+#define REG_IRQ_DURATION_MAX_LSB    32
+#define REG_CAN_RX_OVERRUNS         33  // Frames lost, receive ring full
+#define REG_CAN_RX_MAX_FILL         34  // Max frames in receive ring
+#define REG_CAN_TX_OVERRUNS         35  // Frames lost, transmit ring full
+#define REG_CAN_RX_SHED_MSB         36  // Low priority frames shed
+#define REG_CAN_RX_SHED_LSB         37
+#define REG_CAN_RX_URGENT_OVERRUNS  38  // Urgent lane full
+#define REG_CAN_RX_URGENT_MAX_FILL  39  // Max frames in urgent lane
+#define REG_CAN_RX_URGENT_LATENCY_MSB 40  // Max urgent receive to process (us)
+#define REG_CAN_RX_URGENT_LATENCY_LSB 41
+#define REG_CAN_RX_SHED_THRESHOLD   42  // Shed when normal lane fill >= this
+#define REG_CAN_RX_URGENT_PRIORITY  43  // Priority below this is urgent
 // * * *  Registers - Page=1  * * *
 
 // Decision Matrix
@@ -130,6 +225,372 @@
 #define DESCION_MATRIX_ROWS         8   // Rows in DM
 #define DESCION_MATRIX_PAGE         1
 
+// Data match for each row, bit 0-2 of the first register is the data
+// byte index, bit 4-6 the operator. Then mask, value (low bound) and
+// high bound.
+#define REG_DM_DATA_MATCH           64  // 8 x 4
+#define REG_DM_TIME_LAST_MSB        96  // Last event matching time (us)
+#define REG_DM_TIME_LAST_LSB        97
+#define REG_DM_TIME_MAX_MSB         98  // Longest matching time (us), write to clear
+#define REG_DM_TIME_MAX_LSB         99
+
+// Data match operators
+#define DM_OP_NONE                  0
+#define DM_OP_EQ                    1
+#define DM_OP_NE                    2
+#define DM_OP_LT                    3
+#define DM_OP_GT                    4
+#define DM_OP_RANGE                 5   // Value <= data <= high bound
+
+// * * *  Registers - Page=2  * * *
+
+// Pin configuration and inputs
+#define REG_PAGE_PINS               2
+
+#define REG_PIN3_MODE               0   // Mode for pin 3-20
+#define REG_PIN20_MODE              17
+#define REG_INPUT_SAMPLE_TIME       18  // Input sample period (ms)
+#define REG_INPUT_STATE0            19  // Debounced inputs, pin 3-10
+#define REG_INPUT_STATE1            20  // Debounced inputs, pin 11-18
+#define REG_INPUT_STATE2            21  // Debounced inputs, pin 19-20
+
+// * * *  Registers - Page=3  * * *
+
+// Edge capture
+#define REG_PAGE_EDGES              3
+
+#define REG_EDGE_COUNT              0   // Active edges, MSB/LSB per channel
+#define REG_EDGE_WIDTH              10  // Last pulse width (us), MSB/LSB per channel
+#define REG_EDGE_LOST_MSB           20  // Edges lost, queue full
+#define REG_EDGE_LOST_LSB           21
+#define REG_EDGE_MAX_FILL           22  // Max number of edges in queue
+#define REG_EDGE_LATENCY_MAX_MSB    24  // Max edge to event latency (us)
+#define REG_EDGE_LATENCY_MAX_LSB    25
+
+// * * *  Registers - Page=4  * * *
+
+// ADC. Eight configuration registers per channel AN0-AN4.
+#define REG_PAGE_ADC                4
+
+#define REG_ADC_CHANNEL             0   // First channel configuration
+#define REG_ADC_CHANNEL_SIZE        8   // Registers per channel
+#define REG_ADC_VALUE               40  // Value, MSB/LSB per channel
+#define REG_ADC_OVERSAMPLE          50  // Oversampling, 4^n samples
+#define REG_ADC_FULLSCALE_MSB       51  // Full scale (mV)
+#define REG_ADC_FULLSCALE_LSB       52
+#define REG_ADC_BURST_CONTROL       53  // Burst capture start/status
+#define REG_ADC_BURST_COUNT         54  // Samples per burst, 0 = 256
+#define REG_ADC_BURST_PERIOD_MSB    55  // Sample period (time stamp ticks)
+#define REG_ADC_BURST_PERIOD_LSB    56
+#define REG_ADC_BURST_INTERVAL      57  // ms between streamed frames
+#define REG_ADC_BURST_RATE_MSB      58  // Effective sample rate (Hz)
+#define REG_ADC_BURST_RATE_LSB      59
+#define REG_ADC_BURST_OVERRUNS      60  // Samples not taken on time
+
+// Offsets in channel configuration
+#define ADC_REG_FLAGS               0   // Event flags
+#define ADC_REG_THRESHOLD_MSB       1   // Threshold
+#define ADC_REG_THRESHOLD_LSB       2
+#define ADC_REG_HYSTERESIS_MSB      3   // Hysteresis below threshold
+#define ADC_REG_HYSTERESIS_LSB      4
+#define ADC_REG_DELTA_MSB           5   // Change that sends an event
+#define ADC_REG_DELTA_LSB           6
+#define ADC_REG_PERIOD              7   // Event period (s), 0 = off
+
+// * * *  Registers - Page=5  * * *
+
+// Pulse counter
+#define REG_PAGE_COUNTER            5
+
+#define REG_COUNTER_TOTAL0          0   // Total count MSB, 4 bytes
+#define REG_COUNTER_TOTAL3          3   // Total count LSB
+#define REG_COUNTER_GATE_MSB        4   // Gate time (ms)
+#define REG_COUNTER_GATE_LSB        5
+#define REG_COUNTER_FREQ0           6   // Frequency (0.01 Hz) MSB, 4 bytes
+#define REG_COUNTER_FREQ3           9
+#define REG_COUNTER_PERIOD          10  // Event period (s), 0 = off
+#define REG_COUNTER_HLVD_LEVEL      11  // Power loss trip level (HLVDL)
+#define REG_COUNTER_SAVES           12  // Totals saved since start
+
+// * * *  Registers - Page=6  * * *
+
+// Hardware PWM. Channel 0-2 is pin 15, 16, 20.
+#define REG_PAGE_PWM                6
+
+#define REG_PWM_LEVEL               0   // Level per channel, set at once
+#define REG_PWM_TARGET              3   // Level per channel, fade to
+#define REG_PWM_FADE                6   // Fade time (ms), MSB/LSB per channel
+#define REG_PWM_DIM_STEP            12  // Dim up/down step
+
+// Software PWM. Levels for pin 3-20.
+#define REG_PAGE_SOFTPWM            7
+
+#define REG_SOFTPWM_LEVEL           0   // Level for pin 3
+#define REG_SOFTPWM_LEVEL_LAST      17  // Level for pin 20
+#define REG_SOFTPWM_SHARE_MSB       18  // CPU share last second (0.01 %)
+#define REG_SOFTPWM_SHARE_LSB       19
+#define REG_SOFTPWM_ISR_MAX         20  // Longest interrupt (us), write to clear
+#define REG_SOFTPWM_LATE            21  // Late slots, write to clear
+#define REG_SOFTPWM_CHANNELS        22  // Pins in software PWM mode
+#define REG_SOFTPWM_BUILD_MSB       23  // Last plane build (us)
+#define REG_SOFTPWM_BUILD_LSB       24
+
+// UART on pin 3/4
+#define REG_PAGE_UART               8
+
+#define REG_UART_BAUD               0   // Baud rate code
+#define REG_UART_SIZE               1   // Flush at this many bytes (1-7)
+#define REG_UART_IDLE               2   // Flush after idle (ms), 0 = off
+#define REG_UART_FLAGS              3
+#define REG_UART_DELIMITER          4   // Flush on this byte
+#define REG_UART_PEER               5   // Take TX data from this node
+#define REG_UART_RX_RATE_MSB        6   // Bytes received last second
+#define REG_UART_RX_RATE_LSB        7
+#define REG_UART_TX_RATE_MSB        8   // Bytes sent last second
+#define REG_UART_TX_RATE_LSB        9
+#define REG_UART_LATENCY_MSB        10  // Worst byte latency (ms)
+#define REG_UART_LATENCY_LSB        11
+#define REG_UART_OVERRUNS           12  // Receiver overruns
+#define REG_UART_RX_LOST            13  // Bytes lost, receive ring full
+#define REG_UART_TX_LOST            14  // Bytes lost, transmit ring full
+#define REG_UART_FRAMING_ERRORS     15
+
+// I2C on pin 5/6
+#define REG_PAGE_I2C                9
+
+#define REG_I2C_SPEED               0   // 0 = 100 kHz, 1 = 400 kHz
+#define REG_I2C_UTILIZATION_MSB     1   // Bus busy last second (0.1 %)
+#define REG_I2C_UTILIZATION_LSB     2
+#define REG_I2C_RATE                3   // Transactions last second
+#define REG_I2C_ERRORS              4   // Write to clear
+#define REG_I2C_ISR_MAX             5   // Longest interrupt (us), write to clear
+#define REG_I2C_QUEUE_FULL          6   // Polls delayed, write to clear
+#define REG_I2C_SENSOR              16  // Sensor poll table, 8 x 10
+
+// SPI on pin 5-7
+#define REG_PAGE_SPI                10
+
+#define REG_SPI_CLOCK               0   // 0 = 10 MHz, 1 = 2.5 MHz, 2 = 625 kHz
+#define REG_SPI_MODE                1   // SPI mode 0-3
+#define REG_SPI_EXT_CS              2   // Extender latch pin, 0 = none
+#define REG_SPI_EXT_LEN             3   // Extender registers in chain
+#define REG_SPI_EXT_STATE           4   // Extender outputs, 4 bytes
+#define REG_SPI_RATE_MSB            8   // Transfers last second
+#define REG_SPI_RATE_LSB            9
+#define REG_SPI_ISR_MAX             10  // Longest interrupt (us), write to clear
+#define REG_SPI_QUEUE_FULL          11  // Write to clear
+
+// 1-Wire
+#define REG_PAGE_ONEWIRE            11
+
+#define REG_ONEWIRE_COUNT           0   // Sensors found, write to search
+#define REG_ONEWIRE_ISR_MAX         1   // Longest interrupt (us), write to clear
+#define REG_ONEWIRE_CRC_ERRORS      2   // Write to clear
+#define REG_ONEWIRE_NO_PRESENCE     3   // No answer to reset, write to clear
+#define REG_ONEWIRE_PERIOD          8   // Report period (s) per sensor, 8
+#define REG_ONEWIRE_ROM             16  // ROM codes, 8 x 8
+#define REG_ONEWIRE_TEMP            80  // Temperature (0.01 C), 8 x 2
+
+// Output scenes
+#define REG_PAGE_SCENE              12
+
+#define REG_SCENE_LAST              0   // Last scene recalled, 0xff = none
+#define REG_SCENE_TIME_MAX_MSB      1   // Longest recall (us), write to clear
+#define REG_SCENE_TIME_MAX_LSB      2
+#define REG_SCENE_WAVE_SIZE         3   // Outputs per wave, 0 = all at once
+#define REG_SCENE_WAVE_INTERVAL     4   // ms between waves
+#define REG_SCENE_DONE_TIME_MSB     5   // ms for last switch to complete
+#define REG_SCENE_DONE_TIME_LSB     6
+#define REG_SCENE_TABLE             16  // Scene mask and values, 8 x 8
+#define REG_SCENE_GROUP             80  // Group masks, 8 x 4
+#define REG_SCENE_SYNC_STATE        112 // Armed/scheduled, write 0 to disarm
+#define REG_SCENE_SYNC_MASK         113 // Staged mask, 3 bytes
+#define REG_SCENE_SYNC_VALUE        116 // Staged values, 3 bytes
+#define REG_SCENE_SYNC_FIRES        119 // Fires done, wraps
+#define REG_SCENE_SYNC_LATE_MSB     120 // Late after set time last fire (us)
+#define REG_SCENE_SYNC_LATE_LSB     121
+#define REG_SCENE_SYNC_LATE_MAX_MSB 122 // Most late (us), write to clear
+#define REG_SCENE_SYNC_LATE_MAX_LSB 123
+
+// Event translation
+#define REG_PAGE_TRANSLATE          13
+
+#define REG_TRANSLATE_TEMPLATES     0   // Templates, 7 x 16
+#define REG_TRANSLATE_SENT          112 // Write to clear
+#define REG_TRANSLATE_SUPPRESSED    113 // Not sent in cooldown, write to clear
+#define REG_TRANSLATE_LOST          114 // Transmit ring full, write to clear
+
+// Rule code
+#define REG_PAGE_RULE_CODE          14
+
+#define REG_RULE_CODE               0   // Code area, 128 bytes
+
+// Rules
+#define REG_PAGE_RULES              15
+
+#define REG_RULES_TABLE             0   // Start, trigger, period, 8 x 4
+#define REG_RULES_STATS             32  // Statistics, 8 x 8, write to clear
+#define REG_RULES_VARS              96  // Variables, 8 x 2
+#define REG_RULES_PASS_MAX_MSB      112 // Longest pass (us), write to clear
+#define REG_RULES_PASS_MAX_LSB      113
+#define REG_RULES_ERROR             114 // Why last rule was stopped, write to clear
+#define REG_RULES_ERROR_RULE        115 // Rule that was stopped
+
+// Output interlock
+#define REG_PAGE_INTERLOCK          16
+
+#define REG_INTERLOCK_GROUPS        0   // Mask and dead time, 4 x 4
+#define REG_INTERLOCK_DELAYED       16  // Held for dead time, write to clear
+#define REG_INTERLOCK_BLOCKED       17  // Not done, write to clear
+#define REG_INTERLOCK_PENDING       20  // Pin held back per group, 0 = none
+
+// Shutters
+#define REG_PAGE_SHUTTER            17
+
+#define REG_SHUTTER_CHANNELS        0   // Pins and travel times, 4 x 8
+#define REG_SHUTTER_POSITION        32  // Position in percent, write to go
+#define REG_SHUTTER_STATE           36  // State, write to stop
+#define REG_SHUTTER_FINE            40  // Position in 0.01 %, 4 x 2
+
+// Regulators
+#define REG_PAGE_REGULATOR          18
+
+#define REG_REGULATOR_CHANNELS      0   // Source, output and parameters, 4 x 16
+#define REG_REGULATOR_VALUE         64  // Value, MSB/LSB per channel
+#define REG_REGULATOR_OUTPUT        72  // Output in percent per channel
+
+// Rate limit
+#define REG_PAGE_RATELIMIT          19
+
+#define REG_RATELIMIT_CONTROL       0   // bit 0 - Enable
+#define REG_RATELIMIT_BUCKETS       1   // Rate and burst, 5 x 2
+#define REG_RATELIMIT_DROPPED       16  // Dropped per bucket, 5 x 2, write to clear
+#define REG_RATELIMIT_HELD          26  // Pin events held, write to clear
+#define REG_RATELIMIT_COALESCED     28  // Held pin events replaced, write to clear
+#define REG_RATELIMIT_PENDING       30  // Pins with a held event
+
+#define REG_PAGES_USED              20  // Number of register pages
+
+// --------------------------------------------------------------------------------
+
+// Version of the application EEPROM layout in the last EEPROM byte,
+// which never moves. Bump when the layout below changes so an upgraded
+// node gets the defaults instead of reading old data at new addresses.
+#define EEPROM_LAYOUT_VERSION       0x3ff
+#define EEPROM_LAYOUT               1
+
+// Application EEPROM storage after the decision matrix
+#define EEPROM_APP_START            ( VSCP_EEPROM_END + REG_FIRST_PAGE_END + \
+                                        8 * DESCION_MATRIX_ROWS )
+
+// Idle
+#define EEPROM_IDLE_CONTROL         ( EEPROM_APP_START + 0 )
+#define EEPROM_IDLE_LATENCY_BOUND   ( EEPROM_APP_START + 1 )
+#define EEPROM_IDLE_END             ( EEPROM_APP_START + 2 )
+
+// Pin configuration and inputs
+#define EEPROM_PIN_MODE             ( EEPROM_IDLE_END + 0 )     // 18 bytes
+#define EEPROM_INPUT_SAMPLE_TIME    ( EEPROM_IDLE_END + 18 )
+#define EEPROM_PINS_END             ( EEPROM_IDLE_END + 19 )
+
+// ADC. Channel configuration has the register layout.
+#define EEPROM_ADC_CHANNEL          ( EEPROM_PINS_END + 0 )     // 40 bytes
+#define EEPROM_ADC_OVERSAMPLE       ( EEPROM_PINS_END + 40 )
+#define EEPROM_ADC_FULLSCALE_MSB    ( EEPROM_PINS_END + 41 )
+#define EEPROM_ADC_FULLSCALE_LSB    ( EEPROM_PINS_END + 42 )
+#define EEPROM_ADC_BURST_COUNT      ( EEPROM_PINS_END + 43 )
+#define EEPROM_ADC_BURST_PERIOD_MSB ( EEPROM_PINS_END + 44 )
+#define EEPROM_ADC_BURST_PERIOD_LSB ( EEPROM_PINS_END + 45 )
+#define EEPROM_ADC_BURST_INTERVAL   ( EEPROM_PINS_END + 46 )
+#define EEPROM_ADC_END              ( EEPROM_PINS_END + 47 )
+
+// Pulse counter. Totals are saved to one of a ring of slots so writes
+// are spread. Addresses go above 0xff from here.
+#define EEPROM_COUNTER_GATE_MSB     ( EEPROM_ADC_END + 0 )
+#define EEPROM_COUNTER_GATE_LSB     ( EEPROM_ADC_END + 1 )
+#define EEPROM_COUNTER_PERIOD       ( EEPROM_ADC_END + 2 )
+#define EEPROM_COUNTER_HLVD_LEVEL   ( EEPROM_ADC_END + 3 )
+#define EEPROM_COUNTER_SLOTS        ( EEPROM_ADC_END + 4 )      // 16 * 5 bytes
+#define EEPROM_COUNTER_END          ( EEPROM_ADC_END + 84 )
+
+// Hardware PWM
+#define EEPROM_PWM_FADE             ( EEPROM_COUNTER_END + 0 )  // 6 bytes
+#define EEPROM_PWM_DIM_STEP         ( EEPROM_COUNTER_END + 6 )
+#define EEPROM_PWM_END              ( EEPROM_COUNTER_END + 7 )
+
+// UART
+#define EEPROM_UART_BAUD            ( EEPROM_PWM_END + 0 )
+#define EEPROM_UART_SIZE            ( EEPROM_PWM_END + 1 )
+#define EEPROM_UART_IDLE            ( EEPROM_PWM_END + 2 )
+#define EEPROM_UART_FLAGS           ( EEPROM_PWM_END + 3 )
+#define EEPROM_UART_DELIMITER       ( EEPROM_PWM_END + 4 )
+#define EEPROM_UART_PEER            ( EEPROM_PWM_END + 5 )
+#define EEPROM_UART_END             ( EEPROM_PWM_END + 6 )
+
+// I2C
+#define EEPROM_I2C_SPEED            ( EEPROM_UART_END + 0 )
+#define EEPROM_I2C_SENSORS          ( EEPROM_UART_END + 1 )     // 80 bytes
+#define EEPROM_I2C_END              ( EEPROM_UART_END + 81 )
+
+// SPI
+#define EEPROM_SPI_CLOCK            ( EEPROM_I2C_END + 0 )
+#define EEPROM_SPI_MODE             ( EEPROM_I2C_END + 1 )
+#define EEPROM_SPI_EXT_CS           ( EEPROM_I2C_END + 2 )
+#define EEPROM_SPI_EXT_LEN          ( EEPROM_I2C_END + 3 )
+#define EEPROM_SPI_END              ( EEPROM_I2C_END + 4 )
+
+// 1-Wire
+#define EEPROM_ONEWIRE_PERIOD       ( EEPROM_SPI_END + 0 )      // 8 bytes
+#define EEPROM_ONEWIRE_END          ( EEPROM_SPI_END + 8 )
+
+// Output scenes
+#define EEPROM_SCENE_TABLE          ( EEPROM_ONEWIRE_END + 0 )  // 8 * 6 bytes
+#define EEPROM_SCENE_GROUPS         ( EEPROM_ONEWIRE_END + 48 ) // 8 * 3 bytes
+#define EEPROM_SCENE_END            ( EEPROM_ONEWIRE_END + 72 )
+
+// Decision matrix data match
+#define EEPROM_DM_DATA_MATCH        ( EEPROM_SCENE_END + 0 )    // 8 * 4 bytes
+#define EEPROM_DM_END               ( EEPROM_SCENE_END + 32 )
+
+// Event translation
+#define EEPROM_TRANSLATE_TEMPLATES  ( EEPROM_DM_END + 0 )       // 7 * 16 bytes
+#define EEPROM_TRANSLATE_END        ( EEPROM_DM_END + 112 )
+
+// Rules
+#define EEPROM_RULE_CODE            ( EEPROM_TRANSLATE_END + 0 )    // 128 bytes
+#define EEPROM_RULE_TABLE           ( EEPROM_TRANSLATE_END + 128 )  // 8 * 3 bytes
+#define EEPROM_RULE_END             ( EEPROM_TRANSLATE_END + 152 )
+
+// Output interlock
+#define EEPROM_INTERLOCK_GROUPS     ( EEPROM_RULE_END + 0 )     // 4 * 4 bytes
+#define EEPROM_INTERLOCK_END        ( EEPROM_RULE_END + 16 )
+
+// Staggered switch on
+#define EEPROM_SCENE_WAVE_SIZE      ( EEPROM_INTERLOCK_END + 0 )
+#define EEPROM_SCENE_WAVE_INTERVAL  ( EEPROM_INTERLOCK_END + 1 )
+#define EEPROM_SCENE_WAVE_END       ( EEPROM_INTERLOCK_END + 2 )
+
+// Shutters
+#define EEPROM_SHUTTER_CHANNELS     ( EEPROM_SCENE_WAVE_END + 0 )   // 4 * 8 bytes
+#define EEPROM_SHUTTER_END          ( EEPROM_SCENE_WAVE_END + 32 )
+
+// Regulators
+#define EEPROM_REGULATOR_CHANNELS   ( EEPROM_SHUTTER_END + 0 )      // 4 * 16 bytes
+#define EEPROM_REGULATOR_END        ( EEPROM_SHUTTER_END + 64 )
+
+// Receive lanes
+#define EEPROM_CAN_RX_SHED_THRESHOLD    ( EEPROM_REGULATOR_END + 0 )
+#define EEPROM_CAN_RX_URGENT_PRIORITY   ( EEPROM_REGULATOR_END + 1 )
+#define EEPROM_CAN_RX_END               ( EEPROM_REGULATOR_END + 2 )
+
+// Rate limit
+#define EEPROM_RATELIMIT_CONTROL    ( EEPROM_CAN_RX_END + 0 )
+#define EEPROM_RATELIMIT_BUCKETS    ( EEPROM_CAN_RX_END + 1 )       // 5 * 2 bytes
+#define EEPROM_RATELIMIT_END        ( EEPROM_CAN_RX_END + 11 )
+
+#define IDLE_CONTROL_ENABLE         0x01
+#define IDLE_DEFAULT_LATENCY_BOUND  100 // us
+
 // --------------------------------------------------------------------------------
 
 // * * * Actions * * *
@@ -138,6 +599,27 @@
 #define ACTION_CLR                  2
 #define ACTION_SETALL               3
 #define ACTION_CLRALL               4
+#define ACTION_CAPTURE              5   // Burst ADC capture, param = channel
+#define ACTION_PWM_LEVEL            6   // Set PWM level, param = pin
+#define ACTION_PWM_DIM_UP           7   // Dim up one step, param = pin
+#define ACTION_PWM_DIM_DOWN         8   // Dim down one step, param = pin
+#define ACTION_PWM_FADE             9   // Fade to level, param = pin
+#define ACTION_SCENE_RECALL         10  // Recall scene, param = scene
+#define ACTION_SCENE_STORE          11  // Store outputs in scene, param = scene
+#define ACTION_SCENE_TOGGLE         12  // Toggle scene, param = scene
+#define ACTION_SET_MASK             13  // Set pins in group, param = group
+#define ACTION_CLR_MASK             14  // Clear pins in group, param = group
+#define ACTION_TOGGLE_MASK          15  // Toggle pins in group, param = group
+#define ACTION_SEND_EVENT           16  // Send template event, param = template
+#define ACTION_SHUTTER_UP           17  // Open shutter, param = channel
+#define ACTION_SHUTTER_DOWN         18  // Close shutter, param = channel
+#define ACTION_SHUTTER_STOP         19  // Stop shutter, param = channel
+#define ACTION_SHUTTER_GOTO         20  // Go to position, param = channel
+#define ACTION_REGULATOR_SETPOINT   21  // Setpoint from event, param = channel
+#define ACTION_SYNC_ARM             22  // Stage scene, param = scene
+#define ACTION_SYNC_ARM_SET         23  // Stage pin on, param = pin
+#define ACTION_SYNC_ARM_CLR         24  // Stage pin off, param = pin
+#define ACTION_SYNC_FIRE            25  // Apply staged, param = delay (ms)
 
 
 // * * * Control registers
@@ -154,6 +636,7 @@ void doWork( void );
 void init( void );
 void init_app_ram( void );
 void init_app_eeprom( void ); 
+void init_app_layout_eeprom( void );
 void read_app_register( unsigned char reg );
 void write_app_register( unsigned char reg, unsigned char val );
 void sendDMatrixInfo( void );
@@ -161,6 +644,9 @@ void SendInformationEvent( unsigned char idx, unsigned char eventClass, unsigned
 
 void doDM( void );
 
+void actionSet( uint8_t dmflags, uint8_t param );
+void actionClr( uint8_t dmflags, uint8_t param );
+
 void doActionOn( unsigned char dmflags, unsigned char arg );
 void doActionOff( unsigned char dmflags, unsigned char arg );
 void doActionPulse( unsigned char dmflags, unsigned char arg );
@@ -169,6 +655,9 @@ void doActionDisable( unsigned char dmflags, unsigned char arg );
 void doActionToggle( unsigned char dmflags, unsigned char arg );
 
 void doApplicationOneSecondWork( void );
+void doIdle( void );
+void configureIO( void );
+void configurePin( uint8_t pin, uint8_t old );
 
 /*!
 	Send Extended ID CAN frame
@@ -179,6 +668,12 @@ void doApplicationOneSecondWork( void );
 */
 int8_t sendCANFrame( uint32_t id, uint8_t size, uint8_t *pData );
 
+/*!
+	Get free space in the CAN transmit ring
+	@return Number of frames that can be sent without waiting.
+*/
+uint8_t getCANTxFree( void );
+
 /*!
 	Get extended ID CAN frame
 	@param pid Pointer to CAN extended ID for frame.
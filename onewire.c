@@ -0,0 +1,766 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "onewire.h"
+#include "ratelimit.h"
+
+// Operations run by the interrupt
+#define OW_OP_RESET                 0
+#define OW_OP_WRITE                 1
+#define OW_OP_READ                  2
+#define OW_OP_TRIPLET               3   // Read bit, read complement, write
+
+// Interrupt phases
+#define OW_PHASE_RESET              0   // Pull low for reset
+#define OW_PHASE_RESET_RELEASE      1
+#define OW_PHASE_PRESENCE           2   // Sample presence
+#define OW_PHASE_SLOT               3   // Start a bit slot
+#define OW_PHASE_SLOT_RELEASE       4   // End of write 0 low time
+#define OW_PHASE_DONE               5   // Recovery after last slot done
+
+// Timing in 0.8 us time stamp ticks
+#define OW_T_RESET_LOW              625     // 500 us
+#define OW_T_PRESENCE               88      // 70 us after release
+#define OW_T_RESET_END              550     // 440 us after release
+#define OW_T_LOW                    3       // 2.4 us low, write 1 and read
+#define OW_T_SAMPLE                 14      // Read sample at 11.2 us
+#define OW_T_SLOT                   88      // 70 us slot, write 1 and read
+#define OW_T_LOW0                   80      // 64 us low, write 0
+#define OW_T_SLOT0                  88      // 70 us slot, write 0
+#define OW_T_MIN                    4       // Least time to a compare
+
+// Main loop states
+#define OW_STATE_IDLE               0
+#define OW_STATE_SEARCH_ROM         1   // Reset done, send search command
+#define OW_STATE_SEARCH_BIT         2   // Search next ROM bit
+#define OW_STATE_SEARCH_RESULT      3   // Triplet done
+#define OW_STATE_CONVERT            4   // Reset done, start conversion
+#define OW_STATE_CONVERT_START      5   // Convert command sent
+#define OW_STATE_CONVERT_WAIT       6   // Waiting for conversion
+#define OW_STATE_READ_NEXT          7   // Reset next sensor to read
+#define OW_STATE_READ_MATCH         8   // Reset done, address sensor
+#define OW_STATE_READ_CMD           9   // Sensor addressed, read command
+#define OW_STATE_READ_DATA          10  // Command sent, read scratchpad
+#define OW_STATE_READ_DONE          11  // Scratchpad read
+
+// ROM and function commands
+#define OW_CMD_SEARCH_ROM           0xf0
+#define OW_CMD_MATCH_ROM            0x55
+#define OW_CMD_SKIP_ROM             0xcc
+#define OW_CMD_CONVERT_T            0x44
+#define OW_CMD_READ_SCRATCHPAD      0xbe
+
+// Measurement data coding, unit Celsius
+#define OW_CODING_CELSIUS           0x88
+#define OW_DECIMAL_POINT            0x82    // Two steps to the left
+
+uint8_t ow_enabled;
+
+// Bus pin. Low is driven by clearing TRIS with LAT low, high is the
+// external pull-up.
+volatile uint8_t *ow_tris;
+volatile uint8_t *ow_lat;
+volatile uint8_t *ow_port;
+uint8_t ow_mask;
+
+#define OW_LOW()        { *ow_lat &= ~ow_mask; *ow_tris &= ~ow_mask; }
+#define OW_RELEASE()    { *ow_tris |= ow_mask; }
+#define OW_READ()       ( *ow_port & ow_mask )
+
+// Operation run by the interrupt
+volatile uint8_t ow_busy;           // TRUE while an operation runs
+uint8_t ow_op;
+uint8_t ow_phase;
+uint8_t ow_buf[ 1 + ONEWIRE_ROM_SIZE ];
+uint8_t ow_bits;                    // Bits in operation
+uint8_t ow_bit;                     // Bits done
+uint16_t ow_t;                      // Time stamp at start of step
+uint8_t ow_presence;                // TRUE if a device answered reset
+uint8_t ow_trip_id;                 // Triplet, bit read
+uint8_t ow_trip_cmp;                // Triplet, complement read
+uint8_t ow_trip_dir;                // Triplet, direction in and out
+
+// Main loop
+uint8_t ow_state;
+uint8_t ow_search;                  // TRUE when a ROM search is wanted
+uint8_t ow_search_cnt;              // s to next search with no sensors
+uint8_t ow_rom[ ONEWIRE_SENSORS ][ ONEWIRE_ROM_SIZE ];
+uint8_t ow_count;                   // Sensors found
+uint8_t ow_search_rom[ ONEWIRE_ROM_SIZE ];
+uint8_t ow_id_bit;                  // Bit being searched, 0-63
+uint8_t ow_last_disc;               // Last discrepancy, 1-64, 0 = none
+uint8_t ow_last_zero;
+volatile uint16_t ow_wait;          // ms left of conversion
+uint8_t ow_due;                     // Sensors due, one bit each
+uint8_t ow_reading;                 // Sensors in this conversion
+uint8_t ow_sensor;                  // Sensor being read
+uint8_t ow_period_cnt[ ONEWIRE_SENSORS ];
+int16_t ow_temp[ ONEWIRE_SENSORS ]; // Last temperature (0.01 C)
+uint8_t ow_valid;                   // Temperature read, one bit each
+
+// Statistics
+volatile uint16_t ow_isr_max;       // Longest interrupt (ticks)
+uint8_t ow_crc_errors;
+uint8_t ow_no_presence;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// crc8
+//
+// Dallas/Maxim CRC, x^8 + x^5 + x^4 + 1. The CRC over data that ends
+// with its own CRC is zero.
+//
+
+static uint8_t crc8( uint8_t *p, uint8_t len )
+{
+    uint8_t i;
+    uint8_t crc = 0;
+    uint8_t b;
+
+    while ( len-- ) {
+        b = *p++;
+        for ( i = 0; i < 8; i++ ) {
+            crc = ( ( crc ^ b ) & 0x01 ) ? ( ( crc >> 1 ) ^ 0x8c ) : ( crc >> 1 );
+            b >>= 1;
+        }
+    }
+
+    return crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// schedule
+//
+// Set the next compare. A time already passed is moved to just ahead
+// so the compare is not missed for a whole timer cycle.
+//
+
+static void schedule( uint16_t delay )
+{
+    uint16_t now;
+    uint16_t at;
+
+    at = ow_t + delay;
+    TIMESTAMP_READ( now );
+    if ( (int16_t)( at - now ) < OW_T_MIN ) {
+        at = now + OW_T_MIN;
+    }
+
+    CCPR3H = at >> 8;
+    CCPR3L = at & 0xff;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// startOp
+//
+// Start an operation. Main loop only.
+//
+
+static void startOp( uint8_t op, uint8_t len )
+{
+    uint8_t gie;
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+
+    ow_op = op;
+    ow_bit = 0;
+    ow_bits = ( OW_OP_TRIPLET == op ) ? 3 : ( len * 8 );
+    ow_phase = ( OW_OP_RESET == op ) ? OW_PHASE_RESET : OW_PHASE_SLOT;
+    ow_busy = TRUE;
+
+    TIMESTAMP_READ( ow_t );
+    schedule( OW_T_MIN );
+    CCP3CON = 0b00001010;           // Compare, interrupt only
+    PIR4bits.CCP3IF = 0;
+    PIE4bits.CCP3IE = 1;
+
+    INTCONbits.GIEH = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// onewire_init
+//
+
+void onewire_init( void )
+{
+    uint8_t i;
+    uint8_t gie;
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+
+    PIE4bits.CCP3IE = 0;
+    CCP3CON = 0;
+    ow_busy = FALSE;
+    ow_enabled = FALSE;
+
+    // First pin in 1-Wire mode
+    for ( i = 0; i < PIN_COUNT; i++ ) {
+        if ( PIN_MODE_ONEWIRE == ( pin_mode[ i ] & PIN_MODE_MASK ) ) {
+            ow_enabled = TRUE;
+            break;
+        }
+    }
+
+    if ( ow_enabled ) {
+
+        switch ( pin_port[ i ] ) {
+
+            case PIN_PORT_A:
+                ow_tris = &TRISA;
+                ow_lat = &LATA;
+                ow_port = &PORTA;
+                break;
+
+            case PIN_PORT_B:
+                ow_tris = &TRISB;
+                ow_lat = &LATB;
+                ow_port = &PORTB;
+                break;
+
+            default:
+                ow_tris = &TRISC;
+                ow_lat = &LATC;
+                ow_port = &PORTC;
+                break;
+        }
+
+        ow_mask = pin_mask[ i ];
+        OW_RELEASE();
+
+        // CCP3 compare on Timer1
+        CCPTMRSbits.C3TSEL = 0;
+        IPR4bits.CCP3IP = 1;
+    }
+
+    INTCONbits.GIEH = gie;
+
+    for ( i = 0; i < ONEWIRE_SENSORS; i++ ) {
+        ow_period_cnt[ i ] = eeprom_read( EEPROM_ONEWIRE_PERIOD + i );
+    }
+
+    ow_state = OW_STATE_IDLE;
+    ow_search = TRUE;
+    ow_search_cnt = ONEWIRE_SEARCH_RETRY;
+    ow_count = 0;
+    ow_valid = 0;
+    ow_due = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// onewire_init_eeprom
+//
+
+void onewire_init_eeprom( void )
+{
+    uint8_t i;
+
+    for ( i = 0; i < ONEWIRE_SENSORS; i++ ) {
+        eeprom_write( EEPROM_ONEWIRE_PERIOD + i, ONEWIRE_DEFAULT_PERIOD );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// onewire_tick
+//
+
+void onewire_tick( void )
+{
+    if ( ow_wait ) ow_wait--;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// onewire_isr
+//
+// One step of a reset or bit slot. Write 0 and reset low times are
+// timed by compare. The low pulse of write 1 and read is 2.4 us and
+// the read sample must be taken within 15 us of the start of the slot,
+// so those are waited for here. This is the longest time interrupts
+// are held off.
+//
+
+void onewire_isr( void )
+{
+    uint16_t start;
+    uint16_t now;
+    uint8_t bit;
+
+    TIMESTAMP_READ( start );
+
+    PIR4bits.CCP3IF = 0;
+
+    switch ( ow_phase ) {
+
+        case OW_PHASE_RESET:
+            OW_LOW();
+            ow_t = start;
+            schedule( OW_T_RESET_LOW );
+            ow_phase = OW_PHASE_RESET_RELEASE;
+            break;
+
+        case OW_PHASE_RESET_RELEASE:
+            OW_RELEASE();
+            ow_t = start;
+            schedule( OW_T_PRESENCE );
+            ow_phase = OW_PHASE_PRESENCE;
+            break;
+
+        case OW_PHASE_PRESENCE:
+            ow_presence = OW_READ() ? FALSE : TRUE;
+            schedule( OW_T_RESET_END );
+            ow_phase = OW_PHASE_DONE;
+            break;
+
+        case OW_PHASE_SLOT:
+
+            // Bit to write, reads write a 1
+            if ( OW_OP_WRITE == ow_op ) {
+                bit = ( ow_buf[ ow_bit >> 3 ] >> ( ow_bit & 7 ) ) & 1;
+            }
+            else if ( ( OW_OP_TRIPLET == ow_op ) && ( 2 == ow_bit ) ) {
+                if ( ow_trip_id != ow_trip_cmp ) ow_trip_dir = ow_trip_id;
+                bit = ow_trip_dir;
+            }
+            else {
+                bit = 1;
+            }
+
+            ow_t = start;
+
+            if ( !bit ) {
+                OW_LOW();
+                schedule( OW_T_LOW0 );
+                ow_phase = OW_PHASE_SLOT_RELEASE;
+                break;
+            }
+
+            OW_LOW();
+            do {
+                TIMESTAMP_READ( now );
+            } while ( (uint16_t)( now - start ) < OW_T_LOW );
+            OW_RELEASE();
+
+            if ( ( OW_OP_READ == ow_op ) ||
+                    ( ( OW_OP_TRIPLET == ow_op ) && ( ow_bit < 2 ) ) ) {
+
+                do {
+                    TIMESTAMP_READ( now );
+                } while ( (uint16_t)( now - start ) < OW_T_SAMPLE );
+                bit = OW_READ() ? 1 : 0;
+
+                if ( OW_OP_READ == ow_op ) {
+                    if ( bit ) ow_buf[ ow_bit >> 3 ] |= ( 1 << ( ow_bit & 7 ) );
+                }
+                else if ( 0 == ow_bit ) {
+                    ow_trip_id = bit;
+                }
+                else {
+                    ow_trip_cmp = bit;
+                }
+            }
+
+            schedule( OW_T_SLOT );
+            ow_phase = ( ++ow_bit < ow_bits ) ? OW_PHASE_SLOT : OW_PHASE_DONE;
+            break;
+
+        case OW_PHASE_SLOT_RELEASE:
+            OW_RELEASE();
+            schedule( OW_T_SLOT0 );
+            ow_phase = ( ++ow_bit < ow_bits ) ? OW_PHASE_SLOT : OW_PHASE_DONE;
+            break;
+
+        case OW_PHASE_DONE:
+            PIE4bits.CCP3IE = 0;
+            CCP3CON = 0;
+            ow_busy = FALSE;
+            break;
+    }
+
+    TIMESTAMP_READ( now );
+    now -= start;
+    if ( now > ow_isr_max ) {
+        ow_isr_max = now;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendTemperature
+//
+
+static uint8_t sendTemperature( uint8_t idx )
+{
+    uint8_t data[ 4 ];
+
+    // Kept and sent later, not dropped
+    if ( !ratelimit_ready( VSCP_CLASS1_MEASUREMENT ) ) return FALSE;
+
+    data[ 0 ] = OW_CODING_CELSIUS | idx;
+    data[ 1 ] = OW_DECIMAL_POINT;
+    data[ 2 ] = ( ow_temp[ idx ] >> 8 ) & 0xff;
+    data[ 3 ] = ow_temp[ idx ] & 0xff;
+
+    return sendVSCPFrame( VSCP_CLASS1_MEASUREMENT,
+                            VSCP_TYPE_MEASUREMENT_TEMPERATURE,
+                            vscp_nickname,
+                            VSCP_PRIORITY_LOW,
+                            4,
+                            data );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doOneWire
+//
+// Each state starts one operation and the next state runs when it is
+// done. ROM search follows the Maxim search algorithm one bit per
+// triplet. All sensors convert at once, the due ones are then read one
+// by one.
+//
+
+void doOneWire( void )
+{
+    uint8_t i;
+    uint8_t n;
+    uint16_t wait;
+
+    if ( !ow_enabled || ow_busy ) return;
+
+    switch ( ow_state ) {
+
+        case OW_STATE_IDLE:
+            if ( ow_search ) {
+                ow_search = FALSE;
+                ow_count = 0;
+                ow_valid = 0;
+                ow_last_disc = 0;
+                startOp( OW_OP_RESET, 0 );
+                ow_state = OW_STATE_SEARCH_ROM;
+            }
+            else if ( ow_due && ow_count ) {
+                startOp( OW_OP_RESET, 0 );
+                ow_state = OW_STATE_CONVERT;
+            }
+            break;
+
+        case OW_STATE_SEARCH_ROM:
+            if ( !ow_presence ) {
+                if ( ow_no_presence < 255 ) ow_no_presence++;
+                ow_state = OW_STATE_IDLE;
+                break;
+            }
+            ow_buf[ 0 ] = OW_CMD_SEARCH_ROM;
+            startOp( OW_OP_WRITE, 1 );
+            ow_id_bit = 0;
+            ow_last_zero = 0;
+            ow_state = OW_STATE_SEARCH_BIT;
+            break;
+
+        case OW_STATE_SEARCH_BIT:
+            // Direction if both 0 and 1 answer. Before the last
+            // discrepancy repeat the last ROM, at it take 1, after it 0.
+            n = ow_id_bit + 1;
+            if ( n < ow_last_disc ) {
+                ow_trip_dir = ( ow_search_rom[ ow_id_bit >> 3 ] >> ( ow_id_bit & 7 ) ) & 1;
+            }
+            else {
+                ow_trip_dir = ( n == ow_last_disc ) ? 1 : 0;
+            }
+            startOp( OW_OP_TRIPLET, 0 );
+            ow_state = OW_STATE_SEARCH_RESULT;
+            break;
+
+        case OW_STATE_SEARCH_RESULT:
+
+            // No device answered
+            if ( ow_trip_id && ow_trip_cmp ) {
+                ow_state = OW_STATE_IDLE;
+                break;
+            }
+
+            if ( !ow_trip_id && !ow_trip_cmp && !ow_trip_dir ) {
+                ow_last_zero = ow_id_bit + 1;
+            }
+
+            if ( ow_trip_dir ) {
+                ow_search_rom[ ow_id_bit >> 3 ] |= ( 1 << ( ow_id_bit & 7 ) );
+            }
+            else {
+                ow_search_rom[ ow_id_bit >> 3 ] &= ~( 1 << ( ow_id_bit & 7 ) );
+            }
+
+            if ( ++ow_id_bit < 64 ) {
+                ow_state = OW_STATE_SEARCH_BIT;
+                break;
+            }
+
+            // A full ROM
+            if ( 0 == crc8( ow_search_rom, ONEWIRE_ROM_SIZE ) ) {
+                for ( i = 0; i < ONEWIRE_ROM_SIZE; i++ ) {
+                    ow_rom[ ow_count ][ i ] = ow_search_rom[ i ];
+                }
+                ow_count++;
+            }
+            else if ( ow_crc_errors < 255 ) {
+                ow_crc_errors++;
+            }
+
+            ow_last_disc = ow_last_zero;
+            if ( ow_last_disc && ( ow_count < ONEWIRE_SENSORS ) ) {
+                startOp( OW_OP_RESET, 0 );
+                ow_state = OW_STATE_SEARCH_ROM;
+            }
+            else {
+                ow_state = OW_STATE_IDLE;
+            }
+            break;
+
+        case OW_STATE_CONVERT:
+            if ( !ow_presence ) {
+                if ( ow_no_presence < 255 ) ow_no_presence++;
+                ow_state = OW_STATE_IDLE;
+                break;
+            }
+            ow_buf[ 0 ] = OW_CMD_SKIP_ROM;
+            ow_buf[ 1 ] = OW_CMD_CONVERT_T;
+            startOp( OW_OP_WRITE, 2 );
+            ow_state = OW_STATE_CONVERT_START;
+            break;
+
+        case OW_STATE_CONVERT_START:
+            INTCONbits.GIEL = 0;
+            ow_wait = ONEWIRE_CONVERT_TIME;
+            INTCONbits.GIEL = 1;
+            ow_reading = ow_due;
+            ow_due = 0;
+            ow_sensor = 0;
+            ow_state = OW_STATE_CONVERT_WAIT;
+            break;
+
+        case OW_STATE_CONVERT_WAIT:
+            INTCONbits.GIEL = 0;
+            wait = ow_wait;
+            INTCONbits.GIEL = 1;
+            if ( wait ) break;
+            ow_state = OW_STATE_READ_NEXT;
+            break;
+
+        case OW_STATE_READ_NEXT:
+            while ( ( ow_sensor < ow_count ) &&
+                    !( ow_reading & ( 1 << ow_sensor ) ) ) {
+                ow_sensor++;
+            }
+            if ( ow_sensor >= ow_count ) {
+                ow_state = OW_STATE_IDLE;
+                break;
+            }
+            startOp( OW_OP_RESET, 0 );
+            ow_state = OW_STATE_READ_MATCH;
+            break;
+
+        case OW_STATE_READ_MATCH:
+            if ( !ow_presence ) {
+                if ( ow_no_presence < 255 ) ow_no_presence++;
+                ow_state = OW_STATE_IDLE;
+                break;
+            }
+            ow_buf[ 0 ] = OW_CMD_MATCH_ROM;
+            for ( i = 0; i < ONEWIRE_ROM_SIZE; i++ ) {
+                ow_buf[ 1 + i ] = ow_rom[ ow_sensor ][ i ];
+            }
+            startOp( OW_OP_WRITE, 1 + ONEWIRE_ROM_SIZE );
+            ow_state = OW_STATE_READ_CMD;
+            break;
+
+        case OW_STATE_READ_CMD:
+            ow_buf[ 0 ] = OW_CMD_READ_SCRATCHPAD;
+            startOp( OW_OP_WRITE, 1 );
+            ow_state = OW_STATE_READ_DATA;
+            break;
+
+        case OW_STATE_READ_DATA:
+            for ( i = 0; i < sizeof( ow_buf ); i++ ) {
+                ow_buf[ i ] = 0;
+            }
+            startOp( OW_OP_READ, sizeof( ow_buf ) );
+            ow_state = OW_STATE_READ_DONE;
+            break;
+
+        case OW_STATE_READ_DONE:
+            if ( 0 == crc8( ow_buf, sizeof( ow_buf ) ) ) {
+
+                // 1/16 C to 0.01 C
+                ow_temp[ ow_sensor ] =
+                    ( (int32_t)(int16_t)( ( ow_buf[ 1 ] << 8 ) | ow_buf[ 0 ] ) * 25 ) / 4;
+                ow_valid |= ( 1 << ow_sensor );
+
+                // Try again next time round if the transmit ring is full
+                if ( !sendTemperature( ow_sensor ) ) break;
+            }
+            else if ( ow_crc_errors < 255 ) {
+                ow_crc_errors++;
+            }
+
+            ow_sensor++;
+            ow_state = OW_STATE_READ_NEXT;
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// onewire_oneSecond
+//
+
+void onewire_oneSecond( void )
+{
+    uint8_t i;
+
+    for ( i = 0; i < ONEWIRE_SENSORS; i++ ) {
+        if ( ow_period_cnt[ i ] && !--ow_period_cnt[ i ] ) {
+            ow_due |= ( 1 << i );
+            ow_period_cnt[ i ] = eeprom_read( EEPROM_ONEWIRE_PERIOD + i );
+        }
+    }
+
+    // Search again while the bus is empty
+    if ( ow_enabled && !ow_count && ( OW_STATE_IDLE == ow_state ) ) {
+        if ( !--ow_search_cnt ) {
+            ow_search_cnt = ONEWIRE_SEARCH_RETRY;
+            ow_search = TRUE;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// onewire_getTemp
+//
+
+uint8_t onewire_getTemp( uint8_t idx, int16_t *ptemp )
+{
+    if ( idx >= ONEWIRE_SENSORS ) return FALSE;
+    if ( !( ow_valid & ( 1 << idx ) ) ) return FALSE;
+
+    *ptemp = ow_temp[ idx ];
+
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// onewire_readReg
+//
+
+uint8_t onewire_readReg( uint8_t reg )
+{
+    uint16_t max;
+    uint8_t idx;
+
+    if ( ( reg >= REG_ONEWIRE_PERIOD ) &&
+            ( reg < ( REG_ONEWIRE_PERIOD + ONEWIRE_SENSORS ) ) ) {
+        return eeprom_read( EEPROM_ONEWIRE_PERIOD + ( reg - REG_ONEWIRE_PERIOD ) );
+    }
+
+    if ( ( reg >= REG_ONEWIRE_ROM ) &&
+            ( reg < ( REG_ONEWIRE_ROM + ONEWIRE_SENSORS * ONEWIRE_ROM_SIZE ) ) ) {
+        idx = ( reg - REG_ONEWIRE_ROM ) / ONEWIRE_ROM_SIZE;
+        if ( idx >= ow_count ) return 0;
+        return ow_rom[ idx ][ ( reg - REG_ONEWIRE_ROM ) % ONEWIRE_ROM_SIZE ];
+    }
+
+    if ( ( reg >= REG_ONEWIRE_TEMP ) &&
+            ( reg < ( REG_ONEWIRE_TEMP + 2 * ONEWIRE_SENSORS ) ) ) {
+        idx = ( reg - REG_ONEWIRE_TEMP ) >> 1;
+        return ( ( reg - REG_ONEWIRE_TEMP ) & 1 ) ?
+                    ( ow_temp[ idx ] & 0xff ) : ( ( ow_temp[ idx ] >> 8 ) & 0xff );
+    }
+
+    switch ( reg ) {
+
+        case REG_ONEWIRE_COUNT:
+            return ow_count;
+
+        case REG_ONEWIRE_ISR_MAX:
+            INTCONbits.GIEH = 0;
+            max = ow_isr_max;
+            INTCONbits.GIEH = 1;
+            max = TIMESTAMP_TO_US( max );
+            return ( max > 255 ) ? 255 : max;
+
+        case REG_ONEWIRE_CRC_ERRORS:
+            return ow_crc_errors;
+
+        case REG_ONEWIRE_NO_PRESENCE:
+            return ow_no_presence;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// onewire_writeReg
+//
+
+uint8_t onewire_writeReg( uint8_t reg, uint8_t val )
+{
+    if ( ( reg >= REG_ONEWIRE_PERIOD ) &&
+            ( reg < ( REG_ONEWIRE_PERIOD + ONEWIRE_SENSORS ) ) ) {
+        eeprom_write( EEPROM_ONEWIRE_PERIOD + ( reg - REG_ONEWIRE_PERIOD ), val );
+        ow_period_cnt[ reg - REG_ONEWIRE_PERIOD ] = val;
+        return eeprom_read( EEPROM_ONEWIRE_PERIOD + ( reg - REG_ONEWIRE_PERIOD ) );
+    }
+
+    switch ( reg ) {
+
+        // Search again
+        case REG_ONEWIRE_COUNT:
+            ow_search = TRUE;
+            return ow_count;
+
+        // Write to clear
+        case REG_ONEWIRE_ISR_MAX:
+            INTCONbits.GIEH = 0;
+            ow_isr_max = 0;
+            INTCONbits.GIEH = 1;
+            return 0;
+
+        case REG_ONEWIRE_CRC_ERRORS:
+            ow_crc_errors = 0;
+            return 0;
+
+        case REG_ONEWIRE_NO_PRESENCE:
+            ow_no_presence = 0;
+            return 0;
+    }
+
+    return ~val;
+}
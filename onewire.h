@@ -0,0 +1,100 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_ONEWIRE_H
+#define ODESSA_ONEWIRE_H
+
+// 1-Wire master on the first pin in 1-Wire mode. The bus needs an
+// external pull-up, parasite power is not supported. Slots are timed
+// with CCP3 compare on the time stamp timer from the high priority
+// interrupt. Only the short parts of a slot, the 2.4 us low pulse and
+// the read sample, are done with the interrupt waiting for the time.
+#define ONEWIRE_SENSORS             8
+#define ONEWIRE_ROM_SIZE            8
+
+#define ONEWIRE_DEFAULT_PERIOD      30      // s
+
+// Time between ROM searches while no sensor has been found, so sensors
+// powered up or connected after the node are picked up
+#define ONEWIRE_SEARCH_RETRY        10      // s
+
+// Conversion time for 12-bit resolution (ms)
+#define ONEWIRE_CONVERT_TIME        750
+
+/*!
+    Set up 1-Wire from pin modes and start a ROM search. Call after
+    pins_init().
+*/
+void onewire_init( void );
+
+/*!
+    Write default 1-Wire configuration to EEPROM
+*/
+void onewire_init_eeprom( void );
+
+/*!
+    Conversion wait. Called from the 1 ms tick interrupt only.
+*/
+void onewire_tick( void );
+
+/*!
+    Slot timing. Called from the high priority interrupt only.
+*/
+void onewire_isr( void );
+
+/*!
+    Run ROM search and conversions and send temperature events
+*/
+void doOneWire( void );
+
+/*!
+    Count down sensor periods. Call once a second.
+*/
+void onewire_oneSecond( void );
+
+/*!
+    Get the last temperature of a sensor
+    @param idx Sensor 0-7.
+    @param ptemp Pointer to temperature in 0.01 C.
+    @return TRUE if the sensor has been read since the last ROM search.
+*/
+uint8_t onewire_getTemp( uint8_t idx, int16_t *ptemp );
+
+/*!
+    Read 1-Wire register (page REG_PAGE_ONEWIRE)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t onewire_readReg( uint8_t reg );
+
+/*!
+    Write 1-Wire register (page REG_PAGE_ONEWIRE)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t onewire_writeReg( uint8_t reg, uint8_t val );
+
+#endif
@@ -0,0 +1,315 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include "odessa.h"
+#include "pins.h"
+
+// Port for pin 3-20
+const uint8_t pin_port[ PIN_COUNT ] = {
+    PIN_PORT_C,     // Pin 3  - RC7
+    PIN_PORT_C,     // Pin 4  - RC6
+    PIN_PORT_C,     // Pin 5  - RC3
+    PIN_PORT_C,     // Pin 6  - RC4
+    PIN_PORT_C,     // Pin 7  - RC5
+    PIN_PORT_A,     // Pin 8  - RA0
+    PIN_PORT_A,     // Pin 9  - RA1
+    PIN_PORT_A,     // Pin 10 - RA2
+    PIN_PORT_A,     // Pin 11 - RA3
+    PIN_PORT_A,     // Pin 12 - RA5
+    PIN_PORT_NONE,  // Pin 13 - No connect
+    PIN_PORT_NONE,  // Pin 14 - RESET
+    PIN_PORT_B,     // Pin 15 - RB4
+    PIN_PORT_C,     // Pin 16 - RC2
+    PIN_PORT_B,     // Pin 17 - RB1
+    PIN_PORT_B,     // Pin 18 - RB0
+    PIN_PORT_B,     // Pin 19 - RB6
+    PIN_PORT_B      // Pin 20 - RB5
+};
+
+// Port bit mask for pin 3-20
+const uint8_t pin_mask[ PIN_COUNT ] = {
+    0x80,           // Pin 3  - RC7
+    0x40,           // Pin 4  - RC6
+    0x08,           // Pin 5  - RC3
+    0x10,           // Pin 6  - RC4
+    0x20,           // Pin 7  - RC5
+    0x01,           // Pin 8  - RA0
+    0x02,           // Pin 9  - RA1
+    0x04,           // Pin 10 - RA2
+    0x08,           // Pin 11 - RA3
+    0x20,           // Pin 12 - RA5
+    0x00,           // Pin 13 - No connect
+    0x00,           // Pin 14 - RESET
+    0x10,           // Pin 15 - RB4
+    0x04,           // Pin 16 - RC2
+    0x02,           // Pin 17 - RB1
+    0x01,           // Pin 18 - RB0
+    0x40,           // Pin 19 - RB6
+    0x20            // Pin 20 - RB5
+};
+
+// Modes supported by pin 3-20
+#define CAPS_IO     ( PIN_CAP( PIN_MODE_OUTPUT ) | PIN_CAP( PIN_MODE_INPUT ) | \
+                        PIN_CAP( PIN_MODE_SOFTPWM ) | PIN_CAP( PIN_MODE_ONEWIRE ) )
+
+const uint16_t pin_caps[ PIN_COUNT ] = {
+    CAPS_IO | PIN_CAP( PIN_MODE_UART ),     // Pin 3  - RC7/RX1
+    CAPS_IO | PIN_CAP( PIN_MODE_UART ),     // Pin 4  - RC6/TX1
+    CAPS_IO | PIN_CAP( PIN_MODE_I2C ) |
+        PIN_CAP( PIN_MODE_SPI ),            // Pin 5  - RC3/SCL/SCK
+    CAPS_IO | PIN_CAP( PIN_MODE_I2C ) |
+        PIN_CAP( PIN_MODE_SPI ),            // Pin 6  - RC4/SDA/SDI
+    CAPS_IO | PIN_CAP( PIN_MODE_SPI ),      // Pin 7  - RC5/SDO
+    CAPS_IO | PIN_CAP( PIN_MODE_ANALOG ),   // Pin 8  - RA0/AN0
+    CAPS_IO | PIN_CAP( PIN_MODE_ANALOG ),   // Pin 9  - RA1/AN1
+    CAPS_IO | PIN_CAP( PIN_MODE_ANALOG ),   // Pin 10 - RA2/AN2
+    CAPS_IO | PIN_CAP( PIN_MODE_ANALOG ),   // Pin 11 - RA3/AN3
+    CAPS_IO | PIN_CAP( PIN_MODE_ANALOG ),   // Pin 12 - RA5/AN4
+    0,                                      // Pin 13 - No connect
+    0,                                      // Pin 14 - RESET
+    CAPS_IO | PIN_CAP( PIN_MODE_EDGE ) |
+        PIN_CAP( PIN_MODE_PWM ),            // Pin 15 - RB4/KBI0/P1A
+    CAPS_IO | PIN_CAP( PIN_MODE_PWM ),      // Pin 16 - RC2/CCP2
+    CAPS_IO | PIN_CAP( PIN_MODE_EDGE ),     // Pin 17 - RB1/INT1
+    CAPS_IO | PIN_CAP( PIN_MODE_EDGE ),     // Pin 18 - RB0/INT0
+    CAPS_IO | PIN_CAP( PIN_MODE_EDGE ),     // Pin 19 - RB6/KBI2
+    CAPS_IO | PIN_CAP( PIN_MODE_EDGE ) |
+        PIN_CAP( PIN_MODE_COUNTER ) |
+        PIN_CAP( PIN_MODE_PWM )             // Pin 20 - RB5/KBI1/T3CKI/CCP5
+};
+
+uint8_t pin_mode[ PIN_COUNT ];
+
+
+///////////////////////////////////////////////////////////////////////////////
+// pins_init
+//
+// Read pin modes and set port directions. Pins not driven are set as
+// inputs.
+//
+
+void pins_init( void )
+{
+    uint8_t i;
+    uint8_t inputs[ PIN_PORTS ];
+    uint8_t pullups;
+
+    inputs[ PIN_PORT_A ] = 0;
+    inputs[ PIN_PORT_B ] = 0;
+    inputs[ PIN_PORT_C ] = 0;
+    pullups = 0;
+
+    for ( i = 0; i < PIN_COUNT; i++ ) {
+
+        pin_mode[ i ] = eeprom_read( EEPROM_PIN_MODE + i );
+
+        if ( PIN_PORT_NONE == pin_port[ i ] ) continue;
+
+        if ( !( PIN_DRIVEN_MODES & PIN_CAP( pin_mode[ i ] & PIN_MODE_MASK ) ) ) {
+
+            inputs[ pin_port[ i ] ] |= pin_mask[ i ];
+
+            if ( ( PIN_PORT_B == pin_port[ i ] ) &&
+                    ( pin_mode[ i ] & PIN_FLAG_PULLUP ) ) {
+                pullups |= pin_mask[ i ];
+            }
+        }
+    }
+
+    // RA4 is VCAP, RB2/RB3 is CAN and RC0 is the init. button
+    TRISA = 0x10 | inputs[ PIN_PORT_A ];
+    TRISB = 0b00001100 | inputs[ PIN_PORT_B ];
+    TRISC = 0b00000001 | inputs[ PIN_PORT_C ];
+
+    // Weak pull-ups on port B
+    WPUB = pullups;
+    INTCON2bits.RBPU = pullups ? 0 : 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pins_configure
+//
+// Set the direction and pull-up of one pin from its mode. The other
+// pins and the peripherals that set directions themselves are left
+// alone. High priority interrupts are off as the 1-Wire interrupt
+// drives its pin with TRIS.
+//
+
+void pins_configure( uint8_t pin )
+{
+    uint8_t idx;
+    uint8_t mask;
+    uint8_t bInput;
+    uint8_t gie;
+    volatile uint8_t *ptris;
+
+    if ( ( pin < PIN_FIRST ) || ( pin > PIN_LAST ) ) return;
+
+    idx = pin - PIN_FIRST;
+    if ( PIN_PORT_NONE == pin_port[ idx ] ) return;
+
+    mask = pin_mask[ idx ];
+    bInput = ( PIN_DRIVEN_MODES & PIN_CAP( pin_mode[ idx ] & PIN_MODE_MASK ) ) ?
+                FALSE : TRUE;
+
+    switch ( pin_port[ idx ] ) {
+        case PIN_PORT_A:
+            ptris = &TRISA;
+            break;
+        case PIN_PORT_B:
+            ptris = &TRISB;
+            break;
+        default:
+            ptris = &TRISC;
+            break;
+    }
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+
+    if ( bInput ) {
+        *ptris |= mask;
+    }
+    else {
+        *ptris &= ~mask;
+    }
+
+    INTCONbits.GIEH = gie;
+
+    // Weak pull-ups on port B
+    if ( PIN_PORT_B == pin_port[ idx ] ) {
+        if ( bInput && ( pin_mode[ idx ] & PIN_FLAG_PULLUP ) ) {
+            WPUB |= mask;
+        }
+        else {
+            WPUB &= ~mask;
+        }
+        INTCON2bits.RBPU = WPUB ? 0 : 1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pins_init_eeprom
+//
+
+void pins_init_eeprom( void )
+{
+    uint8_t i;
+
+    // All pins are outputs
+    for ( i = 0; i < PIN_COUNT; i++ ) {
+        eeprom_write( EEPROM_PIN_MODE + i, PIN_MODE_OUTPUT );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pins_getMode
+//
+
+uint8_t pins_getMode( uint8_t pin )
+{
+    if ( ( pin < PIN_FIRST ) || ( pin > PIN_LAST ) ) return 0xff;
+    if ( PIN_PORT_NONE == pin_port[ pin - PIN_FIRST ] ) return 0xff;
+
+    return ( pin_mode[ pin - PIN_FIRST ] & PIN_MODE_MASK );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pins_toPorts
+//
+
+void pins_toPorts( uint32_t pins, uint8_t *pports )
+{
+    uint8_t i;
+
+    pports[ PIN_PORT_A ] = 0;
+    pports[ PIN_PORT_B ] = 0;
+    pports[ PIN_PORT_C ] = 0;
+
+    for ( i = 0; i < PIN_COUNT; i++ ) {
+        if ( ( pins & 1 ) && ( PIN_PORT_NONE != pin_port[ i ] ) ) {
+            pports[ pin_port[ i ] ] |= pin_mask[ i ];
+        }
+        pins >>= 1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pins_fromPorts
+//
+
+uint32_t pins_fromPorts( uint8_t *pports )
+{
+    uint8_t i;
+    uint32_t pins = 0;
+
+    for ( i = PIN_COUNT; i > 0; i-- ) {
+        pins <<= 1;
+        if ( ( PIN_PORT_NONE != pin_port[ i - 1 ] ) &&
+                ( pports[ pin_port[ i - 1 ] ] & pin_mask[ i - 1 ] ) ) {
+            pins |= 1;
+        }
+    }
+
+    return pins;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pins_readReg
+//
+
+uint8_t pins_readReg( uint8_t reg )
+{
+    if ( reg > REG_PIN20_MODE ) return 0;
+
+    return pin_mode[ reg - REG_PIN3_MODE ];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pins_writeReg
+//
+// Caller must reconfigure I/O after a pin mode has been changed. A mode
+// the pin can't be used in is not accepted.
+//
+
+uint8_t pins_writeReg( uint8_t reg, uint8_t val )
+{
+    if ( reg > REG_PIN20_MODE ) return ~val;
+
+    if ( !( pin_caps[ reg - REG_PIN3_MODE ] &
+                PIN_CAP( val & PIN_MODE_MASK ) ) ) {
+        return ~val;
+    }
+
+    eeprom_write( EEPROM_PIN_MODE + ( reg - REG_PIN3_MODE ), val );
+    pin_mode[ reg - REG_PIN3_MODE ] =
+            eeprom_read( EEPROM_PIN_MODE + ( reg - REG_PIN3_MODE ) );
+
+    return pin_mode[ reg - REG_PIN3_MODE ];
+}
@@ -0,0 +1,134 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+#ifndef ODESSA_PINS_H
+#define ODESSA_PINS_H
+
+// Connector pins 3-20 are numbered from zero in pin bitmaps. A pin bitmap
+// has the same layout as the three control registers, bit 0 = pin 3,
+// bit 8 = pin 11, bit 16 = pin 19.
+#define PIN_FIRST                   3
+#define PIN_LAST                    20
+#define PIN_COUNT                   18
+
+#define PIN_BIT( pin )              ( (uint32_t)1 << ( (pin) - PIN_FIRST ) )
+
+// Pins 13 (no connect) and 14 (RESET) can't be used
+#define PIN_ALL_MASK                0x0003f3ffL
+
+// Ports
+#define PIN_PORT_A                  0
+#define PIN_PORT_B                  1
+#define PIN_PORT_C                  2
+#define PIN_PORT_NONE               0xff
+#define PIN_PORTS                   3
+
+// Pin modes (low nibble of the pin mode register)
+#define PIN_MODE_OUTPUT             0
+#define PIN_MODE_INPUT              1
+#define PIN_MODE_EDGE               2   // Edge capture (pin 15, 17-20)
+#define PIN_MODE_ANALOG             3   // Analog input (pin 8-12)
+#define PIN_MODE_COUNTER            4   // Pulse counter, T3CKI (pin 20)
+#define PIN_MODE_PWM                5   // Hardware PWM (pin 15, 16, 20)
+#define PIN_MODE_SOFTPWM            6   // Software PWM
+#define PIN_MODE_UART               7   // UART RX/TX (pin 3, 4)
+#define PIN_MODE_I2C                8   // I2C SCL/SDA (pin 5, 6)
+#define PIN_MODE_SPI                9   // SPI SCK/SDI/SDO (pin 5, 6, 7)
+#define PIN_MODE_ONEWIRE            10  // 1-Wire bus
+#define PIN_MODE_MASK               0x0f
+
+// Modes a pin can be used in, one bit per mode
+#define PIN_CAP( mode )             ( (uint16_t)1 << (mode) )
+
+// Modes where the pin is driven
+#define PIN_DRIVEN_MODES            ( PIN_CAP( PIN_MODE_OUTPUT ) |  \
+                                        PIN_CAP( PIN_MODE_PWM ) |     \
+                                        PIN_CAP( PIN_MODE_SOFTPWM ) )
+
+// Pin mode flags
+#define PIN_FLAG_PULLUP             0x20    // Weak pull-up (port B only)
+#define PIN_FLAG_BUTTON             0x40    // Send BUTTON instead of ON/OFF
+#define PIN_FLAG_INVERT             0x80    // Input is active low
+
+// Pin port and bit mask for pin 3-20
+extern const uint8_t pin_port[ PIN_COUNT ];
+extern const uint8_t pin_mask[ PIN_COUNT ];
+extern const uint16_t pin_caps[ PIN_COUNT ];
+
+// Pin modes (RAM copy of EEPROM)
+extern uint8_t pin_mode[ PIN_COUNT ];
+
+/*!
+    Read pin modes from EEPROM and set up port directions
+*/
+void pins_init( void );
+
+/*!
+    Set up the direction of one pin from its mode
+    @param pin Connector pin 3-20
+*/
+void pins_configure( uint8_t pin );
+
+/*!
+    Write default pin modes to EEPROM
+*/
+void pins_init_eeprom( void );
+
+/*!
+    Get the mode for a pin
+    @param pin Connector pin 3-20
+    @return Pin mode (PIN_MODE_xxx) or 0xff for invalid pin.
+*/
+uint8_t pins_getMode( uint8_t pin );
+
+/*!
+    Convert a pin bitmap to port bitmaps
+    @param pins Pin bitmap.
+    @param pports Pointer to array of PIN_PORTS port bitmaps.
+*/
+void pins_toPorts( uint32_t pins, uint8_t *pports );
+
+/*!
+    Convert port bitmaps to a pin bitmap
+    @param pports Pointer to array of PIN_PORTS port bitmaps.
+    @return Pin bitmap.
+*/
+uint32_t pins_fromPorts( uint8_t *pports );
+
+/*!
+    Read pin configuration register (page REG_PAGE_PINS)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t pins_readReg( uint8_t reg );
+
+/*!
+    Write pin configuration register (page REG_PAGE_PINS)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t pins_writeReg( uint8_t reg, uint8_t val );
+
+#endif
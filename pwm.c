@@ -0,0 +1,341 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include "odessa.h"
+#include "pins.h"
+#include "pwm.h"
+
+// Connector pin for each channel
+const uint8_t pwm_pin[ PWM_CHANNELS ] = { 15, 16, 20 };
+
+uint8_t pwm_enabled;                // Channels in use, one bit per channel
+
+// Levels are 8.8 fixed point so slow fades move smoothly
+volatile uint16_t pwm_current[ PWM_CHANNELS ];
+volatile uint16_t pwm_target[ PWM_CHANNELS ];
+uint16_t pwm_step[ PWM_CHANNELS ];  // Change per ms
+uint8_t pwm_duty[ PWM_CHANNELS ];   // Level in duty registers
+
+uint8_t pwm_dim_step;
+
+// Write 8-bit level as 10-bit duty. The two low bits repeat the top of
+// the level so 255 gives 1023, which is longer than the period of 1020
+// with PR2 = 0xfe so the output stays on.
+#define PWM_WRITE( ch, level )                                              \
+    switch ( ch ) {                                                         \
+        case 0:                                                             \
+            CCPR1L = level;                                                 \
+            CCP1CONbits.DC1B = ( level ) >> 6;                              \
+            break;                                                          \
+        case 1:                                                             \
+            CCPR2L = level;                                                 \
+            CCP2CONbits.DC2B = ( level ) >> 6;                              \
+            break;                                                          \
+        case 2:                                                             \
+            CCPR5L = level;                                                 \
+            CCP5CONbits.DC5B = ( level ) >> 6;                              \
+            break;                                                          \
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// loadFade
+//
+
+static void loadFade( uint8_t ch )
+{
+    uint16_t fade;
+
+    fade = ( (uint16_t)eeprom_read( EEPROM_PWM_FADE + 2 * ch ) << 8 ) |
+                eeprom_read( EEPROM_PWM_FADE + 2 * ch + 1 );
+
+    // Zero fade time jumps in one step
+    pwm_step[ ch ] = fade ? ( 0xff00 / fade ) : 0xff00;
+    if ( 0 == pwm_step[ ch ] ) pwm_step[ ch ] = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pwm_init
+//
+
+void pwm_init( void )
+{
+    uint8_t ch;
+    uint8_t gie;
+    uint8_t old;
+    uint8_t changed;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+
+    old = pwm_enabled;
+    pwm_enabled = 0;
+    for ( ch = 0; ch < PWM_CHANNELS; ch++ ) {
+
+        if ( PIN_MODE_PWM == pins_getMode( pwm_pin[ ch ] ) ) {
+            pwm_enabled |= ( 1 << ch );
+        }
+
+        loadFade( ch );
+
+        // A channel still in PWM mode keeps its level
+        if ( !( old & pwm_enabled & ( 1 << ch ) ) ) {
+            pwm_current[ ch ] = 0;
+            pwm_target[ ch ] = 0;
+            pwm_duty[ ch ] = 0;
+            PWM_WRITE( ch, 0 );
+        }
+    }
+
+    pwm_dim_step = eeprom_read( EEPROM_PWM_DIM_STEP );
+
+    // PWM uses Timer2
+    CCPTMRSbits.C1TSEL = 0;
+    CCPTMRSbits.C2TSEL = 0;
+    CCPTMRSbits.C5TSEL = 0;
+
+    // Modules are only written when the channel is turned on or off. A
+    // CCP2 not used for PWM may be armed for a synchronized fire.
+    changed = old ^ pwm_enabled;
+
+    // ECCP1 single output on P1A, active high
+    if ( changed & 0x01 ) {
+        CCP1CON = ( pwm_enabled & 0x01 ) ? 0b00001100 : 0;
+        PSTR1CON = 0b00000001;
+        PWM1CON = 0;
+        ECCP1AS = 0;
+    }
+
+    if ( changed & 0x02 ) {
+        CCP2CON = ( pwm_enabled & 0x02 ) ? 0b00001100 : 0;
+    }
+
+    if ( changed & 0x04 ) {
+        CCP5CON = ( pwm_enabled & 0x04 ) ? 0b00001100 : 0;
+    }
+
+    // Timer2, 1:16 prescaler, period 1020 duty steps
+    if ( ( 0 == old ) != ( 0 == pwm_enabled ) ) {
+        PR2 = 0xfe;
+        T2CON = pwm_enabled ? 0b00000110 : 0;
+    }
+
+    INTCONbits.GIEL = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pwm_init_eeprom
+//
+
+void pwm_init_eeprom( void )
+{
+    uint8_t ch;
+
+    for ( ch = 0; ch < PWM_CHANNELS; ch++ ) {
+        eeprom_write( EEPROM_PWM_FADE + 2 * ch, ( PWM_DEFAULT_FADE >> 8 ) & 0xff );
+        eeprom_write( EEPROM_PWM_FADE + 2 * ch + 1, PWM_DEFAULT_FADE & 0xff );
+    }
+
+    eeprom_write( EEPROM_PWM_DIM_STEP, PWM_DEFAULT_DIM_STEP );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pwm_tick
+//
+// Move each fading channel one step towards its target. The duty
+// registers are only written when the 8-bit level changes.
+//
+
+void pwm_tick( void )
+{
+    uint8_t ch;
+    uint8_t level;
+    uint16_t current;
+    uint16_t target;
+
+    for ( ch = 0; ch < PWM_CHANNELS; ch++ ) {
+
+        current = pwm_current[ ch ];
+        target = pwm_target[ ch ];
+        if ( current == target ) continue;
+
+        if ( current < target ) {
+            current = ( ( target - current ) > pwm_step[ ch ] ) ?
+                            ( current + pwm_step[ ch ] ) : target;
+        }
+        else {
+            current = ( ( current - target ) > pwm_step[ ch ] ) ?
+                            ( current - pwm_step[ ch ] ) : target;
+        }
+
+        pwm_current[ ch ] = current;
+
+        level = current >> 8;
+        if ( level != pwm_duty[ ch ] ) {
+            pwm_duty[ ch ] = level;
+            PWM_WRITE( ch, level );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pwm_channel
+//
+
+uint8_t pwm_channel( uint8_t pin )
+{
+    uint8_t ch;
+
+    for ( ch = 0; ch < PWM_CHANNELS; ch++ ) {
+        if ( ( pwm_pin[ ch ] == pin ) && ( pwm_enabled & ( 1 << ch ) ) ) {
+            return ch;
+        }
+    }
+
+    return PWM_NONE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pwm_setLevel
+//
+
+void pwm_setLevel( uint8_t ch, uint8_t level )
+{
+    if ( ch >= PWM_CHANNELS ) return;
+
+    INTCONbits.GIEL = 0;
+    pwm_current[ ch ] = (uint16_t)level << 8;
+    pwm_target[ ch ] = (uint16_t)level << 8;
+    pwm_duty[ ch ] = level;
+    PWM_WRITE( ch, level );
+    INTCONbits.GIEL = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pwm_getLevel
+//
+
+uint8_t pwm_getLevel( uint8_t ch )
+{
+    if ( ch >= PWM_CHANNELS ) return 0;
+
+    return pwm_target[ ch ] >> 8;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pwm_fadeTo
+//
+
+void pwm_fadeTo( uint8_t ch, uint8_t level )
+{
+    if ( ch >= PWM_CHANNELS ) return;
+
+    INTCONbits.GIEL = 0;
+    pwm_target[ ch ] = (uint16_t)level << 8;
+    INTCONbits.GIEL = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pwm_dim
+//
+
+void pwm_dim( uint8_t ch, uint8_t bUp )
+{
+    uint8_t level;
+
+    if ( ch >= PWM_CHANNELS ) return;
+
+    level = pwm_target[ ch ] >> 8;
+    if ( bUp ) {
+        level = ( level > ( 255 - pwm_dim_step ) ) ? 255 : ( level + pwm_dim_step );
+    }
+    else {
+        level = ( level < pwm_dim_step ) ? 0 : ( level - pwm_dim_step );
+    }
+
+    pwm_fadeTo( ch, level );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pwm_readReg
+//
+
+uint8_t pwm_readReg( uint8_t reg )
+{
+    uint8_t rv;
+
+    if ( reg < REG_PWM_TARGET ) {
+        INTCONbits.GIEL = 0;
+        rv = pwm_current[ reg - REG_PWM_LEVEL ] >> 8;
+        INTCONbits.GIEL = 1;
+        return rv;
+    }
+    else if ( reg < REG_PWM_FADE ) {
+        return pwm_target[ reg - REG_PWM_TARGET ] >> 8;
+    }
+    else if ( reg < REG_PWM_DIM_STEP ) {
+        return eeprom_read( EEPROM_PWM_FADE + ( reg - REG_PWM_FADE ) );
+    }
+    else if ( REG_PWM_DIM_STEP == reg ) {
+        return pwm_dim_step;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pwm_writeReg
+//
+
+uint8_t pwm_writeReg( uint8_t reg, uint8_t val )
+{
+    if ( reg < REG_PWM_TARGET ) {
+        pwm_setLevel( reg - REG_PWM_LEVEL, val );
+        return val;
+    }
+    else if ( reg < REG_PWM_FADE ) {
+        pwm_fadeTo( reg - REG_PWM_TARGET, val );
+        return val;
+    }
+    else if ( reg < REG_PWM_DIM_STEP ) {
+        eeprom_write( EEPROM_PWM_FADE + ( reg - REG_PWM_FADE ), val );
+        INTCONbits.GIEL = 0;
+        loadFade( ( reg - REG_PWM_FADE ) >> 1 );
+        INTCONbits.GIEL = 1;
+        return eeprom_read( EEPROM_PWM_FADE + ( reg - REG_PWM_FADE ) );
+    }
+    else if ( REG_PWM_DIM_STEP == reg ) {
+        eeprom_write( EEPROM_PWM_DIM_STEP, val );
+        pwm_dim_step = eeprom_read( EEPROM_PWM_DIM_STEP );
+        return pwm_dim_step;
+    }
+
+    return ~val;
+}
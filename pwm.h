@@ -0,0 +1,107 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_PWM_H
+#define ODESSA_PWM_H
+
+// Hardware PWM on ECCP1 (pin 15), CCP2 (pin 16) and CCP5 (pin 20), all
+// on Timer2. PR2 = 255 with 1:16 prescaler gives 2.44 kHz and 10-bit
+// duty. Levels are 0-255.
+#define PWM_CHANNELS                3
+#define PWM_NONE                    0xff
+
+#define PWM_DEFAULT_FADE            1000    // ms for a full 0-255 ramp
+#define PWM_DEFAULT_DIM_STEP        16
+
+// Dim step (RAM copy of EEPROM), also used for software PWM
+extern uint8_t pwm_dim_step;
+
+/*!
+    Set up PWM from pin modes. Call after pins_init().
+*/
+void pwm_init( void );
+
+/*!
+    Write default PWM configuration to EEPROM
+*/
+void pwm_init_eeprom( void );
+
+/*!
+    Advance fades. Called from the 1 ms tick interrupt only.
+*/
+void pwm_tick( void );
+
+/*!
+    Get PWM channel for a pin
+    @param pin Connector pin 3-20
+    @return Channel 0-2 or PWM_NONE if the pin is not in PWM mode.
+*/
+uint8_t pwm_channel( uint8_t pin );
+
+/*!
+    Set level at once
+    @param ch Channel 0-2
+    @param level Level 0-255
+*/
+void pwm_setLevel( uint8_t ch, uint8_t level );
+
+/*!
+    Get level, the target if a fade is running
+    @param ch Channel 0-2
+    @return Level 0-255
+*/
+uint8_t pwm_getLevel( uint8_t ch );
+
+/*!
+    Fade to a level. The speed is set by the fade time of the channel
+    which is the time for a full 0-255 ramp.
+    @param ch Channel 0-2
+    @param level Level 0-255
+*/
+void pwm_fadeTo( uint8_t ch, uint8_t level );
+
+/*!
+    Fade one dim step up or down from the current target
+    @param ch Channel 0-2
+    @param bUp TRUE to dim up, FALSE to dim down.
+*/
+void pwm_dim( uint8_t ch, uint8_t bUp );
+
+/*!
+    Read PWM register (page REG_PAGE_PWM)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t pwm_readReg( uint8_t reg );
+
+/*!
+    Write PWM register (page REG_PAGE_PWM)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t pwm_writeReg( uint8_t reg, uint8_t val );
+
+#endif
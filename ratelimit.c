@@ -0,0 +1,428 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "ratelimit.h"
+
+uint8_t ratelimit_control;
+uint8_t ratelimit_rate[ RATELIMIT_BUCKETS ];        // Events per second
+uint8_t ratelimit_burst[ RATELIMIT_BUCKETS ];       // Events
+uint32_t ratelimit_tokens[ RATELIMIT_BUCKETS ];     // 1/1000 event
+volatile uint8_t ratelimit_ms;                      // ms since last refill
+
+uint8_t ratelimit_held_type[ RATELIMIT_PINS ];      // Held event, 0 = none
+uint8_t ratelimit_held_cnt;                         // Pins with held event
+uint8_t ratelimit_next;                             // Pin to send first
+
+// Statistics
+uint16_t ratelimit_dropped[ RATELIMIT_BUCKETS ];    // No token
+uint16_t ratelimit_held;                            // Pin events held
+uint16_t ratelimit_coalesced;                       // Replaced while held
+
+
+///////////////////////////////////////////////////////////////////////////////
+// bucketOf
+//
+
+static uint8_t bucketOf( uint16_t vscpclass )
+{
+    switch ( vscpclass ) {
+
+        case VSCP_CLASS1_INFORMATION:
+            return RATELIMIT_INFORMATION;
+
+        case VSCP_CLASS1_MEASUREMENT:
+        case VSCP_CLASS1_MEASUREMENT64:
+        case VSCP_CLASS1_MEASUREZONE:
+        case VSCP_CLASS1_MEASUREMENT32:
+            return RATELIMIT_MEASUREMENT;
+
+        case VSCP_CLASS1_DATA:
+            return RATELIMIT_DATA;
+    }
+
+    return RATELIMIT_OTHER;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// capacity
+//
+
+static uint32_t capacity( uint8_t bucket )
+{
+    return (uint32_t)( ratelimit_burst[ bucket ] ? ratelimit_burst[ bucket ] : 1 ) *
+                RATELIMIT_TOKEN;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// hasToken
+//
+
+static uint8_t hasToken( uint8_t bucket )
+{
+    return ( !ratelimit_rate[ bucket ] ||
+                ( ratelimit_tokens[ bucket ] >= RATELIMIT_TOKEN ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isExempt
+//
+// Protocol events and heartbeats are never limited, a node that is
+// busy must still answer and be seen as alive.
+//
+
+static uint8_t isExempt( uint16_t vscpclass, uint8_t vscptype )
+{
+    if ( !( ratelimit_control & RATELIMIT_CONTROL_ENABLE ) ) return TRUE;
+    if ( VSCP_CLASS1_PROTOCOL == vscpclass ) return TRUE;
+
+    return ( ( VSCP_CLASS1_INFORMATION == vscpclass ) &&
+                ( VSCP_TYPE_INFORMATION_NODE_HEARTBEAT == vscptype ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pinType
+//
+// ON/OFF for an output pin from its state now. A scene or fire may
+// have switched it without an event while the event was held.
+//
+
+static uint8_t pinType( uint8_t pin, uint8_t vscptype )
+{
+    uint8_t lat;
+
+    if ( ( VSCP_TYPE_INFORMATION_ON != vscptype ) &&
+            ( VSCP_TYPE_INFORMATION_OFF != vscptype ) ) {
+        return vscptype;
+    }
+
+    if ( PIN_MODE_OUTPUT != pins_getMode( pin ) ) return vscptype;
+
+    switch ( pin_port[ pin - PIN_FIRST ] ) {
+        case PIN_PORT_A:
+            lat = LATA;
+            break;
+        case PIN_PORT_B:
+            lat = LATB;
+            break;
+        default:
+            lat = LATC;
+            break;
+    }
+
+    return ( lat & pin_mask[ pin - PIN_FIRST ] ) ?
+                VSCP_TYPE_INFORMATION_ON : VSCP_TYPE_INFORMATION_OFF;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// load
+//
+
+static void load( uint8_t bucket )
+{
+    uint16_t addr;
+
+    addr = EEPROM_RATELIMIT_BUCKETS + bucket * RATELIMIT_SIZE;
+    ratelimit_rate[ bucket ] = eeprom_read( addr + RATELIMIT_POS_RATE );
+    ratelimit_burst[ bucket ] = eeprom_read( addr + RATELIMIT_POS_BURST );
+
+    if ( ratelimit_tokens[ bucket ] > capacity( bucket ) ) {
+        ratelimit_tokens[ bucket ] = capacity( bucket );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ratelimit_init
+//
+
+void ratelimit_init( void )
+{
+    uint8_t i;
+    uint8_t gie;
+
+    ratelimit_control = eeprom_read( EEPROM_RATELIMIT_CONTROL );
+
+    for ( i = 0; i < RATELIMIT_BUCKETS; i++ ) {
+        load( i );
+        ratelimit_tokens[ i ] = capacity( i );
+        ratelimit_dropped[ i ] = 0;
+    }
+
+    for ( i = 0; i < RATELIMIT_PINS; i++ ) {
+        ratelimit_held_type[ i ] = 0;
+    }
+    ratelimit_held_cnt = 0;
+    ratelimit_next = 0;
+
+    ratelimit_held = 0;
+    ratelimit_coalesced = 0;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    ratelimit_ms = 0;
+    INTCONbits.GIEL = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ratelimit_init_eeprom
+//
+
+void ratelimit_init_eeprom( void )
+{
+    uint8_t i;
+    uint16_t addr;
+
+    eeprom_write( EEPROM_RATELIMIT_CONTROL, RATELIMIT_CONTROL_ENABLE );
+
+    for ( i = 0; i < RATELIMIT_BUCKETS; i++ ) {
+        addr = EEPROM_RATELIMIT_BUCKETS + i * RATELIMIT_SIZE;
+        eeprom_write( addr + RATELIMIT_POS_RATE, RATELIMIT_DEFAULT_RATE );
+        eeprom_write( addr + RATELIMIT_POS_BURST, RATELIMIT_DEFAULT_BURST );
+    }
+
+    addr = EEPROM_RATELIMIT_BUCKETS + RATELIMIT_GLOBAL * RATELIMIT_SIZE;
+    eeprom_write( addr + RATELIMIT_POS_RATE, RATELIMIT_DEFAULT_GLOBAL_RATE );
+    eeprom_write( addr + RATELIMIT_POS_BURST, RATELIMIT_DEFAULT_GLOBAL_BURST );
+
+    addr = EEPROM_RATELIMIT_BUCKETS + RATELIMIT_INFORMATION * RATELIMIT_SIZE;
+    eeprom_write( addr + RATELIMIT_POS_RATE, RATELIMIT_DEFAULT_INFO_RATE );
+    eeprom_write( addr + RATELIMIT_POS_BURST, RATELIMIT_DEFAULT_INFO_BURST );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ratelimit_tick
+//
+
+void ratelimit_tick( void )
+{
+    if ( ratelimit_ms < 255 ) ratelimit_ms++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doRateLimit
+//
+// A bucket gets rate tokens each ms, which is rate events per second.
+// Held pin events are sent from the pin after the last one
+// sent so a busy pin can't keep the others waiting.
+//
+
+void doRateLimit( void )
+{
+    uint8_t i;
+    uint8_t ms;
+    uint8_t type;
+
+    INTCONbits.GIEL = 0;
+    ms = ratelimit_ms;
+    ratelimit_ms = 0;
+    INTCONbits.GIEL = 1;
+
+    if ( ms ) {
+        for ( i = 0; i < RATELIMIT_BUCKETS; i++ ) {
+            ratelimit_tokens[ i ] += (uint32_t)ratelimit_rate[ i ] * ms;
+            if ( ratelimit_tokens[ i ] > capacity( i ) ) {
+                ratelimit_tokens[ i ] = capacity( i );
+            }
+        }
+    }
+
+    for ( i = 0; ( i < RATELIMIT_PINS ) && ratelimit_held_cnt; i++ ) {
+
+        if ( !ratelimit_ready( VSCP_CLASS1_INFORMATION ) ) return;
+
+        type = ratelimit_held_type[ ratelimit_next ];
+        if ( type ) {
+            ratelimit_held_type[ ratelimit_next ] = 0;
+            ratelimit_held_cnt--;
+            SendInformationEvent( ratelimit_next + PIN_FIRST,
+                                    VSCP_CLASS1_INFORMATION,
+                                    pinType( ratelimit_next + PIN_FIRST, type ) );
+        }
+
+        if ( ++ratelimit_next >= RATELIMIT_PINS ) ratelimit_next = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ratelimit_ready
+//
+
+uint8_t ratelimit_ready( uint16_t vscpclass )
+{
+    if ( isExempt( vscpclass, 0 ) ) return TRUE;
+
+    return ( hasToken( bucketOf( vscpclass ) ) && hasToken( RATELIMIT_GLOBAL ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ratelimit_take
+//
+// A refused event is counted as dropped here. Senders that keep an
+// event and try again check ratelimit_ready() first so it is not
+// counted on every try.
+//
+
+uint8_t ratelimit_take( uint16_t vscpclass, uint8_t vscptype )
+{
+    uint8_t bucket;
+
+    if ( isExempt( vscpclass, vscptype ) ) return TRUE;
+
+    bucket = bucketOf( vscpclass );
+
+    if ( !hasToken( bucket ) ) {
+        if ( ratelimit_dropped[ bucket ] < 0xffff ) ratelimit_dropped[ bucket ]++;
+        return FALSE;
+    }
+
+    if ( !hasToken( RATELIMIT_GLOBAL ) ) {
+        if ( ratelimit_dropped[ RATELIMIT_GLOBAL ] < 0xffff ) {
+            ratelimit_dropped[ RATELIMIT_GLOBAL ]++;
+        }
+        return FALSE;
+    }
+
+    if ( ratelimit_rate[ bucket ] ) {
+        ratelimit_tokens[ bucket ] -= RATELIMIT_TOKEN;
+    }
+
+    if ( ratelimit_rate[ RATELIMIT_GLOBAL ] ) {
+        ratelimit_tokens[ RATELIMIT_GLOBAL ] -= RATELIMIT_TOKEN;
+    }
+
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ratelimit_hold
+//
+// An event for a pin that already has one held is held too, so the
+// events of a pin are never sent out of order.
+//
+
+uint8_t ratelimit_hold( uint8_t pin, uint8_t vscptype )
+{
+    uint8_t idx;
+
+    idx = pin - PIN_FIRST;
+    if ( idx >= RATELIMIT_PINS ) return FALSE;
+
+    if ( ratelimit_held_type[ idx ] ) {
+        if ( ratelimit_coalesced < 0xffff ) ratelimit_coalesced++;
+    }
+    else {
+        if ( ratelimit_ready( VSCP_CLASS1_INFORMATION ) ) return FALSE;
+        ratelimit_held_cnt++;
+    }
+
+    if ( ratelimit_held < 0xffff ) ratelimit_held++;
+    ratelimit_held_type[ idx ] = vscptype;
+
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ratelimit_readReg
+//
+
+uint8_t ratelimit_readReg( uint8_t reg )
+{
+    uint16_t val;
+
+    if ( REG_RATELIMIT_CONTROL == reg ) {
+        return ratelimit_control;
+    }
+
+    if ( ( reg >= REG_RATELIMIT_BUCKETS ) &&
+            ( reg < ( REG_RATELIMIT_BUCKETS + RATELIMIT_BUCKETS * RATELIMIT_SIZE ) ) ) {
+        return eeprom_read( EEPROM_RATELIMIT_BUCKETS + reg - REG_RATELIMIT_BUCKETS );
+    }
+
+    if ( ( reg >= REG_RATELIMIT_DROPPED ) &&
+            ( reg < ( REG_RATELIMIT_DROPPED + RATELIMIT_BUCKETS * 2 ) ) ) {
+        val = ratelimit_dropped[ ( reg - REG_RATELIMIT_DROPPED ) >> 1 ];
+    }
+    else if ( ( REG_RATELIMIT_HELD == reg ) || ( ( REG_RATELIMIT_HELD + 1 ) == reg ) ) {
+        val = ratelimit_held;
+    }
+    else if ( ( REG_RATELIMIT_COALESCED == reg ) || ( ( REG_RATELIMIT_COALESCED + 1 ) == reg ) ) {
+        val = ratelimit_coalesced;
+    }
+    else if ( REG_RATELIMIT_PENDING == reg ) {
+        return ratelimit_held_cnt;
+    }
+    else {
+        return 0;
+    }
+
+    // MSB on even register
+    if ( reg & 1 ) return val & 0xff;
+    return ( val >> 8 ) & 0xff;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ratelimit_writeReg
+//
+// Writing any of the statistics registers clears them all.
+//
+
+uint8_t ratelimit_writeReg( uint8_t reg, uint8_t val )
+{
+    uint8_t i;
+
+    if ( REG_RATELIMIT_CONTROL == reg ) {
+        eeprom_write( EEPROM_RATELIMIT_CONTROL, val );
+        ratelimit_control = eeprom_read( EEPROM_RATELIMIT_CONTROL );
+        return ratelimit_control;
+    }
+
+    if ( ( reg >= REG_RATELIMIT_BUCKETS ) &&
+            ( reg < ( REG_RATELIMIT_BUCKETS + RATELIMIT_BUCKETS * RATELIMIT_SIZE ) ) ) {
+        eeprom_write( EEPROM_RATELIMIT_BUCKETS + reg - REG_RATELIMIT_BUCKETS, val );
+        load( ( reg - REG_RATELIMIT_BUCKETS ) / RATELIMIT_SIZE );
+        return ratelimit_readReg( reg );
+    }
+
+    if ( ( reg >= REG_RATELIMIT_DROPPED ) &&
+            ( reg < ( REG_RATELIMIT_COALESCED + 2 ) ) ) {
+        for ( i = 0; i < RATELIMIT_BUCKETS; i++ ) {
+            ratelimit_dropped[ i ] = 0;
+        }
+        ratelimit_held = 0;
+        ratelimit_coalesced = 0;
+        return val;
+    }
+
+    return ~val;
+}
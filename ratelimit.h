@@ -0,0 +1,125 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_RATELIMIT_H
+#define ODESSA_RATELIMIT_H
+
+// Rate limit for events sent by the module. Each event takes a token
+// from the bucket of its class and from the global bucket. Buckets fill
+// at a set rate up to a burst size, so a chattering input or a bad
+// decision matrix can't take more than a set share of the bus. Protocol
+// events and heartbeats are never limited. ON/OFF events for a pin are held when the
+// limit is reached and the last state of the pin is sent later.
+#define RATELIMIT_GLOBAL            0
+#define RATELIMIT_INFORMATION       1
+#define RATELIMIT_MEASUREMENT       2   // All measurement classes
+#define RATELIMIT_DATA              3
+#define RATELIMIT_OTHER             4
+#define RATELIMIT_BUCKETS           5
+
+#define RATELIMIT_POS_RATE          0   // Events per second, 0 = no limit
+#define RATELIMIT_POS_BURST         1   // Events
+#define RATELIMIT_SIZE              2   // EEPROM bytes per bucket
+
+// Control register
+#define RATELIMIT_CONTROL_ENABLE    0x01
+
+// Tokens are kept in 1/1000 event so a bucket fills with its rate each ms
+#define RATELIMIT_TOKEN             1000
+
+// Pins with held ON/OFF events, pin 3-20 and extender pins
+#define RATELIMIT_PINS              50
+
+// About 10% of a 125 kbps bus
+#define RATELIMIT_DEFAULT_GLOBAL_RATE   100
+#define RATELIMIT_DEFAULT_GLOBAL_BURST  60
+#define RATELIMIT_DEFAULT_INFO_RATE     50
+#define RATELIMIT_DEFAULT_INFO_BURST    30
+#define RATELIMIT_DEFAULT_RATE          20
+#define RATELIMIT_DEFAULT_BURST         20
+
+/*!
+    Load rate limits from EEPROM and fill the buckets
+*/
+void ratelimit_init( void );
+
+/*!
+    Write default rate limits to EEPROM
+*/
+void ratelimit_init_eeprom( void );
+
+/*!
+    Count ms for bucket refill. Called from the 1 ms tick interrupt only.
+*/
+void ratelimit_tick( void );
+
+/*!
+    Fill the buckets and send held pin events there is room for
+*/
+void doRateLimit( void );
+
+/*!
+    Check if there is a token for an event without taking it. Used by
+    senders that keep an event and try again later.
+    @param vscpclass Class of the event.
+    @return TRUE if an event of the class can be sent now.
+*/
+uint8_t ratelimit_ready( uint16_t vscpclass );
+
+/*!
+    Take a token for an event. Counts the event as dropped if there is
+    no token.
+    @param vscpclass Class of the event.
+    @param vscptype Type of the event.
+    @return TRUE if the event can be sent.
+*/
+uint8_t ratelimit_take( uint16_t vscpclass, uint8_t vscptype );
+
+/*!
+    Hold an ON/OFF event for a pin if the limit is reached or an event
+    is already held for the pin. A held event replaces the one held
+    before.
+    @param pin Pin 3-52.
+    @param vscptype Event type.
+    @return TRUE if the event was held and must not be sent now.
+*/
+uint8_t ratelimit_hold( uint8_t pin, uint8_t vscptype );
+
+/*!
+    Read rate limit register (page REG_PAGE_RATELIMIT)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t ratelimit_readReg( uint8_t reg );
+
+/*!
+    Write rate limit register (page REG_PAGE_RATELIMIT)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t ratelimit_writeReg( uint8_t reg, uint8_t val );
+
+#endif
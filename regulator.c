@@ -0,0 +1,672 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "adc.h"
+#include "onewire.h"
+#include "pwm.h"
+#include "softpwm.h"
+#include "regulator.h"
+
+// Data coding for the report, integer format, unit 1 and the channel
+// as index
+#define REGULATOR_CODING            0x68
+
+// Measurement data coding formats
+#define CODING_FORMAT_MASK          0xe0
+#define CODING_FORMAT_INTEGER       0x60
+#define CODING_FORMAT_NORMALIZED    0x80
+
+// Decimals of the value for a source
+#define DECIMALS( ch )  ( ( REGULATOR_SOURCE_ADC == regulator_channel[ ch ].source ) ? 3 : 2 )
+
+// Channel configuration (RAM copy of EEPROM)
+regulator_channel_t regulator_channel[ REGULATOR_CHANNELS ];
+
+int16_t regulator_value[ REGULATOR_CHANNELS ];      // Last value
+uint8_t regulator_valid;                            // Value seen, bit per channel
+uint16_t regulator_age[ REGULATOR_CHANNELS ];       // s since event value
+int32_t regulator_integral[ REGULATOR_CHANNELS ];   // 0.01 %
+uint16_t regulator_out[ REGULATOR_CHANNELS ];       // 0.01 %
+uint8_t regulator_on;                               // Output pin on, bit per channel
+uint8_t regulator_changed;                          // Report due, bit per channel
+uint8_t regulator_due[ REGULATOR_CHANNELS ];        // 100 ms periods to next run
+uint8_t regulator_report_cnt[ REGULATOR_CHANNELS ];
+uint8_t regulator_phase;                            // In time proportioning window
+volatile uint8_t regulator_ms;                      // ms since last 100 ms period
+
+
+///////////////////////////////////////////////////////////////////////////////
+// load
+//
+
+static void load( uint8_t ch )
+{
+    uint16_t addr;
+    regulator_channel_t *pch;
+
+    addr = EEPROM_REGULATOR_CHANNELS + ch * REGULATOR_SIZE;
+    pch = &regulator_channel[ ch ];
+
+    pch->source = eeprom_read( addr + REGULATOR_POS_SOURCE );
+    pch->index = eeprom_read( addr + REGULATOR_POS_INDEX );
+    pch->nickname = eeprom_read( addr + REGULATOR_POS_NICKNAME );
+    pch->type = eeprom_read( addr + REGULATOR_POS_TYPE );
+    pch->output = eeprom_read( addr + REGULATOR_POS_OUTPUT );
+    pch->flags = eeprom_read( addr + REGULATOR_POS_FLAGS );
+    pch->setpoint = ( (uint16_t)eeprom_read( addr + REGULATOR_POS_SETPOINT ) << 8 ) |
+                        eeprom_read( addr + REGULATOR_POS_SETPOINT + 1 );
+    pch->hysteresis = ( (uint16_t)eeprom_read( addr + REGULATOR_POS_HYSTERESIS ) << 8 ) |
+                        eeprom_read( addr + REGULATOR_POS_HYSTERESIS + 1 );
+    pch->kp = ( (uint16_t)eeprom_read( addr + REGULATOR_POS_KP ) << 8 ) |
+                        eeprom_read( addr + REGULATOR_POS_KP + 1 );
+    pch->ki = ( (uint16_t)eeprom_read( addr + REGULATOR_POS_KI ) << 8 ) |
+                        eeprom_read( addr + REGULATOR_POS_KI + 1 );
+    pch->period = eeprom_read( addr + REGULATOR_POS_PERIOD );
+    pch->report = eeprom_read( addr + REGULATOR_POS_REPORT );
+
+    if ( pch->source > REGULATOR_SOURCE_EVENT ) {
+        pch->source = REGULATOR_SOURCE_NONE;
+    }
+
+    regulator_valid &= ~( 1 << ch );
+    regulator_age[ ch ] = 0;
+    regulator_due[ ch ] = 1;
+    regulator_report_cnt[ ch ] = pch->report;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setDigital
+//
+// Switch an output pin only when it changes so the ON/OFF events are
+// only sent then. Goes through actionSet() so interlock groups hold.
+//
+
+static void setDigital( uint8_t ch, uint8_t bOn )
+{
+    uint8_t bit;
+
+    bit = ( 1 << ch );
+    if ( ( ( regulator_on & bit ) ? TRUE : FALSE ) == bOn ) return;
+
+    if ( bOn ) {
+        regulator_on |= bit;
+        actionSet( 0, regulator_channel[ ch ].output );
+    }
+    else {
+        regulator_on &= ~bit;
+        actionClr( 0, regulator_channel[ ch ].output );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// drive
+//
+// Set the output. A PWM pin gets the level, an output pin is switched
+// by time proportioning over REGULATOR_WINDOW periods, which for
+// on/off control is just on or off.
+//
+
+static void drive( uint8_t ch )
+{
+    uint8_t pin;
+    uint8_t level;
+
+    pin = regulator_channel[ ch ].output;
+    level = ( (uint32_t)regulator_out[ ch ] * 255 + REGULATOR_FULL / 2 ) / REGULATOR_FULL;
+
+    switch ( pins_getMode( pin ) ) {
+
+        case PIN_MODE_OUTPUT:
+            setDigital( ch, ( regulator_out[ ch ] >
+                        (uint16_t)regulator_phase * ( REGULATOR_FULL / REGULATOR_WINDOW ) ) );
+            break;
+
+        case PIN_MODE_PWM:
+            if ( pwm_getLevel( pwm_channel( pin ) ) != level ) {
+                pwm_setLevel( pwm_channel( pin ), level );
+            }
+            break;
+
+        case PIN_MODE_SOFTPWM:
+            if ( softpwm_getLevel( pin ) != level ) {
+                softpwm_setLevel( pin, level );
+            }
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// release
+//
+// Turn the output of a channel off before it is reconfigured.
+//
+
+static void release( uint8_t ch )
+{
+    regulator_out[ ch ] = 0;
+    drive( ch );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sample
+//
+// Get the value of the source. FALSE if there is none, the output is
+// then turned off.
+//
+
+static uint8_t sample( uint8_t ch )
+{
+    uint16_t mv;
+    int16_t temp;
+    regulator_channel_t *pch;
+
+    pch = &regulator_channel[ ch ];
+
+    switch ( pch->source ) {
+
+        case REGULATOR_SOURCE_ADC:
+            if ( !adc_getMillivolts( pch->index, &mv ) ) return FALSE;
+            regulator_value[ ch ] = ( mv > 32767 ) ? 32767 : mv;
+            break;
+
+        case REGULATOR_SOURCE_ONEWIRE:
+            if ( !onewire_getTemp( pch->index, &temp ) ) return FALSE;
+            regulator_value[ ch ] = temp;
+            break;
+
+        case REGULATOR_SOURCE_EVENT:
+            if ( !( regulator_valid & ( 1 << ch ) ) ) return FALSE;
+            if ( regulator_age[ ch ] >= REGULATOR_EVENT_TIMEOUT ) return FALSE;
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+
+    regulator_valid |= ( 1 << ch );
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// control
+//
+// Run the control law once. PI is P + I with the integral kept within
+// the output range, so it does not wind up while the output is at a
+// limit.
+//
+
+static void control( uint8_t ch )
+{
+    int32_t err;
+    int32_t out;
+    uint16_t old;
+    regulator_channel_t *pch;
+
+    pch = &regulator_channel[ ch ];
+    old = ( regulator_out[ ch ] + 50 ) / 100;
+
+    if ( !sample( ch ) ) {
+        regulator_out[ ch ] = 0;
+    }
+    else {
+
+        err = (int32_t)pch->setpoint - regulator_value[ ch ];
+        if ( pch->flags & REGULATOR_FLAG_REVERSE ) err = -err;
+
+        // Error is clamped so the products fit 32 bits
+        if ( err > 32767 ) err = 32767;
+        else if ( err < -32767 ) err = -32767;
+
+        if ( pch->flags & REGULATOR_FLAG_PI ) {
+
+            regulator_integral[ ch ] += ( (int32_t)pch->ki * err ) / 256;
+            if ( regulator_integral[ ch ] < 0 ) {
+                regulator_integral[ ch ] = 0;
+            }
+            else if ( regulator_integral[ ch ] > REGULATOR_FULL ) {
+                regulator_integral[ ch ] = REGULATOR_FULL;
+            }
+
+            out = ( (int32_t)pch->kp * err ) / 256 + regulator_integral[ ch ];
+            if ( out < 0 ) out = 0;
+            else if ( out > REGULATOR_FULL ) out = REGULATOR_FULL;
+
+            regulator_out[ ch ] = out;
+        }
+        else if ( err > (int32_t)pch->hysteresis ) {
+            regulator_out[ ch ] = REGULATOR_FULL;
+        }
+        else if ( err < -(int32_t)pch->hysteresis ) {
+            regulator_out[ ch ] = 0;
+        }
+    }
+
+    if ( ( ( regulator_out[ ch ] + 50 ) / 100 ) != old ) {
+        regulator_changed |= ( 1 << ch );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// report
+//
+
+static void report( uint8_t ch )
+{
+    uint8_t data[ 6 ];
+
+    data[ 0 ] = REGULATOR_CODING | ch;
+    data[ 1 ] = ( regulator_channel[ ch ].setpoint >> 8 ) & 0xff;
+    data[ 2 ] = regulator_channel[ ch ].setpoint & 0xff;
+    data[ 3 ] = ( regulator_value[ ch ] >> 8 ) & 0xff;
+    data[ 4 ] = regulator_value[ ch ] & 0xff;
+    data[ 5 ] = ( regulator_out[ ch ] + 50 ) / 100;
+
+    sendVSCPFrame( VSCP_CLASS1_DATA,
+                    VSCP_TYPE_DATA_IO,
+                    vscp_nickname,
+                    VSCP_PRIORITY_MEDIUM,
+                    6,
+                    data );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// decode
+//
+// Value of measurement data in integer or normalized integer coding,
+// scaled to the given number of decimals. An integer value is in whole
+// units.
+//
+
+static uint8_t decode( uint8_t *pdata, uint8_t size, uint8_t decimals,
+                            int16_t *pvalue )
+{
+    uint8_t i;
+    uint8_t first;
+    int8_t shift;
+    int32_t value;
+
+    if ( size < 2 ) return FALSE;
+
+    switch ( pdata[ 0 ] & CODING_FORMAT_MASK ) {
+
+        case CODING_FORMAT_INTEGER:
+            first = 1;
+            shift = decimals;
+            break;
+
+        case CODING_FORMAT_NORMALIZED:
+            if ( size < 3 ) return FALSE;
+            first = 2;
+            shift = pdata[ 1 ] & 0x1f;
+            shift = ( pdata[ 1 ] & 0x80 ) ? decimals - shift : decimals + shift;
+            break;
+
+        default:
+            return FALSE;
+    }
+
+    // At most 32 bits
+    if ( ( size - first ) > 4 ) return FALSE;
+
+    value = ( pdata[ first ] & 0x80 ) ? -1 : 0;
+    for ( i = first; i < size; i++ ) {
+        value = value * 256 + pdata[ i ];
+    }
+
+    for ( ; shift < 0; shift++ ) {
+        value /= 10;
+    }
+
+    for ( ; ( shift > 0 ) && ( value < 32768 ) && ( value > -32768 ); shift-- ) {
+        value *= 10;
+    }
+
+    if ( value > 32767 ) value = 32767;
+    else if ( value < -32768 ) value = -32768;
+
+    *pvalue = value;
+
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restart
+//
+// Turn the output of a channel off and load it again. The output goes
+// off under the old configuration. An output pin that has left output
+// mode is still on in LAT and can't be switched with actionClr(), so
+// it is cleared here.
+//
+
+static void restart( uint8_t ch )
+{
+    uint8_t gie;
+    uint8_t pin;
+
+    release( ch );
+
+    pin = regulator_channel[ ch ].output;
+    if ( ( regulator_on & ( 1 << ch ) ) &&
+            ( pin >= PIN_FIRST ) && ( pin <= PIN_LAST ) ) {
+
+        gie = INTCONbits.GIEH;
+        INTCONbits.GIEH = 0;
+        switch ( pin_port[ pin - PIN_FIRST ] ) {
+            case PIN_PORT_A:
+                LATA &= ~pin_mask[ pin - PIN_FIRST ];
+                break;
+            case PIN_PORT_B:
+                LATB &= ~pin_mask[ pin - PIN_FIRST ];
+                break;
+            case PIN_PORT_C:
+                LATC &= ~pin_mask[ pin - PIN_FIRST ];
+                break;
+        }
+        INTCONbits.GIEH = gie;
+    }
+
+    regulator_on &= ~( 1 << ch );
+    regulator_changed &= ~( 1 << ch );
+
+    load( ch );
+    regulator_value[ ch ] = 0;
+    regulator_integral[ ch ] = 0;
+    regulator_out[ ch ] = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// regulator_init
+//
+
+void regulator_init( void )
+{
+    uint8_t i;
+    uint8_t gie;
+
+    for ( i = 0; i < REGULATOR_CHANNELS; i++ ) {
+        restart( i );
+    }
+
+    regulator_phase = 0;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    regulator_ms = 0;
+    INTCONbits.GIEL = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// regulator_pinChanged
+//
+
+void regulator_pinChanged( uint8_t pin )
+{
+    uint8_t i;
+
+    for ( i = 0; i < REGULATOR_CHANNELS; i++ ) {
+        if ( pin == regulator_channel[ i ].output ) {
+            restart( i );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// regulator_init_eeprom
+//
+
+void regulator_init_eeprom( void )
+{
+    uint8_t i;
+    uint8_t j;
+    uint16_t addr;
+
+    for ( i = 0; i < REGULATOR_CHANNELS; i++ ) {
+
+        addr = EEPROM_REGULATOR_CHANNELS + i * REGULATOR_SIZE;
+
+        for ( j = 0; j < REGULATOR_SIZE; j++ ) {
+            eeprom_write( addr + j, 0 );
+        }
+
+        eeprom_write( addr + REGULATOR_POS_NICKNAME, 0xff );
+        eeprom_write( addr + REGULATOR_POS_HYSTERESIS, REGULATOR_DEFAULT_HYSTERESIS >> 8 );
+        eeprom_write( addr + REGULATOR_POS_HYSTERESIS + 1, REGULATOR_DEFAULT_HYSTERESIS & 0xff );
+        eeprom_write( addr + REGULATOR_POS_KP, REGULATOR_DEFAULT_KP >> 8 );
+        eeprom_write( addr + REGULATOR_POS_KP + 1, REGULATOR_DEFAULT_KP & 0xff );
+        eeprom_write( addr + REGULATOR_POS_KI, REGULATOR_DEFAULT_KI >> 8 );
+        eeprom_write( addr + REGULATOR_POS_KI + 1, REGULATOR_DEFAULT_KI & 0xff );
+        eeprom_write( addr + REGULATOR_POS_PERIOD, REGULATOR_DEFAULT_PERIOD );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// regulator_tick
+//
+
+void regulator_tick( void )
+{
+    if ( regulator_ms < 255 ) regulator_ms++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// regulator_event
+//
+
+void regulator_event( void )
+{
+    uint8_t ch;
+    uint8_t size;
+    regulator_channel_t *pch;
+
+    if ( VSCP_CLASS1_MEASUREMENT != vscp_imsg.vscp_class ) return;
+
+    size = vscp_imsg.flags & 0x0f;
+    if ( !size ) return;
+
+    for ( ch = 0; ch < REGULATOR_CHANNELS; ch++ ) {
+
+        pch = &regulator_channel[ ch ];
+
+        if ( REGULATOR_SOURCE_EVENT != pch->source ) continue;
+        if ( pch->type != vscp_imsg.vscp_type ) continue;
+        if ( ( 0xff != pch->nickname ) && ( pch->nickname != vscp_imsg.oaddr ) ) continue;
+        if ( ( vscp_imsg.data[ 0 ] & 0x07 ) != pch->index ) continue;
+
+        if ( decode( vscp_imsg.data, size, 2, &regulator_value[ ch ] ) ) {
+            regulator_valid |= ( 1 << ch );
+            regulator_age[ ch ] = 0;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doRegulator
+//
+
+void doRegulator( void )
+{
+    uint8_t ch;
+    uint8_t gie;
+    uint8_t bDue;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    bDue = ( regulator_ms >= 100 ) ? TRUE : FALSE;
+    if ( bDue ) regulator_ms -= 100;
+    INTCONbits.GIEL = gie;
+
+    if ( !bDue ) return;
+
+    if ( ++regulator_phase >= REGULATOR_WINDOW ) {
+        regulator_phase = 0;
+    }
+
+    for ( ch = 0; ch < REGULATOR_CHANNELS; ch++ ) {
+
+        if ( REGULATOR_SOURCE_NONE == regulator_channel[ ch ].source ) continue;
+
+        if ( regulator_due[ ch ] > 1 ) {
+            regulator_due[ ch ]--;
+        }
+        else {
+            regulator_due[ ch ] = regulator_channel[ ch ].period;
+            control( ch );
+        }
+
+        drive( ch );
+
+        if ( regulator_changed & ( 1 << ch ) ) {
+            regulator_changed &= ~( 1 << ch );
+            regulator_report_cnt[ ch ] = regulator_channel[ ch ].report;
+            report( ch );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// regulator_oneSecond
+//
+
+void regulator_oneSecond( void )
+{
+    uint8_t ch;
+
+    for ( ch = 0; ch < REGULATOR_CHANNELS; ch++ ) {
+
+        if ( REGULATOR_SOURCE_NONE == regulator_channel[ ch ].source ) continue;
+
+        if ( regulator_age[ ch ] < 0xffff ) regulator_age[ ch ]++;
+
+        if ( regulator_report_cnt[ ch ] && !--regulator_report_cnt[ ch ] ) {
+            regulator_changed |= ( 1 << ch );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// regulator_setpointEvent
+//
+// The setpoint is kept in RAM only, a thermostat sending it often would
+// wear out the EEPROM. The stored setpoint is used again after a reset.
+//
+
+void regulator_setpointEvent( uint8_t ch )
+{
+    int16_t setpoint;
+
+    if ( ch >= REGULATOR_CHANNELS ) return;
+
+    if ( !decode( vscp_imsg.data, vscp_imsg.flags & 0x0f, DECIMALS( ch ),
+                    &setpoint ) ) {
+        return;
+    }
+
+    if ( setpoint == regulator_channel[ ch ].setpoint ) return;
+
+    regulator_channel[ ch ].setpoint = setpoint;
+    regulator_changed |= ( 1 << ch );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// regulator_readReg
+//
+
+uint8_t regulator_readReg( uint8_t reg )
+{
+    uint8_t ch;
+
+    if ( reg < ( REG_REGULATOR_CHANNELS + REGULATOR_CHANNELS * REGULATOR_SIZE ) ) {
+        return eeprom_read( EEPROM_REGULATOR_CHANNELS + reg - REG_REGULATOR_CHANNELS );
+    }
+
+    if ( ( reg >= REG_REGULATOR_VALUE ) &&
+            ( reg < ( REG_REGULATOR_VALUE + REGULATOR_CHANNELS * 2 ) ) ) {
+        ch = ( reg - REG_REGULATOR_VALUE ) >> 1;
+        if ( reg & 1 ) return regulator_value[ ch ] & 0xff;
+        return ( regulator_value[ ch ] >> 8 ) & 0xff;
+    }
+
+    if ( ( reg >= REG_REGULATOR_OUTPUT ) &&
+            ( reg < ( REG_REGULATOR_OUTPUT + REGULATOR_CHANNELS ) ) ) {
+        return ( regulator_out[ reg - REG_REGULATOR_OUTPUT ] + 50 ) / 100;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// regulator_writeReg
+//
+// The output is turned off while the channel is reconfigured, the
+// control law picks it up again on the next period.
+//
+
+uint8_t regulator_writeReg( uint8_t reg, uint8_t val )
+{
+    uint8_t ch;
+    uint8_t pos;
+    int16_t setpoint;
+
+    if ( reg < ( REG_REGULATOR_CHANNELS + REGULATOR_CHANNELS * REGULATOR_SIZE ) ) {
+
+        ch = ( reg - REG_REGULATOR_CHANNELS ) / REGULATOR_SIZE;
+        pos = ( reg - REG_REGULATOR_CHANNELS ) % REGULATOR_SIZE;
+
+        switch ( pos ) {
+
+            case REGULATOR_POS_SOURCE:
+            case REGULATOR_POS_INDEX:
+            case REGULATOR_POS_OUTPUT:
+            case REGULATOR_POS_FLAGS:
+                release( ch );
+                regulator_integral[ ch ] = 0;
+                break;
+        }
+
+        // A setpoint from an event stays unless the setpoint is written
+        setpoint = regulator_channel[ ch ].setpoint;
+        eeprom_write( EEPROM_REGULATOR_CHANNELS + reg - REG_REGULATOR_CHANNELS, val );
+        load( ch );
+        if ( ( REGULATOR_POS_SETPOINT != pos ) &&
+                ( ( REGULATOR_POS_SETPOINT + 1 ) != pos ) ) {
+            regulator_channel[ ch ].setpoint = setpoint;
+        }
+        regulator_changed |= ( 1 << ch );
+
+        return regulator_readReg( reg );
+    }
+
+    return ~val;
+}
@@ -0,0 +1,152 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_REGULATOR_H
+#define ODESSA_REGULATOR_H
+
+// Regulator channels. Each channel reads a value from a local ADC
+// channel, a 1-Wire sensor or a measurement event from another node and
+// drives an output pin on/off with hysteresis or a PWM level from a PI
+// controller. The loop runs locally so it keeps working without a host.
+#define REGULATOR_CHANNELS          4
+#define REGULATOR_SIZE              16  // EEPROM bytes per channel
+
+#define REGULATOR_POS_SOURCE        0   // REGULATOR_SOURCE_xxx
+#define REGULATOR_POS_INDEX         1   // ADC channel, sensor or sensor index
+#define REGULATOR_POS_NICKNAME      2   // Sender of event, 0xff = any
+#define REGULATOR_POS_TYPE          3   // CLASS1.MEASUREMENT type of event
+#define REGULATOR_POS_OUTPUT        4   // Pin 3-20, 0 = none
+#define REGULATOR_POS_FLAGS         5
+#define REGULATOR_POS_SETPOINT      6   // Signed, MSB first
+#define REGULATOR_POS_HYSTERESIS    8   // MSB first
+#define REGULATOR_POS_KP            10  // 1/256 0.01 % per unit, MSB first
+#define REGULATOR_POS_KI            12  // 1/256 0.01 % per unit and period
+#define REGULATOR_POS_PERIOD        14  // Control period (100 ms)
+#define REGULATOR_POS_REPORT        15  // Report period (s), 0 = on change
+
+// Sources. Values are in mV for an ADC channel and in 0.01 of the unit
+// for a 1-Wire sensor and for events.
+#define REGULATOR_SOURCE_NONE       0
+#define REGULATOR_SOURCE_ADC        1
+#define REGULATOR_SOURCE_ONEWIRE    2
+#define REGULATOR_SOURCE_EVENT      3
+
+// Flags
+#define REGULATOR_FLAG_PI           0x01    // PI, else on/off with hysteresis
+#define REGULATOR_FLAG_REVERSE      0x02    // Output up when value is high
+
+#define REGULATOR_DEFAULT_PERIOD    10      // 1 s
+
+// Output in 0.01 %
+#define REGULATOR_FULL              10000
+
+// Time proportioning window for PI on an on/off output (100 ms)
+#define REGULATOR_WINDOW            100
+
+// Output off when no event value has been received for this long (s)
+#define REGULATOR_EVENT_TIMEOUT     300
+
+#define REGULATOR_DEFAULT_HYSTERESIS    50      // 0.5 C
+#define REGULATOR_DEFAULT_KP            2560    // 10 % per C
+#define REGULATOR_DEFAULT_KI            26      // 0.1 % per C and period
+
+// Channel configuration (RAM copy of EEPROM)
+typedef struct {
+    uint8_t source;
+    uint8_t index;
+    uint8_t nickname;
+    uint8_t type;
+    uint8_t output;
+    uint8_t flags;
+    int16_t setpoint;
+    uint16_t hysteresis;
+    uint16_t kp;
+    uint16_t ki;
+    uint8_t period;                 // 100 ms
+    uint8_t report;                 // Seconds, 0 = on change only
+} regulator_channel_t;
+
+/*!
+    Load regulator channels from EEPROM. Call after pins_init().
+*/
+void regulator_init( void );
+
+/*!
+    Write default regulator configuration to EEPROM, no channels
+*/
+void regulator_init_eeprom( void );
+
+/*!
+    Restart the channels that drive a pin after its mode has changed.
+    Other channels keep running.
+    @param pin Connector pin 3-20
+*/
+void regulator_pinChanged( uint8_t pin );
+
+/*!
+    Count ms for the control period. Called from the 1 ms tick
+    interrupt only.
+*/
+void regulator_tick( void );
+
+/*!
+    Take the value of an event source from vscp_imsg
+*/
+void regulator_event( void );
+
+/*!
+    Run the control law of channels that are due
+*/
+void doRegulator( void );
+
+/*!
+    Count down report periods and event timeouts. Call once a second.
+*/
+void regulator_oneSecond( void );
+
+/*!
+    Set the setpoint of a channel from the data of vscp_imsg. Integer
+    and normalized integer coding are scaled to the unit of the channel
+    source.
+    @param ch Channel 0-3
+*/
+void regulator_setpointEvent( uint8_t ch );
+
+/*!
+    Read regulator register (page REG_PAGE_REGULATOR)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t regulator_readReg( uint8_t reg );
+
+/*!
+    Write regulator register (page REG_PAGE_REGULATOR)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t regulator_writeReg( uint8_t reg, uint8_t val );
+
+#endif
@@ -0,0 +1,688 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include "odessa.h"
+#include "pins.h"
+#include "inputs.h"
+#include "pwm.h"
+#include "softpwm.h"
+#include "scene.h"
+#include "translate.h"
+#include "rules.h"
+
+// Rule code and table (RAM copy of EEPROM)
+uint8_t rules_code[ RULES_CODE_SIZE ];
+uint8_t rules_start[ RULES_COUNT ];
+uint8_t rules_trigger[ RULES_COUNT ];
+uint8_t rules_period[ RULES_COUNT ];    // 100 ms
+
+uint8_t rules_due[ RULES_COUNT ];       // 100 ms periods to next run
+volatile uint8_t rules_ms;              // ms since last 100 ms period
+
+int16_t rules_var[ RULES_VARS ];
+uint16_t rules_timer[ RULES_TIMERS ];   // Seconds left
+
+// Statistics
+uint16_t rules_runs[ RULES_COUNT ];
+uint8_t rules_steps_last[ RULES_COUNT ];
+uint8_t rules_steps_max[ RULES_COUNT ];
+uint16_t rules_time_max[ RULES_COUNT ]; // Longest run (ticks)
+uint8_t rules_aborts[ RULES_COUNT ];
+uint16_t rules_pass_max;                // Longest pass over all rules (ticks)
+uint8_t rules_error;                    // Reason last rule was stopped
+uint8_t rules_error_rule;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// rules_init
+//
+
+void rules_init( void )
+{
+    uint8_t i;
+    uint8_t gie;
+
+    for ( i = 0; i < RULES_CODE_SIZE; i++ ) {
+        rules_code[ i ] = eeprom_read( EEPROM_RULE_CODE + i );
+    }
+
+    for ( i = 0; i < RULES_COUNT; i++ ) {
+        rules_start[ i ] = eeprom_read( EEPROM_RULE_TABLE + i * 3 );
+        rules_trigger[ i ] = eeprom_read( EEPROM_RULE_TABLE + i * 3 + 1 );
+        rules_period[ i ] = eeprom_read( EEPROM_RULE_TABLE + i * 3 + 2 );
+        rules_due[ i ] = rules_period[ i ];
+        rules_runs[ i ] = 0;
+        rules_steps_last[ i ] = 0;
+        rules_steps_max[ i ] = 0;
+        rules_time_max[ i ] = 0;
+        rules_aborts[ i ] = 0;
+    }
+
+    for ( i = 0; i < RULES_VARS; i++ ) {
+        rules_var[ i ] = 0;
+    }
+
+    for ( i = 0; i < RULES_TIMERS; i++ ) {
+        rules_timer[ i ] = 0;
+    }
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    rules_ms = 0;
+    INTCONbits.GIEL = gie;
+
+    rules_pass_max = 0;
+    rules_error = RULES_ERR_NONE;
+    rules_error_rule = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rules_init_eeprom
+//
+
+void rules_init_eeprom( void )
+{
+    uint8_t i;
+
+    for ( i = 0; i < RULES_CODE_SIZE; i++ ) {
+        eeprom_write( EEPROM_RULE_CODE + i, RULE_OP_END );
+    }
+
+    for ( i = 0; i < RULES_COUNT * 3; i++ ) {
+        eeprom_write( EEPROM_RULE_TABLE + i, 0 );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rules_tick
+//
+
+void rules_tick( void )
+{
+    if ( rules_ms < 255 ) rules_ms++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pinState
+//
+// State of a pin as seen by a rule. Inputs are debounced, outputs are
+// read from the latch and a PWM pin is on at any level above zero.
+//
+
+static uint8_t pinState( uint8_t pin )
+{
+    uint8_t port;
+
+    switch ( pins_getMode( pin ) ) {
+
+        case 0xff:
+            return 0;
+
+        case PIN_MODE_INPUT:
+            return inputs_getState( pin );
+
+        case PIN_MODE_PWM:
+            return pwm_getLevel( pwm_channel( pin ) ) ? 1 : 0;
+
+        case PIN_MODE_SOFTPWM:
+            return softpwm_getLevel( pin ) ? 1 : 0;
+
+        case PIN_MODE_OUTPUT:
+            if ( PIN_PORT_A == pin_port[ pin - PIN_FIRST ] ) port = LATA;
+            else if ( PIN_PORT_B == pin_port[ pin - PIN_FIRST ] ) port = LATB;
+            else port = LATC;
+            break;
+
+        default:
+            if ( PIN_PORT_A == pin_port[ pin - PIN_FIRST ] ) port = PORTA;
+            else if ( PIN_PORT_B == pin_port[ pin - PIN_FIRST ] ) port = PORTB;
+            else port = PORTC;
+            break;
+    }
+
+    return ( port & pin_mask[ pin - PIN_FIRST ] ) ? 1 : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setPin
+//
+// Switch a pin only if it changes, so a rule that runs often does not
+// send an information event each time.
+//
+
+static void setPin( uint8_t pin, uint8_t bActive )
+{
+    if ( ( pin < PIN_FIRST ) || ( pin > PIN_LAST ) ) return;
+    if ( pinState( pin ) == ( bActive ? 1 : 0 ) ) return;
+
+    if ( bActive ) {
+        actionSet( 0, pin );
+    }
+    else {
+        actionClr( 0, pin );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// run
+//
+// Run one rule. The stack is checked before each instruction and the
+// rule is stopped when the instruction budget is used up, so a bad
+// program can't hang the main loop. bEvent is TRUE when vscp_imsg
+// holds the event that triggered the rule.
+//
+
+static void run( uint8_t idx, uint8_t bEvent )
+{
+    int16_t stack[ RULES_STACK ];
+    uint8_t sp;
+    uint8_t pc;
+    uint8_t op;
+    uint8_t arg;
+    uint8_t steps;
+    uint8_t err;
+    int16_t a;
+    int16_t b;
+    uint16_t start;
+    uint16_t stop;
+
+    TIMESTAMP_READ( start );
+
+    sp = 0;
+    pc = rules_start[ idx ];
+    steps = 0;
+    err = RULES_ERR_NONE;
+
+    while ( TRUE ) {
+
+        if ( steps >= RULES_STEPS ) {
+            err = RULES_ERR_BUDGET;
+            break;
+        }
+        steps++;
+
+        if ( pc >= RULES_CODE_SIZE ) {
+            err = RULES_ERR_CODE;
+            break;
+        }
+
+        op = rules_code[ pc++ ];
+        if ( RULE_OP_END == op ) break;
+
+        // Operands
+        arg = 0;
+        if ( op & 0x80 ) {
+            if ( pc >= RULES_CODE_SIZE ) {
+                err = RULES_ERR_CODE;
+                break;
+            }
+            arg = rules_code[ pc++ ];
+        }
+        if ( op & 0x40 ) {
+            if ( pc >= RULES_CODE_SIZE ) {
+                err = RULES_ERR_CODE;
+                break;
+            }
+            a = ( (int16_t)arg << 8 ) | rules_code[ pc++ ];
+        }
+
+        // Operators take two values and leave one
+        if ( ( op >= RULE_OP_ADD ) && ( op <= RULE_OP_BAND ) &&
+                ( RULE_OP_NOT != op ) ) {
+            if ( sp < 2 ) {
+                err = RULES_ERR_STACK;
+                break;
+            }
+            b = stack[ --sp ];
+            a = stack[ sp - 1 ];
+        }
+
+        switch ( op ) {
+
+            // Push
+
+            case RULE_OP_CLASS:
+                a = bEvent ? (int16_t)vscp_imsg.vscp_class : -1;
+                break;
+
+            case RULE_OP_TYPE:
+                a = bEvent ? (int16_t)vscp_imsg.vscp_type : -1;
+                break;
+
+            case RULE_OP_PUSH:
+                a = arg;
+                break;
+
+            case RULE_OP_PUSHW:
+                break;
+
+            case RULE_OP_PIN:
+                a = pinState( arg );
+                break;
+
+            case RULE_OP_VAR:
+                a = ( arg < RULES_VARS ) ? rules_var[ arg ] : 0;
+                break;
+
+            case RULE_OP_TIMER:
+                a = ( arg < RULES_TIMERS ) ? (int16_t)rules_timer[ arg ] : 0;
+                break;
+
+            case RULE_OP_DATA:
+                a = ( bEvent && ( arg < ( vscp_imsg.flags & 0x0f ) ) ) ?
+                        vscp_imsg.data[ arg ] : -1;
+                break;
+
+            // Operators
+
+            case RULE_OP_ADD:
+                stack[ sp - 1 ] = a + b;
+                continue;
+
+            case RULE_OP_SUB:
+                stack[ sp - 1 ] = a - b;
+                continue;
+
+            case RULE_OP_AND:
+                stack[ sp - 1 ] = ( a && b ) ? 1 : 0;
+                continue;
+
+            case RULE_OP_OR:
+                stack[ sp - 1 ] = ( a || b ) ? 1 : 0;
+                continue;
+
+            case RULE_OP_EQ:
+                stack[ sp - 1 ] = ( a == b ) ? 1 : 0;
+                continue;
+
+            case RULE_OP_NE:
+                stack[ sp - 1 ] = ( a != b ) ? 1 : 0;
+                continue;
+
+            case RULE_OP_LT:
+                stack[ sp - 1 ] = ( a < b ) ? 1 : 0;
+                continue;
+
+            case RULE_OP_GT:
+                stack[ sp - 1 ] = ( a > b ) ? 1 : 0;
+                continue;
+
+            case RULE_OP_LE:
+                stack[ sp - 1 ] = ( a <= b ) ? 1 : 0;
+                continue;
+
+            case RULE_OP_GE:
+                stack[ sp - 1 ] = ( a >= b ) ? 1 : 0;
+                continue;
+
+            case RULE_OP_BAND:
+                stack[ sp - 1 ] = a & b;
+                continue;
+
+            case RULE_OP_NOT:
+                if ( !sp ) {
+                    err = RULES_ERR_STACK;
+                    break;
+                }
+                stack[ sp - 1 ] = stack[ sp - 1 ] ? 0 : 1;
+                continue;
+
+            // Jumps, relative to the next instruction
+
+            case RULE_OP_JMP:
+                pc += (int8_t)arg;
+                continue;
+
+            case RULE_OP_JZ:
+                if ( !sp ) {
+                    err = RULES_ERR_STACK;
+                    break;
+                }
+                if ( !stack[ --sp ] ) pc += (int8_t)arg;
+                continue;
+
+            // Actions
+
+            case RULE_OP_SET:
+                setPin( arg, TRUE );
+                continue;
+
+            case RULE_OP_CLR:
+                setPin( arg, FALSE );
+                continue;
+
+            case RULE_OP_OUT:
+            case RULE_OP_STORE:
+            case RULE_OP_START:
+                if ( !sp ) {
+                    err = RULES_ERR_STACK;
+                    break;
+                }
+                a = stack[ --sp ];
+                if ( RULE_OP_OUT == op ) {
+                    setPin( arg, a ? TRUE : FALSE );
+                }
+                else if ( RULE_OP_STORE == op ) {
+                    if ( arg < RULES_VARS ) rules_var[ arg ] = a;
+                }
+                else if ( arg < RULES_TIMERS ) {
+                    rules_timer[ arg ] = ( a > 0 ) ? a : 0;
+                }
+                continue;
+
+            case RULE_OP_SCENE:
+                scene_recall( arg );
+                continue;
+
+            case RULE_OP_SEND:
+                translate_send( arg );
+                continue;
+
+            default:
+                err = RULES_ERR_CODE;
+                break;
+        }
+
+        if ( err ) break;
+
+        // Instructions that push a value get here
+        if ( sp >= RULES_STACK ) {
+            err = RULES_ERR_STACK;
+            break;
+        }
+        stack[ sp++ ] = a;
+    }
+
+    TIMESTAMP_READ( stop );
+    stop -= start;
+    if ( stop > rules_time_max[ idx ] ) {
+        rules_time_max[ idx ] = stop;
+    }
+
+    if ( rules_runs[ idx ] < 0xffff ) rules_runs[ idx ]++;
+    rules_steps_last[ idx ] = steps;
+    if ( steps > rules_steps_max[ idx ] ) {
+        rules_steps_max[ idx ] = steps;
+    }
+
+    if ( err ) {
+        if ( rules_aborts[ idx ] < 255 ) rules_aborts[ idx ]++;
+        rules_error = err;
+        rules_error_rule = idx;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rules_event
+//
+
+void rules_event( void )
+{
+    uint8_t i;
+    uint8_t bRun;
+    uint16_t start;
+    uint16_t stop;
+
+    TIMESTAMP_READ( start );
+
+    bRun = FALSE;
+    for ( i = 0; i < RULES_COUNT; i++ ) {
+        if ( RULES_TRIGGER_EVENT != rules_trigger[ i ] ) continue;
+        run( i, TRUE );
+        bRun = TRUE;
+    }
+
+    if ( !bRun ) return;
+
+    TIMESTAMP_READ( stop );
+    stop -= start;
+    if ( stop > rules_pass_max ) {
+        rules_pass_max = stop;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doRules
+//
+
+void doRules( void )
+{
+    uint8_t i;
+    uint8_t gie;
+    uint8_t bDue;
+    uint8_t bRun;
+    uint16_t start;
+    uint16_t stop;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    bDue = ( rules_ms >= 100 ) ? TRUE : FALSE;
+    if ( bDue ) rules_ms -= 100;
+    INTCONbits.GIEL = gie;
+
+    if ( !bDue ) return;
+
+    TIMESTAMP_READ( start );
+
+    bRun = FALSE;
+    for ( i = 0; i < RULES_COUNT; i++ ) {
+        if ( RULES_TRIGGER_PERIODIC != rules_trigger[ i ] ) continue;
+        if ( rules_due[ i ] > 1 ) {
+            rules_due[ i ]--;
+            continue;
+        }
+        rules_due[ i ] = rules_period[ i ];
+        run( i, FALSE );
+        bRun = TRUE;
+    }
+
+    if ( !bRun ) return;
+
+    TIMESTAMP_READ( stop );
+    stop -= start;
+    if ( stop > rules_pass_max ) {
+        rules_pass_max = stop;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rules_oneSecond
+//
+
+void rules_oneSecond( void )
+{
+    uint8_t i;
+
+    for ( i = 0; i < RULES_TIMERS; i++ ) {
+        if ( rules_timer[ i ] ) rules_timer[ i ]--;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rules_readCode
+//
+
+uint8_t rules_readCode( uint8_t reg )
+{
+    if ( reg >= RULES_CODE_SIZE ) return 0;
+
+    return rules_code[ reg ];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rules_writeCode
+//
+// Code can be written while rules run. Turn rules off first when more
+// than one byte changes.
+//
+
+uint8_t rules_writeCode( uint8_t reg, uint8_t val )
+{
+    if ( reg >= RULES_CODE_SIZE ) return ~val;
+
+    eeprom_write( EEPROM_RULE_CODE + reg, val );
+    rules_code[ reg ] = eeprom_read( EEPROM_RULE_CODE + reg );
+
+    return rules_code[ reg ];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rules_readReg
+//
+
+uint8_t rules_readReg( uint8_t reg )
+{
+    uint8_t idx;
+
+    if ( reg < ( REG_RULES_TABLE + RULES_COUNT * 4 ) ) {
+        idx = ( reg - REG_RULES_TABLE ) >> 2;
+        switch ( reg & 3 ) {
+            case 0:
+                return rules_start[ idx ];
+            case 1:
+                return rules_trigger[ idx ];
+            case 2:
+                return rules_period[ idx ];
+        }
+        return 0;
+    }
+
+    if ( ( reg >= REG_RULES_STATS ) &&
+            ( reg < ( REG_RULES_STATS + RULES_COUNT * 8 ) ) ) {
+        idx = ( reg - REG_RULES_STATS ) >> 3;
+        switch ( reg & 7 ) {
+            case 0:
+                return ( rules_runs[ idx ] >> 8 ) & 0xff;
+            case 1:
+                return rules_runs[ idx ] & 0xff;
+            case 2:
+                return rules_steps_last[ idx ];
+            case 3:
+                return rules_steps_max[ idx ];
+            case 4:
+                return ( TIMESTAMP_TO_US( rules_time_max[ idx ] ) >> 8 ) & 0xff;
+            case 5:
+                return TIMESTAMP_TO_US( rules_time_max[ idx ] ) & 0xff;
+            case 6:
+                return rules_aborts[ idx ];
+        }
+        return 0;
+    }
+
+    if ( ( reg >= REG_RULES_VARS ) &&
+            ( reg < ( REG_RULES_VARS + RULES_VARS * 2 ) ) ) {
+        idx = ( reg - REG_RULES_VARS ) >> 1;
+        if ( reg & 1 ) return rules_var[ idx ] & 0xff;
+        return ( rules_var[ idx ] >> 8 ) & 0xff;
+    }
+
+    switch ( reg ) {
+
+        case REG_RULES_PASS_MAX_MSB:
+            return ( TIMESTAMP_TO_US( rules_pass_max ) >> 8 ) & 0xff;
+
+        case REG_RULES_PASS_MAX_LSB:
+            return TIMESTAMP_TO_US( rules_pass_max ) & 0xff;
+
+        case REG_RULES_ERROR:
+            return rules_error;
+
+        case REG_RULES_ERROR_RULE:
+            return rules_error_rule;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rules_writeReg
+//
+// Writing a statistics register of a rule clears all statistics of
+// the rule.
+//
+
+uint8_t rules_writeReg( uint8_t reg, uint8_t val )
+{
+    uint8_t idx;
+
+    if ( reg < ( REG_RULES_TABLE + RULES_COUNT * 4 ) ) {
+        idx = ( reg - REG_RULES_TABLE ) >> 2;
+        if ( 3 == ( reg & 3 ) ) return ~val;
+        eeprom_write( EEPROM_RULE_TABLE + idx * 3 + ( reg & 3 ), val );
+        rules_start[ idx ] = eeprom_read( EEPROM_RULE_TABLE + idx * 3 );
+        rules_trigger[ idx ] = eeprom_read( EEPROM_RULE_TABLE + idx * 3 + 1 );
+        rules_period[ idx ] = eeprom_read( EEPROM_RULE_TABLE + idx * 3 + 2 );
+        rules_due[ idx ] = rules_period[ idx ];
+        return rules_readReg( reg );
+    }
+
+    if ( ( reg >= REG_RULES_STATS ) &&
+            ( reg < ( REG_RULES_STATS + RULES_COUNT * 8 ) ) ) {
+        idx = ( reg - REG_RULES_STATS ) >> 3;
+        rules_runs[ idx ] = 0;
+        rules_steps_last[ idx ] = 0;
+        rules_steps_max[ idx ] = 0;
+        rules_time_max[ idx ] = 0;
+        rules_aborts[ idx ] = 0;
+        return rules_readReg( reg );
+    }
+
+    if ( ( reg >= REG_RULES_VARS ) &&
+            ( reg < ( REG_RULES_VARS + RULES_VARS * 2 ) ) ) {
+        idx = ( reg - REG_RULES_VARS ) >> 1;
+        if ( reg & 1 ) {
+            rules_var[ idx ] = ( rules_var[ idx ] & 0xff00 ) | val;
+        }
+        else {
+            rules_var[ idx ] = ( rules_var[ idx ] & 0x00ff ) | ( (int16_t)val << 8 );
+        }
+        return rules_readReg( reg );
+    }
+
+    switch ( reg ) {
+
+        case REG_RULES_PASS_MAX_MSB:
+        case REG_RULES_PASS_MAX_LSB:
+            rules_pass_max = 0;
+            break;
+
+        case REG_RULES_ERROR:
+        case REG_RULES_ERROR_RULE:
+            rules_error = RULES_ERR_NONE;
+            rules_error_rule = 0;
+            break;
+
+        default:
+            return ~val;
+    }
+
+    return rules_readReg( reg );
+}
@@ -0,0 +1,148 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_RULES_H
+#define ODESSA_RULES_H
+
+// Rule engine. Rules are small stack machine programs in a shared code
+// area, compiled on the host by tools/rulec.py. A rule runs when an
+// event is received or periodically and is stopped if it runs more than
+// RULES_STEPS instructions. Values on the stack are signed 16-bit.
+#define RULES_COUNT                 8
+#define RULES_CODE_SIZE             128
+#define RULES_STACK                 8
+#define RULES_VARS                  8
+#define RULES_TIMERS                4
+#define RULES_STEPS                 64  // Instruction budget per run
+
+// Rule triggers
+#define RULES_TRIGGER_OFF           0
+#define RULES_TRIGGER_EVENT         1   // Each received event
+#define RULES_TRIGGER_PERIODIC      2   // Every period * 100 ms
+
+// Reasons a rule was stopped
+#define RULES_ERR_NONE              0
+#define RULES_ERR_BUDGET            1   // Instruction budget used up
+#define RULES_ERR_STACK             2   // Stack overflow or underflow
+#define RULES_ERR_CODE              3   // Bad opcode or outside code area
+
+// Instructions without operand
+#define RULE_OP_END                 0x00
+#define RULE_OP_CLASS               0x01    // Push event class, -1 if none
+#define RULE_OP_TYPE                0x02    // Push event type, -1 if none
+#define RULE_OP_ADD                 0x10
+#define RULE_OP_SUB                 0x11
+#define RULE_OP_AND                 0x12    // Logical
+#define RULE_OP_OR                  0x13    // Logical
+#define RULE_OP_NOT                 0x14    // Logical
+#define RULE_OP_EQ                  0x15
+#define RULE_OP_NE                  0x16
+#define RULE_OP_LT                  0x17
+#define RULE_OP_GT                  0x18
+#define RULE_OP_LE                  0x19
+#define RULE_OP_GE                  0x1a
+#define RULE_OP_BAND                0x1b    // Bitwise
+
+// Instructions with one operand byte
+#define RULE_OP_PUSH                0x80    // Push 0-255
+#define RULE_OP_PIN                 0x81    // Push pin state 0/1, pin 3-20
+#define RULE_OP_VAR                 0x82    // Push variable 0-7
+#define RULE_OP_TIMER               0x83    // Push timer 0-3, seconds left
+#define RULE_OP_DATA                0x84    // Push event data byte, -1 if none
+#define RULE_OP_JMP                 0x88    // Signed offset from next
+#define RULE_OP_JZ                  0x89    // Pop, jump if zero
+#define RULE_OP_SET                 0x90    // Turn pin on if off
+#define RULE_OP_CLR                 0x91    // Turn pin off if on
+#define RULE_OP_OUT                 0x92    // Pop, pin on if not zero
+#define RULE_OP_STORE               0x93    // Pop to variable
+#define RULE_OP_START               0x94    // Pop seconds to timer
+#define RULE_OP_SCENE               0x95    // Recall scene
+#define RULE_OP_SEND                0x96    // Send translation template
+
+// Instructions with two operand bytes
+#define RULE_OP_PUSHW               0xc0    // Push 16-bit, MSB first
+
+/*!
+    Load rules from EEPROM
+*/
+void rules_init( void );
+
+/*!
+    Write default rules to EEPROM, all rules off
+*/
+void rules_init_eeprom( void );
+
+/*!
+    Time base for periodic rules. Called from the 1 ms tick interrupt
+    only.
+*/
+void rules_tick( void );
+
+/*!
+    Run the event rules. vscp_imsg must hold the received event.
+*/
+void rules_event( void );
+
+/*!
+    Run periodic rules that are due
+*/
+void doRules( void );
+
+/*!
+    Count down rule timers. Call once a second.
+*/
+void rules_oneSecond( void );
+
+/*!
+    Read rule code register (page REG_PAGE_RULE_CODE)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t rules_readCode( uint8_t reg );
+
+/*!
+    Write rule code register (page REG_PAGE_RULE_CODE)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t rules_writeCode( uint8_t reg, uint8_t val );
+
+/*!
+    Read rule register (page REG_PAGE_RULES)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t rules_readReg( uint8_t reg );
+
+/*!
+    Write rule register (page REG_PAGE_RULES)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t rules_writeReg( uint8_t reg, uint8_t val );
+
+#endif
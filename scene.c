@@ -0,0 +1,1165 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "pwm.h"
+#include "softpwm.h"
+#include "scene.h"
+#include "interlock.h"
+
+// Data coding for the state report, bit format with the scene or group
+// as index. Unit 1 marks a group, unit 2 a fire of staged outputs.
+#define SCENE_CODING_SCENE          0x00
+#define SCENE_CODING_GROUP          0x08
+#define SCENE_CODING_SYNC           0x10
+
+// The CCP2 compare is armed for the fire time when it is less than two
+// ticks away. Must be well below the 52 ms Timer1 wraps in.
+#define SCENE_FIRE_ARM              ( 2 * TIMESTAMP_TICKS_PER_SECOND / 1000 )
+
+// CCP2 compare mode, interrupt only
+#define SCENE_FIRE_CCP_COMPARE      0b00001010
+
+uint8_t scene_out[ PIN_PORTS ];     // Port bits in output mode
+uint32_t scene_pwm;                 // Pins in PWM or software PWM mode
+uint32_t scene_driven;              // Pins a scene can change
+
+// RAM copy of EEPROM, as pin bitmaps and as port bitmaps of the pins
+// in output mode
+uint32_t scene_mask[ SCENE_COUNT ];
+uint32_t scene_value[ SCENE_COUNT ];
+uint8_t scene_port_mask[ SCENE_COUNT ][ PIN_PORTS ];
+uint8_t scene_port_value[ SCENE_COUNT ][ PIN_PORTS ];
+uint32_t scene_group[ SCENE_GROUPS ];
+uint8_t scene_port_group[ SCENE_GROUPS ][ PIN_PORTS ];
+
+// Staggered switch on (RAM copy of EEPROM)
+uint8_t scene_wave_size;            // Outputs per wave, 0 = all at once
+uint8_t scene_wave_interval;        // ms between waves
+
+uint32_t scene_wave_pins;           // Outputs left to turn on
+uint32_t scene_wave_notify;         // Outputs that send ON when turned on
+uint8_t scene_wave_coding;          // State report when done, 0xff = none
+uint32_t scene_wave_mask;
+uint32_t scene_wave_value;
+volatile uint8_t scene_wave_due;    // ms to next wave
+volatile uint16_t scene_wave_time;  // ms since the switch started
+
+// Synchronized switching
+uint32_t scene_sync_mask;           // Staged outputs
+uint32_t scene_sync_value;
+uint32_t scene_fire_mask;           // Outputs of the scheduled fire
+uint32_t scene_fire_value;
+uint8_t scene_fire_ports_mask[ PIN_PORTS ];     // Written by the tick
+uint8_t scene_fire_ports_value[ PIN_PORTS ];
+uint32_t scene_fire_at;             // Time stamp to fire at
+volatile uint32_t scene_fire_done;  // Time stamp outputs were written
+volatile uint8_t scene_fire_state;  // SCENE_SYNC_IDLE, _SCHEDULED or _DONE
+
+// Statistics
+uint8_t scene_fires;                // Fires done, wraps
+uint16_t scene_fire_late;           // Late after set time last fire (us)
+uint16_t scene_fire_late_max;       // Most late (us)
+uint8_t scene_last;                 // Last scene recalled, 0xff = none
+uint16_t scene_time_max;            // Longest scene or group change (ticks)
+uint16_t scene_done_time;           // ms for last switch to complete
+
+
+///////////////////////////////////////////////////////////////////////////////
+// readPins
+//
+// Read a pin bitmap stored as three bytes, pin 3-10 first.
+//
+
+static uint32_t readPins( uint16_t addr )
+{
+    return (uint32_t)eeprom_read( addr ) |
+            ( (uint32_t)eeprom_read( addr + 1 ) << 8 ) |
+            ( (uint32_t)eeprom_read( addr + 2 ) << 16 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// load
+//
+// Load a scene from EEPROM into the RAM copy.
+//
+
+static void load( uint8_t idx )
+{
+    uint8_t i;
+
+    scene_mask[ idx ] = readPins( EEPROM_SCENE_TABLE + idx * SCENE_SIZE );
+    scene_value[ idx ] = readPins( EEPROM_SCENE_TABLE + idx * SCENE_SIZE + 3 ) &
+                            scene_mask[ idx ];
+
+    pins_toPorts( scene_mask[ idx ], scene_port_mask[ idx ] );
+    pins_toPorts( scene_value[ idx ], scene_port_value[ idx ] );
+
+    for ( i = 0; i < PIN_PORTS; i++ ) {
+        scene_port_mask[ idx ][ i ] &= scene_out[ i ];
+        scene_port_value[ idx ][ i ] &= scene_out[ i ];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// loadGroup
+//
+
+static void loadGroup( uint8_t idx )
+{
+    uint8_t i;
+
+    scene_group[ idx ] = readPins( EEPROM_SCENE_GROUPS + idx * 3 );
+    pins_toPorts( scene_group[ idx ], scene_port_group[ idx ] );
+
+    for ( i = 0; i < PIN_PORTS; i++ ) {
+        scene_port_group[ idx ][ i ] &= scene_out[ i ];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// writePorts
+//
+// Masked write of the output pins, one write per port. Interrupts are
+// off so the software PWM and 1-Wire interrupts can't change a port
+// between the read and the write.
+//
+
+static void writePorts( const uint8_t *pmask, const uint8_t *pvalue )
+{
+    uint8_t gie;
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+
+    LATA = ( LATA & ~pmask[ PIN_PORT_A ] ) | pvalue[ PIN_PORT_A ];
+    LATB = ( LATB & ~pmask[ PIN_PORT_B ] ) | pvalue[ PIN_PORT_B ];
+    LATC = ( LATC & ~pmask[ PIN_PORT_C ] ) | pvalue[ PIN_PORT_C ];
+
+    INTCONbits.GIEH = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// togglePorts
+//
+
+static void togglePorts( const uint8_t *pmask )
+{
+    uint8_t gie;
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+
+    LATA ^= pmask[ PIN_PORT_A ];
+    LATB ^= pmask[ PIN_PORT_B ];
+    LATC ^= pmask[ PIN_PORT_C ];
+
+    INTCONbits.GIEH = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// writePWM
+//
+// PWM and software PWM pins in the mask go to full level or off.
+//
+
+static void writePWM( uint32_t mask, uint32_t value )
+{
+    uint8_t i;
+    uint8_t level;
+
+    mask &= scene_pwm;
+    if ( !mask ) return;
+
+    for ( i = 0; i < PIN_COUNT; i++ ) {
+        if ( mask & 1 ) {
+            level = ( value & 1 ) ? 255 : 0;
+            if ( PIN_MODE_PWM == ( pin_mode[ i ] & PIN_MODE_MASK ) ) {
+                pwm_setLevel( pwm_channel( i + PIN_FIRST ), level );
+            }
+            else {
+                softpwm_setLevel( i + PIN_FIRST, level );
+            }
+        }
+        mask >>= 1;
+        value >>= 1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getState
+//
+// Pin bitmap of the pins a scene can change that are on. A PWM pin is on
+// if its level is not zero.
+//
+
+static uint32_t getState( void )
+{
+    uint8_t i;
+    uint8_t ports[ PIN_PORTS ];
+    uint32_t state;
+
+    ports[ PIN_PORT_A ] = LATA & scene_out[ PIN_PORT_A ];
+    ports[ PIN_PORT_B ] = LATB & scene_out[ PIN_PORT_B ];
+    ports[ PIN_PORT_C ] = LATC & scene_out[ PIN_PORT_C ];
+    state = pins_fromPorts( ports );
+
+    if ( scene_pwm ) {
+        for ( i = 0; i < PIN_COUNT; i++ ) {
+            if ( !( scene_pwm & PIN_BIT( i + PIN_FIRST ) ) ) continue;
+            if ( PIN_MODE_PWM == ( pin_mode[ i ] & PIN_MODE_MASK ) ) {
+                if ( pwm_getLevel( pwm_channel( i + PIN_FIRST ) ) ) {
+                    state |= PIN_BIT( i + PIN_FIRST );
+                }
+            }
+            else if ( softpwm_getLevel( i + PIN_FIRST ) ) {
+                state |= PIN_BIT( i + PIN_FIRST );
+            }
+        }
+    }
+
+    return state;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// report
+//
+// One event with the pins changed and their new state.
+//
+
+static void report( uint8_t coding, uint32_t mask, uint32_t value )
+{
+    uint8_t data[ 7 ];
+
+    data[ 0 ] = coding;
+    data[ 1 ] = ( mask >> 16 ) & 0xff;
+    data[ 2 ] = ( mask >> 8 ) & 0xff;
+    data[ 3 ] = mask & 0xff;
+    data[ 4 ] = ( value >> 16 ) & 0xff;
+    data[ 5 ] = ( value >> 8 ) & 0xff;
+    data[ 6 ] = value & 0xff;
+
+    sendVSCPFrame( VSCP_CLASS1_DATA,
+                    VSCP_TYPE_DATA_IO,
+                    vscp_nickname,
+                    VSCP_PRIORITY_MEDIUM,
+                    7,
+                    data );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendEvents
+//
+
+static void sendEvents( uint32_t pins, uint8_t type )
+{
+    uint8_t i;
+
+    for ( i = PIN_FIRST; i <= PIN_LAST; i++ ) {
+        if ( pins & PIN_BIT( i ) ) {
+            SendInformationEvent( i, VSCP_CLASS1_INFORMATION, type );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// writeOutputs
+//
+// Masked write of output pins given as pin bitmaps, through the
+// interlock. With staggering on, outputs turned on are left for the
+// waves and the state report is sent when the last wave is done. Used
+// instead of the port bitmaps when either is in use.
+//
+
+static uint32_t writeOutputs( uint32_t mask,
+                                uint32_t value,
+                                uint8_t coding,
+                                uint8_t bEvents )
+{
+    uint8_t i;
+    uint8_t gie;
+    uint32_t on;
+    uint8_t ports_mask[ PIN_PORTS ];
+    uint8_t ports_value[ PIN_PORTS ];
+
+    if ( mask & interlock_pins ) {
+        value = interlock_filter( value & mask, mask & scene_driven ) & mask;
+    }
+
+    on = 0;
+    if ( scene_wave_size ) {
+        on = value & ~getState() & scene_driven & ~scene_pwm;
+    }
+
+    // Outputs in the mask are no longer switched by earlier waves
+    scene_wave_pins &= ~mask;
+    scene_wave_notify &= ~mask;
+
+    pins_toPorts( mask, ports_mask );
+    pins_toPorts( value & ~on, ports_value );
+    for ( i = 0; i < PIN_PORTS; i++ ) {
+        ports_mask[ i ] &= scene_out[ i ];
+        ports_value[ i ] &= scene_out[ i ];
+    }
+
+    writePorts( ports_mask, ports_value );
+
+    if ( bEvents ) {
+        sendEvents( mask & value & ~on & scene_driven & ~scene_pwm,
+                        VSCP_TYPE_INFORMATION_ON );
+        sendEvents( mask & ~value & scene_driven & ~scene_pwm,
+                        VSCP_TYPE_INFORMATION_OFF );
+    }
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    if ( on ) {
+        scene_wave_time = 0;
+        scene_wave_due = 0;
+    }
+    else if ( !scene_wave_pins ) {
+        scene_done_time = 0;
+    }
+    INTCONbits.GIEL = gie;
+
+    if ( on ) {
+        scene_wave_pins |= on;
+        if ( bEvents ) scene_wave_notify |= on;
+        scene_wave_coding = coding;
+        scene_wave_mask = mask & scene_driven;
+        scene_wave_value = value & scene_driven;
+    }
+
+    return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isPlain
+//
+// TRUE if the port bitmaps can be written directly.
+//
+
+static uint8_t isPlain( uint32_t mask )
+{
+    if ( scene_wave_size ) return FALSE;
+    if ( mask & ( interlock_pins | scene_wave_pins ) ) return FALSE;
+
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// wave
+//
+// Turn on the next wave of outputs, lowest pins first.
+//
+
+static void wave( void )
+{
+    uint8_t i;
+    uint8_t n;
+    uint8_t gie;
+    uint32_t pins;
+    uint32_t on;
+    uint8_t ports[ PIN_PORTS ];
+
+    pins = 0;
+    n = 0;
+    for ( i = PIN_FIRST; i <= PIN_LAST; i++ ) {
+        if ( !( scene_wave_pins & PIN_BIT( i ) ) ) continue;
+        pins |= PIN_BIT( i );
+        if ( scene_wave_size && ( ++n >= scene_wave_size ) ) break;
+    }
+
+    scene_wave_pins &= ~pins;
+
+    // The interlock may have changed since the switch was queued,
+    // pins it does not allow now are held back or dropped by it
+    on = pins;
+    if ( on & interlock_pins ) {
+        on = interlock_filter( on, on );
+    }
+
+    pins_toPorts( on, ports );
+    writePorts( ports, ports );
+
+    sendEvents( on & scene_wave_notify, VSCP_TYPE_INFORMATION_ON );
+    scene_wave_notify &= ~pins;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    if ( scene_wave_pins ) {
+        scene_wave_due = scene_wave_interval;
+    }
+    else {
+        scene_done_time = scene_wave_time;
+    }
+    INTCONbits.GIEL = gie;
+
+    if ( !scene_wave_pins && ( 0xff != scene_wave_coding ) ) {
+        report( scene_wave_coding, scene_wave_mask, scene_wave_value );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_cancelWave
+//
+
+void scene_cancelWave( uint8_t pin )
+{
+    if ( ( pin < PIN_FIRST ) || ( pin > PIN_LAST ) ) return;
+
+    scene_wave_pins &= ~PIN_BIT( pin );
+    scene_wave_notify &= ~PIN_BIT( pin );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// apply
+//
+// Set the pins of a scene to the scene values or off.
+//
+
+static void apply( uint8_t idx, uint8_t bOff )
+{
+    const uint8_t off[ PIN_PORTS ] = { 0, 0, 0 };
+    uint32_t value;
+    uint16_t start;
+    uint16_t stop;
+
+    TIMESTAMP_READ( start );
+
+    value = bOff ? 0 : scene_value[ idx ];
+    if ( isPlain( scene_mask[ idx ] ) ) {
+        writePorts( scene_port_mask[ idx ], bOff ? off : scene_port_value[ idx ] );
+    }
+    else {
+        value = writeOutputs( scene_mask[ idx ], value,
+                                SCENE_CODING_SCENE | idx, FALSE );
+    }
+    writePWM( scene_mask[ idx ], value );
+
+    TIMESTAMP_READ( stop );
+    stop -= start;
+    if ( stop > scene_time_max ) {
+        scene_time_max = stop;
+    }
+
+    scene_last = idx;
+
+    // Sent by the last wave
+    if ( scene_wave_pins ) return;
+
+    report( SCENE_CODING_SCENE | idx,
+            scene_mask[ idx ] & scene_driven,
+            value & scene_driven );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// disarm
+//
+// Stop the fire compare. High priority interrupts must be off.
+//
+
+static void disarm( void )
+{
+    PIE3bits.CCP2IE = 0;
+    PIR3bits.CCP2IF = 0;
+    if ( SCENE_FIRE_CCP_COMPARE == CCP2CON ) CCP2CON = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fireNow
+//
+// Write the outputs of a scheduled fire and disarm the compare. High
+// priority interrupts must be off.
+//
+
+static void fireNow( uint32_t now )
+{
+    disarm();
+
+    if ( SCENE_SYNC_SCHEDULED != scene_fire_state ) return;
+
+    LATA = ( LATA & ~scene_fire_ports_mask[ PIN_PORT_A ] ) |
+                scene_fire_ports_value[ PIN_PORT_A ];
+    LATB = ( LATB & ~scene_fire_ports_mask[ PIN_PORT_B ] ) |
+                scene_fire_ports_value[ PIN_PORT_B ];
+    LATC = ( LATC & ~scene_fire_ports_mask[ PIN_PORT_C ] ) |
+                scene_fire_ports_value[ PIN_PORT_C ];
+
+    scene_fire_done = now;
+    scene_fire_state = SCENE_SYNC_DONE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fireTick
+//
+// Arm the CCP2 compare on the time stamp when the fire is less than
+// two ticks away, so the outputs are written by the high priority
+// interrupt within microseconds of the fire time and nodes switch
+// together, not just within the same ms. CCP2 is the PWM of pin 16;
+// with pin 16 in PWM mode, or if the compare is missed, the tick
+// writes the outputs at the first tick after the fire time.
+//
+
+static void fireTick( void )
+{
+    uint8_t gie;
+    uint16_t at;
+    uint32_t now;
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+
+    TIMESTAMP_READ32( now );
+
+    if ( (int32_t)( scene_fire_at - now ) <= 0 ) {
+        fireNow( now );
+    }
+    else if ( !PIE3bits.CCP2IE && ( 0 == CCP2CON ) &&
+                ( (int32_t)( scene_fire_at - now ) < SCENE_FIRE_ARM ) ) {
+
+        at = (uint16_t)scene_fire_at;
+        CCPR2H = at >> 8;
+        CCPR2L = at & 0xff;
+        CCP2CON = SCENE_FIRE_CCP_COMPARE;
+        PIR3bits.CCP2IF = 0;
+        PIE3bits.CCP2IE = 1;
+
+        // The time may have passed while the compare was set up
+        TIMESTAMP_READ32( now );
+        if ( (int32_t)( scene_fire_at - now ) <= 0 ) {
+            fireNow( now );
+        }
+    }
+
+    INTCONbits.GIEH = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_fireIsr
+//
+
+void scene_fireIsr( void )
+{
+    uint32_t now;
+
+    TIMESTAMP_READ32( now );
+    fireNow( now );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fireDone
+//
+// Finish a fire from the main loop. Outputs in an interlock group go
+// through the interlock and PWM pins are set here, so only plain
+// outputs switch at the exact time.
+//
+
+static void fireDone( void )
+{
+    uint8_t gie;
+    uint8_t state;
+    uint32_t late;
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    state = scene_fire_state;
+    if ( SCENE_SYNC_DONE == state ) {
+        scene_fire_state = SCENE_SYNC_IDLE;
+    }
+    INTCONbits.GIEH = gie;
+
+    if ( SCENE_SYNC_DONE != state ) return;
+
+    late = TIMESTAMP_TO_US( scene_fire_done - scene_fire_at );
+    scene_fire_late = ( late > 0xffff ) ? 0xffff : late;
+    if ( scene_fire_late > scene_fire_late_max ) {
+        scene_fire_late_max = scene_fire_late;
+    }
+    scene_fires++;
+
+    if ( scene_fire_mask & interlock_pins ) {
+        writeOutputs( scene_fire_mask & interlock_pins, scene_fire_value,
+                        0xff, FALSE );
+    }
+    writePWM( scene_fire_mask, scene_fire_value );
+
+    report( SCENE_CODING_SYNC,
+            scene_fire_mask & scene_driven,
+            scene_fire_value & scene_fire_mask & scene_driven );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_init
+//
+
+void scene_init( void )
+{
+    uint8_t gie;
+
+    scene_wave_pins = 0;
+    scene_wave_notify = 0;
+
+    scene_sync_mask = 0;
+    scene_sync_value = 0;
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    scene_wave_due = 0;
+    scene_wave_time = 0;
+    scene_fire_state = SCENE_SYNC_IDLE;
+    INTCONbits.GIEH = gie;
+
+    scene_configure();
+
+    scene_last = 0xff;
+    scene_done_time = 0;
+    scene_fires = 0;
+    scene_fire_late = 0;
+    scene_fire_late_max = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_configure
+//
+
+void scene_configure( void )
+{
+    uint8_t i;
+    uint8_t mode;
+    uint8_t gie;
+
+    scene_out[ PIN_PORT_A ] = 0;
+    scene_out[ PIN_PORT_B ] = 0;
+    scene_out[ PIN_PORT_C ] = 0;
+    scene_pwm = 0;
+    scene_driven = 0;
+
+    for ( i = 0; i < PIN_COUNT; i++ ) {
+
+        if ( PIN_PORT_NONE == pin_port[ i ] ) continue;
+
+        mode = pin_mode[ i ] & PIN_MODE_MASK;
+        if ( PIN_MODE_OUTPUT == mode ) {
+            scene_out[ pin_port[ i ] ] |= pin_mask[ i ];
+            scene_driven |= PIN_BIT( i + PIN_FIRST );
+        }
+        else if ( ( ( PIN_MODE_PWM == mode ) &&
+                        ( PWM_NONE != pwm_channel( i + PIN_FIRST ) ) ) ||
+                    ( PIN_MODE_SOFTPWM == mode ) ) {
+            scene_pwm |= PIN_BIT( i + PIN_FIRST );
+            scene_driven |= PIN_BIT( i + PIN_FIRST );
+        }
+    }
+
+    for ( i = 0; i < SCENE_COUNT; i++ ) {
+        load( i );
+    }
+
+    for ( i = 0; i < SCENE_GROUPS; i++ ) {
+        loadGroup( i );
+    }
+
+    scene_wave_size = eeprom_read( EEPROM_SCENE_WAVE_SIZE );
+    scene_wave_interval = eeprom_read( EEPROM_SCENE_WAVE_INTERVAL );
+
+    // Switches in progress keep going for the pins still driven
+    scene_wave_pins &= pins_fromPorts( scene_out );
+    scene_wave_notify &= scene_wave_pins;
+    scene_sync_mask &= scene_driven;
+    scene_sync_value &= scene_driven;
+    scene_fire_mask &= scene_driven;
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    for ( i = 0; i < PIN_PORTS; i++ ) {
+        scene_fire_ports_mask[ i ] &= scene_out[ i ];
+    }
+    INTCONbits.GIEH = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_init_eeprom
+//
+
+void scene_init_eeprom( void )
+{
+    uint8_t i;
+
+    // No pins in any scene
+    for ( i = 0; i < SCENE_COUNT * SCENE_SIZE; i++ ) {
+        eeprom_write( EEPROM_SCENE_TABLE + i, 0 );
+    }
+
+    for ( i = 0; i < SCENE_GROUPS * 3; i++ ) {
+        eeprom_write( EEPROM_SCENE_GROUPS + i, 0 );
+    }
+
+    // All outputs at once
+    eeprom_write( EEPROM_SCENE_WAVE_SIZE, 0 );
+    eeprom_write( EEPROM_SCENE_WAVE_INTERVAL, SCENE_DEFAULT_WAVE_INTERVAL );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_tick
+//
+
+void scene_tick( void )
+{
+    if ( scene_wave_due ) scene_wave_due--;
+    if ( scene_wave_time < 0xffff ) scene_wave_time++;
+
+    if ( SCENE_SYNC_SCHEDULED == scene_fire_state ) fireTick();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doScene
+//
+
+void doScene( void )
+{
+    uint8_t gie;
+    uint8_t due;
+
+    fireDone();
+
+    if ( !scene_wave_pins ) return;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    due = scene_wave_due;
+    INTCONbits.GIEL = gie;
+
+    if ( due ) return;
+
+    wave();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_recall
+//
+
+void scene_recall( uint8_t idx )
+{
+    if ( idx >= SCENE_COUNT ) return;
+
+    apply( idx, FALSE );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_store
+//
+
+void scene_store( uint8_t idx )
+{
+    uint8_t i;
+    uint32_t mask;
+    uint32_t value;
+    uint16_t addr;
+
+    if ( idx >= SCENE_COUNT ) return;
+
+    mask = scene_mask[ idx ];
+    if ( !mask ) {
+        mask = scene_driven;
+    }
+    value = getState() & mask;
+
+    addr = EEPROM_SCENE_TABLE + idx * SCENE_SIZE;
+    for ( i = 0; i < 3; i++ ) {
+        eeprom_write( addr + i, ( mask >> ( 8 * i ) ) & 0xff );
+        eeprom_write( addr + 3 + i, ( value >> ( 8 * i ) ) & 0xff );
+    }
+
+    load( idx );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_toggle
+//
+
+void scene_toggle( uint8_t idx )
+{
+    uint32_t mask;
+
+    if ( idx >= SCENE_COUNT ) return;
+
+    mask = scene_mask[ idx ] & scene_driven;
+    apply( idx, ( ( getState() ^ scene_value[ idx ] ) & mask ) ? FALSE : TRUE );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_setGroup
+//
+
+void scene_setGroup( uint8_t idx, uint8_t op )
+{
+    const uint8_t off[ PIN_PORTS ] = { 0, 0, 0 };
+    uint32_t mask;
+    uint32_t value;
+    uint16_t start;
+    uint16_t stop;
+
+    if ( idx >= SCENE_GROUPS ) return;
+
+    TIMESTAMP_READ( start );
+
+    mask = scene_group[ idx ] & scene_driven;
+
+    switch ( op ) {
+
+        case SCENE_GROUP_SET:
+            value = mask;
+            if ( isPlain( mask ) ) {
+                writePorts( scene_port_group[ idx ], scene_port_group[ idx ] );
+            }
+            else {
+                value = writeOutputs( mask, value, SCENE_CODING_GROUP | idx, FALSE );
+            }
+            break;
+
+        case SCENE_GROUP_CLR:
+            value = 0;
+            if ( isPlain( mask ) ) {
+                writePorts( scene_port_group[ idx ], off );
+            }
+            else {
+                value = writeOutputs( mask, value, SCENE_CODING_GROUP | idx, FALSE );
+            }
+            break;
+
+        default:
+            value = ~getState() & mask;
+            if ( isPlain( mask ) ) {
+                togglePorts( scene_port_group[ idx ] );
+            }
+            else {
+                value = writeOutputs( mask, value, SCENE_CODING_GROUP | idx, FALSE );
+            }
+            break;
+    }
+
+    writePWM( mask, value );
+
+    TIMESTAMP_READ( stop );
+    stop -= start;
+    if ( stop > scene_time_max ) {
+        scene_time_max = stop;
+    }
+
+    // Sent by the last wave
+    if ( scene_wave_pins ) return;
+
+    report( SCENE_CODING_GROUP | idx, mask, value );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_setAll
+//
+
+void scene_setAll( uint8_t bOn )
+{
+    uint32_t mask;
+    uint16_t start;
+    uint16_t stop;
+
+    TIMESTAMP_READ( start );
+
+    mask = scene_driven & ~scene_pwm;
+    writeOutputs( mask, bOn ? mask : 0, 0xff, TRUE );
+
+    TIMESTAMP_READ( stop );
+    stop -= start;
+    if ( stop > scene_time_max ) {
+        scene_time_max = stop;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_arm
+//
+
+void scene_arm( uint8_t idx )
+{
+    if ( idx >= SCENE_COUNT ) return;
+
+    scene_sync_mask |= scene_mask[ idx ];
+    scene_sync_value = ( scene_sync_value & ~scene_mask[ idx ] ) | scene_value[ idx ];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_armPin
+//
+
+void scene_armPin( uint8_t pin, uint8_t bOn )
+{
+    if ( ( pin < PIN_FIRST ) || ( pin > PIN_LAST ) ) return;
+
+    scene_sync_mask |= PIN_BIT( pin );
+    if ( bOn ) {
+        scene_sync_value |= PIN_BIT( pin );
+    }
+    else {
+        scene_sync_value &= ~PIN_BIT( pin );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_fire
+//
+// The staged outputs are moved to the fire, so the next outputs can be
+// staged while it waits. A fire not yet done takes in the new outputs
+// and the new time.
+//
+
+void scene_fire( uint8_t delay )
+{
+    uint8_t i;
+    uint8_t gie;
+    uint32_t exact;
+    uint8_t ports_mask[ PIN_PORTS ];
+    uint8_t ports_value[ PIN_PORTS ];
+
+    // Last fire must be finished first
+    fireDone();
+
+    if ( !scene_sync_mask ) return;
+
+    // The tick and the compare must not fire while the fire is changed.
+    // The compare is armed again for the new time by the tick.
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    disarm();
+
+    if ( SCENE_SYNC_SCHEDULED == scene_fire_state ) {
+        scene_fire_mask |= scene_sync_mask;
+        scene_fire_value = ( scene_fire_value & ~scene_sync_mask ) |
+                                ( scene_sync_value & scene_sync_mask );
+    }
+    else {
+        scene_fire_mask = scene_sync_mask;
+        scene_fire_value = scene_sync_value & scene_sync_mask;
+    }
+
+    scene_sync_mask = 0;
+    scene_sync_value = 0;
+
+    // Outputs in the fire are no longer switched by earlier waves
+    scene_wave_pins &= ~scene_fire_mask;
+    scene_wave_notify &= ~scene_fire_mask;
+
+    exact = scene_fire_mask & ~interlock_pins;
+    pins_toPorts( exact, ports_mask );
+    pins_toPorts( exact & scene_fire_value, ports_value );
+
+    for ( i = 0; i < PIN_PORTS; i++ ) {
+        scene_fire_ports_mask[ i ] = ports_mask[ i ] & scene_out[ i ];
+        scene_fire_ports_value[ i ] = ports_value[ i ] & scene_out[ i ];
+    }
+
+    scene_fire_at = can_rx_stamp +
+                        (uint32_t)delay * ( TIMESTAMP_TICKS_PER_SECOND / 1000 );
+    scene_fire_state = SCENE_SYNC_SCHEDULED;
+
+    INTCONbits.GIEH = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_readReg
+//
+
+uint8_t scene_readReg( uint8_t reg )
+{
+    uint8_t offset;
+    uint8_t state;
+
+    if ( ( reg >= REG_SCENE_TABLE ) &&
+            ( reg < ( REG_SCENE_TABLE + SCENE_COUNT * SCENE_REG_SIZE ) ) ) {
+        offset = ( reg - REG_SCENE_TABLE ) % SCENE_REG_SIZE;
+        if ( offset >= SCENE_SIZE ) return 0;
+        return eeprom_read( EEPROM_SCENE_TABLE +
+                            ( ( reg - REG_SCENE_TABLE ) / SCENE_REG_SIZE ) * SCENE_SIZE +
+                            offset );
+    }
+
+    if ( ( reg >= REG_SCENE_GROUP ) &&
+            ( reg < ( REG_SCENE_GROUP + SCENE_GROUPS * 4 ) ) ) {
+        offset = ( reg - REG_SCENE_GROUP ) & 3;
+        if ( offset >= 3 ) return 0;
+        return eeprom_read( EEPROM_SCENE_GROUPS +
+                            ( ( reg - REG_SCENE_GROUP ) >> 2 ) * 3 + offset );
+    }
+
+    switch ( reg ) {
+
+        case REG_SCENE_LAST:
+            return scene_last;
+
+        case REG_SCENE_TIME_MAX_MSB:
+            return ( TIMESTAMP_TO_US( scene_time_max ) >> 8 ) & 0xff;
+
+        case REG_SCENE_TIME_MAX_LSB:
+            return TIMESTAMP_TO_US( scene_time_max ) & 0xff;
+
+        case REG_SCENE_WAVE_SIZE:
+            return scene_wave_size;
+
+        case REG_SCENE_WAVE_INTERVAL:
+            return scene_wave_interval;
+
+        case REG_SCENE_DONE_TIME_MSB:
+            return ( scene_done_time >> 8 ) & 0xff;
+
+        case REG_SCENE_DONE_TIME_LSB:
+            return scene_done_time & 0xff;
+
+        case REG_SCENE_SYNC_STATE:
+            INTCONbits.GIEL = 0;
+            state = scene_fire_state;
+            INTCONbits.GIEL = 1;
+            if ( SCENE_SYNC_IDLE != state ) return SCENE_SYNC_SCHEDULED;
+            return scene_sync_mask ? SCENE_SYNC_ARMED : SCENE_SYNC_IDLE;
+
+        case REG_SCENE_SYNC_MASK:
+        case REG_SCENE_SYNC_MASK + 1:
+        case REG_SCENE_SYNC_MASK + 2:
+            return ( scene_sync_mask >> ( 8 * ( reg - REG_SCENE_SYNC_MASK ) ) ) & 0xff;
+
+        case REG_SCENE_SYNC_VALUE:
+        case REG_SCENE_SYNC_VALUE + 1:
+        case REG_SCENE_SYNC_VALUE + 2:
+            return ( scene_sync_value >> ( 8 * ( reg - REG_SCENE_SYNC_VALUE ) ) ) & 0xff;
+
+        case REG_SCENE_SYNC_FIRES:
+            return scene_fires;
+
+        case REG_SCENE_SYNC_LATE_MSB:
+            return ( scene_fire_late >> 8 ) & 0xff;
+
+        case REG_SCENE_SYNC_LATE_LSB:
+            return scene_fire_late & 0xff;
+
+        case REG_SCENE_SYNC_LATE_MAX_MSB:
+            return ( scene_fire_late_max >> 8 ) & 0xff;
+
+        case REG_SCENE_SYNC_LATE_MAX_LSB:
+            return scene_fire_late_max & 0xff;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scene_writeReg
+//
+
+uint8_t scene_writeReg( uint8_t reg, uint8_t val )
+{
+    uint8_t idx;
+    uint8_t offset;
+
+    if ( ( reg >= REG_SCENE_TABLE ) &&
+            ( reg < ( REG_SCENE_TABLE + SCENE_COUNT * SCENE_REG_SIZE ) ) ) {
+        idx = ( reg - REG_SCENE_TABLE ) / SCENE_REG_SIZE;
+        offset = ( reg - REG_SCENE_TABLE ) % SCENE_REG_SIZE;
+        if ( offset >= SCENE_SIZE ) return ~val;
+        eeprom_write( EEPROM_SCENE_TABLE + idx * SCENE_SIZE + offset, val );
+        load( idx );
+        return eeprom_read( EEPROM_SCENE_TABLE + idx * SCENE_SIZE + offset );
+    }
+
+    if ( ( reg >= REG_SCENE_GROUP ) &&
+            ( reg < ( REG_SCENE_GROUP + SCENE_GROUPS * 4 ) ) ) {
+        idx = ( reg - REG_SCENE_GROUP ) >> 2;
+        offset = ( reg - REG_SCENE_GROUP ) & 3;
+        if ( offset >= 3 ) return ~val;
+        eeprom_write( EEPROM_SCENE_GROUPS + idx * 3 + offset, val );
+        loadGroup( idx );
+        return eeprom_read( EEPROM_SCENE_GROUPS + idx * 3 + offset );
+    }
+
+    switch ( reg ) {
+
+        // Write to clear
+        case REG_SCENE_TIME_MAX_MSB:
+        case REG_SCENE_TIME_MAX_LSB:
+            scene_time_max = 0;
+            return 0;
+
+        case REG_SCENE_WAVE_SIZE:
+            eeprom_write( EEPROM_SCENE_WAVE_SIZE, val );
+            scene_wave_size = eeprom_read( EEPROM_SCENE_WAVE_SIZE );
+            return scene_wave_size;
+
+        case REG_SCENE_WAVE_INTERVAL:
+            eeprom_write( EEPROM_SCENE_WAVE_INTERVAL, val );
+            scene_wave_interval = eeprom_read( EEPROM_SCENE_WAVE_INTERVAL );
+            return scene_wave_interval;
+
+        // Write 0 to disarm and cancel a fire not yet done
+        case REG_SCENE_SYNC_STATE:
+            if ( val ) return ~val;
+            scene_sync_mask = 0;
+            scene_sync_value = 0;
+            INTCONbits.GIEH = 0;
+            if ( SCENE_SYNC_SCHEDULED == scene_fire_state ) {
+                scene_fire_state = SCENE_SYNC_IDLE;
+            }
+            INTCONbits.GIEH = 1;
+            return scene_readReg( reg );
+
+        case REG_SCENE_SYNC_MASK:
+        case REG_SCENE_SYNC_MASK + 1:
+        case REG_SCENE_SYNC_MASK + 2:
+            offset = 8 * ( reg - REG_SCENE_SYNC_MASK );
+            scene_sync_mask = ( scene_sync_mask & ~( (uint32_t)0xff << offset ) ) |
+                                ( (uint32_t)val << offset );
+            return val;
+
+        case REG_SCENE_SYNC_VALUE:
+        case REG_SCENE_SYNC_VALUE + 1:
+        case REG_SCENE_SYNC_VALUE + 2:
+            offset = 8 * ( reg - REG_SCENE_SYNC_VALUE );
+            scene_sync_value = ( scene_sync_value & ~( (uint32_t)0xff << offset ) ) |
+                                ( (uint32_t)val << offset );
+            return val;
+
+        case REG_SCENE_SYNC_LATE_MAX_MSB:
+        case REG_SCENE_SYNC_LATE_MAX_LSB:
+            scene_fire_late_max = 0;
+            return 0;
+    }
+
+    return ~val;
+}
@@ -0,0 +1,172 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_SCENE_H
+#define ODESSA_SCENE_H
+
+// Output scenes. A scene is a pin mask and the values for the pins in
+// it, in the pin bitmap layout. Pins in output mode are written with one
+// write per port, pins in PWM or software PWM mode go to full level or
+// off. The RAM copy holds the port bitmaps so recall does not depend on
+// the number of pins in the scene.
+#define SCENE_COUNT                 8
+#define SCENE_SIZE                  6   // EEPROM bytes, mask and value
+#define SCENE_REG_SIZE              8   // Registers per scene
+
+// Pin groups for the mask actions, a pin mask each. Applied in the same
+// way as scenes.
+#define SCENE_GROUPS                8
+
+// Staggered switch on. Outputs turned on by a scene, group or SETALL
+// can be switched in waves of a few outputs to limit inrush current.
+#define SCENE_DEFAULT_WAVE_INTERVAL 50  // ms
+
+// Synchronized switching. Outputs are staged first and applied by a
+// fire a set time after the trigger frame was received. All nodes see
+// the frame at the same time so they switch together whatever their
+// main loops are busy with.
+#define SCENE_SYNC_IDLE             0
+#define SCENE_SYNC_ARMED            1   // Outputs staged
+#define SCENE_SYNC_SCHEDULED        2   // Fire waiting for its time
+#define SCENE_SYNC_DONE             3   // Fired, not yet reported
+
+// Group operations
+#define SCENE_GROUP_SET             0
+#define SCENE_GROUP_CLR             1
+#define SCENE_GROUP_TOGGLE          2
+
+/*!
+    Set up scenes from pin modes. Call after the other pin users are
+    set up.
+*/
+void scene_init( void );
+
+/*!
+    Write default scenes to EEPROM
+*/
+void scene_init_eeprom( void );
+
+/*!
+    Take the output pins from the pin modes after a mode has changed.
+    Switches in progress and staged outputs are kept for pins that are
+    still outputs.
+*/
+void scene_configure( void );
+
+/*!
+    Recall a scene
+    @param idx Scene 0-7
+*/
+void scene_recall( uint8_t idx );
+
+/*!
+    Store the current state of the pins in a scene mask as the scene
+    values. A scene with an empty mask gets all pins in output, PWM or
+    software PWM mode.
+    @param idx Scene 0-7
+*/
+void scene_store( uint8_t idx );
+
+/*!
+    Toggle a scene. If the pins in the mask already have the scene
+    values they are turned off, else the scene is recalled.
+    @param idx Scene 0-7
+*/
+void scene_toggle( uint8_t idx );
+
+/*!
+    Set, clear or toggle all pins in a group
+    @param idx Group 0-7
+    @param op SCENE_GROUP_SET, SCENE_GROUP_CLR or SCENE_GROUP_TOGGLE
+*/
+void scene_setGroup( uint8_t idx, uint8_t op );
+
+/*!
+    Set or clear all pins in output mode. Pins in other modes are left
+    alone. An ON or OFF event is sent for each pin as it is switched.
+    @param bOn TRUE to set, FALSE to clear.
+*/
+void scene_setAll( uint8_t bOn );
+
+/*!
+    Take a pin out of a staggered switch in progress. Called when the
+    pin is set or cleared directly so a later wave does not undo it.
+    @param pin Connector pin 3-20
+*/
+void scene_cancelWave( uint8_t pin );
+
+/*!
+    Stage the pins of a scene for the next fire
+    @param idx Scene 0-7
+*/
+void scene_arm( uint8_t idx );
+
+/*!
+    Stage a pin for the next fire
+    @param pin Connector pin 3-20
+    @param bOn TRUE to turn on, FALSE to turn off.
+*/
+void scene_armPin( uint8_t pin, uint8_t bOn );
+
+/*!
+    Apply the staged outputs a time after the event in vscp_imsg was
+    received
+    @param delay ms from the reception of the event, 0 = next tick.
+*/
+void scene_fire( uint8_t delay );
+
+/*!
+    Time base for staggered switching and the fire of staged outputs.
+    Called from the 1 ms tick interrupt only.
+*/
+void scene_tick( void );
+
+/*!
+    Write the outputs of a fire on the CCP2 compare. Called from the
+    high priority interrupt only.
+*/
+void scene_fireIsr( void );
+
+/*!
+    Switch the next wave of outputs when due
+*/
+void doScene( void );
+
+/*!
+    Read scene register (page REG_PAGE_SCENE)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t scene_readReg( uint8_t reg );
+
+/*!
+    Write scene register (page REG_PAGE_SCENE)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t scene_writeReg( uint8_t reg, uint8_t val );
+
+#endif
@@ -0,0 +1,634 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "shutter.h"
+
+// Data coding for the position report, integer format, unit 2 and the
+// channel as index
+#define SHUTTER_CODING              0x70
+
+// Motor index
+#define MOTOR_UP                    0
+#define MOTOR_DOWN                  1
+
+// RAM copy of EEPROM. Port is PIN_PORT_NONE for a channel not in use.
+uint8_t shutter_port[ SHUTTER_CHANNELS ][ 2 ];
+uint8_t shutter_mask[ SHUTTER_CHANNELS ][ 2 ];
+uint16_t shutter_travel[ SHUTTER_CHANNELS ][ 2 ];   // 10 ms
+uint16_t shutter_reverse[ SHUTTER_CHANNELS ];       // ms
+
+uint8_t shutter_state[ SHUTTER_CHANNELS ];
+uint8_t shutter_known[ SHUTTER_CHANNELS ];          // FALSE until an end stop
+uint8_t shutter_pending[ SHUTTER_CHANNELS ];        // TRUE until at target
+uint16_t shutter_pos[ SHUTTER_CHANNELS ];           // At start of move
+uint16_t shutter_goal[ SHUTTER_CHANNELS ];          // End of this move
+uint16_t shutter_target[ SHUTTER_CHANNELS ];        // Position asked for
+uint32_t shutter_planned[ SHUTTER_CHANNELS ];       // ms for this move
+
+volatile uint32_t shutter_run[ SHUTTER_CHANNELS ];  // ms left of move
+volatile uint16_t shutter_pause[ SHUTTER_CHANNELS ];    // ms left of pause
+volatile uint8_t shutter_done;                      // Arrived, bit per channel
+
+
+///////////////////////////////////////////////////////////////////////////////
+// writeMotor
+//
+// Turn one motor output on or both off. Interrupts are off so the tick
+// can't stop the motor between the read and the write.
+//
+
+static void writeMotor( uint8_t ch, uint8_t motor, uint8_t bOn )
+{
+    uint8_t i;
+    uint8_t gie;
+    uint8_t clr[ PIN_PORTS ];
+    uint8_t set[ PIN_PORTS ];
+
+    for ( i = 0; i < PIN_PORTS; i++ ) {
+        clr[ i ] = 0;
+        set[ i ] = 0;
+    }
+
+    clr[ shutter_port[ ch ][ MOTOR_UP ] ] |= shutter_mask[ ch ][ MOTOR_UP ];
+    clr[ shutter_port[ ch ][ MOTOR_DOWN ] ] |= shutter_mask[ ch ][ MOTOR_DOWN ];
+    if ( bOn ) {
+        set[ shutter_port[ ch ][ motor ] ] = shutter_mask[ ch ][ motor ];
+    }
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+
+    LATA = ( LATA & ~clr[ PIN_PORT_A ] ) | set[ PIN_PORT_A ];
+    LATB = ( LATB & ~clr[ PIN_PORT_B ] ) | set[ PIN_PORT_B ];
+    LATC = ( LATC & ~clr[ PIN_PORT_C ] ) | set[ PIN_PORT_C ];
+
+    INTCONbits.GIEH = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// load
+//
+
+static void load( uint8_t ch )
+{
+    uint8_t i;
+    uint8_t pin;
+    uint16_t addr;
+
+    addr = EEPROM_SHUTTER_CHANNELS + ch * SHUTTER_SIZE;
+
+    for ( i = 0; i < 2; i++ ) {
+
+        shutter_port[ ch ][ i ] = PIN_PORT_NONE;
+        shutter_mask[ ch ][ i ] = 0;
+        shutter_travel[ ch ][ i ] =
+            ( (uint16_t)eeprom_read( addr + SHUTTER_POS_UP_TIME + 2 * i ) << 8 ) |
+            eeprom_read( addr + SHUTTER_POS_UP_TIME + 2 * i + 1 );
+
+        pin = eeprom_read( addr + SHUTTER_POS_UP_PIN + i );
+        if ( PIN_MODE_OUTPUT != pins_getMode( pin ) ) continue;
+
+        shutter_port[ ch ][ i ] = pin_port[ pin - PIN_FIRST ];
+        shutter_mask[ ch ][ i ] = pin_mask[ pin - PIN_FIRST ];
+    }
+
+    shutter_reverse[ ch ] =
+        (uint16_t)eeprom_read( addr + SHUTTER_POS_REVERSE ) * 10;
+
+    // Both outputs and both travel times are needed
+    if ( ( PIN_PORT_NONE == shutter_port[ ch ][ MOTOR_UP ] ) ||
+            ( PIN_PORT_NONE == shutter_port[ ch ][ MOTOR_DOWN ] ) ||
+            ( eeprom_read( addr + SHUTTER_POS_UP_PIN ) ==
+                eeprom_read( addr + SHUTTER_POS_DOWN_PIN ) ) ||
+            !shutter_travel[ ch ][ MOTOR_UP ] ||
+            !shutter_travel[ ch ][ MOTOR_DOWN ] ) {
+        shutter_port[ ch ][ MOTOR_UP ] = PIN_PORT_NONE;
+        shutter_port[ ch ][ MOTOR_DOWN ] = PIN_PORT_NONE;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// position
+//
+// Position now. While moving it is worked out from the time left of
+// the move.
+//
+
+static uint16_t position( uint8_t ch )
+{
+    uint8_t gie;
+    uint8_t motor;
+    uint32_t left;
+    uint32_t delta;
+
+    if ( ( SHUTTER_UP != shutter_state[ ch ] ) &&
+            ( SHUTTER_DOWN != shutter_state[ ch ] ) ) {
+        return shutter_pos[ ch ];
+    }
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    left = shutter_run[ ch ];
+    INTCONbits.GIEL = gie;
+
+    motor = ( SHUTTER_UP == shutter_state[ ch ] ) ? MOTOR_UP : MOTOR_DOWN;
+
+    // In 10 ms so the product fits 32 bits
+    delta = ( ( shutter_planned[ ch ] - left ) / 10 ) * SHUTTER_FULL /
+                shutter_travel[ ch ][ motor ];
+
+    if ( MOTOR_UP == motor ) {
+        return ( delta >= shutter_pos[ ch ] ) ? 0 : shutter_pos[ ch ] - delta;
+    }
+
+    return ( ( shutter_pos[ ch ] + delta ) >= SHUTTER_FULL ) ?
+                SHUTTER_FULL : shutter_pos[ ch ] + delta;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// report
+//
+
+static void report( uint8_t ch )
+{
+    uint8_t data[ 2 ];
+
+    data[ 0 ] = SHUTTER_CODING | ch;
+    data[ 1 ] = ( shutter_pos[ ch ] + 50 ) / 100;
+
+    sendVSCPFrame( VSCP_CLASS1_DATA,
+                    VSCP_TYPE_DATA_IO,
+                    vscp_nickname,
+                    VSCP_PRIORITY_MEDIUM,
+                    2,
+                    data );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// halt
+//
+// Stop the motor and keep the position it got to.
+//
+
+static void halt( uint8_t ch )
+{
+    uint8_t gie;
+
+    shutter_pos[ ch ] = position( ch );
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    writeMotor( ch, MOTOR_UP, FALSE );
+    shutter_run[ ch ] = 0;
+    shutter_done &= ~( 1 << ch );
+    shutter_pause[ ch ] = shutter_reverse[ ch ];
+    INTCONbits.GIEL = gie;
+
+    shutter_state[ ch ] = SHUTTER_IDLE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// plan
+//
+// Time in ms to move from one position to another. Going to an end
+// position runs on for SHUTTER_OVERRUN % of the full travel time.
+//
+
+static uint32_t plan( uint8_t ch, uint8_t motor, uint16_t from, uint16_t to )
+{
+    uint32_t run;
+
+    run = ( from > to ) ? from - to : to - from;
+    run = run * shutter_travel[ ch ][ motor ] / ( SHUTTER_FULL / 10 );
+
+    if ( ( 0 == to ) || ( SHUTTER_FULL == to ) ) {
+        run += (uint32_t)shutter_travel[ ch ][ motor ] * SHUTTER_OVERRUN / 10;
+    }
+
+    return run;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// start
+//
+// Start the next move if one is waiting and the reverse pause is over.
+// With the position not known the shutter first goes to the end
+// nearest the target.
+//
+
+static void start( uint8_t ch )
+{
+    uint8_t gie;
+    uint8_t motor;
+    uint16_t pause;
+    uint16_t from;
+    uint16_t to;
+    uint32_t run;
+
+    if ( !shutter_pending[ ch ] ) return;
+    if ( SHUTTER_IDLE != shutter_state[ ch ] ) return;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    pause = shutter_pause[ ch ];
+    INTCONbits.GIEL = gie;
+
+    if ( pause ) return;
+
+    if ( shutter_known[ ch ] ) {
+        from = shutter_pos[ ch ];
+        to = shutter_target[ ch ];
+    }
+    else {
+        to = ( shutter_target[ ch ] >= ( SHUTTER_FULL / 2 ) ) ? SHUTTER_FULL : 0;
+        from = to ? 0 : SHUTTER_FULL;
+    }
+
+    motor = ( to < from ) ? MOTOR_UP : MOTOR_DOWN;
+    run = plan( ch, motor, from, to );
+
+    if ( !run ) {
+        shutter_pending[ ch ] = FALSE;
+        report( ch );
+        return;
+    }
+
+    shutter_pos[ ch ] = from;
+    shutter_goal[ ch ] = to;
+    shutter_planned[ ch ] = run;
+    shutter_state[ ch ] = ( MOTOR_UP == motor ) ? SHUTTER_UP : SHUTTER_DOWN;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    writeMotor( ch, motor, TRUE );
+    shutter_run[ ch ] = run;
+    INTCONbits.GIEL = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restart
+//
+// Stop a channel and load it again, position unknown. Low priority
+// interrupts must be off.
+//
+
+static void restart( uint8_t ch )
+{
+    // Motor of the old configuration off, the tick only stops motors
+    // with time left
+    if ( PIN_PORT_NONE != shutter_port[ ch ][ MOTOR_UP ] ) {
+        writeMotor( ch, MOTOR_UP, FALSE );
+    }
+
+    load( ch );
+    shutter_run[ ch ] = 0;
+    shutter_pause[ ch ] = 0;
+    shutter_state[ ch ] = SHUTTER_IDLE;
+    shutter_known[ ch ] = FALSE;
+    shutter_pending[ ch ] = FALSE;
+    shutter_pos[ ch ] = 0;
+    shutter_target[ ch ] = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// shutter_init
+//
+
+void shutter_init( void )
+{
+    uint8_t i;
+    uint8_t gie;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+
+    for ( i = 0; i < SHUTTER_CHANNELS; i++ ) {
+        restart( i );
+    }
+    shutter_done = 0;
+
+    INTCONbits.GIEL = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// shutter_pinChanged
+//
+
+void shutter_pinChanged( uint8_t pin )
+{
+    uint8_t i;
+    uint8_t gie;
+    uint16_t addr;
+
+    for ( i = 0; i < SHUTTER_CHANNELS; i++ ) {
+
+        addr = EEPROM_SHUTTER_CHANNELS + i * SHUTTER_SIZE;
+        if ( ( pin != eeprom_read( addr + SHUTTER_POS_UP_PIN ) ) &&
+                ( pin != eeprom_read( addr + SHUTTER_POS_DOWN_PIN ) ) ) {
+            continue;
+        }
+
+        gie = INTCONbits.GIEL;
+        INTCONbits.GIEL = 0;
+        restart( i );
+        shutter_done &= ~( 1 << i );
+        INTCONbits.GIEL = gie;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// shutter_init_eeprom
+//
+
+void shutter_init_eeprom( void )
+{
+    uint8_t i;
+    uint16_t addr;
+
+    for ( i = 0; i < SHUTTER_CHANNELS; i++ ) {
+        addr = EEPROM_SHUTTER_CHANNELS + i * SHUTTER_SIZE;
+        eeprom_write( addr + SHUTTER_POS_UP_PIN, 0 );
+        eeprom_write( addr + SHUTTER_POS_DOWN_PIN, 0 );
+        eeprom_write( addr + SHUTTER_POS_UP_TIME, SHUTTER_DEFAULT_TRAVEL >> 8 );
+        eeprom_write( addr + SHUTTER_POS_UP_TIME + 1, SHUTTER_DEFAULT_TRAVEL & 0xff );
+        eeprom_write( addr + SHUTTER_POS_DOWN_TIME, SHUTTER_DEFAULT_TRAVEL >> 8 );
+        eeprom_write( addr + SHUTTER_POS_DOWN_TIME + 1, SHUTTER_DEFAULT_TRAVEL & 0xff );
+        eeprom_write( addr + SHUTTER_POS_REVERSE, SHUTTER_DEFAULT_REVERSE );
+        eeprom_write( addr + SHUTTER_POS_REVERSE + 1, 0 );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// shutter_tick
+//
+
+void shutter_tick( void )
+{
+    uint8_t i;
+
+    for ( i = 0; i < SHUTTER_CHANNELS; i++ ) {
+
+        if ( shutter_run[ i ] ) {
+
+            if ( --shutter_run[ i ] ) continue;
+
+            // Arrived, both outputs off
+            switch ( shutter_port[ i ][ MOTOR_UP ] ) {
+                case PIN_PORT_A:
+                    LATA &= ~shutter_mask[ i ][ MOTOR_UP ];
+                    break;
+                case PIN_PORT_B:
+                    LATB &= ~shutter_mask[ i ][ MOTOR_UP ];
+                    break;
+                case PIN_PORT_C:
+                    LATC &= ~shutter_mask[ i ][ MOTOR_UP ];
+                    break;
+            }
+
+            switch ( shutter_port[ i ][ MOTOR_DOWN ] ) {
+                case PIN_PORT_A:
+                    LATA &= ~shutter_mask[ i ][ MOTOR_DOWN ];
+                    break;
+                case PIN_PORT_B:
+                    LATB &= ~shutter_mask[ i ][ MOTOR_DOWN ];
+                    break;
+                case PIN_PORT_C:
+                    LATC &= ~shutter_mask[ i ][ MOTOR_DOWN ];
+                    break;
+            }
+
+            shutter_done |= ( 1 << i );
+        }
+        else if ( shutter_pause[ i ] ) {
+            shutter_pause[ i ]--;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doShutter
+//
+
+void doShutter( void )
+{
+    uint8_t i;
+    uint8_t gie;
+    uint8_t done;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    done = shutter_done;
+    shutter_done = 0;
+    for ( i = 0; i < SHUTTER_CHANNELS; i++ ) {
+        if ( done & ( 1 << i ) ) {
+            shutter_pause[ i ] = shutter_reverse[ i ];
+        }
+    }
+    INTCONbits.GIEL = gie;
+
+    for ( i = 0; i < SHUTTER_CHANNELS; i++ ) {
+
+        if ( done & ( 1 << i ) ) {
+
+            shutter_state[ i ] = SHUTTER_IDLE;
+            shutter_pos[ i ] = shutter_goal[ i ];
+            if ( ( 0 == shutter_goal[ i ] ) || ( SHUTTER_FULL == shutter_goal[ i ] ) ) {
+                shutter_known[ i ] = TRUE;
+            }
+
+            // Else this was the move to an end stop to find the position
+            if ( shutter_goal[ i ] == shutter_target[ i ] ) {
+                shutter_pending[ i ] = FALSE;
+                report( i );
+            }
+        }
+
+        start( i );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// shutter_goto
+//
+
+void shutter_goto( uint8_t ch, uint8_t percent )
+{
+    uint8_t gie;
+    uint8_t motor;
+    uint16_t pos;
+    uint16_t target;
+    uint32_t run;
+
+    if ( ch >= SHUTTER_CHANNELS ) return;
+    if ( PIN_PORT_NONE == shutter_port[ ch ][ MOTOR_UP ] ) return;
+
+    target = ( ( percent > 100 ) ? 100 : percent ) * ( SHUTTER_FULL / 100 );
+
+    if ( ( SHUTTER_UP == shutter_state[ ch ] ) ||
+            ( SHUTTER_DOWN == shutter_state[ ch ] ) ) {
+
+        // Finding an end stop, go on to the new target after it
+        if ( !shutter_known[ ch ] ) {
+            shutter_target[ ch ] = target;
+            return;
+        }
+
+        // Same direction, move the stop point
+        pos = position( ch );
+        motor = ( SHUTTER_UP == shutter_state[ ch ] ) ? MOTOR_UP : MOTOR_DOWN;
+        if ( ( ( MOTOR_UP == motor ) && ( target < pos ) ) ||
+                ( ( MOTOR_DOWN == motor ) && ( target > pos ) ) ) {
+
+            run = plan( ch, motor, pos, target );
+            if ( !run ) run = 1;
+
+            gie = INTCONbits.GIEL;
+            INTCONbits.GIEL = 0;
+            if ( shutter_run[ ch ] ) {
+                shutter_run[ ch ] = run;
+                shutter_pos[ ch ] = pos;
+                shutter_goal[ ch ] = target;
+                shutter_target[ ch ] = target;
+                shutter_planned[ ch ] = run;
+                shutter_pending[ ch ] = TRUE;
+                INTCONbits.GIEL = gie;
+                return;
+            }
+            INTCONbits.GIEL = gie;
+
+            // Arrived just now, doShutter() reports it
+        }
+        else {
+            halt( ch );
+        }
+    }
+
+    shutter_target[ ch ] = target;
+    shutter_pending[ ch ] = TRUE;
+    start( ch );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// shutter_stop
+//
+
+void shutter_stop( uint8_t ch )
+{
+    if ( ch >= SHUTTER_CHANNELS ) return;
+
+    shutter_pending[ ch ] = FALSE;
+
+    if ( ( SHUTTER_UP != shutter_state[ ch ] ) &&
+            ( SHUTTER_DOWN != shutter_state[ ch ] ) ) {
+        return;
+    }
+
+    halt( ch );
+    report( ch );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// shutter_readReg
+//
+
+uint8_t shutter_readReg( uint8_t reg )
+{
+    uint8_t ch;
+    uint8_t gie;
+    uint16_t pause;
+
+    if ( reg < ( REG_SHUTTER_CHANNELS + SHUTTER_CHANNELS * SHUTTER_SIZE ) ) {
+        return eeprom_read( EEPROM_SHUTTER_CHANNELS + reg - REG_SHUTTER_CHANNELS );
+    }
+
+    if ( ( reg >= REG_SHUTTER_POSITION ) &&
+            ( reg < ( REG_SHUTTER_POSITION + SHUTTER_CHANNELS ) ) ) {
+        return ( position( reg - REG_SHUTTER_POSITION ) + 50 ) / 100;
+    }
+
+    if ( ( reg >= REG_SHUTTER_STATE ) &&
+            ( reg < ( REG_SHUTTER_STATE + SHUTTER_CHANNELS ) ) ) {
+        ch = reg - REG_SHUTTER_STATE;
+        if ( SHUTTER_IDLE != shutter_state[ ch ] ) return shutter_state[ ch ];
+        gie = INTCONbits.GIEL;
+        INTCONbits.GIEL = 0;
+        pause = shutter_pause[ ch ];
+        INTCONbits.GIEL = gie;
+        return ( shutter_pending[ ch ] && pause ) ? SHUTTER_WAIT : SHUTTER_IDLE;
+    }
+
+    if ( ( reg >= REG_SHUTTER_FINE ) &&
+            ( reg < ( REG_SHUTTER_FINE + SHUTTER_CHANNELS * 2 ) ) ) {
+        ch = ( reg - REG_SHUTTER_FINE ) >> 1;
+        if ( reg & 1 ) return position( ch ) & 0xff;
+        return ( position( ch ) >> 8 ) & 0xff;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// shutter_writeReg
+//
+
+uint8_t shutter_writeReg( uint8_t reg, uint8_t val )
+{
+    uint8_t ch;
+
+    if ( reg < ( REG_SHUTTER_CHANNELS + SHUTTER_CHANNELS * SHUTTER_SIZE ) ) {
+        ch = ( reg - REG_SHUTTER_CHANNELS ) / SHUTTER_SIZE;
+        shutter_stop( ch );
+        eeprom_write( EEPROM_SHUTTER_CHANNELS + reg - REG_SHUTTER_CHANNELS, val );
+        load( ch );
+        shutter_known[ ch ] = FALSE;
+        return shutter_readReg( reg );
+    }
+
+    if ( ( reg >= REG_SHUTTER_POSITION ) &&
+            ( reg < ( REG_SHUTTER_POSITION + SHUTTER_CHANNELS ) ) ) {
+        if ( val > 100 ) return ~val;
+        shutter_goto( reg - REG_SHUTTER_POSITION, val );
+        return val;
+    }
+
+    // Any write stops the shutter
+    if ( ( reg >= REG_SHUTTER_STATE ) &&
+            ( reg < ( REG_SHUTTER_STATE + SHUTTER_CHANNELS ) ) ) {
+        shutter_stop( reg - REG_SHUTTER_STATE );
+        return shutter_readReg( reg );
+    }
+
+    return ~val;
+}
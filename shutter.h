@@ -0,0 +1,115 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_SHUTTER_H
+#define ODESSA_SHUTTER_H
+
+// Shutter channels. Each channel drives a motor with one output for up
+// and one for down and keeps the position from the travel time. The
+// motor is stopped from the 1 ms tick so the position does not depend
+// on main loop or bus latency.
+#define SHUTTER_CHANNELS            4
+#define SHUTTER_SIZE                8   // EEPROM bytes per channel
+
+#define SHUTTER_POS_UP_PIN          0
+#define SHUTTER_POS_DOWN_PIN        1
+#define SHUTTER_POS_UP_TIME         2   // Full travel up (10 ms), MSB first
+#define SHUTTER_POS_DOWN_TIME       4   // Full travel down (10 ms), MSB first
+#define SHUTTER_POS_REVERSE         6   // Pause before next move (10 ms)
+
+#define SHUTTER_DEFAULT_TRAVEL      3000    // 30 s
+#define SHUTTER_DEFAULT_REVERSE     50      // 500 ms
+
+// Position in 0.01 %, 0 = up (open), SHUTTER_FULL = down (closed)
+#define SHUTTER_FULL                10000
+
+// Extra travel time in % when going to an end position, so the
+// position is right again after each end stop
+#define SHUTTER_OVERRUN             10
+
+// Channel states
+#define SHUTTER_IDLE                0
+#define SHUTTER_UP                  1
+#define SHUTTER_DOWN                2
+#define SHUTTER_WAIT                3   // Reverse pause before next move
+
+/*!
+    Load shutter channels from EEPROM. Call after pins_init().
+*/
+void shutter_init( void );
+
+/*!
+    Stop and restart the channels that use a pin after its mode has
+    changed. Other channels keep running.
+    @param pin Connector pin 3-20
+*/
+void shutter_pinChanged( uint8_t pin );
+
+/*!
+    Write default shutter configuration to EEPROM, no channels
+*/
+void shutter_init_eeprom( void );
+
+/*!
+    Count down travel and pause times and stop motors that have
+    arrived. Called from the 1 ms tick interrupt only.
+*/
+void shutter_tick( void );
+
+/*!
+    Report arrivals and start moves that are due
+*/
+void doShutter( void );
+
+/*!
+    Move a shutter to a position. A move in the other direction stops
+    the motor first and waits the reverse pause.
+    @param ch Channel 0-3
+    @param percent Position 0 (up) - 100 (down).
+*/
+void shutter_goto( uint8_t ch, uint8_t percent );
+
+/*!
+    Stop a shutter where it is
+    @param ch Channel 0-3
+*/
+void shutter_stop( uint8_t ch );
+
+/*!
+    Read shutter register (page REG_PAGE_SHUTTER)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t shutter_readReg( uint8_t reg );
+
+/*!
+    Write shutter register (page REG_PAGE_SHUTTER)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t shutter_writeReg( uint8_t reg, uint8_t val );
+
+#endif
@@ -0,0 +1,370 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include "odessa.h"
+#include "pins.h"
+#include "softpwm.h"
+
+// Timer4 setup for each bit. 1:16 prescaler, bit 0-4 by period, bit 5-7
+// by postscaler on a full 256 count period.
+const uint8_t softpwm_pr[ SOFTPWM_BITS ] = {
+    15, 31, 63, 127, 255, 255, 255, 255
+};
+
+const uint8_t softpwm_con[ SOFTPWM_BITS ] = {
+    0b00000110, 0b00000110, 0b00000110, 0b00000110,
+    0b00000110, 0b00001110, 0b00011110, 0b00111110
+};
+
+// Time stamp ticks per Timer4 count. Timer4 runs at Fosc/4 with a 1:16
+// prescaler, 1.6 us, the time stamp at 0.8 us.
+#define SOFTPWM_TMR4_TICKS          2
+
+// Context restore at the end of the low priority interrupt, which
+// can't be timed from inside it. Estimated from the instruction count
+// of the XC8 epilogue, about 40 cycles.
+#define SOFTPWM_ISR_EXIT            5
+
+// Bit planes, port bits to set for each bit of the level. Two sets so
+// the main loop can build one while the interrupt outputs the other.
+// The interrupt changes set at the start of a period.
+uint8_t softpwm_plane[ 2 ][ SOFTPWM_BITS ][ PIN_PORTS ];
+volatile uint8_t softpwm_active;    // Set in use by the interrupt
+volatile uint8_t softpwm_pending;   // TRUE when the other set is ready
+uint8_t softpwm_keep[ PIN_PORTS ];  // Port bits not in software PWM mode
+uint8_t softpwm_bit;                // Bit plane being output
+
+uint8_t softpwm_level[ PIN_COUNT ];
+uint8_t softpwm_dirty;              // TRUE when planes must be rebuilt
+uint8_t softpwm_channels;           // Pins in software PWM mode
+
+// Statistics
+volatile uint32_t softpwm_busy;     // Interrupt time this second (ticks)
+volatile uint16_t softpwm_isr_max;  // Longest interrupt (ticks)
+uint16_t softpwm_share;             // CPU share last second (0.01 %)
+uint16_t softpwm_build;             // Last plane build (ticks)
+volatile uint8_t softpwm_late;      // Slots started too late
+
+
+///////////////////////////////////////////////////////////////////////////////
+// softpwm_init
+//
+
+void softpwm_init( void )
+{
+    uint8_t i;
+    uint8_t k;
+    uint8_t gie;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+
+    T4CON = 0;
+    PIE4bits.TMR4IE = 0;
+    PIR4bits.TMR4IF = 0;
+
+    softpwm_keep[ PIN_PORT_A ] = 0xff;
+    softpwm_keep[ PIN_PORT_B ] = 0xff;
+    softpwm_keep[ PIN_PORT_C ] = 0xff;
+    softpwm_channels = 0;
+
+    for ( i = 0; i < PIN_COUNT; i++ ) {
+        if ( PIN_PORT_NONE == pin_port[ i ] ) continue;
+        if ( PIN_MODE_SOFTPWM == ( pin_mode[ i ] & PIN_MODE_MASK ) ) {
+            softpwm_keep[ pin_port[ i ] ] &= ~pin_mask[ i ];
+            softpwm_channels++;
+        }
+    }
+
+    // Planes may hold bits for pins no longer in this mode
+    for ( k = 0; k < SOFTPWM_BITS; k++ ) {
+        for ( i = 0; i < PIN_PORTS; i++ ) {
+            softpwm_plane[ 0 ][ k ][ i ] = 0;
+            softpwm_plane[ 1 ][ k ][ i ] = 0;
+        }
+    }
+
+    softpwm_active = 0;
+    softpwm_pending = FALSE;
+    softpwm_dirty = TRUE;
+    softpwm_busy = 0;
+    softpwm_isr_max = 0;
+
+    if ( softpwm_channels ) {
+
+        // First interrupt starts a period with bit 0
+        softpwm_bit = SOFTPWM_BITS - 1;
+        TMR4 = 0;
+        PR4 = softpwm_pr[ 0 ];
+        T4CON = softpwm_con[ 0 ];
+
+        IPR4bits.TMR4IP = 0;
+        PIE4bits.TMR4IE = 1;
+    }
+
+    INTCONbits.GIEL = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// softpwm_isr
+//
+// Timer4 has just started the next slot with the old period. It is
+// counting from zero so there is normally time to set the new one
+// before it matches. If the interrupt was held up for longer than the
+// new period the slot is ended at once, else it would run for a full
+// timer cycle.
+//
+
+void softpwm_isr( void )
+{
+    uint16_t start;
+    uint16_t stop;
+    uint8_t entry;
+    uint8_t *p;
+
+    // Timer4 has counted since the flag was set, which covers the
+    // context save and the handlers that ran before this one
+    entry = TMR4;
+    TIMESTAMP_READ( start );
+
+    PIR4bits.TMR4IF = 0;
+
+    softpwm_bit = ( softpwm_bit + 1 ) & ( SOFTPWM_BITS - 1 );
+    if ( ( 0 == softpwm_bit ) && softpwm_pending ) {
+        softpwm_active ^= 1;
+        softpwm_pending = FALSE;
+    }
+
+    p = softpwm_plane[ softpwm_active ][ softpwm_bit ];
+    LATA = ( LATA & softpwm_keep[ PIN_PORT_A ] ) | p[ PIN_PORT_A ];
+    LATB = ( LATB & softpwm_keep[ PIN_PORT_B ] ) | p[ PIN_PORT_B ];
+    LATC = ( LATC & softpwm_keep[ PIN_PORT_C ] ) | p[ PIN_PORT_C ];
+
+    PR4 = softpwm_pr[ softpwm_bit ];
+    T4CON = softpwm_con[ softpwm_bit ];
+    if ( TMR4 > PR4 ) {
+        TMR4 = PR4;
+        softpwm_late++;
+    }
+
+    TIMESTAMP_READ( stop );
+    stop -= start;
+    stop += (uint16_t)entry * SOFTPWM_TMR4_TICKS + SOFTPWM_ISR_EXIT;
+    softpwm_busy += stop;
+    if ( stop > softpwm_isr_max ) {
+        softpwm_isr_max = stop;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doSoftPWM
+//
+// The set not in use is rebuilt from all levels and handed to the
+// interrupt. If the interrupt has not taken the last one yet we wait.
+//
+
+void doSoftPWM( void )
+{
+    uint8_t i;
+    uint8_t k;
+    uint8_t level;
+    uint8_t port;
+    uint8_t mask;
+    uint8_t next;
+    uint16_t start;
+    uint16_t stop;
+
+    if ( !softpwm_dirty || softpwm_pending ) return;
+
+    TIMESTAMP_READ( start );
+
+    next = softpwm_active ^ 1;
+
+    for ( k = 0; k < SOFTPWM_BITS; k++ ) {
+        for ( i = 0; i < PIN_PORTS; i++ ) {
+            softpwm_plane[ next ][ k ][ i ] = 0;
+        }
+    }
+
+    for ( i = 0; i < PIN_COUNT; i++ ) {
+
+        if ( PIN_MODE_SOFTPWM != ( pin_mode[ i ] & PIN_MODE_MASK ) ) continue;
+
+        level = softpwm_level[ i ];
+        port = pin_port[ i ];
+        mask = pin_mask[ i ];
+
+        for ( k = 0; level; k++ ) {
+            if ( level & 1 ) {
+                softpwm_plane[ next ][ k ][ port ] |= mask;
+            }
+            level >>= 1;
+        }
+    }
+
+    softpwm_dirty = FALSE;
+    softpwm_pending = TRUE;
+
+    TIMESTAMP_READ( stop );
+    softpwm_build = stop - start;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// softpwm_oneSecond
+//
+
+void softpwm_oneSecond( void )
+{
+    uint32_t busy;
+
+    INTCONbits.GIEL = 0;
+    busy = softpwm_busy;
+    softpwm_busy = 0;
+    INTCONbits.GIEL = 1;
+
+    // 0.8 us ticks in a second to 0.01 %
+    softpwm_share = busy / 125;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// softpwm_setLevel
+//
+
+void softpwm_setLevel( uint8_t pin, uint8_t level )
+{
+    if ( ( pin < PIN_FIRST ) || ( pin > PIN_LAST ) ) return;
+
+    softpwm_level[ pin - PIN_FIRST ] = level;
+    softpwm_dirty = TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// softpwm_getLevel
+//
+
+uint8_t softpwm_getLevel( uint8_t pin )
+{
+    if ( ( pin < PIN_FIRST ) || ( pin > PIN_LAST ) ) return 0;
+
+    return softpwm_level[ pin - PIN_FIRST ];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// softpwm_dim
+//
+
+void softpwm_dim( uint8_t pin, uint8_t bUp, uint8_t step )
+{
+    uint8_t level;
+
+    if ( ( pin < PIN_FIRST ) || ( pin > PIN_LAST ) ) return;
+
+    level = softpwm_level[ pin - PIN_FIRST ];
+    if ( bUp ) {
+        level = ( level > ( 255 - step ) ) ? 255 : ( level + step );
+    }
+    else {
+        level = ( level < step ) ? 0 : ( level - step );
+    }
+
+    softpwm_setLevel( pin, level );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// softpwm_readReg
+//
+
+uint8_t softpwm_readReg( uint8_t reg )
+{
+    uint16_t max;
+
+    if ( reg <= REG_SOFTPWM_LEVEL_LAST ) {
+        return softpwm_level[ reg - REG_SOFTPWM_LEVEL ];
+    }
+
+    switch ( reg ) {
+
+        case REG_SOFTPWM_SHARE_MSB:
+            return ( softpwm_share >> 8 ) & 0xff;
+
+        case REG_SOFTPWM_SHARE_LSB:
+            return softpwm_share & 0xff;
+
+        case REG_SOFTPWM_ISR_MAX:
+            INTCONbits.GIEL = 0;
+            max = softpwm_isr_max;
+            INTCONbits.GIEL = 1;
+            max = TIMESTAMP_TO_US( max );
+            return ( max > 255 ) ? 255 : max;
+
+        case REG_SOFTPWM_LATE:
+            return softpwm_late;
+
+        case REG_SOFTPWM_CHANNELS:
+            return softpwm_channels;
+
+        case REG_SOFTPWM_BUILD_MSB:
+            return ( TIMESTAMP_TO_US( softpwm_build ) >> 8 ) & 0xff;
+
+        case REG_SOFTPWM_BUILD_LSB:
+            return TIMESTAMP_TO_US( softpwm_build ) & 0xff;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// softpwm_writeReg
+//
+// Levels can be written also for pins not in software PWM mode so they
+// can be set before the mode is changed.
+//
+
+uint8_t softpwm_writeReg( uint8_t reg, uint8_t val )
+{
+    if ( reg <= REG_SOFTPWM_LEVEL_LAST ) {
+        softpwm_setLevel( PIN_FIRST + reg - REG_SOFTPWM_LEVEL, val );
+        return val;
+    }
+
+    // Write to clear
+    if ( REG_SOFTPWM_ISR_MAX == reg ) {
+        INTCONbits.GIEL = 0;
+        softpwm_isr_max = 0;
+        INTCONbits.GIEL = 1;
+        return 0;
+    }
+    else if ( REG_SOFTPWM_LATE == reg ) {
+        softpwm_late = 0;
+        return 0;
+    }
+
+    return ~val;
+}
@@ -0,0 +1,93 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_SOFTPWM_H
+#define ODESSA_SOFTPWM_H
+
+// Software PWM by bit-angle modulation on Timer4. Bit n of the level is
+// output for 2^n time units, so a period is eight interrupts whatever the
+// number of channels. Each interrupt writes the three ports with masked
+// writes. A unit is 16 Timer4 counts at 1.6 us, 25.6 us, which gives a
+// period of 255 units, 6.5 ms or 153 Hz.
+#define SOFTPWM_BITS                8
+
+/*!
+    Set up software PWM from pin modes. Call after pins_init().
+*/
+void softpwm_init( void );
+
+/*!
+    Output next bit plane. Called from the low priority interrupt only.
+*/
+void softpwm_isr( void );
+
+/*!
+    Build bit planes for changed levels
+*/
+void doSoftPWM( void );
+
+/*!
+    Compute CPU share of the last second. Call once a second.
+*/
+void softpwm_oneSecond( void );
+
+/*!
+    Set level for a pin
+    @param pin Connector pin 3-20
+    @param level Level 0-255
+*/
+void softpwm_setLevel( uint8_t pin, uint8_t level );
+
+/*!
+    Get level for a pin
+    @param pin Connector pin 3-20
+    @return Level 0-255
+*/
+uint8_t softpwm_getLevel( uint8_t pin );
+
+/*!
+    Change level one step up or down
+    @param pin Connector pin 3-20
+    @param bUp TRUE to dim up, FALSE to dim down.
+    @param step Level change.
+*/
+void softpwm_dim( uint8_t pin, uint8_t bUp, uint8_t step );
+
+/*!
+    Read software PWM register (page REG_PAGE_SOFTPWM)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t softpwm_readReg( uint8_t reg );
+
+/*!
+    Write software PWM register (page REG_PAGE_SOFTPWM)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t softpwm_writeReg( uint8_t reg, uint8_t val );
+
+#endif
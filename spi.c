@@ -0,0 +1,460 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include "odessa.h"
+#include "pins.h"
+#include "spi.h"
+
+uint8_t spi_enabled;
+
+// Transfer queue. New transfers are added at head by the main loop, the
+// interrupt works on cur and the main loop takes finished transfers
+// from tail.
+spi_xfer_t spi_xfer[ SPI_QUEUE_SIZE ];
+uint8_t spi_head;
+volatile uint8_t spi_cur;
+uint8_t spi_tail;
+
+volatile uint8_t spi_busy;          // TRUE while a transfer is running
+uint8_t spi_idx;                    // Byte in transfer
+
+// Output extender
+uint8_t spi_ext_cs;                 // Latch pin, 0 = no extender
+uint8_t spi_ext_len;                // Registers in chain
+uint8_t spi_ext[ SPI_EXT_MAX ];     // Output state, byte 0 nearest
+uint8_t spi_ext_dirty;              // TRUE when the chain must be updated
+uint8_t spi_ext_queued;             // TRUE while an update is queued
+
+// Statistics
+volatile uint16_t spi_count;        // Transfers this second
+uint16_t spi_rate;                  // Transfers last second
+volatile uint16_t spi_isr_max;      // Longest interrupt (ticks)
+uint8_t spi_queue_full;             // Transfers not queued, queue full
+
+
+///////////////////////////////////////////////////////////////////////////////
+// csWrite
+//
+// Set chip select level. Called with the low priority interrupt
+// disabled or from it.
+//
+
+static void csWrite( uint8_t pin, uint8_t level )
+{
+    uint8_t mask;
+
+    mask = pin_mask[ pin - PIN_FIRST ];
+
+    switch ( pin_port[ pin - PIN_FIRST ] ) {
+
+        case PIN_PORT_A:
+            LATA = level ? ( LATA | mask ) : ( LATA & ~mask );
+            break;
+
+        case PIN_PORT_B:
+            LATB = level ? ( LATB | mask ) : ( LATB & ~mask );
+            break;
+
+        case PIN_PORT_C:
+            LATC = level ? ( LATC | mask ) : ( LATC & ~mask );
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// startXfer
+//
+// Select and send the first byte of the transfer at cur. Called with
+// the low priority interrupt disabled or from it.
+//
+
+static void startXfer( void )
+{
+    spi_xfer_t *p;
+
+    p = &spi_xfer[ spi_cur ];
+    spi_idx = 0;
+    spi_busy = TRUE;
+    csWrite( p->cs, 0 );
+    SSPBUF = p->data[ 0 ];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// spi_init
+//
+
+void spi_init( void )
+{
+    uint8_t mode;
+    uint8_t gie;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+
+    spi_enabled = ( PIN_MODE_SPI == pins_getMode( SPI_SCK_PIN ) ) &&
+                    ( PIN_MODE_SPI == pins_getMode( SPI_SDO_PIN ) );
+
+    spi_head = spi_cur = spi_tail = 0;
+    spi_busy = FALSE;
+    spi_ext_queued = FALSE;
+
+    spi_ext_cs = eeprom_read( EEPROM_SPI_EXT_CS );
+    spi_ext_len = eeprom_read( EEPROM_SPI_EXT_LEN );
+    if ( spi_ext_len > SPI_EXT_MAX ) spi_ext_len = SPI_EXT_MAX;
+    if ( PIN_MODE_OUTPUT != pins_getMode( spi_ext_cs ) ) {
+        spi_ext_cs = 0;
+    }
+
+    if ( spi_enabled ) {
+
+        // SCK and SDO are driven, SDI is an input
+        TRISCbits.TRISC3 = 0;
+        TRISCbits.TRISC5 = 0;
+
+        // Mode 0-3 is clock polarity and phase
+        mode = eeprom_read( EEPROM_SPI_MODE ) & 0x03;
+        SSPCON1 = 0;
+        SSPSTAT = ( mode & 0x01 ) ? 0x00 : 0x40;    // CKE
+        SSPCON1 = 0x20 |                            // SSPEN
+                    ( ( mode & 0x02 ) ? 0x10 : 0 ) |  // CKP
+                    ( eeprom_read( EEPROM_SPI_CLOCK ) & 0x03 );
+
+        PIR1bits.SSPIF = 0;
+        IPR1bits.SSPIP = 0;
+        PIE1bits.SSPIE = 1;
+
+        // Outputs to a known state
+        spi_ext_dirty = ( spi_ext_cs && spi_ext_len );
+        if ( spi_ext_cs ) csWrite( spi_ext_cs, 1 );
+    }
+
+    INTCONbits.GIEL = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// spi_init_eeprom
+//
+
+void spi_init_eeprom( void )
+{
+    eeprom_write( EEPROM_SPI_CLOCK, SPI_DEFAULT_CLOCK );
+    eeprom_write( EEPROM_SPI_MODE, 0 );
+    eeprom_write( EEPROM_SPI_EXT_CS, 0 );
+    eeprom_write( EEPROM_SPI_EXT_LEN, 0 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// spi_isr
+//
+// The byte sent has been clocked out and the byte received is in
+// SSPBUF. Chip select stays active between chained transfers.
+//
+
+void spi_isr( void )
+{
+    uint16_t start;
+    uint16_t stop;
+    spi_xfer_t *p;
+
+    TIMESTAMP_READ( start );
+
+    PIR1bits.SSPIF = 0;
+    p = &spi_xfer[ spi_cur ];
+
+    p->data[ spi_idx++ ] = SSPBUF;
+
+    if ( spi_idx < p->len ) {
+        SSPBUF = p->data[ spi_idx ];
+    }
+    else {
+
+        if ( !( p->flags & SPI_FLAG_CHAIN ) ) {
+            csWrite( p->cs, 1 );
+        }
+
+        p->status = SPI_STATUS_DONE;
+        spi_count++;
+        spi_cur = ( spi_cur + 1 ) & ( SPI_QUEUE_SIZE - 1 );
+
+        if ( spi_cur != spi_head ) {
+            startXfer();
+        }
+        else {
+            spi_busy = FALSE;
+        }
+    }
+
+    TIMESTAMP_READ( stop );
+    stop -= start;
+    if ( stop > spi_isr_max ) {
+        spi_isr_max = stop;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// spi_queue
+//
+
+uint8_t spi_queue( uint8_t cs,
+                    uint8_t flags,
+                    uint8_t len,
+                    uint8_t *pdata,
+                    uint8_t tag )
+{
+    uint8_t i;
+    uint8_t next;
+    spi_xfer_t *p;
+
+    if ( !spi_enabled ) return FALSE;
+    if ( ( 0 == len ) || ( len > SPI_DATA_MAX ) ) return FALSE;
+    if ( PIN_MODE_OUTPUT != pins_getMode( cs ) ) return FALSE;
+
+    next = ( spi_head + 1 ) & ( SPI_QUEUE_SIZE - 1 );
+    if ( next == spi_tail ) {
+        if ( spi_queue_full < 255 ) spi_queue_full++;
+        return FALSE;
+    }
+
+    p = &spi_xfer[ spi_head ];
+    p->cs = cs;
+    p->flags = flags;
+    p->len = len;
+    for ( i = 0; i < len; i++ ) {
+        p->data[ i ] = pdata[ i ];
+    }
+    p->status = SPI_STATUS_PENDING;
+    p->tag = tag;
+
+    INTCONbits.GIEL = 0;
+    spi_head = next;
+    if ( !spi_busy ) startXfer();
+    INTCONbits.GIEL = 1;
+
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// spi_setOutput
+//
+
+uint8_t spi_setOutput( uint8_t pin, uint8_t bActive )
+{
+    uint8_t bit;
+
+    if ( pin < SPI_EXT_FIRST ) return FALSE;
+    bit = pin - SPI_EXT_FIRST;
+    if ( bit >= ( 8 * spi_ext_len ) ) return FALSE;
+
+    if ( bActive ) {
+        spi_ext[ bit >> 3 ] |= ( 1 << ( bit & 7 ) );
+    }
+    else {
+        spi_ext[ bit >> 3 ] &= ~( 1 << ( bit & 7 ) );
+    }
+
+    spi_ext_dirty = TRUE;
+
+    return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// spi_setAll
+//
+
+void spi_setAll( uint8_t bActive )
+{
+    uint8_t i;
+
+    for ( i = 0; i < SPI_EXT_MAX; i++ ) {
+        spi_ext[ i ] = bActive ? 0xff : 0x00;
+    }
+
+    spi_ext_dirty = TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// spi_hasWork
+//
+
+uint8_t spi_hasWork( void )
+{
+    if ( !spi_enabled ) return FALSE;
+
+    return ( ( spi_tail != spi_cur ) ||
+                ( spi_ext_dirty && !spi_ext_queued && spi_ext_cs && spi_ext_len ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doSPI
+//
+// Changes to extender outputs are collected and sent as one transfer
+// with the farthest register first, so all outputs change together on
+// the latch edge.
+//
+
+void doSPI( void )
+{
+    uint8_t i;
+    uint8_t data[ SPI_EXT_MAX ];
+
+    if ( !spi_enabled ) return;
+
+    while ( spi_tail != spi_cur ) {
+        if ( SPI_TAG_EXTENDER == spi_xfer[ spi_tail ].tag ) {
+            spi_ext_queued = FALSE;
+        }
+        spi_tail = ( spi_tail + 1 ) & ( SPI_QUEUE_SIZE - 1 );
+    }
+
+    if ( !spi_ext_dirty || spi_ext_queued ) return;
+    if ( !spi_ext_cs || !spi_ext_len ) return;
+
+    for ( i = 0; i < spi_ext_len; i++ ) {
+        data[ i ] = spi_ext[ spi_ext_len - 1 - i ];
+    }
+
+    if ( spi_queue( spi_ext_cs, 0, spi_ext_len, data, SPI_TAG_EXTENDER ) ) {
+        spi_ext_dirty = FALSE;
+        spi_ext_queued = TRUE;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// spi_oneSecond
+//
+
+void spi_oneSecond( void )
+{
+    INTCONbits.GIEL = 0;
+    spi_rate = spi_count;
+    spi_count = 0;
+    INTCONbits.GIEL = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// spi_readReg
+//
+
+uint8_t spi_readReg( uint8_t reg )
+{
+    uint16_t max;
+
+    if ( ( reg >= REG_SPI_EXT_STATE ) &&
+            ( reg < ( REG_SPI_EXT_STATE + SPI_EXT_MAX ) ) ) {
+        return spi_ext[ reg - REG_SPI_EXT_STATE ];
+    }
+
+    switch ( reg ) {
+
+        case REG_SPI_CLOCK:
+            return eeprom_read( EEPROM_SPI_CLOCK );
+
+        case REG_SPI_MODE:
+            return eeprom_read( EEPROM_SPI_MODE );
+
+        case REG_SPI_EXT_CS:
+            return eeprom_read( EEPROM_SPI_EXT_CS );
+
+        case REG_SPI_EXT_LEN:
+            return eeprom_read( EEPROM_SPI_EXT_LEN );
+
+        case REG_SPI_RATE_MSB:
+            return ( spi_rate >> 8 ) & 0xff;
+
+        case REG_SPI_RATE_LSB:
+            return spi_rate & 0xff;
+
+        case REG_SPI_ISR_MAX:
+            INTCONbits.GIEL = 0;
+            max = spi_isr_max;
+            INTCONbits.GIEL = 1;
+            max = TIMESTAMP_TO_US( max );
+            return ( max > 255 ) ? 255 : max;
+
+        case REG_SPI_QUEUE_FULL:
+            return spi_queue_full;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// spi_writeReg
+//
+
+uint8_t spi_writeReg( uint8_t reg, uint8_t val )
+{
+    if ( ( reg >= REG_SPI_EXT_STATE ) &&
+            ( reg < ( REG_SPI_EXT_STATE + SPI_EXT_MAX ) ) ) {
+        spi_ext[ reg - REG_SPI_EXT_STATE ] = val;
+        spi_ext_dirty = TRUE;
+        return val;
+    }
+
+    switch ( reg ) {
+
+        case REG_SPI_CLOCK:
+            if ( val > SPI_CLOCK_625K ) return ~val;
+            eeprom_write( EEPROM_SPI_CLOCK, val );
+            spi_init();
+            return eeprom_read( EEPROM_SPI_CLOCK );
+
+        case REG_SPI_MODE:
+            if ( val > 3 ) return ~val;
+            eeprom_write( EEPROM_SPI_MODE, val );
+            spi_init();
+            return eeprom_read( EEPROM_SPI_MODE );
+
+        case REG_SPI_EXT_CS:
+            if ( val && ( PIN_MODE_OUTPUT != pins_getMode( val ) ) ) return ~val;
+            eeprom_write( EEPROM_SPI_EXT_CS, val );
+            spi_init();
+            return eeprom_read( EEPROM_SPI_EXT_CS );
+
+        case REG_SPI_EXT_LEN:
+            if ( val > SPI_EXT_MAX ) return ~val;
+            eeprom_write( EEPROM_SPI_EXT_LEN, val );
+            spi_init();
+            return eeprom_read( EEPROM_SPI_EXT_LEN );
+
+        // Write to clear
+        case REG_SPI_ISR_MAX:
+            INTCONbits.GIEL = 0;
+            spi_isr_max = 0;
+            INTCONbits.GIEL = 1;
+            return 0;
+
+        case REG_SPI_QUEUE_FULL:
+            spi_queue_full = 0;
+            return 0;
+    }
+
+    return ~val;
+}
@@ -0,0 +1,153 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_SPI_H
+#define ODESSA_SPI_H
+
+// SPI master on the MSSP, pin 5 (RC3/SCK), pin 6 (RC4/SDI) and pin 7
+// (RC5/SDO). Pin 5 and 7 must be in SPI mode, pin 6 only if data is
+// read. The MSSP is either SPI or I2C, set by the pin modes. Chip select
+// is any pin in output mode.
+#define SPI_SCK_PIN                 5
+#define SPI_SDI_PIN                 6
+#define SPI_SDO_PIN                 7
+
+// Transfer queue. Size must be a power of two.
+#define SPI_QUEUE_SIZE              4
+#define SPI_DATA_MAX                8
+
+// Transfer flags
+#define SPI_FLAG_CHAIN              0x01    // Keep chip select for next
+
+// Transfer status
+#define SPI_STATUS_PENDING          0
+#define SPI_STATUS_DONE             1
+
+// Transfer owners
+#define SPI_TAG_NONE                0xff
+#define SPI_TAG_EXTENDER            0xfe
+
+// Clock
+#define SPI_CLOCK_10M               0
+#define SPI_CLOCK_2M5               1
+#define SPI_CLOCK_625K              2
+
+#define SPI_DEFAULT_CLOCK           SPI_CLOCK_2M5
+
+// Output extender. Shift registers (74HC595) chained on SDO with the
+// latch on the chip select pin. Outputs are numbered from pin 21, pin
+// 21-28 is the register nearest the module.
+#define SPI_EXT_FIRST               21
+#define SPI_EXT_MAX                 4       // Bytes (registers) in chain
+
+typedef struct {
+    uint8_t cs;                     // Chip select pin 3-20
+    uint8_t flags;
+    uint8_t len;
+    uint8_t data[ SPI_DATA_MAX ];   // Data out, replaced by data in
+    uint8_t status;
+    uint8_t tag;                    // Owner of the result
+} spi_xfer_t;
+
+// TRUE when the MSSP is in SPI mode
+extern uint8_t spi_enabled;
+
+/*!
+    Set up SPI from pin modes. Call after i2c_init().
+*/
+void spi_init( void );
+
+/*!
+    Write default SPI configuration to EEPROM
+*/
+void spi_init_eeprom( void );
+
+/*!
+    Byte done. Called from the low priority interrupt only.
+*/
+void spi_isr( void );
+
+/*!
+    Queue a transfer
+    @param cs Chip select pin, must be in output mode.
+    @param flags SPI_FLAG_CHAIN to keep chip select active for the
+            next transfer.
+    @param len Bytes to transfer, 1-SPI_DATA_MAX.
+    @param pdata Data to send.
+    @param tag Owner of the result or SPI_TAG_NONE.
+    @return TRUE if queued, FALSE if not.
+*/
+uint8_t spi_queue( uint8_t cs,
+                    uint8_t flags,
+                    uint8_t len,
+                    uint8_t *pdata,
+                    uint8_t tag );
+
+/*!
+    Set an extender output
+    @param pin Extender pin from SPI_EXT_FIRST.
+    @param bActive TRUE to set, FALSE to clear.
+    @return TRUE if the pin exists.
+*/
+uint8_t spi_setOutput( uint8_t pin, uint8_t bActive );
+
+/*!
+    Set or clear all extender outputs
+    @param bActive TRUE to set, FALSE to clear.
+*/
+void spi_setAll( uint8_t bActive );
+
+/*!
+    Check for finished transfers or extender outputs to write
+    @return TRUE if doSPI() has work to do.
+*/
+uint8_t spi_hasWork( void );
+
+/*!
+    Retire finished transfers and update the extender chain
+*/
+void doSPI( void );
+
+/*!
+    Count transfers of the last second. Call once a second.
+*/
+void spi_oneSecond( void );
+
+/*!
+    Read SPI register (page REG_PAGE_SPI)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t spi_readReg( uint8_t reg );
+
+/*!
+    Write SPI register (page REG_PAGE_SPI)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t spi_writeReg( uint8_t reg, uint8_t val );
+
+#endif
@@ -0,0 +1,335 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "pwm.h"
+#include "host.h"
+
+// Registers
+volatile __INTCONbits_t INTCONbits;
+volatile __INTCON2bits_t INTCON2bits;
+volatile __PIR1bits_t PIR1bits;
+volatile uint8_t PORTA, PORTB, PORTC;
+volatile uint8_t LATA, LATB, LATC;
+volatile uint8_t TRISA, TRISB, TRISC;
+volatile uint8_t WPUB;
+volatile uint8_t TMR1L, TMR1H;
+
+// VSCP firmware
+vscpmsg vscp_imsg;
+vscpmsg vscp_omsg;
+uint8_t vscp_nickname = 0x42;
+
+uint8_t host_eeprom[ HOST_EEPROM_SIZE ];
+
+host_event_t host_events[ HOST_EVENTS ];
+uint8_t host_event_cnt;
+
+uint8_t host_set_cnt;
+uint8_t host_clr_cnt;
+
+uint16_t host_mv[ 5 ];
+uint8_t host_mv_valid;
+
+uint8_t host_pwm_level[ 3 ];
+uint8_t host_softpwm_level[ 18 ];
+
+uint8_t host_scene;
+uint8_t host_template;
+
+static int host_checks;
+static int host_failed;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// host_reset
+//
+
+void host_reset( void )
+{
+    memset( host_eeprom, 0xff, sizeof( host_eeprom ) );
+    memset( &vscp_imsg, 0, sizeof( vscp_imsg ) );
+
+    LATA = LATB = LATC = 0;
+    PORTA = PORTB = PORTC = 0;
+    INTCONbits.GIEH = 1;
+    INTCONbits.GIEL = 1;
+
+    memset( host_mv, 0, sizeof( host_mv ) );
+    host_mv_valid = 0;
+    memset( host_pwm_level, 0, sizeof( host_pwm_level ) );
+    memset( host_softpwm_level, 0, sizeof( host_softpwm_level ) );
+
+    host_clearEvents();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// host_clearEvents
+//
+
+void host_clearEvents( void )
+{
+    host_event_cnt = 0;
+    host_set_cnt = 0;
+    host_clr_cnt = 0;
+    host_scene = 0xff;
+    host_template = 0xff;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// host_setMode
+//
+
+void host_setMode( uint8_t pin, uint8_t mode )
+{
+    pins_writeReg( REG_PIN3_MODE + pin - PIN_FIRST, mode );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// latOf
+//
+
+static volatile uint8_t *latOf( uint8_t pin )
+{
+    switch ( pin_port[ pin - PIN_FIRST ] ) {
+        case PIN_PORT_A:
+            return &LATA;
+        case PIN_PORT_B:
+            return &LATB;
+    }
+
+    return &LATC;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// host_getLat
+//
+
+uint8_t host_getLat( uint8_t pin )
+{
+    return ( *latOf( pin ) & pin_mask[ pin - PIN_FIRST ] ) ? 1 : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// host_check
+//
+
+void host_check( int bOk, const char *pexpr, const char *pfile, int line )
+{
+    host_checks++;
+    if ( bOk ) return;
+
+    host_failed++;
+    printf( "%s:%d: check failed: %s\n", pfile, line, pexpr );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// host_done
+//
+
+int host_done( const char *pname )
+{
+    printf( "%s: %d checks, %d failed\n", pname, host_checks, host_failed );
+
+    return host_failed ? 1 : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// EEPROM
+//
+
+uint8_t eeprom_read( uint16_t addr )
+{
+    return ( addr < HOST_EEPROM_SIZE ) ? host_eeprom[ addr ] : 0xff;
+}
+
+void eeprom_write( uint16_t addr, uint8_t val )
+{
+    if ( addr < HOST_EEPROM_SIZE ) host_eeprom[ addr ] = val;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Events
+//
+
+static void record( uint16_t vscpclass, uint8_t vscptype,
+                        uint8_t size, uint8_t *pdata )
+{
+    host_event_t *pev;
+
+    if ( host_event_cnt >= HOST_EVENTS ) return;
+
+    pev = &host_events[ host_event_cnt++ ];
+    pev->vscp_class = vscpclass;
+    pev->vscp_type = vscptype;
+    pev->size = size;
+    memset( pev->data, 0, sizeof( pev->data ) );
+    if ( pdata && size ) memcpy( pev->data, pdata, ( size > 8 ) ? 8 : size );
+}
+
+// No rate limit unless ratelimit.c is linked
+__attribute__(( weak )) uint8_t ratelimit_take( uint16_t vscpclass, uint8_t vscptype )
+{
+    return TRUE;
+}
+
+__attribute__(( weak )) uint8_t ratelimit_hold( uint8_t pin, uint8_t vscptype )
+{
+    return FALSE;
+}
+
+int8_t sendVSCPFrame( uint16_t vscpclass, uint8_t vscptype, uint8_t nodeid,
+                        uint8_t priority, uint8_t size, uint8_t *pData )
+{
+    if ( !ratelimit_take( vscpclass, vscptype ) ) return FALSE;
+
+    record( vscpclass, vscptype, size, pData );
+    return TRUE;
+}
+
+// As in main.c
+void SendInformationEvent( unsigned char idx, unsigned char eventClass,
+                            unsigned char eventTypeId )
+{
+    uint8_t data[ 3 ];
+
+    if ( ( VSCP_CLASS1_INFORMATION == eventClass ) &&
+            ratelimit_hold( idx, eventTypeId ) ) {
+        return;
+    }
+
+    data[ 0 ] = idx - 3;
+    data[ 1 ] = 0;
+    data[ 2 ] = 0;
+    sendVSCPFrame( eventClass, eventTypeId, vscp_nickname,
+                    VSCP_PRIORITY_MEDIUM, 3, data );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Pin actions, as in main.c without interlock and extender pins
+//
+
+void actionSet( uint8_t dmflags, uint8_t param )
+{
+    if ( ( param < PIN_FIRST ) || ( param > PIN_LAST ) ) return;
+
+    host_set_cnt++;
+    *latOf( param ) |= pin_mask[ param - PIN_FIRST ];
+    SendInformationEvent( param, VSCP_CLASS1_INFORMATION,
+                            VSCP_TYPE_INFORMATION_ON );
+}
+
+void actionClr( uint8_t dmflags, uint8_t param )
+{
+    if ( ( param < PIN_FIRST ) || ( param > PIN_LAST ) ) return;
+
+    host_clr_cnt++;
+    *latOf( param ) &= ~pin_mask[ param - PIN_FIRST ];
+    SendInformationEvent( param, VSCP_CLASS1_INFORMATION,
+                            VSCP_TYPE_INFORMATION_OFF );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Other modules
+//
+
+uint8_t adc_getMillivolts( uint8_t ch, uint16_t *pmv )
+{
+    if ( ( ch >= 5 ) || !( host_mv_valid & ( 1 << ch ) ) ) return FALSE;
+
+    *pmv = host_mv[ ch ];
+    return TRUE;
+}
+
+uint8_t onewire_getTemp( uint8_t idx, int16_t *ptemp )
+{
+    return FALSE;
+}
+
+uint8_t inputs_getState( uint8_t pin )
+{
+    uint8_t port;
+
+    switch ( pin_port[ pin - PIN_FIRST ] ) {
+        case PIN_PORT_A:
+            port = PORTA;
+            break;
+        case PIN_PORT_B:
+            port = PORTB;
+            break;
+        default:
+            port = PORTC;
+            break;
+    }
+
+    return ( port & pin_mask[ pin - PIN_FIRST ] ) ? 1 : 0;
+}
+
+uint8_t pwm_channel( uint8_t pin )
+{
+    if ( PIN_MODE_PWM != pins_getMode( pin ) ) return PWM_NONE;
+    if ( 15 == pin ) return 0;
+    if ( 16 == pin ) return 1;
+    if ( 20 == pin ) return 2;
+
+    return PWM_NONE;
+}
+
+uint8_t pwm_getLevel( uint8_t ch )
+{
+    return ( ch < 3 ) ? host_pwm_level[ ch ] : 0;
+}
+
+void pwm_setLevel( uint8_t ch, uint8_t level )
+{
+    if ( ch < 3 ) host_pwm_level[ ch ] = level;
+}
+
+uint8_t softpwm_getLevel( uint8_t pin )
+{
+    return host_softpwm_level[ pin - PIN_FIRST ];
+}
+
+void softpwm_setLevel( uint8_t pin, uint8_t level )
+{
+    host_softpwm_level[ pin - PIN_FIRST ] = level;
+}
+
+void scene_recall( uint8_t idx )
+{
+    host_scene = idx;
+}
+
+void translate_send( uint8_t idx )
+{
+    host_template = idx;
+}
@@ -0,0 +1,106 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+#ifndef ODESSA_TEST_HOST_H
+#define ODESSA_TEST_HOST_H
+
+// Host stand-ins for the hardware and for the modules that are not
+// under test. Events sent and pins switched are recorded so a test can
+// check them.
+
+#include <stdint.h>
+
+#define HOST_EEPROM_SIZE            1024
+#define HOST_EVENTS                 64
+
+// Pin of a recorded information event
+#define HOST_EVENT_PIN( n )         ( host_events[ n ].data[ 0 ] + 3 )
+
+typedef struct {
+    uint16_t vscp_class;
+    uint8_t vscp_type;
+    uint8_t size;
+    uint8_t data[ 8 ];
+} host_event_t;
+
+extern uint8_t host_eeprom[ HOST_EEPROM_SIZE ];
+
+extern host_event_t host_events[ HOST_EVENTS ];
+extern uint8_t host_event_cnt;
+
+extern uint8_t host_set_cnt;        // actionSet() calls
+extern uint8_t host_clr_cnt;        // actionClr() calls
+
+extern uint16_t host_mv[ 5 ];       // ADC channel values
+extern uint8_t host_mv_valid;       // Bit per ADC channel
+
+extern uint8_t host_pwm_level[ 3 ];
+extern uint8_t host_softpwm_level[ 18 ];
+
+extern uint8_t host_scene;          // Last recalled scene, 0xff = none
+extern uint8_t host_template;       // Last sent template, 0xff = none
+
+/*!
+    Erase the EEPROM and clear all recorded state
+*/
+void host_reset( void );
+
+/*!
+    Forget recorded events and actions
+*/
+void host_clearEvents( void );
+
+/*!
+    Set a pin mode through the pin mode register
+    @param pin Pin 3-20.
+    @param mode PIN_MODE_xxx.
+*/
+void host_setMode( uint8_t pin, uint8_t mode );
+
+/*!
+    Latch state of an output pin
+    @param pin Pin 3-20.
+    @return 1 if the pin is on.
+*/
+uint8_t host_getLat( uint8_t pin );
+
+/*!
+    Record a test result
+    @param bOk Result.
+    @param pexpr Text of the checked expression.
+    @param pfile Source file.
+    @param line Source line.
+*/
+void host_check( int bOk, const char *pexpr, const char *pfile, int line );
+
+/*!
+    Print the summary
+    @param pname Test name.
+    @return Process exit code, 0 if all checks passed.
+*/
+int host_done( const char *pname );
+
+#define CHECK( expr )   host_check( ( expr ) ? 1 : 0, #expr, __FILE__, __LINE__ )
+
+#endif
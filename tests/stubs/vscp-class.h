@@ -0,0 +1,40 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+// Host build of the modules under test. Classes they use.
+
+#ifndef ODESSA_TEST_VSCP_CLASS_H
+#define ODESSA_TEST_VSCP_CLASS_H
+
+#define VSCP_CLASS1_PROTOCOL        0
+#define VSCP_CLASS1_ALARM           1
+#define VSCP_CLASS1_MEASUREMENT     10
+#define VSCP_CLASS1_DATA            15
+#define VSCP_CLASS1_INFORMATION     20
+#define VSCP_CLASS1_CONTROL         30
+#define VSCP_CLASS1_MEASUREMENT64   60
+#define VSCP_CLASS1_MEASUREZONE     65
+#define VSCP_CLASS1_MEASUREMENT32   70
+
+#endif
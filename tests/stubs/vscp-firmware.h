@@ -0,0 +1,51 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+// Host build of the modules under test. The parts of the VSCP firmware
+// they use.
+
+#ifndef ODESSA_TEST_VSCP_FIRMWARE_H
+#define ODESSA_TEST_VSCP_FIRMWARE_H
+
+#include <stdint.h>
+
+#define VSCP_PRIORITY_MEDIUM        3
+
+typedef struct {
+    uint8_t flags;                  // Size in bit 0-3
+    uint8_t priority;
+    uint16_t vscp_class;
+    uint8_t vscp_type;
+    uint8_t oaddr;
+    uint8_t data[ 8 ];
+} vscpmsg;
+
+extern vscpmsg vscp_imsg;
+extern vscpmsg vscp_omsg;
+extern uint8_t vscp_nickname;
+
+int8_t sendVSCPFrame( uint16_t vscpclass, uint8_t vscptype, uint8_t nodeid,
+                        uint8_t priority, uint8_t size, uint8_t *pData );
+
+#endif
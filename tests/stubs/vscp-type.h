@@ -0,0 +1,37 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+// Host build of the modules under test. Types they use.
+
+#ifndef ODESSA_TEST_VSCP_TYPE_H
+#define ODESSA_TEST_VSCP_TYPE_H
+
+#define VSCP_TYPE_INFORMATION_BUTTON            1
+#define VSCP_TYPE_INFORMATION_ON                3
+#define VSCP_TYPE_INFORMATION_OFF               4
+#define VSCP_TYPE_INFORMATION_NODE_HEARTBEAT    9
+#define VSCP_TYPE_MEASUREMENT_TEMPERATURE       6
+#define VSCP_TYPE_DATA_IO                       1
+
+#endif
@@ -0,0 +1,59 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+// Host build of the modules under test. Only the registers they use
+// are here, as plain variables defined in host.c.
+
+#ifndef ODESSA_TEST_XC_H
+#define ODESSA_TEST_XC_H
+
+#include <stdint.h>
+
+typedef struct {
+    unsigned GIEH:1;
+    unsigned GIEL:1;
+} __INTCONbits_t;
+
+typedef struct {
+    unsigned RBPU:1;
+} __INTCON2bits_t;
+
+typedef struct {
+    unsigned TMR1IF:1;
+} __PIR1bits_t;
+
+extern volatile __INTCONbits_t INTCONbits;
+extern volatile __INTCON2bits_t INTCON2bits;
+extern volatile __PIR1bits_t PIR1bits;
+
+extern volatile uint8_t PORTA, PORTB, PORTC;
+extern volatile uint8_t LATA, LATB, LATC;
+extern volatile uint8_t TRISA, TRISB, TRISC;
+extern volatile uint8_t WPUB;
+extern volatile uint8_t TMR1L, TMR1H;
+
+uint8_t eeprom_read( uint16_t addr );
+void eeprom_write( uint16_t addr, uint8_t val );
+
+#endif
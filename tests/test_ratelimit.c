@@ -0,0 +1,287 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+// Token bucket maths of ratelimit.c
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "ratelimit.h"
+#include "host.h"
+
+extern uint32_t ratelimit_tokens[ RATELIMIT_BUCKETS ];
+
+
+///////////////////////////////////////////////////////////////////////////////
+// setup
+//
+
+static void setup( void )
+{
+    host_reset();
+    pins_init_eeprom();
+    pins_init();
+    ratelimit_init_eeprom();
+    ratelimit_init();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setBucket
+//
+
+static void setBucket( uint8_t bucket, uint8_t rate, uint8_t burst )
+{
+    ratelimit_writeReg( REG_RATELIMIT_BUCKETS + bucket * RATELIMIT_SIZE +
+                            RATELIMIT_POS_RATE, rate );
+    ratelimit_writeReg( REG_RATELIMIT_BUCKETS + bucket * RATELIMIT_SIZE +
+                            RATELIMIT_POS_BURST, burst );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// elapse
+//
+
+static void elapse( uint16_t ms )
+{
+    while ( ms-- ) {
+        ratelimit_tick();
+        if ( !( ms % 100 ) ) doRateLimit();
+    }
+    doRateLimit();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// takeAll
+//
+// Take events of a class until one is refused.
+//
+
+static uint16_t takeAll( uint16_t vscpclass )
+{
+    uint16_t n = 0;
+
+    while ( ( n < 1000 ) && ratelimit_take( vscpclass, VSCP_TYPE_INFORMATION_ON ) ) {
+        n++;
+    }
+
+    return n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// readWord
+//
+
+static uint16_t readWord( uint8_t reg )
+{
+    return ( (uint16_t)ratelimit_readReg( reg ) << 8 ) | ratelimit_readReg( reg + 1 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testBurst
+//
+// A full bucket gives its burst, then events are dropped and counted
+// per bucket.
+//
+
+static void testBurst( void )
+{
+    setup();
+
+    CHECK( RATELIMIT_DEFAULT_INFO_BURST == takeAll( VSCP_CLASS1_INFORMATION ) );
+    CHECK( 1 == readWord( REG_RATELIMIT_DROPPED + RATELIMIT_INFORMATION * 2 ) );
+    CHECK( 0 == readWord( REG_RATELIMIT_DROPPED + RATELIMIT_GLOBAL * 2 ) );
+
+    // Other classes have their own bucket but share the global one
+    CHECK( RATELIMIT_DEFAULT_BURST == takeAll( VSCP_CLASS1_MEASUREMENT ) );
+    CHECK( ( RATELIMIT_DEFAULT_GLOBAL_BURST - RATELIMIT_DEFAULT_INFO_BURST -
+                RATELIMIT_DEFAULT_BURST ) == takeAll( VSCP_CLASS1_DATA ) );
+    CHECK( 1 == readWord( REG_RATELIMIT_DROPPED + RATELIMIT_GLOBAL * 2 ) );
+    CHECK( 0 == readWord( REG_RATELIMIT_DROPPED + RATELIMIT_DATA * 2 ) );
+    CHECK( 0 == takeAll( VSCP_CLASS1_CONTROL ) );
+    CHECK( 2 == readWord( REG_RATELIMIT_DROPPED + RATELIMIT_GLOBAL * 2 ) );
+
+    // All measurement classes share a bucket
+    CHECK( 0 == takeAll( VSCP_CLASS1_MEASUREMENT32 ) );
+    CHECK( 2 == readWord( REG_RATELIMIT_DROPPED + RATELIMIT_MEASUREMENT * 2 ) );
+
+    // Write to clear
+    ratelimit_writeReg( REG_RATELIMIT_DROPPED, 0 );
+    CHECK( 0 == readWord( REG_RATELIMIT_DROPPED + RATELIMIT_INFORMATION * 2 ) );
+    CHECK( 0 == readWord( REG_RATELIMIT_DROPPED + RATELIMIT_GLOBAL * 2 ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testRefill
+//
+// A bucket gets rate / 1000 events each ms and is never filled above
+// its burst.
+//
+
+static void testRefill( void )
+{
+    uint16_t i;
+
+    setup();
+    setBucket( RATELIMIT_INFORMATION, 50, 30 );
+
+    takeAll( VSCP_CLASS1_INFORMATION );
+    CHECK( 0 == ratelimit_tokens[ RATELIMIT_INFORMATION ] );
+
+    // 50 events/s is one event each 20 ms
+    elapse( 19 );
+    CHECK( 950 == ratelimit_tokens[ RATELIMIT_INFORMATION ] );
+    CHECK( !ratelimit_ready( VSCP_CLASS1_INFORMATION ) );
+    elapse( 1 );
+    CHECK( ratelimit_ready( VSCP_CLASS1_INFORMATION ) );
+    CHECK( 1 == takeAll( VSCP_CLASS1_INFORMATION ) );
+
+    // 10 s fills up to the burst only
+    elapse( 10000 );
+    CHECK( 30 * RATELIMIT_TOKEN == ratelimit_tokens[ RATELIMIT_INFORMATION ] );
+    CHECK( 30 == takeAll( VSCP_CLASS1_INFORMATION ) );
+
+    // Ms counted by the tick saturate between two passes
+    ratelimit_tokens[ RATELIMIT_INFORMATION ] = 0;
+    for ( i = 0; i < 300; i++ ) ratelimit_tick();
+    doRateLimit();
+    CHECK( 255 * 50 == ratelimit_tokens[ RATELIMIT_INFORMATION ] );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testConfig
+//
+// Rate 0 is no limit, burst 0 is one event, a smaller burst takes
+// effect at once and the limit can be turned off.
+//
+
+static void testConfig( void )
+{
+    setup();
+
+    setBucket( RATELIMIT_DATA, 0, 0 );
+    setBucket( RATELIMIT_GLOBAL, 0, 0 );
+    CHECK( 1000 == takeAll( VSCP_CLASS1_DATA ) );
+
+    setBucket( RATELIMIT_DATA, 10, 0 );
+    CHECK( 1 == takeAll( VSCP_CLASS1_DATA ) );
+
+    setBucket( RATELIMIT_INFORMATION, 50, 5 );
+    CHECK( 5 * RATELIMIT_TOKEN == ratelimit_tokens[ RATELIMIT_INFORMATION ] );
+
+    // No tokens are taken while the limit is off
+    ratelimit_writeReg( REG_RATELIMIT_CONTROL, 0 );
+    CHECK( 1000 == takeAll( VSCP_CLASS1_INFORMATION ) );
+    CHECK( 5 * RATELIMIT_TOKEN == ratelimit_tokens[ RATELIMIT_INFORMATION ] );
+
+    ratelimit_writeReg( REG_RATELIMIT_CONTROL, RATELIMIT_CONTROL_ENABLE );
+    CHECK( 5 == takeAll( VSCP_CLASS1_INFORMATION ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testExempt
+//
+// Protocol events and heartbeats go out with empty buckets and take no
+// token.
+//
+
+static void testExempt( void )
+{
+    setup();
+
+    takeAll( VSCP_CLASS1_INFORMATION );
+    CHECK( ratelimit_take( VSCP_CLASS1_PROTOCOL, 0x20 ) );
+    CHECK( ratelimit_ready( VSCP_CLASS1_PROTOCOL ) );
+    CHECK( ratelimit_take( VSCP_CLASS1_INFORMATION,
+                            VSCP_TYPE_INFORMATION_NODE_HEARTBEAT ) );
+    CHECK( !ratelimit_take( VSCP_CLASS1_INFORMATION,
+                            VSCP_TYPE_INFORMATION_BUTTON ) );
+
+    // A smaller burst empties the global bucket down to it
+    setBucket( RATELIMIT_GLOBAL, 100, 2 );
+    CHECK( 2 == takeAll( VSCP_CLASS1_CONTROL ) );
+    CHECK( ratelimit_take( VSCP_CLASS1_PROTOCOL, 0x20 ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testHold
+//
+// A pin event is held when there is no token, a later event for the
+// pin replaces it and the state of the pin is sent when there is room.
+//
+
+static void testHold( void )
+{
+    setup();
+    host_setMode( 8, PIN_MODE_INPUT );
+
+    CHECK( !ratelimit_hold( 3, VSCP_TYPE_INFORMATION_ON ) );
+
+    takeAll( VSCP_CLASS1_INFORMATION );
+    CHECK( ratelimit_hold( 3, VSCP_TYPE_INFORMATION_ON ) );
+    CHECK( ratelimit_hold( 3, VSCP_TYPE_INFORMATION_OFF ) );
+    CHECK( ratelimit_hold( 8, VSCP_TYPE_INFORMATION_BUTTON ) );
+    CHECK( 2 == ratelimit_readReg( REG_RATELIMIT_PENDING ) );
+    CHECK( 3 == readWord( REG_RATELIMIT_HELD ) );
+    CHECK( 1 == readWord( REG_RATELIMIT_COALESCED ) );
+
+    // Pin 3 was switched on again without an event while held
+    LATC |= pin_mask[ 3 - PIN_FIRST ];
+
+    host_clearEvents();
+    elapse( 20 );
+    CHECK( 1 == host_event_cnt );
+    CHECK( 3 == HOST_EVENT_PIN( 0 ) );
+    CHECK( VSCP_TYPE_INFORMATION_ON == host_events[ 0 ].vscp_type );
+    CHECK( 1 == ratelimit_readReg( REG_RATELIMIT_PENDING ) );
+
+    // A pin with an event held has the next one held too, so they are
+    // not sent out of order
+    ratelimit_tokens[ RATELIMIT_INFORMATION ] = RATELIMIT_TOKEN;
+    CHECK( ratelimit_hold( 8, VSCP_TYPE_INFORMATION_ON ) );
+
+    elapse( 20 );
+    CHECK( 2 == host_event_cnt );
+    CHECK( 8 == HOST_EVENT_PIN( 1 ) );
+    CHECK( VSCP_TYPE_INFORMATION_ON == host_events[ 1 ].vscp_type );
+    CHECK( 0 == ratelimit_readReg( REG_RATELIMIT_PENDING ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int main( void )
+{
+    testBurst();
+    testRefill();
+    testConfig();
+    testExempt();
+    testHold();
+
+    return host_done( "ratelimit" );
+}
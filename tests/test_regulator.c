@@ -0,0 +1,400 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+// Control law and value decoding of regulator.c
+
+#include <string.h>
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "regulator.h"
+#include "host.h"
+
+extern regulator_channel_t regulator_channel[ REGULATOR_CHANNELS ];
+
+
+///////////////////////////////////////////////////////////////////////////////
+// setup
+//
+
+static void setup( void )
+{
+    host_reset();
+    pins_init_eeprom();
+    pins_init();
+    regulator_init_eeprom();
+    regulator_init();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// writeByte
+//
+
+static void writeByte( uint8_t ch, uint8_t pos, uint8_t val )
+{
+    regulator_writeReg( REG_REGULATOR_CHANNELS + ch * REGULATOR_SIZE + pos, val );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// writeWord
+//
+
+static void writeWord( uint8_t ch, uint8_t pos, uint16_t val )
+{
+    writeByte( ch, pos, val >> 8 );
+    writeByte( ch, pos + 1, val & 0xff );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// channel
+//
+// Channel 0 on ADC channel 0, run every 100 ms.
+//
+
+static void channel( uint8_t output, uint8_t flags, int16_t setpoint )
+{
+    writeByte( 0, REGULATOR_POS_SOURCE, REGULATOR_SOURCE_ADC );
+    writeByte( 0, REGULATOR_POS_INDEX, 0 );
+    writeByte( 0, REGULATOR_POS_OUTPUT, output );
+    writeByte( 0, REGULATOR_POS_FLAGS, flags );
+    writeWord( 0, REGULATOR_POS_SETPOINT, setpoint );
+    writeByte( 0, REGULATOR_POS_PERIOD, 1 );
+    host_mv_valid = 0x01;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// period
+//
+// Run control periods with the given ADC value.
+//
+
+static void period( uint16_t mv, uint8_t n )
+{
+    uint8_t i;
+
+    host_mv[ 0 ] = mv;
+
+    while ( n-- ) {
+        for ( i = 0; i < 100; i++ ) regulator_tick();
+        doRegulator();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// output
+//
+// Output in percent as read from the output register.
+//
+
+static uint8_t output( uint8_t ch )
+{
+    return regulator_readReg( REG_REGULATOR_OUTPUT + ch );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// value
+//
+
+static int16_t value( uint8_t ch )
+{
+    return ( regulator_readReg( REG_REGULATOR_VALUE + ch * 2 ) << 8 ) |
+                regulator_readReg( REG_REGULATOR_VALUE + ch * 2 + 1 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// measurement
+//
+// Put a CLASS1.MEASUREMENT temperature event in vscp_imsg.
+//
+
+static void measurement( uint8_t size, uint8_t d0, uint8_t d1, uint8_t d2,
+                            uint8_t d3 )
+{
+    memset( &vscp_imsg, 0, sizeof( vscp_imsg ) );
+    vscp_imsg.vscp_class = VSCP_CLASS1_MEASUREMENT;
+    vscp_imsg.vscp_type = VSCP_TYPE_MEASUREMENT_TEMPERATURE;
+    vscp_imsg.oaddr = 0x10;
+    vscp_imsg.flags = size;
+    vscp_imsg.data[ 0 ] = d0;
+    vscp_imsg.data[ 1 ] = d1;
+    vscp_imsg.data[ 2 ] = d2;
+    vscp_imsg.data[ 3 ] = d3;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testOnOff
+//
+// On/off control switches only outside the hysteresis band.
+//
+
+static void testOnOff( void )
+{
+    setup();
+    channel( 3, 0, 2000 );
+    writeWord( 0, REGULATOR_POS_HYSTERESIS, 50 );
+
+    period( 1900, 1 );
+    CHECK( 1 == host_getLat( 3 ) );
+    CHECK( 100 == output( 0 ) );
+    CHECK( 1900 == value( 0 ) );
+
+    period( 2040, 1 );
+    CHECK( 1 == host_getLat( 3 ) );
+
+    period( 2051, 1 );
+    CHECK( 0 == host_getLat( 3 ) );
+    CHECK( 0 == output( 0 ) );
+
+    period( 1960, 1 );
+    CHECK( 0 == host_getLat( 3 ) );
+
+    // A change of output is reported
+    host_clearEvents();
+    period( 1949, 1 );
+    CHECK( 1 == host_getLat( 3 ) );
+    CHECK( 2 == host_event_cnt );
+    CHECK( VSCP_TYPE_INFORMATION_ON == host_events[ 0 ].vscp_type );
+    CHECK( VSCP_CLASS1_DATA == host_events[ 1 ].vscp_class );
+    CHECK( VSCP_TYPE_DATA_IO == host_events[ 1 ].vscp_type );
+    CHECK( 100 == host_events[ 1 ].data[ 5 ] );
+
+    // Output on when the value is high
+    writeByte( 0, REGULATOR_POS_FLAGS, REGULATOR_FLAG_REVERSE );
+    period( 1949, 1 );
+    CHECK( 0 == host_getLat( 3 ) );
+    period( 2051, 1 );
+    CHECK( 1 == host_getLat( 3 ) );
+
+    // Output off without a value
+    host_mv_valid = 0;
+    period( 2051, 1 );
+    CHECK( 0 == host_getLat( 3 ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testProportional
+//
+// P output is kp / 256 0.01 % per unit, limited to 0-100 %, and
+// scaled to 0-255 on a PWM pin.
+//
+
+static void testProportional( void )
+{
+    setup();
+    host_setMode( 16, PIN_MODE_PWM );
+    channel( 16, REGULATOR_FLAG_PI, 1000 );
+    writeWord( 0, REGULATOR_POS_KP, 2560 );
+    writeWord( 0, REGULATOR_POS_KI, 0 );
+
+    period( 900, 1 );
+    CHECK( 10 == output( 0 ) );
+    CHECK( 26 == host_pwm_level[ 1 ] );
+
+    period( 100, 1 );
+    CHECK( 90 == output( 0 ) );
+    CHECK( 230 == host_pwm_level[ 1 ] );
+
+    period( 0, 1 );
+    CHECK( 100 == output( 0 ) );
+    CHECK( 255 == host_pwm_level[ 1 ] );
+
+    period( 1100, 1 );
+    CHECK( 0 == output( 0 ) );
+    CHECK( 0 == host_pwm_level[ 1 ] );
+
+    // The error is clamped so the product does not overflow
+    writeWord( 0, REGULATOR_POS_KP, 0xffff );
+    writeWord( 0, REGULATOR_POS_SETPOINT, 32767 );
+    period( 0, 1 );
+    CHECK( 100 == output( 0 ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testIntegral
+//
+// The integral grows ki / 256 0.01 % per unit and period and is kept
+// within 0-100 % so it does not wind up.
+//
+
+static void testIntegral( void )
+{
+    setup();
+    host_setMode( 16, PIN_MODE_PWM );
+    channel( 16, REGULATOR_FLAG_PI, 1000 );
+    writeWord( 0, REGULATOR_POS_KP, 0 );
+    writeWord( 0, REGULATOR_POS_KI, 256 );
+
+    period( 900, 5 );
+    CHECK( 5 == output( 0 ) );
+
+    period( 0, 100 );
+    CHECK( 100 == output( 0 ) );
+
+    period( 2000, 1 );
+    CHECK( 90 == output( 0 ) );
+
+    period( 2000, 20 );
+    CHECK( 0 == output( 0 ) );
+
+    period( 1000, 1 );
+    CHECK( 0 == output( 0 ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testWindow
+//
+// PI on an output pin is time proportioned over REGULATOR_WINDOW
+// periods.
+//
+
+static void testWindow( void )
+{
+    uint8_t i;
+    uint8_t on;
+
+    setup();
+    channel( 3, REGULATOR_FLAG_PI, 1000 );
+    writeWord( 0, REGULATOR_POS_KP, 6400 );
+    writeWord( 0, REGULATOR_POS_KI, 0 );
+
+    period( 900, 1 );
+    CHECK( 25 == output( 0 ) );
+
+    on = 0;
+    for ( i = 0; i < REGULATOR_WINDOW; i++ ) {
+        period( 900, 1 );
+        on += host_getLat( 3 );
+    }
+    CHECK( 25 == on );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testEvent
+//
+// Measurement events in integer and normalized integer coding are
+// scaled to 0.01 of the unit and limited to 16 bits.
+//
+
+static void testEvent( void )
+{
+    uint16_t i;
+
+    setup();
+    writeByte( 0, REGULATOR_POS_SOURCE, REGULATOR_SOURCE_EVENT );
+    writeByte( 0, REGULATOR_POS_TYPE, VSCP_TYPE_MEASUREMENT_TEMPERATURE );
+    writeByte( 0, REGULATOR_POS_INDEX, 1 );
+    writeByte( 0, REGULATOR_POS_OUTPUT, 3 );
+    writeWord( 0, REGULATOR_POS_SETPOINT, 2000 );
+    writeByte( 0, REGULATOR_POS_PERIOD, 1 );
+
+    // 21 in whole units
+    measurement( 3, 0x61, 0x00, 0x15, 0 );
+    regulator_event();
+    CHECK( 2100 == value( 0 ) );
+
+    // 21.5, exponent -1
+    measurement( 4, 0x81, 0x81, 0x00, 0xd7 );
+    regulator_event();
+    CHECK( 2150 == value( 0 ) );
+
+    // -5
+    measurement( 3, 0x61, 0xff, 0xfb, 0 );
+    regulator_event();
+    CHECK( -500 == value( 0 ) );
+
+    // 12.345, exponent -3, rounded down to 0.01
+    measurement( 4, 0x81, 0x83, 0x30, 0x39 );
+    regulator_event();
+    CHECK( 1234 == value( 0 ) );
+
+    // Limited to 16 bits
+    measurement( 4, 0x61, 0x01, 0x00, 0x00 );
+    regulator_event();
+    CHECK( 32767 == value( 0 ) );
+
+    // Other sensor index, type or format is not used
+    measurement( 3, 0x60, 0x00, 0x15, 0 );
+    regulator_event();
+    CHECK( 32767 == value( 0 ) );
+    measurement( 3, 0x21, 0x00, 0x15, 0 );
+    regulator_event();
+    CHECK( 32767 == value( 0 ) );
+
+    measurement( 3, 0x61, 0x00, 0x10, 0 );
+    regulator_event();
+    period( 0, 1 );
+    CHECK( 1 == host_getLat( 3 ) );
+
+    // Off when no value has been received for a while
+    for ( i = 0; i < REGULATOR_EVENT_TIMEOUT; i++ ) regulator_oneSecond();
+    period( 0, 1 );
+    CHECK( 0 == host_getLat( 3 ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testSetpoint
+//
+// A setpoint event is scaled to the unit of the source, mV for ADC.
+//
+
+static void testSetpoint( void )
+{
+    setup();
+    channel( 3, 0, 2000 );
+
+    measurement( 2, 0x60, 0x03, 0, 0 );
+    regulator_setpointEvent( 0 );
+    CHECK( 3000 == regulator_channel[ 0 ].setpoint );
+
+    measurement( 3, 0x80, 0x81, 0x19, 0 );
+    regulator_setpointEvent( 0 );
+    CHECK( 2500 == regulator_channel[ 0 ].setpoint );
+
+    // Kept when another parameter is written
+    writeWord( 0, REGULATOR_POS_HYSTERESIS, 10 );
+    CHECK( 2500 == regulator_channel[ 0 ].setpoint );
+
+    writeWord( 0, REGULATOR_POS_SETPOINT, 1500 );
+    CHECK( 1500 == regulator_channel[ 0 ].setpoint );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int main( void )
+{
+    testOnOff();
+    testProportional();
+    testIntegral();
+    testWindow();
+    testEvent();
+    testSetpoint();
+
+    return host_done( "regulator" );
+}
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+#
+# test_rulec.py - Checks of the rule compiler against rules.h
+#
+# Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+#                         http://www.grodansparadis.com
+#                         <akhe@grodansparadis.com>
+#
+# This work is licensed under the Creative Common
+# Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+# license is available in the top folder of this project (LICENSE) or here
+# http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+#
+# The code rulec.py produces is run by rules.c in test_rules.c. This
+# checks that both use the same opcodes and limits and that programs
+# rules.c would stop are refused.
+#
+# Usage: test_rulec.py
+#
+
+import os
+import re
+import sys
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', 'tools'))
+sys.dont_write_bytecode = True
+
+import rulec
+
+
+def defines(name):
+    """#define NAME value lines of a header"""
+    values = {}
+    with open(os.path.join(HERE, '..', name)) as f:
+        for line in f:
+            m = re.match(r'#define\s+(\w+)\s+(0x[0-9a-fA-F]+|\d+)\b', line)
+            if m:
+                values[m.group(1)] = int(m.group(2), 0)
+    return values
+
+
+def encode(statement):
+    """Code of one statement"""
+    return rulec.encode(rulec.Parser(rulec.tokenize(statement)).statement())
+
+
+class Header(unittest.TestCase):
+
+    def test_opcodes(self):
+        h = defines('rules.h')
+        ops = dict((k[len('RULE_OP_'):], v) for k, v in h.items()
+                   if k.startswith('RULE_OP_'))
+        self.assertEqual(ops, rulec.OP)
+
+    def test_limits(self):
+        h = defines('rules.h')
+        self.assertEqual(h['RULES_COUNT'], rulec.RULES)
+        self.assertEqual(h['RULES_CODE_SIZE'], rulec.CODE_SIZE)
+        self.assertEqual(h['RULES_STACK'], rulec.STACK)
+        self.assertEqual(h['RULES_STEPS'], rulec.STEPS)
+        self.assertEqual(h['RULES_VARS'], rulec.VARS)
+        self.assertEqual(h['RULES_TIMERS'], rulec.TIMERS)
+        self.assertEqual(h['RULES_TRIGGER_EVENT'], rulec.TRIGGER_EVENT)
+        self.assertEqual(h['RULES_TRIGGER_PERIODIC'], rulec.TRIGGER_PERIODIC)
+
+    def test_registers(self):
+        h = defines('odessa.h')
+        code, table, listing = rulec.compile_rules(
+            ['rule 2 every 300', 'set 3'])
+        regs = dict(((p, r), v) for p, r, v, d in rulec.registers(code, table))
+        self.assertEqual(regs[(h['REG_PAGE_RULE_CODE'], 0)], rulec.OP['SET'])
+        base = h['REG_RULES_TABLE'] + 2 * 4
+        self.assertEqual(regs[(h['REG_PAGE_RULES'], base + 1)],
+                         rulec.TRIGGER_PERIODIC)
+        self.assertEqual(regs[(h['REG_PAGE_RULES'], base + 2)], 3)
+
+
+class Encode(unittest.TestCase):
+
+    def test_push(self):
+        self.assertEqual(encode('var 0 = 255'),
+                         [0x80, 255, 0x93, 0])
+        self.assertEqual(encode('var 0 = 300'),
+                         [0xc0, 1, 44, 0x93, 0])
+        self.assertEqual(encode('var 0 = -1'),
+                         [0xc0, 0xff, 0xff, 0x93, 0])
+
+    def test_jumps(self):
+        # Jumps are relative to the next instruction
+        self.assertEqual(encode('if pin 3 then set 4'),
+                         [0x81, 3, 0x89, 2, 0x90, 4])
+        self.assertEqual(encode('if pin 3 then set 4 else clr 4'),
+                         [0x81, 3, 0x89, 4, 0x90, 4, 0x88, 2, 0x91, 4])
+
+    def test_precedence(self):
+        # not binds looser than compare, & tighter than +
+        self.assertEqual(encode('var 0 = not 1 + 2 & 3 == 4'),
+                         [0x80, 1, 0x80, 2, 0x80, 3, 0x1b, 0x10, 0x80, 4,
+                          0x15, 0x14, 0x93, 0])
+
+
+class Refused(unittest.TestCase):
+
+    def refused(self, text):
+        self.assertRaises(rulec.RuleError, rulec.compile_rules,
+                          text.splitlines())
+
+    def test_stack(self):
+        def nested(n):
+            return '1 + (' * (n - 1) + '1' + ')' * (n - 1)
+        rulec.compile_rules(['rule 0 on event',
+                             'var 0 = ' + nested(rulec.STACK)])
+        self.refused('rule 0 on event\nvar 0 = ' + nested(rulec.STACK + 1))
+
+    def test_budget(self):
+        sets = ', '.join(['set 3'] * (rulec.STEPS - 1))
+        rulec.compile_rules(['rule 0 on event', sets])
+        self.refused('rule 0 on event\n' + sets + ', set 3')
+
+    def test_code_area(self):
+        sets = ', '.join(['set 3'] * 40)
+        rulec.compile_rules(['rule 0 on event', sets])
+        self.refused('rule 0 on event\n%s\nrule 1 on event\n%s' % (sets, sets))
+
+    def test_ranges(self):
+        self.refused('rule 8 on event\nset 3')
+        self.refused('rule 0 on event\nset 21')
+        self.refused('rule 0 on event\nvar 8 = 1')
+        self.refused('rule 0 on event\ntimer 4 = 1')
+        self.refused('rule 0 on event\nsend 7')
+        self.refused('rule 0 on event\nvar 0 = data[8]')
+        self.refused('rule 0 every 50\nset 3')
+        self.refused('rule 0 every 150\nset 3')
+
+    def test_syntax(self):
+        self.refused('set 3')
+        self.refused('rule 0 on event\nrule 0 on event')
+        self.refused('rule 0 on event\nblink 3')
+        self.refused('rule 0 on event\nif pin 3 set 4')
+        self.refused('rule 0 on event\nset 3 4')
+
+
+if __name__ == '__main__':
+    unittest.main()
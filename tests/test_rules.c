@@ -0,0 +1,297 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+// Rules compiled by tools/rulec.py, run by rules.c
+
+#include <stdio.h>
+#include <string.h>
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "rules.h"
+#include "host.h"
+
+extern uint16_t rules_timer[ RULES_TIMERS ];
+
+
+///////////////////////////////////////////////////////////////////////////////
+// load
+//
+// Write the page:register=value lines of a rulec.py listing to the
+// rule registers. Other lines are the listing itself.
+//
+
+static int load( const char *pname )
+{
+    FILE *f;
+    char line[ 80 ];
+    unsigned page;
+    unsigned reg;
+    unsigned val;
+    int n = 0;
+
+    f = fopen( pname, "r" );
+    if ( NULL == f ) return 0;
+
+    while ( fgets( line, sizeof( line ), f ) ) {
+
+        if ( 3 != sscanf( line, "%u:%u=%x", &page, &reg, &val ) ) continue;
+
+        if ( REG_PAGE_RULE_CODE == page ) {
+            CHECK( val == rules_writeCode( reg, val ) );
+        }
+        else if ( REG_PAGE_RULES == page ) {
+            CHECK( val == rules_writeReg( reg, val ) );
+        }
+        else {
+            CHECK( 0 );
+        }
+        n++;
+    }
+
+    fclose( f );
+
+    return n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// event
+//
+
+static void event( uint16_t vscpclass, uint8_t vscptype, uint8_t size,
+                    uint8_t d0, uint8_t d1, uint8_t d2 )
+{
+    memset( &vscp_imsg, 0, sizeof( vscp_imsg ) );
+    vscp_imsg.vscp_class = vscpclass;
+    vscp_imsg.vscp_type = vscptype;
+    vscp_imsg.flags = size;
+    vscp_imsg.data[ 0 ] = d0;
+    vscp_imsg.data[ 1 ] = d1;
+    vscp_imsg.data[ 2 ] = d2;
+
+    rules_event();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// period
+//
+// Run n 100 ms periods.
+//
+
+static void period( uint8_t n )
+{
+    uint8_t i;
+
+    while ( n-- ) {
+        for ( i = 0; i < 100; i++ ) rules_tick();
+        doRules();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// var
+//
+
+static int16_t var( uint8_t idx )
+{
+    return ( rules_readReg( REG_RULES_VARS + idx * 2 ) << 8 ) |
+                rules_readReg( REG_RULES_VARS + idx * 2 + 1 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// runs
+//
+
+static uint16_t runs( uint8_t idx )
+{
+    return ( rules_readReg( REG_RULES_STATS + idx * 8 ) << 8 ) |
+                rules_readReg( REG_RULES_STATS + idx * 8 + 1 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testCompiled
+//
+// The rules in rules.txt.
+//
+
+static void testCompiled( const char *pname )
+{
+    uint8_t i;
+
+    host_reset();
+    pins_init_eeprom();
+    pins_init();
+    rules_init_eeprom();
+    rules_init();
+
+    CHECK( load( pname ) > RULES_CODE_SIZE );
+
+    // From EEPROM as after a reset
+    rules_init();
+    CHECK( RULES_TRIGGER_EVENT == rules_readReg( REG_RULES_TABLE + 1 ) );
+    CHECK( RULES_TRIGGER_PERIODIC == rules_readReg( REG_RULES_TABLE + 4 + 1 ) );
+    CHECK( 2 == rules_readReg( REG_RULES_TABLE + 4 + 2 ) );
+    CHECK( RULES_TRIGGER_OFF == rules_readReg( REG_RULES_TABLE + 4 * 4 + 1 ) );
+
+    // Rule 0 turns pin 3 on and starts timer 0, rule 2 finds no data
+    // byte 7 and recalls scene 5
+    event( VSCP_CLASS1_INFORMATION, VSCP_TYPE_INFORMATION_ON, 3, 0, 0, 5 );
+    CHECK( 1 == host_getLat( 3 ) );
+    CHECK( 60 == rules_timer[ 0 ] );
+    CHECK( 1 == var( 1 ) );
+    CHECK( -300 == var( 2 ) );
+    CHECK( 0 == host_getLat( 4 ) );
+    CHECK( 5 == host_scene );
+    CHECK( 1 == runs( 0 ) );
+    CHECK( 1 == runs( 2 ) );
+    CHECK( 0 == runs( 1 ) );
+
+    // Pin 3 is on already and is not switched again, only pin 4 is
+    host_clearEvents();
+    event( VSCP_CLASS1_INFORMATION, VSCP_TYPE_INFORMATION_ON, 3, 200, 0x1f, 5 );
+    CHECK( 1 == host_set_cnt );
+    CHECK( 2 == var( 1 ) );
+    CHECK( -85 == var( 2 ) );
+    CHECK( 1 == host_getLat( 4 ) );
+
+    event( VSCP_CLASS1_INFORMATION, VSCP_TYPE_INFORMATION_OFF, 3, 0xff, 0xff, 5 );
+    CHECK( 0 == host_getLat( 3 ) );
+    CHECK( 2 == var( 1 ) );
+    CHECK( -30 == var( 2 ) );
+
+    event( VSCP_CLASS1_CONTROL, VSCP_TYPE_INFORMATION_OFF, 3, 0xff, 0xff, 5 );
+    CHECK( 3 == var( 1 ) );
+
+    // Periodic rules, rule 1 every 200 ms and rule 3 every 100 ms
+    event( VSCP_CLASS1_INFORMATION, VSCP_TYPE_INFORMATION_ON, 3, 0, 0, 5 );
+    host_clearEvents();
+    period( 9 );
+    CHECK( 4 == var( 0 ) );
+    CHECK( 4 == runs( 1 ) );
+    CHECK( 9 == runs( 3 ) );
+    CHECK( 0xff == host_template );
+
+    period( 1 );
+    CHECK( 6 == host_template );
+    CHECK( 0 == var( 0 ) );
+
+    // Timer runs out, rule 1 turns pin 3 off
+    for ( i = 0; i < 59; i++ ) rules_oneSecond();
+    period( 2 );
+    CHECK( 1 == host_getLat( 3 ) );
+    rules_oneSecond();
+    period( 2 );
+    CHECK( 0 == host_getLat( 3 ) );
+
+    CHECK( RULES_ERR_NONE == rules_readReg( REG_RULES_ERROR ) );
+    for ( i = 0; i < RULES_COUNT; i++ ) {
+        CHECK( 0 == rules_readReg( REG_RULES_STATS + i * 8 + 6 ) );
+        CHECK( RULES_STEPS >= rules_readReg( REG_RULES_STATS + i * 8 + 3 ) );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// program
+//
+// Load a program by hand as rule 0, run on events.
+//
+
+static void program( const uint8_t *pcode, uint8_t size )
+{
+    uint8_t i;
+
+    host_reset();
+    pins_init_eeprom();
+    pins_init();
+    rules_init_eeprom();
+    rules_init();
+
+    for ( i = 0; i < size; i++ ) {
+        rules_writeCode( RULES_CODE_SIZE - size + i, pcode[ i ] );
+    }
+    rules_writeReg( REG_RULES_TABLE, RULES_CODE_SIZE - size );
+    rules_writeReg( REG_RULES_TABLE + 1, RULES_TRIGGER_EVENT );
+
+    event( VSCP_CLASS1_INFORMATION, VSCP_TYPE_INFORMATION_ON, 0, 0, 0, 0 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// testStopped
+//
+// Programs rulec.py would not produce are stopped.
+//
+
+static void testStopped( void )
+{
+    static const uint8_t loop[] = { RULE_OP_JMP, 0xfe };
+    static const uint8_t deep[] = { RULE_OP_CLASS, RULE_OP_CLASS, RULE_OP_CLASS,
+                                    RULE_OP_CLASS, RULE_OP_CLASS, RULE_OP_CLASS,
+                                    RULE_OP_CLASS, RULE_OP_CLASS, RULE_OP_CLASS,
+                                    RULE_OP_END };
+    static const uint8_t empty[] = { RULE_OP_ADD, RULE_OP_END };
+    static const uint8_t bad[] = { 0x3f, RULE_OP_END };
+    static const uint8_t past[] = { RULE_OP_PUSH };
+
+    program( loop, sizeof( loop ) );
+    CHECK( RULES_ERR_BUDGET == rules_readReg( REG_RULES_ERROR ) );
+    CHECK( RULES_STEPS == rules_readReg( REG_RULES_STATS + 2 ) );
+    CHECK( 1 == rules_readReg( REG_RULES_STATS + 6 ) );
+
+    program( deep, sizeof( deep ) );
+    CHECK( RULES_ERR_STACK == rules_readReg( REG_RULES_ERROR ) );
+
+    program( empty, sizeof( empty ) );
+    CHECK( RULES_ERR_STACK == rules_readReg( REG_RULES_ERROR ) );
+
+    program( bad, sizeof( bad ) );
+    CHECK( RULES_ERR_CODE == rules_readReg( REG_RULES_ERROR ) );
+
+    program( past, sizeof( past ) );
+    CHECK( RULES_ERR_CODE == rules_readReg( REG_RULES_ERROR ) );
+
+    // Write to clear
+    rules_writeReg( REG_RULES_ERROR, 0 );
+    CHECK( RULES_ERR_NONE == rules_readReg( REG_RULES_ERROR ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int main( int argc, char *argv[] )
+{
+    if ( argc != 2 ) {
+        printf( "usage: test_rules rules.lst\n" );
+        return 2;
+    }
+
+    testCompiled( argv[ 1 ] );
+    testStopped();
+
+    return host_done( "rules" );
+}
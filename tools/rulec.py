@@ -0,0 +1,407 @@
+#!/usr/bin/env python3
+#
+# rulec.py - Rule compiler for the Odessa expansion module
+#
+# Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+#                         http://www.grodansparadis.com
+#                         <akhe@grodansparadis.com>
+#
+# This work is licensed under the Creative Common
+# Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+# license is available in the top folder of this project (LICENSE) or here
+# http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+#
+# Compiles a rule file into register content for register page 14
+# (code) and page 15 (rule table). Output is a VSCP Works register
+# file (.reg) or a list of page:register=value lines.
+#
+# Usage: rulec.py [-l] [-o file] rules.txt
+#
+# Rule file
+#
+#   # Comment
+#   rule 0 on event
+#     if class == 20 and type == 3 and data[2] == 5 then set 3, timer 0 = 60
+#   rule 1 every 1000
+#     if timer 0 == 0 and pin 3 then clr 3
+#     var 0 = var 0 + 1
+#
+# A rule runs on each received event or every 100-25500 ms. Statements
+#
+#   if <expr> then <action>, ... [else <action>, ...]
+#   set <pin>               Turn pin 3-20 on
+#   clr <pin>               Turn pin 3-20 off
+#   out <pin> = <expr>      Pin on if expression is not zero
+#   var <n> = <expr>        Variable 0-7
+#   timer <n> = <expr>      Timer 0-3, seconds
+#   scene <n>               Recall scene 0-7
+#   send <n>                Send translation template 0-6
+#
+# Expressions use 16-bit signed values. Operators, lowest precedence
+# first: or, and, not, == != < > <= >=, + -, &. Values are numbers,
+# pin <n>, var <n>, timer <n>, class, type and data[<n>]. class, type
+# and data are -1 in a periodic rule or for a missing data byte.
+#
+
+import re
+import sys
+
+CODE_SIZE = 128
+RULES = 8
+STACK = 8
+STEPS = 64
+VARS = 8
+TIMERS = 4
+
+TRIGGER_OFF = 0
+TRIGGER_EVENT = 1
+TRIGGER_PERIODIC = 2
+
+# Opcodes, see rules.h
+OP = {
+    'END': 0x00, 'CLASS': 0x01, 'TYPE': 0x02,
+    'ADD': 0x10, 'SUB': 0x11, 'AND': 0x12, 'OR': 0x13, 'NOT': 0x14,
+    'EQ': 0x15, 'NE': 0x16, 'LT': 0x17, 'GT': 0x18, 'LE': 0x19,
+    'GE': 0x1a, 'BAND': 0x1b,
+    'PUSH': 0x80, 'PIN': 0x81, 'VAR': 0x82, 'TIMER': 0x83, 'DATA': 0x84,
+    'JMP': 0x88, 'JZ': 0x89,
+    'SET': 0x90, 'CLR': 0x91, 'OUT': 0x92, 'STORE': 0x93, 'START': 0x94,
+    'SCENE': 0x95, 'SEND': 0x96,
+    'PUSHW': 0xc0,
+}
+NAME = dict((v, k) for k, v in OP.items())
+
+COMPARE = {'==': 'EQ', '!=': 'NE', '<': 'LT', '>': 'GT', '<=': 'LE',
+           '>=': 'GE'}
+
+TOKEN = re.compile(r'\s*(0x[0-9a-fA-F]+|\d+|==|!=|<=|>=|[<>+\-&(),=\[\]]|'
+                   r'[A-Za-z_]+)')
+
+
+class RuleError(Exception):
+    pass
+
+
+def tokenize(text):
+    tokens = []
+    pos = 0
+    text = text.rstrip()
+    while pos < len(text):
+        m = TOKEN.match(text, pos)
+        if not m:
+            raise RuleError('unexpected "%s"' % text[pos:].strip())
+        tokens.append(m.group(1).lower())
+        pos = m.end()
+    return tokens
+
+
+class Parser:
+    """Compile one statement line to a list of (opcode, operands)"""
+
+    def __init__(self, tokens):
+        self.tokens = tokens
+        self.pos = 0
+
+    def peek(self):
+        if self.pos < len(self.tokens):
+            return self.tokens[self.pos]
+        return None
+
+    def take(self, expect=None):
+        tok = self.peek()
+        if tok is None or (expect is not None and tok != expect):
+            raise RuleError('expected "%s"' % (expect or 'more'))
+        self.pos += 1
+        return tok
+
+    def number(self, lo, hi):
+        tok = self.take()
+        try:
+            val = int(tok, 0)
+        except ValueError:
+            raise RuleError('expected a number, got "%s"' % tok)
+        if val < lo or val > hi:
+            raise RuleError('%d not in %d-%d' % (val, lo, hi))
+        return val
+
+    # Expressions
+
+    def expr(self):
+        code = self.and_expr()
+        while self.peek() == 'or':
+            self.take()
+            code += self.and_expr() + [('OR',)]
+        return code
+
+    def and_expr(self):
+        code = self.not_expr()
+        while self.peek() == 'and':
+            self.take()
+            code += self.not_expr() + [('AND',)]
+        return code
+
+    def not_expr(self):
+        if self.peek() == 'not':
+            self.take()
+            return self.not_expr() + [('NOT',)]
+        return self.compare()
+
+    def compare(self):
+        code = self.sum()
+        if self.peek() in COMPARE:
+            op = COMPARE[self.take()]
+            code += self.sum() + [(op,)]
+        return code
+
+    def sum(self):
+        code = self.band()
+        while self.peek() in ('+', '-'):
+            op = 'ADD' if self.take() == '+' else 'SUB'
+            code += self.band() + [(op,)]
+        return code
+
+    def band(self):
+        code = self.value()
+        while self.peek() == '&':
+            self.take()
+            code += self.value() + [('BAND',)]
+        return code
+
+    def value(self):
+        tok = self.peek()
+        if tok == '(':
+            self.take()
+            code = self.expr()
+            self.take(')')
+            return code
+        if tok == '-':
+            self.take()
+            return push(-self.number(0, 32768))
+        if tok == 'pin':
+            self.take()
+            return [('PIN', self.number(3, 20))]
+        if tok == 'var':
+            self.take()
+            return [('VAR', self.number(0, VARS - 1))]
+        if tok == 'timer':
+            self.take()
+            return [('TIMER', self.number(0, TIMERS - 1))]
+        if tok == 'class':
+            self.take()
+            return [('CLASS',)]
+        if tok == 'type':
+            self.take()
+            return [('TYPE',)]
+        if tok == 'data':
+            self.take()
+            self.take('[')
+            idx = self.number(0, 7)
+            self.take(']')
+            return [('DATA', idx)]
+        return push(self.number(0, 65535))
+
+    # Statements
+
+    def action(self):
+        tok = self.take()
+        if tok in ('set', 'clr'):
+            return [(tok.upper(), self.number(3, 20))]
+        if tok == 'scene':
+            return [('SCENE', self.number(0, 7))]
+        if tok == 'send':
+            return [('SEND', self.number(0, 6))]
+        if tok == 'out':
+            pin = self.number(3, 20)
+            self.take('=')
+            return self.expr() + [('OUT', pin)]
+        if tok == 'var':
+            idx = self.number(0, VARS - 1)
+            self.take('=')
+            return self.expr() + [('STORE', idx)]
+        if tok == 'timer':
+            idx = self.number(0, TIMERS - 1)
+            self.take('=')
+            return self.expr() + [('START', idx)]
+        raise RuleError('unknown action "%s"' % tok)
+
+    def actions(self):
+        code = self.action()
+        while self.peek() == ',':
+            self.take()
+            code += self.action()
+        return code
+
+    def statement(self):
+        if self.peek() != 'if':
+            code = self.actions()
+        else:
+            self.take()
+            cond = self.expr()
+            self.take('then')
+            then = self.actions()
+            if self.peek() == 'else':
+                self.take()
+                other = self.actions()
+                then += [('JMP', size(other))]
+                code = cond + [('JZ', size(then))] + then + other
+            else:
+                code = cond + [('JZ', size(then))] + then
+        if self.peek() is not None:
+            raise RuleError('unexpected "%s"' % self.peek())
+        return code
+
+
+def push(val):
+    if 0 <= val <= 255:
+        return [('PUSH', val)]
+    return [('PUSHW', (val >> 8) & 0xff, val & 0xff)]
+
+
+def size(code):
+    return sum(len(ins) for ins in code)
+
+
+def check(code):
+    """Check stack depth and the instruction budget. Jumps only go
+    forward so the longest path is at most all instructions."""
+    depth = 0
+    for ins in code:
+        op = OP[ins[0]]
+        if op in (OP['JMP'], OP['SET'], OP['CLR'], OP['SCENE'], OP['SEND'],
+                  OP['END'], OP['NOT']):
+            pass
+        elif op in (OP['JZ'], OP['OUT'], OP['STORE'], OP['START']) or \
+                OP['ADD'] <= op <= OP['BAND']:
+            depth -= 1
+        else:
+            depth += 1
+        if depth > STACK:
+            raise RuleError('expression too deep, stack is %d' % STACK)
+    if len(code) > STEPS:
+        raise RuleError('%d instructions, budget is %d' % (len(code), STEPS))
+
+
+def encode(code):
+    out = []
+    for ins in code:
+        if ins[0] in ('JMP', 'JZ') and ins[1] > 127:
+            raise RuleError('jump too long')
+        out.append(OP[ins[0]])
+        out += ins[1:]
+    return out
+
+
+def compile_rules(lines):
+    rules = {}
+    rule = None
+    for num, line in enumerate(lines, 1):
+        line = line.split('#', 1)[0].strip()
+        if not line:
+            continue
+        try:
+            tokens = tokenize(line)
+            if tokens[0] == 'rule':
+                p = Parser(tokens[1:])
+                idx = p.number(0, RULES - 1)
+                if idx in rules:
+                    raise RuleError('rule %d defined twice' % idx)
+                if p.take() == 'on':
+                    p.take('event')
+                    rules[idx] = [TRIGGER_EVENT, 0, []]
+                else:
+                    p.pos -= 1
+                    p.take('every')
+                    ms = p.number(100, 25500)
+                    if ms % 100:
+                        raise RuleError('period must be a multiple of 100 ms')
+                    rules[idx] = [TRIGGER_PERIODIC, ms // 100, []]
+                rule = rules[idx]
+                continue
+            if rule is None:
+                raise RuleError('statement outside a rule')
+            rule[2] += Parser(tokens).statement()
+        except RuleError as e:
+            raise RuleError('line %d: %s' % (num, e))
+
+    code = []
+    table = [(0, TRIGGER_OFF, 0)] * RULES
+    listing = []
+    for idx in sorted(rules):
+        trigger, period, body = rules[idx]
+        body = body + [('END',)]
+        try:
+            check(body)
+        except RuleError as e:
+            raise RuleError('rule %d: %s' % (idx, e))
+        table[idx] = (len(code), trigger, period)
+        listing.append('rule %d' % idx)
+        addr = len(code)
+        for ins in body:
+            listing.append('  %3d  %-6s %s' % (addr, ins[0],
+                           ' '.join(str(a) for a in ins[1:])))
+            addr += len(ins)
+        code += encode(body)
+    if len(code) > CODE_SIZE:
+        raise RuleError('%d bytes of code, code area is %d' %
+                        (len(code), CODE_SIZE))
+    code += [OP['END']] * (CODE_SIZE - len(code))
+    return code, table, listing
+
+
+def registers(code, table):
+    regs = []
+    for i, val in enumerate(code):
+        regs.append((14, i, val, 'Rule code %d' % i))
+    for i, (start, trigger, period) in enumerate(table):
+        regs.append((15, i * 4, start, 'Rule %d start' % i))
+        regs.append((15, i * 4 + 1, trigger, 'Rule %d trigger' % i))
+        regs.append((15, i * 4 + 2, period, 'Rule %d period' % i))
+    return regs
+
+
+def main(argv):
+    listing_only = False
+    outname = None
+    args = argv[1:]
+    while args and args[0].startswith('-'):
+        opt = args.pop(0)
+        if opt == '-l':
+            listing_only = True
+        elif opt == '-o' and args:
+            outname = args.pop(0)
+        else:
+            args = []
+    if len(args) != 1:
+        sys.stderr.write('usage: rulec.py [-l] [-o file] rules.txt\n')
+        return 2
+
+    with open(args[0]) as f:
+        try:
+            code, table, listing = compile_rules(f.readlines())
+        except RuleError as e:
+            sys.stderr.write('%s: %s\n' % (args[0], e))
+            return 1
+
+    if listing_only:
+        text = '\n'.join(listing) + '\n'
+        text += ''.join('%d:%d=0x%02x\n' % r[:3]
+                        for r in registers(code, table))
+    else:
+        text = '<?xml version = "1.0" encoding = "UTF-8" ?>\n<registerset>\n'
+        for page, reg, val, desc in registers(code, table):
+            text += ("<register offset='%d' page='%d'>\n"
+                     "<value>0x%02x</value>\n"
+                     "<description>%s</description>\n"
+                     "</register>\n" % (reg, page, val, desc))
+        text += '</registerset>\n'
+
+    if outname:
+        with open(outname, 'w') as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,254 @@
+#!/usr/bin/env python3
+#
+# synctest.py - Fire jitter test for synchronized switching over several
+#               Odessa nodes
+#
+# Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+#                         http://www.grodansparadis.com
+#                         <akhe@grodansparadis.com>
+#
+# This work is licensed under the Creative Common
+# Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+# license is available in the top folder of this project (LICENSE) or here
+# http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+#
+# Sends an arm event and a fire event to a set of nodes over and over,
+# waits for the fire report from each node and reads how late each node
+# wrote its outputs after the time set by the fire. Each node measures
+# this against its own receive time stamp, which is taken when the high
+# priority interrupt is entered. Entry is held off by the sections that
+# run with high priority interrupts off, so the spread of the late times
+# over the nodes in a round is a lower bound on the fire to output
+# jitter between them. The worst high priority interrupt latency of each
+# node (page 0 register 29-30) is read at the end, the spread plus the
+# largest of these is an upper bound.
+#
+# Usage: synctest.py [-i interface] [-c channel] [-n rounds]
+#                    [-l limit_us] [-s nickname]
+#                    -a class:type -f class:type node ...
+#
+# Each node needs a decision matrix row running SYNC-ARM (or
+# SYNC-ARM-SET/CLR) on the arm event and one running SYNC-FIRE with
+# the same delay on all nodes on the fire event. Events are sent with
+# zone and sub zone 255. Uses python-can, default socketcan on can0.
+#
+# The exit code is 1 if a node did not report a fire or the spread in
+# any round was above the limit (default 1000 us).
+#
+
+import sys
+import time
+
+import can
+
+CLASS1_PROTOCOL = 0
+CLASS1_DATA = 15
+TYPE_DATA_IO = 1
+TYPE_EXTENDED_PAGE_READ = 0x22
+TYPE_EXTENDED_PAGE_RESPONSE = 0x23
+
+PRIORITY_HIGH = 0
+PRIORITY_NORMAL = 3
+
+# Scene page, see odessa.h
+REG_PAGE_SCENE = 12
+REG_SCENE_SYNC_FIRES = 119          # Fires, late MSB, late LSB
+
+# Page 0, see odessa.h
+REG_IRQ_LATENCY_MAX_MSB = 29        # Max high priority latency (us)
+
+CODING_SYNC = 0x10
+
+REPORT_TIMEOUT = 1.0                # s
+READ_TIMEOUT = 0.5                  # s
+ARM_TO_FIRE = 0.05                  # s
+
+
+def can_id(priority, vscp_class, vscp_type, nickname):
+    return (priority << 26) | (vscp_class << 16) | (vscp_type << 8) | nickname
+
+
+def send(bus, priority, vscp_class, vscp_type, nickname, data):
+    bus.send(can.Message(arbitration_id=can_id(priority, vscp_class,
+                                               vscp_type, nickname),
+                         data=bytes(data), is_extended_id=True))
+
+
+def split_id(msg):
+    return ((msg.arbitration_id >> 16) & 0x1ff,
+            (msg.arbitration_id >> 8) & 0xff,
+            msg.arbitration_id & 0xff)
+
+
+def wait_reports(bus, nodes):
+    """Wait for the fire report of each node. Returns the nodes heard."""
+    heard = set()
+    end = time.monotonic() + REPORT_TIMEOUT
+    while heard != nodes:
+        left = end - time.monotonic()
+        if left <= 0:
+            break
+        msg = bus.recv(left)
+        if msg is None or not msg.is_extended_id:
+            continue
+        vscp_class, vscp_type, nickname = split_id(msg)
+        if (vscp_class == CLASS1_DATA and vscp_type == TYPE_DATA_IO and
+                nickname in nodes and len(msg.data) and
+                msg.data[0] == CODING_SYNC):
+            heard.add(nickname)
+    return heard
+
+
+def read_regs(bus, host, node, page, reg, count):
+    """Read count (at most 4) registers of a node, None on timeout."""
+    send(bus, PRIORITY_NORMAL, CLASS1_PROTOCOL, TYPE_EXTENDED_PAGE_READ, host,
+         [node, page >> 8, page & 0xff, reg, count])
+    end = time.monotonic() + READ_TIMEOUT
+    while True:
+        left = end - time.monotonic()
+        if left <= 0:
+            return None
+        msg = bus.recv(left)
+        if msg is None or not msg.is_extended_id:
+            continue
+        vscp_class, vscp_type, nickname = split_id(msg)
+        if (vscp_class == CLASS1_PROTOCOL and
+                vscp_type == TYPE_EXTENDED_PAGE_RESPONSE and
+                nickname == node and len(msg.data) >= 4 + count and
+                msg.data[3] == reg):
+            return msg.data[4:4 + count]
+
+
+def read_late(bus, host, node):
+    """Fire count and late time (us) of the last fire of a node."""
+    data = read_regs(bus, host, node, REG_PAGE_SCENE, REG_SCENE_SYNC_FIRES, 3)
+    if data is None:
+        return None
+    return data[0], (data[1] << 8) | data[2]
+
+
+def read_irq_latency(bus, host, node):
+    """Worst high priority interrupt latency (us) of a node."""
+    data = read_regs(bus, host, node, 0, REG_IRQ_LATENCY_MAX_MSB, 2)
+    if data is None:
+        return None
+    return (data[0] << 8) | data[1]
+
+
+def class_type(text):
+    vscp_class, vscp_type = text.split(':')
+    return int(vscp_class, 0), int(vscp_type, 0)
+
+
+def main(argv):
+    interface = 'socketcan'
+    channel = 'can0'
+    rounds = 100
+    limit = 1000
+    host = 0
+    arm = None
+    fire = None
+
+    args = argv[1:]
+    try:
+        while args and args[0].startswith('-'):
+            opt = args.pop(0)
+            val = args.pop(0)
+            if opt == '-i':
+                interface = val
+            elif opt == '-c':
+                channel = val
+            elif opt == '-n':
+                rounds = int(val, 0)
+            elif opt == '-l':
+                limit = int(val, 0)
+            elif opt == '-s':
+                host = int(val, 0)
+            elif opt == '-a':
+                arm = class_type(val)
+            elif opt == '-f':
+                fire = class_type(val)
+            else:
+                raise ValueError(opt)
+        nodes = [int(a, 0) for a in args]
+    except (ValueError, IndexError):
+        nodes = []
+
+    if not nodes or arm is None or fire is None:
+        sys.stderr.write('usage: synctest.py [-i interface] [-c channel] '
+                         '[-n rounds] [-l limit_us] [-s nickname]\n'
+                         '                   -a class:type -f class:type '
+                         'node ...\n')
+        return 2
+
+    bus = can.interface.Bus(channel=channel, interface=interface)
+
+    spreads = []
+    missed = 0
+    worst = 0
+
+    try:
+        for n in range(rounds):
+
+            send(bus, PRIORITY_NORMAL, arm[0], arm[1], host, [0, 255, 255])
+            time.sleep(ARM_TO_FIRE)
+            send(bus, PRIORITY_HIGH, fire[0], fire[1], host, [0, 255, 255])
+
+            heard = wait_reports(bus, set(nodes))
+            lates = {}
+            for node in sorted(heard):
+                result = read_late(bus, host, node)
+                if result is not None:
+                    lates[node] = result[1]
+
+            lost = [node for node in nodes if node not in lates]
+            missed += len(lost)
+
+            if len(lates) > 1:
+                spread = max(lates.values()) - min(lates.values())
+                spreads.append(spread)
+                worst = max(worst, spread)
+            else:
+                spread = None
+
+            print('%4d %s%s' % (n,
+                                ' '.join('%d:%d' % (node, lates[node])
+                                         for node in sorted(lates)),
+                                '' if spread is None else
+                                '  spread %d us' % spread) +
+                  (' missing %s' % ' '.join(str(x) for x in lost)
+                   if lost else ''))
+        # The receive time stamp of a node is late by at most this
+        latency = {}
+        for node in nodes:
+            result = read_irq_latency(bus, host, node)
+            if result is not None:
+                latency[node] = result
+    finally:
+        bus.shutdown()
+
+    if latency:
+        print('interrupt latency max %s' %
+              ' '.join('%d:%d' % (node, latency[node])
+                       for node in sorted(latency)))
+
+    if spreads:
+        spreads.sort()
+        print('rounds %d, spread mean %d us, 99%% %d us, max %d us, '
+              'missed %d' % (len(spreads), sum(spreads) // len(spreads),
+                             spreads[(len(spreads) * 99) // 100 - 1
+                                     if len(spreads) >= 100 else -1],
+                             worst, missed))
+        if latency:
+            print('spread upper bound %d us' %
+                  (worst + max(latency.values())))
+    else:
+        print('no rounds with two or more nodes, missed %d' % missed)
+
+    if missed or not spreads or worst > limit:
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
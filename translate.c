@@ -0,0 +1,216 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "translate.h"
+
+volatile uint16_t translate_cooldown[ TRANSLATE_TEMPLATES ];   // ms left
+
+// Statistics
+uint8_t translate_sent;
+uint8_t translate_suppressed;       // Not sent, in cooldown
+uint8_t translate_lost;             // Not sent, transmit ring full
+
+
+///////////////////////////////////////////////////////////////////////////////
+// translate_init
+//
+
+void translate_init( void )
+{
+    uint8_t i;
+    uint8_t gie;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    for ( i = 0; i < TRANSLATE_TEMPLATES; i++ ) {
+        translate_cooldown[ i ] = 0;
+    }
+    INTCONbits.GIEL = gie;
+
+    translate_sent = 0;
+    translate_suppressed = 0;
+    translate_lost = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// translate_init_eeprom
+//
+
+void translate_init_eeprom( void )
+{
+    uint8_t i;
+
+    // Class 0 templates are never sent
+    for ( i = 0; i < TRANSLATE_TEMPLATES * TRANSLATE_SIZE; i++ ) {
+        eeprom_write( EEPROM_TRANSLATE_TEMPLATES + i,
+                        ( TRANSLATE_POS_COOLDOWN == ( i % TRANSLATE_SIZE ) ) ?
+                            TRANSLATE_DEFAULT_COOLDOWN : 0 );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// translate_tick
+//
+
+void translate_tick( void )
+{
+    uint8_t i;
+
+    for ( i = 0; i < TRANSLATE_TEMPLATES; i++ ) {
+        if ( translate_cooldown[ i ] ) translate_cooldown[ i ]--;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// translate_send
+//
+// Protocol events (class 0) are never sent.
+//
+
+void translate_send( uint8_t idx )
+{
+    uint8_t i;
+    uint8_t src;
+    uint8_t size;
+    uint8_t copy;
+    int8_t offset;
+    uint16_t vscpclass;
+    uint16_t addr;
+    uint16_t cooldown;
+    uint8_t data[ 8 ];
+
+    if ( idx >= TRANSLATE_TEMPLATES ) return;
+
+    addr = EEPROM_TRANSLATE_TEMPLATES + idx * TRANSLATE_SIZE;
+
+    vscpclass = ( ( eeprom_read( addr + TRANSLATE_POS_CLASS_MSB ) & 0x01 ) << 8 ) |
+                    eeprom_read( addr + TRANSLATE_POS_CLASS_LSB );
+    if ( VSCP_CLASS1_PROTOCOL == vscpclass ) return;
+
+    INTCONbits.GIEL = 0;
+    cooldown = translate_cooldown[ idx ];
+    INTCONbits.GIEL = 1;
+
+    if ( cooldown ) {
+        if ( translate_suppressed < 255 ) translate_suppressed++;
+        return;
+    }
+
+    size = eeprom_read( addr + TRANSLATE_POS_SIZE ) & 0x0f;
+    if ( size > 8 ) size = 8;
+    copy = eeprom_read( addr + TRANSLATE_POS_COPY_MASK );
+    offset = (int8_t)eeprom_read( addr + TRANSLATE_POS_COPY_OFFSET );
+
+    for ( i = 0; i < size; i++ ) {
+        data[ i ] = eeprom_read( addr + TRANSLATE_POS_DATA + i );
+        if ( copy & ( 1 << i ) ) {
+            src = i + offset;
+            if ( src < ( vscp_imsg.flags & 0x0f ) ) {
+                data[ i ] = vscp_imsg.data[ src ];
+            }
+        }
+    }
+
+    if ( !sendVSCPFrame( vscpclass,
+                            eeprom_read( addr + TRANSLATE_POS_TYPE ),
+                            vscp_nickname,
+                            eeprom_read( addr + TRANSLATE_POS_SIZE ) >> 5,
+                            size,
+                            data ) ) {
+        if ( translate_lost < 255 ) translate_lost++;
+        return;
+    }
+
+    if ( translate_sent < 255 ) translate_sent++;
+
+    cooldown = (uint16_t)eeprom_read( addr + TRANSLATE_POS_COOLDOWN ) * 10;
+    INTCONbits.GIEL = 0;
+    translate_cooldown[ idx ] = cooldown;
+    INTCONbits.GIEL = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// translate_readReg
+//
+
+uint8_t translate_readReg( uint8_t reg )
+{
+    if ( reg < ( REG_TRANSLATE_TEMPLATES + TRANSLATE_TEMPLATES * TRANSLATE_SIZE ) ) {
+        return eeprom_read( EEPROM_TRANSLATE_TEMPLATES + reg - REG_TRANSLATE_TEMPLATES );
+    }
+
+    switch ( reg ) {
+
+        case REG_TRANSLATE_SENT:
+            return translate_sent;
+
+        case REG_TRANSLATE_SUPPRESSED:
+            return translate_suppressed;
+
+        case REG_TRANSLATE_LOST:
+            return translate_lost;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// translate_writeReg
+//
+
+uint8_t translate_writeReg( uint8_t reg, uint8_t val )
+{
+    if ( reg < ( REG_TRANSLATE_TEMPLATES + TRANSLATE_TEMPLATES * TRANSLATE_SIZE ) ) {
+        eeprom_write( EEPROM_TRANSLATE_TEMPLATES + reg - REG_TRANSLATE_TEMPLATES, val );
+        return eeprom_read( EEPROM_TRANSLATE_TEMPLATES + reg - REG_TRANSLATE_TEMPLATES );
+    }
+
+    switch ( reg ) {
+
+        // Write to clear
+        case REG_TRANSLATE_SENT:
+            translate_sent = 0;
+            return 0;
+
+        case REG_TRANSLATE_SUPPRESSED:
+            translate_suppressed = 0;
+            return 0;
+
+        case REG_TRANSLATE_LOST:
+            translate_lost = 0;
+            return 0;
+    }
+
+    return ~val;
+}
@@ -0,0 +1,87 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_TRANSLATE_H
+#define ODESSA_TRANSLATE_H
+
+// Event translation. The SEND-EVENT decision matrix action sends the
+// event in a template, with bytes optionally copied from the event that
+// triggered the row. A template is not sent again within its cooldown
+// time so two nodes that trigger each other can't flood the bus.
+// Seven templates fill the application registers of the page below the
+// counters, register 128 and up are the standard registers.
+#define TRANSLATE_TEMPLATES         7
+#define TRANSLATE_SIZE              16  // EEPROM bytes per template
+
+// Template layout
+#define TRANSLATE_POS_CLASS_MSB     0   // Bit 0 is class bit 8
+#define TRANSLATE_POS_CLASS_LSB     1
+#define TRANSLATE_POS_TYPE          2
+#define TRANSLATE_POS_SIZE          3   // Bit 0-3 size, bit 5-7 priority
+#define TRANSLATE_POS_COPY_MASK     4   // Data bytes copied from trigger
+#define TRANSLATE_POS_COPY_OFFSET   5   // Signed, trigger byte = byte + offset
+#define TRANSLATE_POS_COOLDOWN      6   // 10 ms
+#define TRANSLATE_POS_DATA          8   // 8 data bytes
+
+#define TRANSLATE_DEFAULT_COOLDOWN  10  // 100 ms
+
+/*!
+    Set up event translation
+*/
+void translate_init( void );
+
+/*!
+    Write default templates to EEPROM
+*/
+void translate_init_eeprom( void );
+
+/*!
+    Cooldown timers. Called from the 1 ms tick interrupt only.
+*/
+void translate_tick( void );
+
+/*!
+    Send the event in a template. vscp_imsg must hold the event that
+    triggered the action.
+    @param idx Template 0-6
+*/
+void translate_send( uint8_t idx );
+
+/*!
+    Read translation register (page REG_PAGE_TRANSLATE)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t translate_readReg( uint8_t reg );
+
+/*!
+    Write translation register (page REG_PAGE_TRANSLATE)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t translate_writeReg( uint8_t reg, uint8_t val );
+
+#endif
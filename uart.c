@@ -0,0 +1,484 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#include "vscp-compiler.h"
+#include "vscp-projdefs.h"
+
+#include <xc.h>
+#include <inttypes.h>
+#include <vscp-firmware.h>
+#include <vscp-class.h>
+#include <vscp-type.h>
+#include "odessa.h"
+#include "pins.h"
+#include "uart.h"
+#include "ratelimit.h"
+
+// SPBRGH:SPBRG for each baud rate code with BRG16 = 1 and BRGH = 1,
+// Fosc / ( 4 * baud ) - 1 at 40 MHz.
+const uint16_t uart_brg[ UART_BAUD_CODES ] = {
+    8332,   // 1200
+    4166,   // 2400
+    2082,   // 4800
+    1041,   // 9600
+    520,    // 19200
+    259,    // 38400
+    173,    // 57600
+    86,     // 115200 (-0.2 %)
+    42,     // 230400 (+0.9 %)
+    21      // 460800 (-1.4 %)
+};
+
+uint8_t uart_enabled;
+
+// Rings
+uint8_t uart_rx_ring[ UART_RX_RING_SIZE ];
+volatile uint8_t uart_rx_head;      // Written by interrupt
+uint8_t uart_rx_tail;               // Written by main loop
+uint8_t uart_tx_ring[ UART_TX_RING_SIZE ];
+uint8_t uart_tx_head;               // Written by main loop
+volatile uint8_t uart_tx_tail;      // Written by interrupt
+
+// Framing
+uint8_t uart_size;                  // Flush at this many bytes
+uint8_t uart_idle_time;             // Flush after this many ms idle
+uint8_t uart_flags;
+uint8_t uart_delimiter;
+uint8_t uart_peer;                  // Nickname we take TX data from
+uint8_t uart_frame[ 1 + UART_FRAME_MAX ];
+uint8_t uart_frame_len;
+uint8_t uart_flush;                 // TRUE when frame is ready to go
+uint8_t uart_seq;
+uint16_t uart_frame_start;          // ms clock at first byte of frame
+
+// Clocks, by tick
+volatile uint8_t uart_idle;         // ms since last received byte
+volatile uint16_t uart_ms;
+
+// Statistics
+volatile uint16_t uart_rx_count;    // Bytes this second
+volatile uint16_t uart_tx_count;
+uint16_t uart_rx_rate;              // Bytes last second
+uint16_t uart_tx_rate;
+uint16_t uart_latency_max;          // ms, first byte to frame sent
+volatile uint8_t uart_overruns;     // Receiver overruns
+volatile uint8_t uart_rx_lost;      // Bytes lost as receive ring was full
+uint8_t uart_tx_lost;               // Bytes lost as transmit ring was full
+volatile uint8_t uart_framing_errors;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// uart_now
+//
+
+static uint16_t uart_now( void )
+{
+    uint16_t now;
+
+    INTCONbits.GIEL = 0;
+    now = uart_ms;
+    INTCONbits.GIEL = 1;
+
+    return now;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// uart_init
+//
+// The EUSART takes over the pins, both are left as inputs.
+//
+
+void uart_init( void )
+{
+    uint8_t baud;
+    uint8_t gie;
+
+    gie = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+
+    PIE1bits.RC1IE = 0;
+    PIE1bits.TX1IE = 0;
+    RCSTA1 = 0;
+    TXSTA1 = 0;
+
+    uart_enabled = ( PIN_MODE_UART == pins_getMode( UART_RX_PIN ) ) &&
+                    ( PIN_MODE_UART == pins_getMode( UART_TX_PIN ) );
+
+    uart_size = eeprom_read( EEPROM_UART_SIZE );
+    if ( ( 0 == uart_size ) || ( uart_size > UART_FRAME_MAX ) ) {
+        uart_size = UART_FRAME_MAX;
+    }
+    uart_idle_time = eeprom_read( EEPROM_UART_IDLE );
+    uart_flags = eeprom_read( EEPROM_UART_FLAGS );
+    uart_delimiter = eeprom_read( EEPROM_UART_DELIMITER );
+    uart_peer = eeprom_read( EEPROM_UART_PEER );
+
+    uart_rx_head = uart_rx_tail = 0;
+    uart_tx_head = uart_tx_tail = 0;
+    uart_frame_len = 0;
+    uart_flush = FALSE;
+
+    if ( uart_enabled ) {
+
+        baud = eeprom_read( EEPROM_UART_BAUD );
+        if ( baud >= UART_BAUD_CODES ) baud = UART_DEFAULT_BAUD;
+
+        BAUDCON1 = 0b00001000;      // BRG16
+        SPBRGH1 = ( uart_brg[ baud ] >> 8 ) & 0xff;
+        SPBRG1 = uart_brg[ baud ] & 0xff;
+        TXSTA1 = 0b00100100;        // TXEN, BRGH, asynchronous
+        RCSTA1 = 0b10010000;        // SPEN, CREN
+
+        IPR1bits.RC1IP = 0;
+        IPR1bits.TX1IP = 0;
+        PIE1bits.RC1IE = 1;
+    }
+
+    INTCONbits.GIEL = gie;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// uart_init_eeprom
+//
+
+void uart_init_eeprom( void )
+{
+    eeprom_write( EEPROM_UART_BAUD, UART_DEFAULT_BAUD );
+    eeprom_write( EEPROM_UART_SIZE, UART_DEFAULT_SIZE );
+    eeprom_write( EEPROM_UART_IDLE, UART_DEFAULT_IDLE );
+    eeprom_write( EEPROM_UART_FLAGS, 0 );
+    eeprom_write( EEPROM_UART_DELIMITER, UART_DEFAULT_DELIMITER );
+    eeprom_write( EEPROM_UART_PEER, UART_DEFAULT_PEER );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// uart_tick
+//
+
+void uart_tick( void )
+{
+    uart_ms++;
+    if ( uart_idle < 255 ) uart_idle++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// uart_isr
+//
+// The receive FIFO holds two bytes so both are taken each time. An
+// overrun stops the receiver until it is restarted.
+//
+
+void uart_isr( void )
+{
+    uint8_t c;
+    uint8_t next;
+
+    while ( PIR1bits.RC1IF ) {
+
+        // Error flag is for the byte at the top of the FIFO
+        if ( RCSTA1bits.FERR ) uart_framing_errors++;
+        c = RCREG1;
+
+        next = ( uart_rx_head + 1 ) & ( UART_RX_RING_SIZE - 1 );
+        if ( next != uart_rx_tail ) {
+            uart_rx_ring[ uart_rx_head ] = c;
+            uart_rx_head = next;
+        }
+        else {
+            uart_rx_lost++;
+        }
+
+        uart_rx_count++;
+        uart_idle = 0;
+    }
+
+    if ( RCSTA1bits.OERR ) {
+        RCSTA1bits.CREN = 0;
+        RCSTA1bits.CREN = 1;
+        uart_overruns++;
+    }
+
+    if ( PIE1bits.TX1IE && PIR1bits.TX1IF ) {
+
+        if ( uart_tx_head != uart_tx_tail ) {
+            TXREG1 = uart_tx_ring[ uart_tx_tail ];
+            uart_tx_tail = ( uart_tx_tail + 1 ) & ( UART_TX_RING_SIZE - 1 );
+            uart_tx_count++;
+        }
+        else {
+            // Nothing more to send
+            PIE1bits.TX1IE = 0;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// uart_hasWork
+//
+
+uint8_t uart_hasWork( void )
+{
+    if ( !uart_enabled ) return FALSE;
+
+    return ( uart_flush || ( uart_rx_tail != uart_rx_head ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doUART
+//
+// Received bytes are collected in a frame that is sent when it holds
+// the set number of bytes, when the delimiter is received or when no
+// byte has been received for the idle time. If the transmit ring is
+// full the frame is kept and the receive ring takes up new bytes.
+//
+
+void doUART( void )
+{
+    uint8_t c;
+    uint16_t latency;
+
+    if ( !uart_enabled ) return;
+
+    while ( !uart_flush && ( uart_rx_tail != uart_rx_head ) ) {
+
+        c = uart_rx_ring[ uart_rx_tail ];
+        uart_rx_tail = ( uart_rx_tail + 1 ) & ( UART_RX_RING_SIZE - 1 );
+
+        if ( 0 == uart_frame_len ) {
+            uart_frame_start = uart_now();
+        }
+
+        uart_frame[ 1 + uart_frame_len ] = c;
+        uart_frame_len++;
+
+        if ( ( uart_frame_len >= uart_size ) ||
+                ( ( uart_flags & UART_FLAG_DELIMITER ) &&
+                    ( c == uart_delimiter ) ) ) {
+            uart_flush = TRUE;
+        }
+    }
+
+    // Line gone idle
+    if ( uart_frame_len && uart_idle_time &&
+            ( uart_rx_tail == uart_rx_head ) &&
+            ( uart_idle >= uart_idle_time ) ) {
+        uart_flush = TRUE;
+    }
+
+    if ( !uart_flush ) return;
+
+    // Kept and sent later, not dropped
+    if ( !ratelimit_ready( VSCP_CLASS1_INFORMATION ) ) return;
+
+    uart_frame[ 0 ] = uart_seq;
+    if ( !sendVSCPFrame( VSCP_CLASS1_INFORMATION,
+                            VSCP_TYPE_INFORMATION_STREAM_DATA,
+                            vscp_nickname,
+                            VSCP_PRIORITY_LOW,
+                            1 + uart_frame_len,
+                            uart_frame ) ) {
+        return;
+    }
+
+    uart_seq++;
+    uart_frame_len = 0;
+    uart_flush = FALSE;
+
+    latency = uart_now() - uart_frame_start;
+    if ( latency > uart_latency_max ) {
+        uart_latency_max = latency;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// uart_receiveEvent
+//
+
+void uart_receiveEvent( void )
+{
+    uint8_t i;
+    uint8_t next;
+
+    if ( !uart_enabled ) return;
+    if ( VSCP_CLASS1_INFORMATION != vscp_imsg.vscp_class ) return;
+    if ( VSCP_TYPE_INFORMATION_STREAM_DATA != vscp_imsg.vscp_type ) return;
+    if ( ( UART_DEFAULT_PEER != uart_peer ) &&
+            ( uart_peer != vscp_imsg.oaddr ) ) return;
+
+    // Byte 0 is the sequence number
+    for ( i = 1; i < ( vscp_imsg.flags & 0x0f ); i++ ) {
+
+        next = ( uart_tx_head + 1 ) & ( UART_TX_RING_SIZE - 1 );
+        if ( next == uart_tx_tail ) {
+            if ( uart_tx_lost < 255 ) uart_tx_lost++;
+            continue;
+        }
+
+        uart_tx_ring[ uart_tx_head ] = vscp_imsg.data[ i ];
+        uart_tx_head = next;
+    }
+
+    PIE1bits.TX1IE = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// uart_oneSecond
+//
+
+void uart_oneSecond( void )
+{
+    INTCONbits.GIEL = 0;
+    uart_rx_rate = uart_rx_count;
+    uart_tx_rate = uart_tx_count;
+    uart_rx_count = 0;
+    uart_tx_count = 0;
+    INTCONbits.GIEL = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// uart_readReg
+//
+
+uint8_t uart_readReg( uint8_t reg )
+{
+    switch ( reg ) {
+
+        case REG_UART_BAUD:
+            return eeprom_read( EEPROM_UART_BAUD );
+
+        case REG_UART_SIZE:
+            return eeprom_read( EEPROM_UART_SIZE );
+
+        case REG_UART_IDLE:
+            return eeprom_read( EEPROM_UART_IDLE );
+
+        case REG_UART_FLAGS:
+            return eeprom_read( EEPROM_UART_FLAGS );
+
+        case REG_UART_DELIMITER:
+            return eeprom_read( EEPROM_UART_DELIMITER );
+
+        case REG_UART_PEER:
+            return eeprom_read( EEPROM_UART_PEER );
+
+        case REG_UART_RX_RATE_MSB:
+            return ( uart_rx_rate >> 8 ) & 0xff;
+
+        case REG_UART_RX_RATE_LSB:
+            return uart_rx_rate & 0xff;
+
+        case REG_UART_TX_RATE_MSB:
+            return ( uart_tx_rate >> 8 ) & 0xff;
+
+        case REG_UART_TX_RATE_LSB:
+            return uart_tx_rate & 0xff;
+
+        case REG_UART_LATENCY_MSB:
+            return ( uart_latency_max >> 8 ) & 0xff;
+
+        case REG_UART_LATENCY_LSB:
+            return uart_latency_max & 0xff;
+
+        case REG_UART_OVERRUNS:
+            return uart_overruns;
+
+        case REG_UART_RX_LOST:
+            return uart_rx_lost;
+
+        case REG_UART_TX_LOST:
+            return uart_tx_lost;
+
+        case REG_UART_FRAMING_ERRORS:
+            return uart_framing_errors;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// uart_writeReg
+//
+
+uint8_t uart_writeReg( uint8_t reg, uint8_t val )
+{
+    switch ( reg ) {
+
+        case REG_UART_BAUD:
+            if ( val >= UART_BAUD_CODES ) return ~val;
+            eeprom_write( EEPROM_UART_BAUD, val );
+            uart_init();
+            return eeprom_read( EEPROM_UART_BAUD );
+
+        case REG_UART_SIZE:
+            if ( ( 0 == val ) || ( val > UART_FRAME_MAX ) ) return ~val;
+            eeprom_write( EEPROM_UART_SIZE, val );
+            uart_size = eeprom_read( EEPROM_UART_SIZE );
+            return uart_size;
+
+        case REG_UART_IDLE:
+            eeprom_write( EEPROM_UART_IDLE, val );
+            uart_idle_time = eeprom_read( EEPROM_UART_IDLE );
+            return uart_idle_time;
+
+        case REG_UART_FLAGS:
+            eeprom_write( EEPROM_UART_FLAGS, val );
+            uart_flags = eeprom_read( EEPROM_UART_FLAGS );
+            return uart_flags;
+
+        case REG_UART_DELIMITER:
+            eeprom_write( EEPROM_UART_DELIMITER, val );
+            uart_delimiter = eeprom_read( EEPROM_UART_DELIMITER );
+            return uart_delimiter;
+
+        case REG_UART_PEER:
+            eeprom_write( EEPROM_UART_PEER, val );
+            uart_peer = eeprom_read( EEPROM_UART_PEER );
+            return uart_peer;
+
+        // Write to clear
+        case REG_UART_LATENCY_MSB:
+        case REG_UART_LATENCY_LSB:
+            uart_latency_max = 0;
+            return 0;
+
+        case REG_UART_OVERRUNS:
+            uart_overruns = 0;
+            return 0;
+
+        case REG_UART_RX_LOST:
+            uart_rx_lost = 0;
+            return 0;
+
+        case REG_UART_TX_LOST:
+            uart_tx_lost = 0;
+            return 0;
+
+        case REG_UART_FRAMING_ERRORS:
+            uart_framing_errors = 0;
+            return 0;
+    }
+
+    return ~val;
+}
@@ -0,0 +1,121 @@
+/* ******************************************************************************
+ * 	VSCP (Very Simple Control Protocol) 
+ * 	http://www.vscp.org
+ *
+ *  Odessa expansion Module
+ *  ========================
+ *
+ *  Copyright (C)1995-2020 Ake Hedman, Grodans Paradis AB
+ *                          http://www.grodansparadis.com
+ *                          <akhe@grodansparadis.com>
+ *
+ *  This work is licensed under the Creative Common 
+ *  Attribution-NonCommercial-ShareAlike 3.0 Unported license. The full
+ *  license is available in the top folder of this project (LICENSE) or here
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/legalcode
+ *  It is also available in a human readable form here 
+ *  http://creativecommons.org/licenses/by-nc-sa/3.0/
+ * 
+ *	This file is part of VSCP - Very Simple Control Protocol 	
+ *	http://www.vscp.org
+ *
+ * ******************************************************************************
+ */
+
+
+#ifndef ODESSA_UART_H
+#define ODESSA_UART_H
+
+// UART on EUSART1, pin 3 (RC7/RX1) and pin 4 (RC6/TX1). Both pins must
+// be in UART mode. Received bytes are sent as stream data events and
+// stream data events are sent out on TX.
+#define UART_RX_PIN                 3
+#define UART_TX_PIN                 4
+
+// Rings between the interrupt and the main loop. Size must be a power
+// of two.
+#define UART_RX_RING_SIZE           64
+#define UART_TX_RING_SIZE           64
+
+// Data bytes in a stream data event, the first byte is a sequence number
+#define UART_FRAME_MAX              7
+
+// Baud rate codes
+#define UART_BAUD_1200              0
+#define UART_BAUD_2400              1
+#define UART_BAUD_4800              2
+#define UART_BAUD_9600              3
+#define UART_BAUD_19200             4
+#define UART_BAUD_38400             5
+#define UART_BAUD_57600             6
+#define UART_BAUD_115200            7
+#define UART_BAUD_230400            8
+#define UART_BAUD_460800            9
+#define UART_BAUD_CODES             10
+
+// Flags
+#define UART_FLAG_DELIMITER         0x01    // Flush on delimiter byte
+
+#define UART_DEFAULT_BAUD           UART_BAUD_9600
+#define UART_DEFAULT_SIZE           UART_FRAME_MAX
+#define UART_DEFAULT_IDLE           10      // ms
+#define UART_DEFAULT_DELIMITER      0x0d    // CR
+#define UART_DEFAULT_PEER           0xff    // Any node
+
+/*!
+    Set up the UART from pin modes. Call after pins_init().
+*/
+void uart_init( void );
+
+/*!
+    Write default UART configuration to EEPROM
+*/
+void uart_init_eeprom( void );
+
+/*!
+    Idle time and latency clock. Called from the 1 ms tick interrupt only.
+*/
+void uart_tick( void );
+
+/*!
+    Receive and transmit. Called from the low priority interrupt only.
+*/
+void uart_isr( void );
+
+/*!
+    Check for received bytes or a frame waiting for the main loop
+    @return TRUE if doUART() has work to do.
+*/
+uint8_t uart_hasWork( void );
+
+/*!
+    Pack received bytes into stream data events
+*/
+void doUART( void );
+
+/*!
+    Put data of a stream data event in vscp_imsg on the transmit ring
+*/
+void uart_receiveEvent( void );
+
+/*!
+    Compute throughput of the last second. Call once a second.
+*/
+void uart_oneSecond( void );
+
+/*!
+    Read UART register (page REG_PAGE_UART)
+    @param reg Register to read.
+    @return Register content.
+*/
+uint8_t uart_readReg( uint8_t reg );
+
+/*!
+    Write UART register (page REG_PAGE_UART)
+    @param reg Register to write.
+    @param val Value to write.
+    @return Register content after write.
+*/
+uint8_t uart_writeReg( uint8_t reg, uint8_t val );
+
+#endif